@@ -37,8 +37,16 @@ enum class command {
   get_ier = 0x0b,
 
   get_pressure = 0x0c,
-  get_flow = 0x0d,
-  get_volume = 0x0e,
+  get_flow = 0x0d,   /* mL/s */
+  get_volume = 0x0e, /* mL since the start of the breath */
+
+  /* All of the above settings at once, as
+   * RR[4] TV[4] PEEP[4] PIP[4] DWELL[4] IER[4]
+   * set_settings responds with the block as clamped, and it takes effect at
+   * the start of the next breath.  get_settings responds with the settings
+   * in use. */
+  set_settings = 0x0f,
+  get_settings = 0x10,
 
   /* Engineering mode commands */
 
@@ -53,6 +61,69 @@ enum class command {
   reset_vc = 0x27,                /* Reset Ventilation Controller */
   set_solenoidNormalState = 0x28, /* Solenoid normal state (open/closed) */
 
+  /* Control loop timing, in us, since boot or reset_loop_stats.
+   * get_loop_stats responds with
+   *   LOAD[2] MISSED[2] PERIODS[2 * 8]
+   * where LOAD is the time spent running tasks in thousandths, MISSED the
+   * ticks missed, and PERIODS a histogram of the periods of the control loop
+   * (see SCHEDULER_PERIOD_BIN_LIMITS_US).  get_task_stats takes TASK[1], the
+   * position of the task in the task table, and responds with
+   *   MIN[2] MAX[2] MEAN[2] RUNS[2] OVERRUNS[2]
+   * for the time the task takes to run. */
+  get_loop_stats = 0x29,
+  get_task_stats = 0x2a,
+  reset_loop_stats = 0x2b,
+  /* RAM usage, as DATA[2] BSS[2] HEAP_TOP[2] FREE[2] MIN_FREE[2]: the sizes
+   * of .data and .bss, the address of the end of the heap, and the bytes
+   * between the heap and the stack, now and at the deepest the stack has
+   * been.  See memstats.h. */
+  get_memory_stats = 0x2c,
+  /* Captures Setpoint, Input and Output of the PID at control loop rate,
+   * 1 kHz, around a trigger, for downloading afterwards.  arm_capture takes
+   *   TRIGGER[1] THRESHOLD[2] DIV[1] PRE[1]
+   * where TRIGGER is a captureTrigger, THRESHOLD the error, in Pa, for
+   * captureTrigger::error, DIV the ticks per sample (0 counts as 1), and PRE
+   * the samples to keep from before the trigger.  It throws away the last
+   * capture.  get_capture takes FIRST[1], the first sample wanted, and
+   * responds with
+   *   STATE[1] COUNT[1] AT[1] SAMPLE[5 * 4]
+   * where STATE is a captureState, COUNT the samples captured, AT the first
+   * taken at or after the trigger, and each SAMPLE
+   *   SETPOINT[2] INPUT[2] OUTPUT[1]
+   * in Pa and blower PWM duty.  Samples past COUNT are zeros, and COUNT is 0
+   * until STATE is done. */
+  arm_capture = 0x2d,
+  get_capture = 0x2e,
+  /* Tunes the PID from a step test of the blower, run in place of the PID:
+   * the duty is held at BASE, stepped up by STEP and back, then stepped up
+   * again.  start_autotune takes
+   *   BASE[1] STEP[1]
+   * and responds with 1 if it started, or 0 if BASE + STEP is over full
+   * duty or STEP is 0.  stop_autotune hands back to the PID.  get_autotune
+   * responds with
+   *   STATE[1] GAIN[4] TAU[4] DEAD[4] KP[4] KI[4] KD[4]
+   * where STATE is an autotuneState, and the rest the model fitted, once
+   * done: GAIN in Pa per unit of duty, TAU its time constant and DEAD its
+   * dead time, in s, and the gains set from them, as for set_kp etc. */
+  start_autotune = 0x2f,
+  stop_autotune = 0x30,
+  get_autotune = 0x31,
+  /* The PID profile of one phase of the breath, used from the tick the
+   * breath enters the phase.  set_kp etc. set the gain in every profile,
+   * and get_Kp etc. get the inspire profile's.  set_phase_gains takes
+   *   PHASE[1] KP[4] KI[4] KD[4]
+   * where PHASE is 1 for inspire, 2 plateau, 3 expire and 4 expire_dwell,
+   * and responds with 1 if it was set, 0 for any other PHASE.
+   * get_phase_gains takes PHASE[1] and responds with KP[4] KI[4] KD[4], or
+   * zeros. */
+  set_phase_gains = 0x32,
+  get_phase_gains = 0x33,
+  /* Timing of the exhalation solenoid, which switches as each phase of the
+   * breath starts, as SWITCHES[2] LAST_US[2] MAX_US[2] LAST_MS[4]: the
+   * switches since boot, how long after the start of their control loop
+   * tick the last and the slowest were made, and the time of the last. */
+  get_actuator_stats = 0x34,
+
   /* Mixed Engineering/Medical mode commands */
 
   set_periodic = 0x40, /* Periodic transmission mode (Pressure, Flow, Volume) */
@@ -64,10 +135,52 @@ enum class command {
   get_ventilatorMode = 0x46,
   start_ventilator = 0x47, /* Start the ventilator */
   stop_ventilator = 0x48,  /* Stop the ventilator */
+  set_baud = 0x49,         /* Change the serial baud rate, see baudRate */
+  /* Which telemetryChannels to stream as dataID::data_channels, as
+   *   DIV[1] for each channel
+   * where the channel is sent every DIV-th sample, at 100 Hz, and not at all
+   * for 0.  Responds with the same.  get_subscription responds with the
+   * subscription in use.  Independent of set_periodic.  Readings batched
+   * for the old subscription are sent ahead of the response. */
+  set_subscription = 0x4a,
+  get_subscription = 0x4b,
 
   count /* Sentinel */
 };
 
+/*
+ * Every packet, in either direction, starts with PACKET_SOF:
+ *   SOF[1] MSGTYPE[1] ID[1] LEN[1] DATA[LEN] CHECKSUM[2]
+ * The checksum covers everything after SOF.  A receiver which has lost track
+ * of the packets, e.g. because a byte was dropped, throws bytes away until
+ * the next SOF.  SOF can also turn up inside a packet, so a packet found that
+ * way is only trusted once its checksum matches.  A packet which stops
+ * arriving part way through is dropped once the line has been quiet for a
+ * while, so an Interface Controller which waits for each answer is never
+ * out of step for more than one packet.
+ */
+#define PACKET_SOF (0x7e)
+
+/*
+ * Set in the msgType of a command, and of its response, which carries a
+ * request ID: REQ[1], chosen by the Interface Controller, in front of the
+ * usual DATA.  The response echoes it, so the Interface Controller can have
+ * several commands outstanding, even several of the same one, and still
+ * match each response to its command.  Commands without it are answered
+ * without it.
+ */
+#define MSGTYPE_TAGGED (0x08)
+
+/*
+ * Longest packet the Ventilator Controller takes, not counting SOF, and so
+ * the longest DATA of a command, after MSGTYPE[1] ID[1] LEN[1] CHECKSUM[2].
+ * A command with a request ID has one byte fewer for its arguments.  Longer
+ * commands are dropped unanswered.
+ */
+#define PACKET_LEN_MAX (32)
+#define PACKET_DATA_LEN_MAX (PACKET_LEN_MAX - 5)
+#define CMD_TAGGED_ARGS_LEN_MAX (PACKET_DATA_LEN_MAX - 1)
+
 /*
  * Stores all message types that can sent by the Ventilator controller and the
  * GUI
@@ -76,11 +189,19 @@ enum class msgType {
   cmd = 0x00,  /* Command */
   ack = 0x01,  /* Ventilator Controller alarm Ack */
   nAck = 0x02, /* Ventilator Controller alarm Fail */
+  /* Ack and nAck are MSGTYPE[1] SEQ[1] CHECKSUM[2], with SEQ copied from the
+   * alarm they answer.  Several alarms can be waiting for an answer at once. */
+  cmdTagged = 0x08, /* Command with a request ID, see MSGTYPE_TAGGED */
 
   rAck = 0x10,         /* Response Ack */
   rErrChecksum = 0x11, /* Response checksum error */
   rErrMode = 0x12,     /* Response mode error */
   rErrCmd = 0x13,      /* Response cmd error */
+  /* Responses to cmdTagged */
+  rAckTagged = 0x18,
+  rErrChecksumTagged = 0x19,
+  rErrModeTagged = 0x1a,
+  rErrCmdTagged = 0x1b,
 
   status = 0x20, /* Status */
   alarm = 0x30,  /* Alarm */
@@ -97,12 +218,26 @@ enum class dataID {
   vc_boot =
       0x80, /* Status sent when arduino boots (includes software version) */
 
-  /* Alarms */
+  /* Alarms, sent as
+   * SEQ[1] FIRST_SEEN[4] LAST_SEEN[4] COUNT[2] SEVERITY[1] DATA[8]
+   * where COUNT is the number of occurrences the ack covers */
   alarm_1 = 0xA0,
   alarm_2 = 0xA1,
+  /* Raised by the controller's own checks, see alarm_rules.h.  DATA holds
+   * VALUE[4] LIMIT[4], the reading which tripped the alarm and the limit it
+   * crossed, as signed big endian Pa (mL/s for alarm_apnea) */
+  alarm_pressure_high = 0xA2,
+  alarm_pressure_low = 0xA3,
+  alarm_peep_loss = 0xA4,
+  alarm_disconnect = 0xA5,
+  alarm_apnea = 0xA6,
 
   /* Data */
-  data_1 = 0xC0,
+  data_1 = 0xC0,          /* Single reading: time, pressure, volume, flow */
+  data_batch = 0xC1,      /* Batch of readings, see telemetry_codec.h */
+  data_compressed = 0xC2, /* Compressed batch, see telemetry_codec.h */
+  breath_summary = 0xC3,  /* Per-breath metrics, see telemetry_codec.h */
+  data_channels = 0xC4,   /* Subscribed channels, see telemetry_codec.h */
 
   count /* Sentinel */
 };
@@ -110,7 +245,69 @@ enum class dataID {
 // The different periodic data transmission modes
 enum class periodicMode {
   off = 0x00,
-  on = 0x01,
+  on = 0x01,         /* Readings sent as dataID::data_batch */
+  compressed = 0x02, /* Readings sent as dataID::data_compressed */
+
+  count /* Sentinel */
+};
+
+// The readings command::set_subscription can stream.
+enum class telemetryChannel {
+  pressure = 0x00,   /* Patient pressure, Pa */
+  volume = 0x01,     /* mL since the start of the breath */
+  flow = 0x02,       /* mL/s */
+  sensor_raw = 0x03, /* Patient pressure sensor, uncalibrated ADC counts */
+  pid_output = 0x04, /* Blower PWM duty */
+  setpoint = 0x05,   /* Pressure the PID is aiming for, Pa */
+
+  count /* Sentinel */
+};
+
+// What starts a capture, see command::arm_capture.
+enum class captureTrigger {
+  now = 0x00,          /* Straight away */
+  phase_change = 0x01, /* The next change of breath phase */
+  inspire = 0x02,      /* The start of the next inspiration */
+  expire = 0x03,       /* The start of the next expiration */
+  error = 0x04,        /* |Setpoint - Input| reaching THRESHOLD */
+
+  count /* Sentinel */
+};
+
+// How far a capture has got.
+enum class captureState {
+  idle = 0x00,      /* Never armed */
+  armed = 0x01,     /* Waiting for the trigger */
+  triggered = 0x02, /* Taking the samples after the trigger */
+  done = 0x03,      /* Ready to download */
+
+  count /* Sentinel */
+};
+
+// How far command::start_autotune has got.
+enum class autotuneState {
+  idle = 0x00,            /* Not run, or stopped */
+  running = 0x01,         /* Stepping the blower */
+  done = 0x02,            /* The model was fitted and the gains set */
+  failed_pressure = 0x03, /* The pressure went over the safe limit */
+  failed_response = 0x04, /* The pressure hardly moved, or too slowly */
+
+  count /* Sentinel */
+};
+
+// Serial baud rates, as requested by command::set_baud.
+//
+// The link always comes up at b115200.  On set_baud, the Ventilation
+// Controller acks at the current rate and then switches.  The Interface
+// Controller should switch once it has the ack, and send comms_check at the
+// new rate.  If the Ventilation Controller doesn't receive a comms_check
+// within a second of switching, it falls back to b115200; so should the
+// Interface Controller, if it gets no reply to its comms_check.
+enum class baudRate {
+  b115200 = 0x00,
+  b250000 = 0x01,
+  b500000 = 0x02,
+  b1000000 = 0x03,
 
   count /* Sentinel */
 };
@@ -0,0 +1,190 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+// Wire encoding of the values in packet payloads (see packet_types.h).
+//
+// Everything is big endian; floats are sent as their IEEE 754 bits.  Values
+// are read and written in place in the packet buffer, so there's no copying
+// into and out of structs, and nothing depends on the host's byte order.
+//
+//   char payload[wire_size<uint32_t, float>()];
+//   wire_put(&payload[0], Hal.millis());
+//   wire_put(&payload[4], pressure);
+//
+//   WireReader in(data, len);
+//   uint32_t time = in.getUint32();
+//   float pressure = in.getFloat();
+//   if (!in.ok()) { ... payload was too short ... }
+//
+// Shared by the controller and the GUI, so this is header-only, plain C++11.
+
+#include <stdint.h>
+#include <string.h>
+
+// Bytes each type takes on the wire.
+template <typename T> struct WireSize;
+template <> struct WireSize<uint8_t> { static const uint8_t value = 1; };
+template <> struct WireSize<int8_t> { static const uint8_t value = 1; };
+template <> struct WireSize<uint16_t> { static const uint8_t value = 2; };
+template <> struct WireSize<int16_t> { static const uint8_t value = 2; };
+template <> struct WireSize<uint32_t> { static const uint8_t value = 4; };
+template <> struct WireSize<int32_t> { static const uint8_t value = 4; };
+template <> struct WireSize<float> { static const uint8_t value = 4; };
+
+// Total wire size of a sequence of values, for sizing payload buffers at
+// compile time.
+template <typename... Ts> struct WireSizeSum;
+template <> struct WireSizeSum<> { static const uint8_t value = 0; };
+template <typename T, typename... Ts> struct WireSizeSum<T, Ts...> {
+  static const uint8_t value = WireSize<T>::value + WireSizeSum<Ts...>::value;
+};
+template <typename... Ts> constexpr uint8_t wire_size() {
+  return WireSizeSum<Ts...>::value;
+}
+
+/****************************************************************************************
+ *    ENCODING
+ ****************************************************************************************/
+
+inline void wire_put(char *out, uint8_t value) {
+  out[0] = static_cast<char>(value);
+}
+inline void wire_put(char *out, int8_t value) {
+  wire_put(out, static_cast<uint8_t>(value));
+}
+inline void wire_put(char *out, uint16_t value) {
+  out[0] = static_cast<char>(value >> 8);
+  out[1] = static_cast<char>(value);
+}
+inline void wire_put(char *out, int16_t value) {
+  wire_put(out, static_cast<uint16_t>(value));
+}
+inline void wire_put(char *out, uint32_t value) {
+  out[0] = static_cast<char>(value >> 24);
+  out[1] = static_cast<char>(value >> 16);
+  out[2] = static_cast<char>(value >> 8);
+  out[3] = static_cast<char>(value);
+}
+inline void wire_put(char *out, int32_t value) {
+  wire_put(out, static_cast<uint32_t>(value));
+}
+inline void wire_put(char *out, float value) {
+  static_assert(sizeof(float) == sizeof(uint32_t), "float must be 32 bits");
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  wire_put(out, bits);
+}
+
+/****************************************************************************************
+ *    DECODING
+ ****************************************************************************************/
+
+inline uint8_t wire_getUint8(const char *in) {
+  return static_cast<uint8_t>(in[0]);
+}
+inline int8_t wire_getInt8(const char *in) {
+  return static_cast<int8_t>(wire_getUint8(in));
+}
+inline uint16_t wire_getUint16(const char *in) {
+  return static_cast<uint16_t>((wire_getUint8(in) << 8) |
+                               wire_getUint8(in + 1));
+}
+inline int16_t wire_getInt16(const char *in) {
+  return static_cast<int16_t>(wire_getUint16(in));
+}
+inline uint32_t wire_getUint32(const char *in) {
+  return (static_cast<uint32_t>(wire_getUint16(in)) << 16) |
+         wire_getUint16(in + 2);
+}
+inline int32_t wire_getInt32(const char *in) {
+  return static_cast<int32_t>(wire_getUint32(in));
+}
+inline float wire_getFloat(const char *in) {
+  uint32_t bits = wire_getUint32(in);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Reads values one after another out of a payload, without running off its
+// end.  Reads past the end return 0 and clear ok().
+class WireReader {
+public:
+  WireReader(const char *data, uint8_t len)
+      : data_(data), len_(len), pos_(0), ok_(true) {}
+
+  uint8_t getUint8() { return take(1) ? wire_getUint8(at(1)) : 0; }
+  int8_t getInt8() { return take(1) ? wire_getInt8(at(1)) : 0; }
+  uint16_t getUint16() { return take(2) ? wire_getUint16(at(2)) : 0; }
+  int16_t getInt16() { return take(2) ? wire_getInt16(at(2)) : 0; }
+  uint32_t getUint32() { return take(4) ? wire_getUint32(at(4)) : 0; }
+  int32_t getInt32() { return take(4) ? wire_getInt32(at(4)) : 0; }
+  float getFloat() { return take(4) ? wire_getFloat(at(4)) : 0; }
+
+  // False if any read ran past the end of the payload.
+  bool ok() const { return ok_; }
+  // Bytes not yet read.
+  uint8_t remaining() const { return len_ - pos_; }
+
+private:
+  bool take(uint8_t n) {
+    if (n > len_ - pos_) {
+      ok_ = false;
+      pos_ = len_;
+      return false;
+    }
+    pos_ += n;
+    return true;
+  }
+  // Start of the n bytes just taken.
+  const char *at(uint8_t n) const { return data_ + pos_ - n; }
+
+  const char *data_;
+  uint8_t len_;
+  uint8_t pos_;
+  bool ok_;
+};
+
+// Writes values one after another into a payload buffer, without running
+// off its end.  Writes which don't fit are dropped and clear ok().
+class WireWriter {
+public:
+  WireWriter(char *data, uint8_t capacity)
+      : data_(data), capacity_(capacity), len_(0), ok_(true) {}
+
+  template <typename T> void put(T value) {
+    if (WireSize<T>::value > capacity_ - len_) {
+      ok_ = false;
+      return;
+    }
+    wire_put(data_ + len_, value);
+    len_ += WireSize<T>::value;
+  }
+
+  bool ok() const { return ok_; }
+  // Bytes written so far.
+  uint8_t length() const { return len_; }
+
+private:
+  char *data_;
+  uint8_t capacity_;
+  uint8_t len_;
+  bool ok_;
+};
+
+#endif // SERIALIZATION_H
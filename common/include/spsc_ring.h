@@ -0,0 +1,191 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// Fixed size queue for handing values from one context to another without
+// locking: one side only ever produces, with push() or pending() and
+// publish(), and one other only ever consumes, with pop() or peek() and
+// consume().  Used between an ISR and the main loop on the controller, and
+// between two threads in the GUI.
+//
+//   SpscRing<char, 64> ring;
+//   ring.push(c);              // e.g. from the UART RX interrupt
+//   const char *data;
+//   uint8_t n = ring.peek(&data);
+//   ... parse n contiguous bytes ...
+//   ring.consume(n);
+//
+// The indices run freely and are masked on access, so N must be a power of
+// two, and size() is simply head - tail.  Each index is written by only one
+// side, so the ring needs no locking:
+//
+//  - On AVR the indices are single bytes, which the CPU loads and stores
+//    atomically, so N is at most 128.  They're volatile, so that each access
+//    really happens, and fenced with compiler barriers, so that the items
+//    are written before the head publishes them and read before the tail
+//    frees them.  Interrupts are never disabled.
+//  - Elsewhere the indices are std::atomic, published with release stores
+//    and read with acquire loads, and kept on separate cache lines.
+//
+// Shared by the controller and the GUI, so this is header-only, plain C++11.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef __AVR__
+#include <atomic>
+#endif
+
+// Smallest unsigned type whose free-running indices can tell a full ring of
+// N items from an empty one.
+template <size_t N, bool Byte = (N <= 128), bool Word = (N <= 32768)>
+struct SpscRingIndex {
+  typedef uint32_t type;
+};
+template <size_t N, bool Word> struct SpscRingIndex<N, true, Word> {
+  typedef uint8_t type;
+};
+template <size_t N> struct SpscRingIndex<N, false, true> {
+  typedef uint16_t type;
+};
+
+template <typename T, size_t N> class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+#ifdef __AVR__
+  static_assert(N <= 128, "N must fit single byte indices on AVR");
+#endif
+
+public:
+  typedef typename SpscRingIndex<N>::type Index;
+
+  SpscRing() : m_head(0), m_tail(0) {}
+
+  // Empties the ring.  Only while neither side is using it.
+  void clear() {
+    store(m_head, 0);
+    store(m_tail, 0);
+  }
+
+  // Items waiting, as seen from either side.  The other side may change it
+  // at any moment: the producer only ever shrinks it, and the consumer only
+  // ever grows it.
+  Index size() const {
+    return static_cast<Index>(load(m_head) - load(m_tail));
+  }
+  bool empty() const { return size() == 0; }
+
+  // Producer side.  Returns false, and drops the value, if the ring is full.
+  bool push(const T &value) {
+    Index head = m_head.load_relaxed();
+    if (static_cast<Index>(head - load(m_tail)) == N) {
+      return false;
+    }
+    m_items[head & MASK] = value;
+    store(m_head, static_cast<Index>(head + 1));
+    return true;
+  }
+
+  // Producer side.  Free slots.
+  Index space() const { return static_cast<Index>(N - size()); }
+
+  // Producer side.  The slot `offset` places past the newest item, which the
+  // consumer can't see until publish().  For writing several items, or
+  // writing them out of order, before handing them over together.  `offset`
+  // must be less than space().
+  T &pending(Index offset) {
+    return m_items[static_cast<Index>(m_head.load_relaxed() + offset) & MASK];
+  }
+
+  // Producer side.  Hands the first `count` pending() slots to the consumer.
+  void publish(Index count) {
+    store(m_head, static_cast<Index>(m_head.load_relaxed() + count));
+  }
+
+  // Consumer side.  Returns false if the ring is empty.
+  bool pop(T *value) {
+    Index tail = m_tail.load_relaxed();
+    if (tail == load(m_head)) {
+      return false;
+    }
+    *value = m_items[tail & MASK];
+    store(m_tail, static_cast<Index>(tail + 1));
+    return true;
+  }
+
+  // Consumer side.  Points *items at the oldest items and returns how many of
+  // them are contiguous, which may be fewer than size() if they wrap.  They
+  // stay in the ring until consume().
+  Index peek(const T **items) const {
+    Index tail = m_tail.load_relaxed();
+    Index available = static_cast<Index>(load(m_head) - tail);
+    Index to_end = static_cast<Index>(N - (tail & MASK));
+    *items = &m_items[tail & MASK];
+    return available < to_end ? available : to_end;
+  }
+
+  // Consumer side.  Removes `count` items, at most size(), from the ring.
+  void consume(Index count) {
+    store(m_tail, static_cast<Index>(m_tail.load_relaxed() + count));
+  }
+
+private:
+  static const Index MASK = static_cast<Index>(N - 1);
+
+#ifdef __AVR__
+  struct Counter {
+    explicit Counter(Index v) : value(v) {}
+    Index load_relaxed() const { return value; }
+    volatile Index value;
+  };
+  // The barriers keep the compiler from moving item accesses across the
+  // index accesses; the CPU doesn't reorder them.
+  static Index load(const Counter &c) {
+    Index v = c.value;
+    asm volatile("" ::: "memory");
+    return v;
+  }
+  static void store(Counter &c, Index v) {
+    asm volatile("" ::: "memory");
+    c.value = v;
+  }
+
+  T m_items[N];
+  Counter m_head; // Written by the producer
+  Counter m_tail; // Written by the consumer
+#else
+  struct alignas(64) Counter {
+    explicit Counter(Index v) : value(v) {}
+    Index load_relaxed() const {
+      return value.load(std::memory_order_relaxed);
+    }
+    std::atomic<Index> value;
+  };
+  static Index load(const Counter &c) {
+    return c.value.load(std::memory_order_acquire);
+  }
+  static void store(Counter &c, Index v) {
+    c.value.store(v, std::memory_order_release);
+  }
+
+  T m_items[N];
+  // On separate cache lines, so the two threads don't contend for one.
+  Counter m_head; // Written by the producer
+  Counter m_tail; // Written by the consumer
+#endif
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,336 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+// Wire formats of the periodic telemetry payloads, and decoders for them.
+// The controller encodes these (see controller/lib/core/telemetry.h) and the
+// GUI decodes them, so this is header-only, plain C++11.  The breath summary
+// has a fixed layout, so its encoder lives here too.
+
+#include <stdint.h>
+
+#include "serialization.h"
+
+// One reading.
+struct TelemetrySample {
+  uint32_t time_ms; // Since controller boot
+  int32_t pressure_pa;
+  int32_t volume_ml;
+  int32_t flow_ml_s;
+};
+
+/****************************************************************************************
+ *    dataID::data_batch
+ ****************************************************************************************/
+
+// All values are big endian:
+//
+//   TIME[4]   time of the first sample, in ms
+//   COUNT[1]  number of samples that follow
+//   COUNT times:
+//     DT[1]        ms since the previous sample (0 for the first), saturating
+//                  at 255
+//     PRESSURE[2]  signed, Pa
+//     VOLUME[2]    signed, mL
+//     FLOW[2]      signed, mL/s
+static const uint8_t TELEMETRY_BATCH_HEADER_LEN = 5;
+static const uint8_t TELEMETRY_SAMPLE_LEN = 7;
+
+/****************************************************************************************
+ *    dataID::data_channels
+ ****************************************************************************************/
+
+// The channels subscribed to with command::set_subscription, each at its own
+// rate.  A record holds the channels due at one sample time, so only what
+// was asked for is sent.  All values are big endian:
+//
+//   TIME[4]   time of the first record, in ms
+//   COUNT[1]  number of records that follow
+//   COUNT times:
+//     DT[1]     ms since the previous record (0 for the first)
+//     MASK[1]   channels in the record, bit n for telemetryChannel n
+//     VALUE[2]  signed, for each channel in MASK, lowest bit first
+//
+// A record more than 255 ms after the one before starts a new packet.
+static const uint8_t TELEMETRY_CHANNELS = 6; // telemetryChannel::count
+static const uint8_t TELEMETRY_CHANNELS_HEADER_LEN = 5;
+static const uint8_t TELEMETRY_CHANNELS_LEN_MAX = 80;
+
+// One record.  Channels not in `mask` are left as they were.
+struct ChannelRecord {
+  uint32_t time_ms;
+  uint8_t mask;
+  int16_t values[TELEMETRY_CHANNELS];
+};
+
+/****************************************************************************************
+ *    dataID::breath_summary
+ ****************************************************************************************/
+
+// Sent once per breath, when the next one starts.  All values are big endian:
+//
+//   TIME[4]       end of the breath, in ms since controller boot
+//   DURATION[2]   length of the breath, in ms
+//   INSPIRE[2]    time spent in inspiration (ramp and plateau), in ms
+//   PIP[2]        signed, highest pressure, Pa
+//   PEEP[2]       signed, mean pressure over the expiratory dwell, Pa
+//   MEAN[2]       signed, mean pressure over the breath, Pa
+//   MIN[2]        signed, lowest pressure, Pa
+//   VT[2]         signed, highest volume, mL
+//   PEAK_FLOW[2]  signed, highest inspiratory flow, mL/s
+//
+// The breath rate is 60000 / DURATION and the I:E ratio is
+// INSPIRE : DURATION - INSPIRE.
+static const uint8_t BREATH_SUMMARY_LEN = 20;
+
+struct BreathSummary {
+  uint32_t time_ms;
+  uint16_t duration_ms;
+  uint16_t inspire_ms;
+  int16_t pip_pa;
+  int16_t peep_pa;
+  int16_t mean_pa;
+  int16_t min_pa;
+  int16_t vt_ml;
+  int16_t peak_flow_ml_s;
+};
+
+// Breaths per minute; 0 for an empty summary.
+inline float breath_rate(const BreathSummary &summary) {
+  return summary.duration_ms == 0 ? 0.0f : 60000.0f / summary.duration_ms;
+}
+
+// Expiration time over inspiration time, the E of a 1:E ratio; 0 if there
+// was no inspiration.
+inline float breath_ieRatio(const BreathSummary &summary) {
+  return summary.inspire_ms == 0
+             ? 0.0f
+             : static_cast<float>(summary.duration_ms - summary.inspire_ms) /
+                   summary.inspire_ms;
+}
+
+// Writes the BREATH_SUMMARY_LEN byte payload.
+inline void breath_encodeSummary(const BreathSummary &summary, char *out) {
+  wire_put(&out[0], summary.time_ms);
+  wire_put(&out[4], summary.duration_ms);
+  wire_put(&out[6], summary.inspire_ms);
+  wire_put(&out[8], summary.pip_pa);
+  wire_put(&out[10], summary.peep_pa);
+  wire_put(&out[12], summary.mean_pa);
+  wire_put(&out[14], summary.min_pa);
+  wire_put(&out[16], summary.vt_ml);
+  wire_put(&out[18], summary.peak_flow_ml_s);
+}
+
+/****************************************************************************************
+ *    dataID::data_compressed
+ ****************************************************************************************/
+
+// Consecutive readings differ by a few LSBs, so this sends per-channel
+// differences as zigzag varints:
+//
+//   TIME[4]   time of the first sample, in ms, big endian
+//   COUNT[1]  number of samples that follow
+//   COUNT times:
+//     DT        varint, ms since the previous sample (0 for the first)
+//     PRESSURE  zigzag varint, Pa
+//     VOLUME    zigzag varint, mL
+//     FLOW      zigzag varint, mL/s
+//
+// The first sample of each packet is a keyframe, holding absolute values;
+// the others hold the difference from the sample before.  A lost packet thus
+// only loses its own samples.
+//
+// A varint holds 7 bits per byte, least significant first, with the top bit
+// set on all but the last byte.  Zigzag maps signed to unsigned values so
+// that small magnitudes stay small: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+static const uint8_t TELEMETRY_COMPRESSED_HEADER_LEN = 5;
+static const uint8_t VARINT_LEN_MAX = 5;
+static const uint8_t TELEMETRY_COMPRESSED_SAMPLE_LEN_MAX = 4 * VARINT_LEN_MAX;
+
+inline uint32_t zigzag_encode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(-static_cast<int32_t>(
+             static_cast<uint32_t>(value) >> 31));
+}
+
+inline int32_t zigzag_decode(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+// Writes value as a varint; returns its length.  `out` must have room for
+// VARINT_LEN_MAX bytes.
+inline uint8_t varint_put(uint32_t value, char *out) {
+  uint8_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out[len++] = static_cast<char>(value);
+  return len;
+}
+
+// Reads a varint from the `len` bytes at `in`; returns how many bytes it
+// took, or 0 if it's truncated or too long.
+inline uint8_t varint_get(const char *in, uint8_t len, uint32_t *value) {
+  uint32_t result = 0;
+  for (uint8_t i = 0; i < len && i < VARINT_LEN_MAX; i++) {
+    uint8_t b = static_cast<uint8_t>(in[i]);
+    result |= static_cast<uint32_t>(b & 0x7f) << (7 * i);
+    if ((b & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/****************************************************************************************
+ *    DECODERS
+ ****************************************************************************************/
+
+// Decodes a data_batch payload into at most `max` samples.  Returns the
+// number of samples, or -1 if the payload is malformed or has more than
+// `max` samples.
+inline int telemetry_decodeBatch(const char *data, uint8_t len,
+                                 TelemetrySample *out, uint8_t max) {
+  if (len < TELEMETRY_BATCH_HEADER_LEN) {
+    return -1;
+  }
+  uint8_t count = static_cast<uint8_t>(data[4]);
+  if (count > max ||
+      len != TELEMETRY_BATCH_HEADER_LEN + count * TELEMETRY_SAMPLE_LEN) {
+    return -1;
+  }
+
+  uint32_t time = wire_getUint32(data);
+  const char *p = data + TELEMETRY_BATCH_HEADER_LEN;
+  for (uint8_t i = 0; i < count; i++, p += TELEMETRY_SAMPLE_LEN) {
+    time += static_cast<uint8_t>(p[0]);
+    out[i].time_ms = time;
+    out[i].pressure_pa = wire_getInt16(p + 1);
+    out[i].volume_ml = wire_getInt16(p + 3);
+    out[i].flow_ml_s = wire_getInt16(p + 5);
+  }
+  return count;
+}
+
+// Decodes a data_compressed payload into at most `max` samples.  Returns the
+// number of samples, or -1 if the payload is malformed or has more than
+// `max` samples.
+inline int telemetry_decodeCompressed(const char *data, uint8_t len,
+                                      TelemetrySample *out, uint8_t max) {
+  if (len < TELEMETRY_COMPRESSED_HEADER_LEN) {
+    return -1;
+  }
+  uint8_t count = static_cast<uint8_t>(data[4]);
+  if (count > max) {
+    return -1;
+  }
+
+  uint32_t time = wire_getUint32(data);
+  int32_t values[3] = {0, 0, 0};
+  uint8_t pos = TELEMETRY_COMPRESSED_HEADER_LEN;
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t field;
+    uint8_t n = varint_get(data + pos, len - pos, &field);
+    if (n == 0) {
+      return -1;
+    }
+    pos += n;
+    time += field;
+
+    for (uint8_t c = 0; c < 3; c++) {
+      n = varint_get(data + pos, len - pos, &field);
+      if (n == 0) {
+        return -1;
+      }
+      pos += n;
+      // Wraps like the encoder's subtraction did.
+      values[c] = static_cast<int32_t>(static_cast<uint32_t>(values[c]) +
+                                       static_cast<uint32_t>(
+                                           zigzag_decode(field)));
+    }
+
+    out[i].time_ms = time;
+    out[i].pressure_pa = values[0];
+    out[i].volume_ml = values[1];
+    out[i].flow_ml_s = values[2];
+  }
+  return pos == len ? count : -1;
+}
+
+// Decodes a data_channels payload into at most `max` records.  Returns the
+// number of records, or -1 if the payload is malformed or has more than
+// `max` records.
+inline int telemetry_decodeChannels(const char *data, uint8_t len,
+                                    ChannelRecord *out, uint8_t max) {
+  if (len < TELEMETRY_CHANNELS_HEADER_LEN) {
+    return -1;
+  }
+  uint8_t count = static_cast<uint8_t>(data[4]);
+  if (count > max) {
+    return -1;
+  }
+
+  uint32_t time = wire_getUint32(data);
+  uint8_t pos = TELEMETRY_CHANNELS_HEADER_LEN;
+  for (uint8_t i = 0; i < count; i++) {
+    if (len - pos < 2) {
+      return -1;
+    }
+    time += static_cast<uint8_t>(data[pos]);
+    uint8_t mask = static_cast<uint8_t>(data[pos + 1]);
+    pos += 2;
+    if (mask >> TELEMETRY_CHANNELS) {
+      return -1;
+    }
+
+    out[i].time_ms = time;
+    out[i].mask = mask;
+    for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+      if (mask & (1 << c)) {
+        if (len - pos < 2) {
+          return -1;
+        }
+        out[i].values[c] = wire_getInt16(data + pos);
+        pos += 2;
+      }
+    }
+  }
+  return pos == len ? count : -1;
+}
+
+// Decodes a breath_summary payload.  Returns false if it's malformed.
+inline bool breath_decodeSummary(const char *data, uint8_t len,
+                                 BreathSummary *out) {
+  if (len != BREATH_SUMMARY_LEN) {
+    return false;
+  }
+  out->time_ms = wire_getUint32(&data[0]);
+  out->duration_ms = wire_getUint16(&data[4]);
+  out->inspire_ms = wire_getUint16(&data[6]);
+  out->pip_pa = wire_getInt16(&data[8]);
+  out->peep_pa = wire_getInt16(&data[10]);
+  out->mean_pa = wire_getInt16(&data[12]);
+  out->min_pa = wire_getInt16(&data[14]);
+  out->vt_ml = wire_getInt16(&data[16]);
+  out->peak_flow_ml_s = wire_getInt16(&data[18]);
+  return true;
+}
+
+#endif // TELEMETRY_CODEC_H
@@ -37,9 +37,13 @@ limitations under the License.
 // Calibration parameter defaults
 
 // PID parameter defaults
+//
+// Blower PWM duty per kPa (Kp), per kPa*s (Ki) and per kPa/s (Kd) of patient
+// pressure error.  Equivalent to the Kp = 2, Ki = 8 previously tuned against
+// the raw 8-bit sensor reading (~19.6 Pa per step).
 
-#define KP_DEFAULT (2.0)
-#define KI_DEFAULT (8.0)
+#define KP_DEFAULT (102.0)
+#define KI_DEFAULT (408.0)
 #define KD_DEFAULT (0.0)
 
 #endif // VENTILATOR_DEFAULTS_H
@@ -17,13 +17,38 @@ limitations under the License.
 
 #include "checksum.h"
 
+// Bytes which can be summed before s2 could overflow 16 bits, given that both
+// sums start out no larger than 255: 255 + 21 * 255 + 255 * (21 * 22 / 2) is
+// 64515.
+static const uint8_t BLOCK_LEN = 21;
+
+// Partially reduces a sum modulo 255, using 256 == 1 (mod 255).
+static inline uint16_t fold(uint16_t sum) { return (sum & 0xff) + (sum >> 8); }
+
 uint16_t checksum_fletcher16(const char *data, uint8_t count,
                              uint16_t state /*=0*/) {
-  uint8_t s1 = state & 0xff;
-  uint8_t s2 = (state >> 8) & 0xff;
-  for (uint8_t index = 0; index < count; ++index) {
-    s1 = (uint16_t{s1} + static_cast<uint16_t>(data[index])) % 255;
-    s2 = (uint16_t{s2} + uint16_t{s1}) % 255;
+  uint16_t s1 = state & 0xff;
+  uint16_t s2 = (state >> 8) & 0xff;
+
+  // Accumulate a block at a time in 16 bits, rather than reducing modulo 255
+  // after every byte; division is expensive on AVR.
+  while (count > 0) {
+    uint8_t len = count < BLOCK_LEN ? count : BLOCK_LEN;
+    count -= len;
+    do {
+      s1 += static_cast<uint8_t>(*data++);
+      s2 += s1;
+    } while (--len);
+
+    // Two folds bring each sum back to at most 255, and 255 is 0 modulo 255.
+    s1 = fold(fold(s1));
+    s2 = fold(fold(s2));
+    if (s1 == 255) {
+      s1 = 0;
+    }
+    if (s2 == 255) {
+      s2 = 0;
+    }
   }
-  return (uint16_t{s2} << 8) | s1;
+  return (s2 << 8) | s1;
 }
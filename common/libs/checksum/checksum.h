@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef CHECKSUM_H
 #define CHECKSUM_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Computes the fletcher16 checksum for a packet.
@@ -31,6 +32,67 @@ limitations under the License.
 uint16_t checksum_fletcher16(const char *data, uint8_t count,
                              uint16_t state = 0);
 
+// Computes the same checksum as checksum_fletcher16(), over a buffer of any
+// length, using SSE2 or NEON when they're available.  This is for the host
+// side, e.g. checking logged streams in the GUI; on other targets it falls
+// back to portable code.
+uint16_t checksum_fletcher16_simd(const char *data, size_t count,
+                                  uint16_t state = 0);
+
+// Streaming form of checksum_fletcher16(), for checksumming a message as it
+// arrives.  Adding a byte costs two additions and no division, so it's cheap
+// enough to do as each byte is received.
+//
+//   Fletcher16 csum;
+//   csum.add(header, sizeof(header));
+//   csum.add(byte);
+//   uint16_t result = csum.value();
+//
+// This is plain C++11 so that the GUI can share it.
+class Fletcher16 {
+public:
+  explicit Fletcher16(uint16_t state = 0)
+      : s1_((state & 0xff) % 255), s2_(((state >> 8) & 0xff) % 255) {}
+
+  void reset() {
+    s1_ = 0;
+    s2_ = 0;
+  }
+
+  void add(char c) {
+    // s1_ and s2_ are both less than 255, so a single subtraction reduces
+    // each sum modulo 255.
+    uint16_t s1 = uint16_t{s1_} + static_cast<uint8_t>(c);
+    if (s1 >= 255) {
+      s1 -= 255;
+    }
+    uint16_t s2 = uint16_t{s2_} + s1;
+    if (s2 >= 255) {
+      s2 -= 255;
+    }
+    s1_ = static_cast<uint8_t>(s1);
+    s2_ = static_cast<uint8_t>(s2);
+  }
+
+  void add(const char *data, uint8_t count) {
+    for (uint8_t i = 0; i < count; ++i) {
+      add(data[i]);
+    }
+  }
+
+  // The checksum of everything added so far; can be passed back in as the
+  // `state` of checksum_fletcher16() or Fletcher16().
+  uint16_t value() const { return static_cast<uint16_t>((s2_ << 8) | s1_); }
+
+  // For a packet ending in its check bytes, true if the packet is intact.
+  // See checksum_check().
+  bool valid() const { return s1_ == 0 && s2_ == 0; }
+
+private:
+  uint8_t s1_;
+  uint8_t s2_;
+};
+
 // Computes check bytes for a fletcher16 checksum.
 //
 // Given a packet p and checksum(p) == c, check_bytes_fletcher16(c) returns two
@@ -0,0 +1,147 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "checksum.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CHECKSUM_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHECKSUM_NEON
+#endif
+
+// The vector code handles 16 byte blocks.  Over a block b[0..15],
+//
+//   s1' = s1 + sum(b[i])
+//   s2' = s2 + 16 * s1 + sum((16 - i) * b[i])
+//
+// so it only needs the plain and weighted sums of each block.  These are
+// accumulated in 32 bit lanes for up to CHUNK_BLOCKS blocks, comfortably
+// short of overflowing, and then folded into s1 and s2.
+static const size_t BLOCK_LEN = 16;
+static const size_t CHUNK_BLOCKS = 256;
+
+// Bytes which the scalar code can sum in 32 bits before reducing.
+static const size_t SCALAR_CHUNK_LEN = 4096;
+
+static void scalar_sums(const uint8_t *data, size_t count, uint64_t *s1,
+                        uint64_t *s2) {
+  while (count > 0) {
+    size_t len = count < SCALAR_CHUNK_LEN ? count : SCALAR_CHUNK_LEN;
+    count -= len;
+    uint32_t a = static_cast<uint32_t>(*s1);
+    uint32_t b = static_cast<uint32_t>(*s2);
+    for (size_t i = 0; i < len; i++) {
+      a += data[i];
+      b += a;
+    }
+    data += len;
+    *s1 = a % 255;
+    *s2 = b % 255;
+  }
+}
+
+#if defined(CHECKSUM_SSE2) || defined(CHECKSUM_NEON)
+
+// Computes, over `blocks` 16 byte blocks, the sum of all bytes, the sum of
+// each block's weighted sum, and the sum over blocks of the bytes in the
+// blocks before it.
+static void chunk_sums(const uint8_t *data, size_t blocks, uint64_t *sum,
+                       uint64_t *weighted, uint64_t *prefix) {
+#if defined(CHECKSUM_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+  const __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+  __m128i vsum = zero;
+  __m128i vprefix = zero;
+  __m128i vweighted = zero;
+  for (size_t i = 0; i < blocks; i++) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    data += BLOCK_LEN;
+    vprefix = _mm_add_epi64(vprefix, vsum);
+    vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+    vweighted = _mm_add_epi32(
+        vweighted, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights_lo));
+    vweighted = _mm_add_epi32(
+        vweighted, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights_hi));
+  }
+
+  uint64_t lanes64[2];
+  uint32_t lanes32[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes64), vsum);
+  *sum = lanes64[0] + lanes64[1];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes64), vprefix);
+  *prefix = lanes64[0] + lanes64[1];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes32), vweighted);
+  *weighted = uint64_t{lanes32[0]} + lanes32[1] + lanes32[2] + lanes32[3];
+#else
+  static const uint8_t weights[BLOCK_LEN] = {16, 15, 14, 13, 12, 11, 10, 9,
+                                             8,  7,  6,  5,  4,  3,  2,  1};
+  const uint8x8_t weights_lo = vld1_u8(weights);
+  const uint8x8_t weights_hi = vld1_u8(weights + 8);
+  uint32x4_t vsum = vdupq_n_u32(0);
+  uint32x4_t vprefix = vdupq_n_u32(0);
+  uint32x4_t vweighted = vdupq_n_u32(0);
+  for (size_t i = 0; i < blocks; i++) {
+    uint8x16_t v = vld1q_u8(data);
+    data += BLOCK_LEN;
+    vprefix = vaddq_u32(vprefix, vsum);
+    vsum = vpadalq_u16(vsum, vpaddlq_u8(v));
+    uint16x8_t products = vmull_u8(vget_low_u8(v), weights_lo);
+    products = vmlal_u8(products, vget_high_u8(v), weights_hi);
+    vweighted = vpadalq_u16(vweighted, products);
+  }
+
+  uint32_t lanes[4];
+  vst1q_u32(lanes, vsum);
+  *sum = uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+  vst1q_u32(lanes, vprefix);
+  *prefix = uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+  vst1q_u32(lanes, vweighted);
+  *weighted = uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+#endif
+}
+
+#endif // CHECKSUM_SSE2 || CHECKSUM_NEON
+
+uint16_t checksum_fletcher16_simd(const char *data, size_t count,
+                                  uint16_t state /*=0*/) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  uint64_t s1 = (state & 0xff) % 255;
+  uint64_t s2 = ((state >> 8) & 0xff) % 255;
+
+#if defined(CHECKSUM_SSE2) || defined(CHECKSUM_NEON)
+  size_t blocks = count / BLOCK_LEN;
+  count -= blocks * BLOCK_LEN;
+  while (blocks > 0) {
+    size_t n = blocks < CHUNK_BLOCKS ? blocks : CHUNK_BLOCKS;
+    blocks -= n;
+
+    uint64_t sum, weighted, prefix;
+    chunk_sums(bytes, n, &sum, &weighted, &prefix);
+    bytes += n * BLOCK_LEN;
+
+    s2 = (s2 + BLOCK_LEN * (n * s1 + prefix) + weighted) % 255;
+    s1 = (s1 + sum) % 255;
+  }
+#endif
+
+  scalar_sums(bytes, count, &s1, &s2);
+  return static_cast<uint16_t>((s2 << 8) | s1);
+}
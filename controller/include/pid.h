@@ -15,30 +15,17 @@ limitations under the License.
 #ifndef PID_H
 #define PID_H
 
-#include <PID_v1.h>
-
 #include "hal.h"
+#include "sensors.h"
+
+inline constexpr AnalogPinId DPSENSOR_PIN = PressureSensors::PATIENT_PIN;
 
-inline constexpr AnalogPinId DPSENSOR_PIN = AnalogPinId::HAL_A0;
-inline constexpr PwmPinId BLOWERSPD_PIN = PwmPinId::PWM_3;
-inline constexpr int BLOWER_HIGH = 142;
-inline constexpr int BLOWER_LOW = 130;
-
-// state machine variables
-inline constexpr int INSPIRE_TIME = 1600;
-inline constexpr int INSPIRE_RATE = 1;
-inline constexpr int PIP = 142;
-inline constexpr int INSPIRE_DWELL = 800;
-inline constexpr int INSPIRE_DWELL_PRESSURE = 140;
-inline constexpr int EXPIRE_TIME = 1000;
-inline constexpr int EXPIRE_RATE = 1;
-inline constexpr int PEEP = 130;
-inline constexpr int EXPIRE_DWELL = 600;
+// Blower PWM duty limits.
+inline constexpr int16_t BLOWER_MIN = 0;
+inline constexpr int16_t BLOWER_MAX = 255;
 
 // not implemented yet
 inline constexpr int AC = 0;
-inline constexpr int RR = 0;
-inline constexpr int IE = 0;
 
 void pid_execute();
 void pid_init();
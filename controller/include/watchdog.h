@@ -23,6 +23,5 @@ limitations under the License.
 
 void watchdog_init();
 void watchdog_handler();
-void watchdog_reboot();
 
 #endif // WATCHDOG_H
@@ -0,0 +1,124 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "actuators.h"
+#include "parameters.h"
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+static const uint32_t COUNTS_PER_US = HalApi::LOOP_TIMER_HZ / 1000000;
+
+static DigitalOutput solenoid;
+// Levels of the solenoid pin for open and closed, for its normal state.
+static VoltageLevel openLevel;
+static VoltageLevel closedLevel;
+static bool solenoidIsOpen;
+// Set by actuators_holdSolenoidClosed(), while phases don't switch it.
+static bool solenoidHeld;
+
+static bool blowerEnabled;
+
+static actuatorStats_t stats;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static void load_polarity() {
+  // A normally open valve is open unpowered.
+  bool normallyOpen = parameters_getSolenoidNormalState() ==
+                      solenoidNormaleState::normally_open;
+  openLevel = normallyOpen ? VoltageLevel::HAL_LOW : VoltageLevel::HAL_HIGH;
+  closedLevel = normallyOpen ? VoltageLevel::HAL_HIGH : VoltageLevel::HAL_LOW;
+}
+
+static void set_solenoid(bool open) {
+  solenoid.write(open ? openLevel : closedLevel);
+  solenoidIsOpen = open;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void actuators_init() {
+  Hal.pwmStart(ACTUATORS_BLOWER_PIN);
+  blowerEnabled = true;
+
+  solenoid.init(ACTUATORS_SOLENOID_PIN);
+  load_polarity();
+  set_solenoid(true);
+  solenoidHeld = false;
+  stats = actuatorStats_t();
+}
+
+void actuators_setBlower(int16_t duty) {
+  if (!blowerEnabled) {
+    return;
+  }
+  Hal.pwmWrite(ACTUATORS_BLOWER_PIN,
+               (uint8_t)(duty < 0 ? 0 : duty > UINT8_MAX ? UINT8_MAX : duty));
+}
+
+void actuators_disableBlower() {
+  Hal.pwmStop(ACTUATORS_BLOWER_PIN);
+  blowerEnabled = false;
+}
+
+void actuators_enableBlower() {
+  if (!blowerEnabled) {
+    Hal.pwmStart(ACTUATORS_BLOWER_PIN);
+    blowerEnabled = true;
+  }
+}
+
+void actuators_startPhase(pid_fsm_state phase) {
+  if (solenoidHeld) {
+    return;
+  }
+  bool open = phase != pid_fsm_state::inspire &&
+              phase != pid_fsm_state::plateau;
+  if (open == solenoidIsOpen) {
+    return;
+  }
+  if (phase == pid_fsm_state::inspire) {
+    load_polarity();
+  }
+  set_solenoid(open);
+
+  stats.last_us = (uint16_t)(Hal.loopTimerTickCounts() / COUNTS_PER_US);
+  if (stats.last_us > stats.max_us) {
+    stats.max_us = stats.last_us;
+  }
+  stats.switches++;
+  stats.last_ms = Hal.millis();
+}
+
+void actuators_holdSolenoidClosed() {
+  solenoidHeld = false;
+  actuators_startPhase(pid_fsm_state::inspire);
+  solenoidHeld = true;
+}
+
+void actuators_releaseSolenoid(pid_fsm_state phase) {
+  solenoidHeld = false;
+  actuators_startPhase(phase);
+}
+
+bool actuators_solenoidOpen() { return solenoidIsOpen; }
+
+void actuators_getStats(actuatorStats_t *out) { *out = stats; }
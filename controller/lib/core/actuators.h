@@ -0,0 +1,71 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef ACTUATORS_H
+#define ACTUATORS_H
+
+#include <stdint.h>
+
+#include "breath.h"
+#include "hal.h"
+
+// The blower and the exhalation solenoid.
+//
+// The blower runs off Timer2 at 31.4 kHz, see HalApi::pwmStart(), out of
+// hearing and with far less ripple in its speed than at the default PWM
+// rate.  The solenoid is switched at the tick each phase of the breath
+// starts in: closed for inspire and plateau, so the patient circuit holds
+// pressure, and open for expire and expire_dwell, and before the first
+// breath.  Its pin is written straight to the port, with the polarity for
+// its normal state looked up at each breath rather than at each write, so a
+// change of parameters_setSolenoidNormalState() takes effect at the next
+// breath.
+
+inline constexpr PwmPinId ACTUATORS_BLOWER_PIN = PwmPinId::PWM_3;
+// TBC
+inline constexpr int ACTUATORS_SOLENOID_PIN = 5;
+
+// How soon after the start of their tick the solenoid switches were made.
+struct actuatorStats_t {
+  uint16_t switches; /* Since boot */
+  uint16_t last_us;  /* Latency of the last switch */
+  uint16_t max_us;   /* Worst latency */
+  uint32_t last_ms;  /* Hal.millis() at the last switch */
+};
+
+// The blower stopped, and the solenoid open.
+void actuators_init();
+
+// Sets the blower's duty, clamped to [0, 255].  Ignored while it's disabled.
+void actuators_setBlower(int16_t duty);
+// Stops the blower, with its pin held low rather than at a duty of 0, until
+// actuators_enableBlower().
+void actuators_disableBlower();
+// Starts the blower again, at a duty of 0.
+void actuators_enableBlower();
+
+// Switches the solenoid for `phase`.  Call as soon as the breath enters it.
+void actuators_startPhase(pid_fsm_state phase);
+// Closes the solenoid, as for inspire, and keeps it closed whatever phases
+// start until actuators_releaseSolenoid(), which switches it for the phase
+// the breath is then in.  For the autotune's step test, which needs the
+// patient circuit to stay the same plant throughout.
+void actuators_holdSolenoidClosed();
+void actuators_releaseSolenoid(pid_fsm_state phase);
+bool actuators_solenoidOpen();
+
+void actuators_getStats(actuatorStats_t *stats);
+
+#endif // ACTUATORS_H
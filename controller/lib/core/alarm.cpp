@@ -12,92 +12,162 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <string.h>
+
 #include "hal.h"
 
 #include "alarm.h"
 
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+// Ring buffer of alarms, kept sorted from head to tail by descending severity
+// and then by time of first occurrence.
 namespace {
-struct alarm_stack_t {
+struct alarm_queue_t {
   alarm_t alarm[ALARM_NODES];
-  int8_t top;
+  uint8_t head;
+  uint8_t size;
+  uint16_t dropped;
+  bool added; /* alarm_add() called since alarm_takeAdded() */
 };
 
-alarm_stack_t stack;
+alarm_queue_t queue;
 } // anonymous namespace
 
-static bool stack_full() {
-  return (stack.top == (ALARM_NODES - 1)) ? true : false;
-}
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
 
-static bool stack_empty() { return (stack.top == -1) ? true : false; }
+// Entry at position pos counted from the head
+static alarm_t *queue_at(uint8_t pos) {
+  return &queue.alarm[(queue.head + pos) % ALARM_NODES];
+}
 
-static int32_t stack_peek(alarm_t **alarm) {
-  int32_t return_status = VC_STATUS_FAILURE;
-  if (!stack_empty()) {
-    *alarm = &stack.alarm[stack.top];
-    return_status = VC_STATUS_SUCCESS;
+static void queue_countDrop() {
+  if (queue.dropped < UINT16_MAX) {
+    queue.dropped++;
   }
-  return return_status;
 }
 
-static int32_t stack_pop(alarm_t **alarm) {
-  int32_t return_status = VC_STATUS_FAILURE;
-  if (!stack_empty()) {
-    *alarm = &stack.alarm[stack.top];
-    stack.top--;
-    return_status = VC_STATUS_SUCCESS;
+static int8_t queue_find(enum dataID alarmID) {
+  for (uint8_t pos = 0; pos < queue.size; pos++) {
+    if (queue_at(pos)->alarm == alarmID) {
+      return pos;
+    }
   }
-  return return_status;
+  return -1;
 }
 
-static void stack_push(alarm_t alarm) {
-  if (!stack_full()) {
-    stack.top++;
-    stack.alarm[stack.top] = alarm;
+static void queue_erase(uint8_t pos) {
+  for (; pos + 1 < queue.size; pos++) {
+    *queue_at(pos) = *queue_at(pos + 1);
   }
+  queue.size--;
 }
 
-void alarm_init() { stack.top = -1; }
-
-void alarm_add(enum dataID alarmID, char *data) {
-  alarm_t alarm;
-  if (!stack_full()) {
-    // No point spending time doing these operations if the stack is full
-    alarm.alarm = alarmID;
-    alarm.timestamp = Hal.millis();
-
-    // Copy alarm data
-    for (uint8_t idx = 0; idx < ALARM_DATALEN; idx++) {
-      alarm.data[idx] = *(data + idx);
+// Inserts behind every alarm of the same or higher severity, so that alarms
+// of equal severity stay in order of arrival.
+static void queue_insert(const alarm_t &alarm) {
+  if (queue.size == ALARM_NODES) {
+    if (queue_at(ALARM_NODES - 1)->severity >= alarm.severity) {
+      // Nothing less severe to make room for this one
+      queue_countDrop();
+      return;
     }
+    queue.size--;
+    queue_countDrop();
+  }
 
-    stack_push(alarm);
-  } else {
-    // Stack full, ignore alarm
-    // TODO Log this
+  uint8_t pos = queue.size;
+  while (pos > 0 && queue_at(pos - 1)->severity < alarm.severity) {
+    *queue_at(pos) = *queue_at(pos - 1);
+    pos--;
   }
+  *queue_at(pos) = alarm;
+  queue.size++;
 }
 
-bool alarm_available() { return (stack_empty() == false) ? true : false; }
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
 
-void alarm_remove() {
-  alarm_t *alarm;
-  stack_pop(&alarm); // Don't need this alarm anymore, remove it
+void alarm_init() {
+  queue.head = 0;
+  queue.size = 0;
+  queue.dropped = 0;
+  queue.added = false;
 }
 
-int32_t alarm_read(enum dataID *alarmID, uint32_t *timestamp, char *data) {
-  int32_t return_status = VC_STATUS_FAILURE;
-  alarm_t *alarm;
-  return_status = stack_peek(&alarm);
+void alarm_add(enum dataID alarmID, char *data, enum alarmSeverity severity) {
+  uint32_t now = Hal.millis();
+  int8_t pos = queue_find(alarmID);
+  queue.added = true;
 
-  if (return_status == VC_STATUS_SUCCESS) {
-    *alarmID = (enum dataID)alarm->alarm;
-    *timestamp = alarm->timestamp;
+  if (pos >= 0) {
+    // Already queued, coalesce with the existing entry
+    alarm_t alarm = *queue_at(pos);
+    if (alarm.count < UINT16_MAX) {
+      alarm.count++;
+    }
+    alarm.last_seen = now;
+    memcpy(alarm.data, data, ALARM_DATALEN);
 
-    for (uint8_t idx = 0; idx < ALARM_DATALEN; idx++) {
-      *(data + idx) = alarm->data[idx];
+    if (severity <= alarm.severity) {
+      *queue_at(pos) = alarm;
+      return;
     }
+    // Raised to a higher severity, move it forward
+    alarm.severity = severity;
+    queue_erase(pos);
+    queue_insert(alarm);
+    return;
   }
 
-  return return_status;
+  alarm_t alarm;
+  alarm.alarm = alarmID;
+  alarm.severity = severity;
+  alarm.count = 1;
+  alarm.timestamp = now;
+  alarm.last_seen = now;
+  memcpy(alarm.data, data, ALARM_DATALEN);
+  queue_insert(alarm);
 }
+
+bool alarm_available() { return queue.size > 0; }
+
+bool alarm_takeAdded() {
+  bool added = queue.added;
+  queue.added = false;
+  return added;
+}
+
+void alarm_remove(enum dataID alarmID, uint16_t count) {
+  int8_t pos = queue_find(alarmID);
+  if (pos < 0) {
+    return;
+  }
+
+  alarm_t *alarm = queue_at(pos);
+  if (alarm->count > count) {
+    alarm->count -= count;
+  } else if (pos == 0) {
+    queue.head = (queue.head + 1) % ALARM_NODES;
+    queue.size--;
+  } else {
+    queue_erase(pos);
+  }
+}
+
+int32_t alarm_read(alarm_t *alarm) { return alarm_readAt(0, alarm); }
+
+int32_t alarm_readAt(uint8_t pos, alarm_t *alarm) {
+  if (pos >= queue.size) {
+    return VC_STATUS_FAILURE;
+  }
+  *alarm = *queue_at(pos);
+  return VC_STATUS_SUCCESS;
+}
+
+uint16_t alarm_getDropped() { return queue.dropped; }
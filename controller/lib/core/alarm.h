@@ -22,22 +22,56 @@ limitations under the License.
 #include "packet_types.h"
 
 /* Number of alarms we can store in the queue */
-#define ALARM_NODES 4
+#define ALARM_NODES 6
 
 // Each alarm can store 8 bytes - modifying this would mean modifying the
 // memory copies.
 #define ALARM_DATALEN 8
 
+// Alarms with a higher severity are sent to the Interface Controller first.
+enum class alarmSeverity : uint8_t {
+  low = 0,
+  medium = 1,
+  high = 2,
+
+  count /* Sentinel */
+};
+
+// One entry in the alarm queue.  Repeats of an alarm that is still queued are
+// coalesced into its entry: count goes up, last_seen and data are taken from
+// the latest occurrence, and timestamp keeps the first.
 struct alarm_t {
   dataID alarm;
-  uint32_t timestamp;
+  alarmSeverity severity;
+  uint16_t count;      /* Occurrences not yet acknowledged */
+  uint32_t timestamp;  /* Time of the first occurrence */
+  uint32_t last_seen;  /* Time of the latest occurrence */
   char data[ALARM_DATALEN];
 };
 
 void alarm_init();
-void alarm_add(enum dataID alarm, char *data);
-int32_t alarm_read(enum dataID *alarmID, uint32_t *timestamp, char *data);
+void alarm_add(enum dataID alarm, char *data,
+               enum alarmSeverity severity = alarmSeverity::medium);
+
+// Copies the alarm at the head of the queue, i.e. the oldest of the most
+// severe alarms.
+int32_t alarm_read(alarm_t *alarm);
+// Copies the alarm pos places behind the head.  Fails past the end of the
+// queue.
+int32_t alarm_readAt(uint8_t pos, alarm_t *alarm);
 bool alarm_available();
-void alarm_remove();
+
+// Returns true if alarm_add() has been called since the last call, so that
+// the transmitter only looks at the queue when it may have changed.
+bool alarm_takeAdded();
+
+// Removes count acknowledged occurrences of the given alarm.  If the alarm was
+// raised again after it was read, the entry stays queued with the remainder.
+void alarm_remove(enum dataID alarm, uint16_t count);
+
+// Number of alarms lost because the queue was full: either a new alarm that
+// was not more severe than anything queued, or the least severe alarm pushed
+// out by a new one.  Saturates.
+uint16_t alarm_getDropped();
 
 #endif // ALARM_H
@@ -0,0 +1,187 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "alarm_rules.h"
+
+#include "alarm.h"
+#include "parameters.h"
+#include "scheduler.h"
+#include "serialization.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// The reading a rule looks at.
+enum class alarmSignal : uint8_t { pressure, flow };
+
+// Bit masks of the phases a rule is evaluated in.
+static constexpr uint8_t phase_bit(pid_fsm_state phase) {
+  return static_cast<uint8_t>(1 << static_cast<uint8_t>(phase));
+}
+static const uint8_t PHASES_INSPIRATION =
+    phase_bit(pid_fsm_state::inspire) | phase_bit(pid_fsm_state::plateau);
+static const uint8_t PHASES_BREATHING =
+    PHASES_INSPIRATION | phase_bit(pid_fsm_state::expire) |
+    phase_bit(pid_fsm_state::expire_dwell);
+
+static constexpr uint16_t ms_to_ticks(uint32_t ms) {
+  return static_cast<uint16_t>(ms * SCHEDULER_TICK_HZ / 1000);
+}
+
+static constexpr int16_t cmh2o_to_pa(float cmh2o) {
+  return static_cast<int16_t>(cmh2o * PA_PER_CMH2O + 0.5f);
+}
+
+struct alarm_rule_t {
+  dataID alarm;
+  alarmSeverity severity;
+  alarmSignal signal;
+  bool below;    /* Trips below the limit, rather than above */
+  uint8_t phases;
+  uint16_t debounce_ticks;
+  int16_t hysteresis; /* Pa or mL/s */
+};
+
+// In the order of enum alarmRule.
+static const alarm_rule_t RULES[] = {
+    {dataID::alarm_pressure_high, alarmSeverity::high, alarmSignal::pressure,
+     false, PHASES_BREATHING, ms_to_ticks(20), cmh2o_to_pa(2.0f)},
+    {dataID::alarm_pressure_low, alarmSeverity::medium, alarmSignal::pressure,
+     true, phase_bit(pid_fsm_state::plateau), ms_to_ticks(100),
+     cmh2o_to_pa(1.0f)},
+    {dataID::alarm_peep_loss, alarmSeverity::medium, alarmSignal::pressure,
+     true, phase_bit(pid_fsm_state::expire_dwell), ms_to_ticks(200),
+     cmh2o_to_pa(1.0f)},
+    {dataID::alarm_disconnect, alarmSeverity::high, alarmSignal::pressure,
+     true, PHASES_INSPIRATION, ms_to_ticks(500), cmh2o_to_pa(1.0f)},
+    {dataID::alarm_apnea, alarmSeverity::high, alarmSignal::flow, true,
+     PHASES_BREATHING, ms_to_ticks(20000), 0},
+};
+static_assert(sizeof(RULES) / sizeof(RULES[0]) ==
+                  static_cast<uint8_t>(alarmRule::count),
+              "RULES must have an entry for each alarmRule");
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+struct alarm_rule_state_t {
+  int32_t limit;
+  uint16_t ticks; /* Consecutive ticks past the limit */
+  bool active;
+};
+
+static alarm_rule_state_t ruleStates[static_cast<uint8_t>(alarmRule::count)];
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static int32_t pressure_limit_pa(float cmh2o) {
+  return static_cast<int32_t>(cmh2o * PA_PER_CMH2O);
+}
+
+static int32_t rule_limit(alarmRule rule) {
+  float pip = parameters_getPIP();
+  float peep = parameters_getPEEP();
+
+  switch (rule) {
+  case alarmRule::pressure_high: {
+    float limit = pip + ALARM_PRESSURE_HIGH_MARGIN_CMH2O;
+    return pressure_limit_pa(limit > PIP_MAX ? static_cast<float>(PIP_MAX)
+                                             : limit);
+  }
+  case alarmRule::pressure_low:
+    return pressure_limit_pa(pip - ALARM_PRESSURE_LOW_MARGIN_CMH2O);
+  case alarmRule::peep_loss:
+    return pressure_limit_pa(peep - ALARM_PEEP_LOSS_MARGIN_CMH2O);
+  case alarmRule::disconnect:
+    return pressure_limit_pa(pip / 2 < ALARM_DISCONNECT_CMH2O
+                                 ? pip / 2
+                                 : ALARM_DISCONNECT_CMH2O);
+  case alarmRule::apnea:
+    return ALARM_APNEA_FLOW_ML_S;
+  default:
+    return 0;
+  }
+}
+
+static void raise_alarm(const alarm_rule_t &rule, int32_t value,
+                        int32_t limit) {
+  // VALUE[4] LIMIT[4]
+  char data[ALARM_DATALEN];
+  static_assert(wire_size<int32_t, int32_t>() == ALARM_DATALEN,
+                "Alarm data doesn't fit");
+  wire_put(&data[0], value);
+  wire_put(&data[wire_size<int32_t>()], limit);
+  alarm_add(rule.alarm, data, rule.severity);
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void alarmRules_init() {
+  for (alarm_rule_state_t &state : ruleStates) {
+    state.ticks = 0;
+    state.active = false;
+  }
+  alarmRules_startBreath();
+}
+
+void alarmRules_startBreath() {
+  for (uint8_t i = 0; i < static_cast<uint8_t>(alarmRule::count); i++) {
+    ruleStates[i].limit = rule_limit(static_cast<alarmRule>(i));
+  }
+}
+
+void alarmRules_evaluate(pid_fsm_state phase, int32_t pressure_pa,
+                         int32_t flow_ml_s) {
+  uint8_t phase_mask = phase_bit(phase);
+
+  for (uint8_t i = 0; i < static_cast<uint8_t>(alarmRule::count); i++) {
+    const alarm_rule_t &rule = RULES[i];
+    alarm_rule_state_t &state = ruleStates[i];
+    if (!(rule.phases & phase_mask)) {
+      continue;
+    }
+
+    int32_t value =
+        rule.signal == alarmSignal::pressure ? pressure_pa : flow_ml_s;
+    // Distance past the limit, positive once it's crossed.
+    int32_t excess = rule.below ? state.limit - value : value - state.limit;
+
+    if (state.active) {
+      if (excess <= -rule.hysteresis) {
+        state.active = false;
+        state.ticks = 0;
+      }
+    } else if (excess <= 0) {
+      state.ticks = 0;
+    } else if (++state.ticks >= rule.debounce_ticks) {
+      state.active = true;
+      raise_alarm(rule, value, state.limit);
+    }
+  }
+}
+
+bool alarmRules_active(alarmRule rule) {
+  return ruleStates[static_cast<uint8_t>(rule)].active;
+}
+
+int32_t alarmRules_getLimit(alarmRule rule) {
+  return ruleStates[static_cast<uint8_t>(rule)].limit;
+}
@@ -0,0 +1,71 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef ALARM_RULES_H
+#define ALARM_RULES_H
+
+#include <stdint.h>
+
+#include "breath.h"
+
+// Threshold alarms, checked against every reading on the controller rather
+// than by the Interface Controller.
+//
+// Each rule compares one reading against a limit, which is derived from the
+// ventilation parameters at the start of every breath.  A rule trips once
+// the limit has been crossed for a number of consecutive ticks (its
+// debounce), and raises its alarm through alarm_add() when it does.  It then
+// stays active, without raising the alarm again, until the reading comes
+// back past the limit by the rule's hysteresis.  Rules only look at readings
+// taken in some phases of the breath, and keep their state in between.
+enum class alarmRule : uint8_t {
+  pressure_high = 0, /* Pressure above PIP, in any phase */
+  pressure_low = 1,  /* Pressure well below PIP on the plateau */
+  peep_loss = 2,     /* Pressure below PEEP in the expiratory dwell */
+  disconnect = 3,    /* Pressure near zero through inspiration */
+  apnea = 4,         /* No inspiratory flow for a long time */
+
+  count /* Sentinel */
+};
+
+// Margins from the set PIP and PEEP, in cmH2O.  The high pressure limit is
+// also capped at PIP_MAX.
+inline constexpr float ALARM_PRESSURE_HIGH_MARGIN_CMH2O = 10.0f;
+inline constexpr float ALARM_PRESSURE_LOW_MARGIN_CMH2O = 5.0f;
+inline constexpr float ALARM_PEEP_LOSS_MARGIN_CMH2O = 3.0f;
+// Pressure below which the patient circuit is taken to be open; never more
+// than half the set PIP.
+inline constexpr float ALARM_DISCONNECT_CMH2O = 2.0f;
+// Flow which counts as an inspiration for the apnea rule [mL/s]
+inline constexpr int32_t ALARM_APNEA_FLOW_ML_S = 50;
+
+// Clears the state of all rules and computes their limits.
+void alarmRules_init();
+
+// Recomputes the limits from the ventilation parameters.  Call at the start
+// of each breath, which is when the settings take effect.
+void alarmRules_startBreath();
+
+// Checks one tick's readings against the rules.
+void alarmRules_evaluate(pid_fsm_state phase, int32_t pressure_pa,
+                         int32_t flow_ml_s);
+
+// True if the rule has tripped and not yet cleared.
+bool alarmRules_active(alarmRule rule);
+
+// The rule's current limit, in Pa or mL/s.
+int32_t alarmRules_getLimit(alarmRule rule);
+
+#endif // ALARM_RULES_H
@@ -0,0 +1,197 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "autotune.h"
+#include "parameters.h"
+
+/****************************************************************************************
+ *    TYPE DEFINITIONS
+ ****************************************************************************************/
+
+namespace {
+enum class autotunePhase : uint8_t {
+  settle,   /* At BASE, until the pressure is steady */
+  step,     /* At BASE + STEP, for the gain */
+  resettle, /* At BASE again */
+  time,     /* At BASE + STEP, timing the rise */
+};
+} // anonymous namespace
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+static enum autotuneState state = autotuneState::idle;
+static autotunePhase phase;
+static uint8_t base;
+static uint8_t step;
+
+// Ticks into the phase, and the pressure summed over the end of it.
+static uint16_t phaseTick;
+static int32_t sum;
+// Steady pressures at BASE and BASE + STEP, in Pa.
+static int32_t low;
+static int32_t high;
+// Ticks after the timed step at which the pressure got 28.3% of the way, or
+// 0 until it does.
+static uint16_t t28;
+
+static autotuneModel_t model;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+// Adds the pressure to the average over the end of the hold.  Returns true,
+// with the average, at the end of it.
+static bool hold(int32_t input, int32_t *average) {
+  if (phaseTick >= AUTOTUNE_HOLD_TICKS - AUTOTUNE_AVERAGE_TICKS) {
+    sum += input;
+  }
+  if (++phaseTick < AUTOTUNE_HOLD_TICKS) {
+    return false;
+  }
+  *average = sum / AUTOTUNE_AVERAGE_TICKS;
+  return true;
+}
+
+static void next_phase(autotunePhase next) {
+  phase = next;
+  phaseTick = 0;
+  sum = 0;
+}
+
+// Fits the model to the step response timed, and sets the gains from it.
+static void fit(uint16_t t63) {
+  float tau = 1.5f * (t63 - t28) / SCHEDULER_TICK_HZ;
+  float dead = (float)t63 / SCHEDULER_TICK_HZ - tau;
+  if (dead < 0) {
+    dead = 0;
+  }
+  model.gain_pa = (float)(high - low) / step;
+  model.tau_s = tau;
+  model.dead_s = dead;
+
+  // SIMC: Kc = tau / (k * (tc + dead)), Ti = min(tau, 4 * (tc + dead)), with
+  // the plant gain k in kPa, as the PID's gains are.
+  float tc = dead > tau / 2 ? dead : tau / 2;
+  float kp = tau / (model.gain_pa / 1000 * (tc + dead));
+  float ti = 4 * (tc + dead) < tau ? 4 * (tc + dead) : tau;
+  model.kp = kp;
+  model.ki = kp / ti;
+  model.kd = 0;
+
+  parameters_setKp(model.kp);
+  parameters_setKi(model.ki);
+  parameters_setKd(model.kd);
+  state = autotuneState::done;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void autotune_init() { state = autotuneState::idle; }
+
+bool autotune_start(uint8_t baseDuty, uint8_t duty_step) {
+  if (duty_step == 0 || baseDuty + duty_step > UINT8_MAX) {
+    return false;
+  }
+  base = baseDuty;
+  step = duty_step;
+  next_phase(autotunePhase::settle);
+  state = autotuneState::running;
+  return true;
+}
+
+void autotune_stop() {
+  if (state == autotuneState::running) {
+    state = autotuneState::idle;
+  }
+}
+
+bool autotune_running() { return state == autotuneState::running; }
+
+enum autotuneState autotune_getState() { return state; }
+
+void autotune_getModel(autotuneModel_t *out) { *out = model; }
+
+int16_t autotune_tick(int32_t input) {
+  static const int32_t LIMIT_PA =
+      (int32_t)(AUTOTUNE_PRESSURE_LIMIT_CMH2O * PA_PER_CMH2O);
+
+  if (state != autotuneState::running) {
+    return 0;
+  }
+  if (input > LIMIT_PA) {
+    state = autotuneState::failed_pressure;
+    return 0;
+  }
+
+  int32_t average;
+  switch (phase) {
+  case autotunePhase::settle:
+    if (hold(input, &average)) {
+      low = average;
+      next_phase(autotunePhase::step);
+    }
+    break;
+  case autotunePhase::step:
+    if (hold(input, &average)) {
+      high = average;
+      if (high - low < AUTOTUNE_MIN_RESPONSE_PA) {
+        state = autotuneState::failed_response;
+        return base;
+      }
+      next_phase(autotunePhase::resettle);
+    }
+    break;
+  case autotunePhase::resettle:
+    if (hold(input, &average)) {
+      // Times the rise from where the pressure is now, in case it drifted.
+      high += average - low;
+      low = average;
+      t28 = 0;
+      next_phase(autotunePhase::time);
+    }
+    break;
+  case autotunePhase::time: {
+    int32_t rise = input - low;
+    int32_t range = high - low;
+    // The step went out the tick before this phase started.
+    uint16_t elapsed = phaseTick + 1;
+    if (t28 == 0 && rise * 1000 >= range * 283) {
+      t28 = elapsed;
+    }
+    if (t28 != 0 && rise * 1000 >= range * 632) {
+      if (elapsed == t28) {
+        // Faster than the loop can tell
+        state = autotuneState::failed_response;
+        return base;
+      }
+      fit(elapsed);
+      return base + step;
+    }
+    if (++phaseTick >= AUTOTUNE_HOLD_TICKS) {
+      state = autotuneState::failed_response;
+      return base;
+    }
+    break;
+  }
+  }
+
+  bool stepped = phase == autotunePhase::step || phase == autotunePhase::time;
+  return stepped ? base + step : base;
+}
@@ -0,0 +1,74 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdint.h>
+
+#include "breath.h"
+#include "packet_types.h"
+#include "scheduler.h"
+
+// PID autotune from a step test, see command::start_autotune.
+//
+// While it runs, autotune_tick() drives the blower in place of the PID.  The
+// pressure is let settle at the BASE duty, then the duty is stepped up by
+// STEP and held until it settles again, which gives the gain of the plant.
+// Then the same again, timing how long the pressure takes to get 28.3% and
+// 63.2% of the way, which for a first order plant with dead time gives its
+// time constant and dead time (Smith's two point method).  Doing the step
+// twice saves storing the response.
+//
+// The PI gains are set from the model by the SIMC rules, for a closed loop
+// time constant of the larger of the dead time and half the plant's, and
+// saved like any other change of the gains.
+
+// Each hold, of the duty and of the pressure, is as long as this.  Several
+// time constants of the lung.
+inline constexpr uint16_t AUTOTUNE_HOLD_TICKS = 3 * SCHEDULER_TICK_HZ;
+// The steady pressure is averaged over the end of each hold.
+inline constexpr uint16_t AUTOTUNE_AVERAGE_TICKS = 256;
+// Stopped for safety at this pressure.
+inline constexpr float AUTOTUNE_PRESSURE_LIMIT_CMH2O = 40.0f;
+// A step which moves the pressure less than this can't be timed reliably.
+inline constexpr int32_t AUTOTUNE_MIN_RESPONSE_PA = 50;
+
+struct autotuneModel_t {
+  float gain_pa;    /* Pa per unit of duty */
+  float tau_s;      /* Time constant */
+  float dead_s;     /* Dead time */
+  float kp, ki, kd; /* As set with parameters_setKp() etc. */
+};
+
+// Idle.
+void autotune_init();
+
+// Starts stepping the blower from `base` by `duty_step`.  Returns false if
+// the step is 0 or would go over full duty.
+bool autotune_start(uint8_t base, uint8_t duty_step);
+// Back to idle, if running.
+void autotune_stop();
+
+bool autotune_running();
+enum autotuneState autotune_getState();
+// The model fitted, valid once the state is done.
+void autotune_getModel(autotuneModel_t *model);
+
+// Call once per tick of the PID loop, in place of the PID, while running.
+// Takes the patient pressure, in Pa, and returns the blower duty.
+int16_t autotune_tick(int32_t input);
+
+#endif // AUTOTUNE_H
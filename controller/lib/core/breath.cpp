@@ -0,0 +1,132 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "breath.h"
+
+#include "parameters.h"
+#include "scheduler.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// Bounds on the settings, beyond the limits enforced by parameters.cpp, which
+// keep the breath timing well defined.  One breath per minute at 1 kHz is
+// 60000 ticks, which still fits the 16 bit tick counters.
+static const float RR_FLOOR = 1.0f;
+static const uint16_t PHASE_TICKS_MIN = 1;
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+BreathFsm::BreathFsm() { reset(); }
+
+void BreathFsm::reset() {
+  phase_ = pid_fsm_state::reset;
+  phase_changed_ = false;
+}
+
+int32_t BreathFsm::tick() {
+  phase_changed_ = false;
+
+  if (phase_ == pid_fsm_state::reset || ++tick_ >= end_tick_) {
+    startBreath();
+  } else if (tick_ == plateau_tick_) {
+    setPhase(pid_fsm_state::plateau, expire_tick_ - plateau_tick_);
+  } else if (tick_ == expire_tick_) {
+    setPhase(pid_fsm_state::expire, dwell_tick_ - expire_tick_);
+  } else if (tick_ == dwell_tick_) {
+    setPhase(pid_fsm_state::expire_dwell, end_tick_ - dwell_tick_);
+  }
+
+  const int16_t *ramp;
+  switch (phase_) {
+  case pid_fsm_state::inspire:
+    ramp = inspire_ramp_;
+    break;
+  case pid_fsm_state::expire:
+    ramp = expire_ramp_;
+    break;
+  case pid_fsm_state::plateau:
+    return pip_;
+  default:
+    return peep_;
+  }
+
+  uint8_t idx = static_cast<uint8_t>(ramp_pos_ >> 16);
+  if (idx >= BREATH_RAMP_POINTS) {
+    idx = BREATH_RAMP_POINTS - 1;
+  }
+  ramp_pos_ += ramp_step_;
+  return ramp[idx];
+}
+
+/****************************************************************************************
+ *    PRIVATE METHODS
+ ****************************************************************************************/
+
+void BreathFsm::setPhase(pid_fsm_state phase, uint16_t phase_ticks) {
+  phase_changed_ = true;
+  phase_ = phase;
+  ramp_pos_ = 0;
+  ramp_step_ = (static_cast<uint32_t>(BREATH_RAMP_POINTS) << 16) / phase_ticks;
+}
+
+void BreathFsm::startBreath() {
+  // Settings sent as a block only ever take effect between breaths
+  parameters_applyStagedSettings();
+
+  float rr = parameters_getRR();
+  if (rr < RR_FLOOR) {
+    rr = RR_FLOOR;
+  }
+  float ier = parameters_getInspireExpireRatio();
+  float dwell = parameters_getDwell() / 100.0f;
+  float peep = parameters_getPEEP() * PA_PER_CMH2O;
+  float pip = parameters_getPIP() * PA_PER_CMH2O;
+  if (pip < peep) {
+    pip = peep;
+  }
+
+  // Phase boundaries.  Each phase lasts at least one tick, so that every
+  // phase is entered once per breath.
+  uint16_t breath = static_cast<uint16_t>(60.0f * SCHEDULER_TICK_HZ / rr);
+  uint16_t inspire = static_cast<uint16_t>(breath * ier / (1.0f + ier));
+  uint16_t inspire_ramp = static_cast<uint16_t>(inspire * (1.0f - dwell));
+  uint16_t expire_ramp =
+      static_cast<uint16_t>((breath - inspire) * (1.0f - dwell));
+
+  plateau_tick_ =
+      inspire_ramp < PHASE_TICKS_MIN ? PHASE_TICKS_MIN : inspire_ramp;
+  expire_tick_ =
+      inspire <= plateau_tick_ ? plateau_tick_ + PHASE_TICKS_MIN : inspire;
+  dwell_tick_ = expire_tick_ + expire_ramp;
+  if (dwell_tick_ <= expire_tick_) {
+    dwell_tick_ = expire_tick_ + PHASE_TICKS_MIN;
+  }
+  end_tick_ = breath <= dwell_tick_ ? dwell_tick_ + PHASE_TICKS_MIN : breath;
+
+  pip_ = static_cast<int16_t>(pip + 0.5f);
+  peep_ = static_cast<int16_t>(peep + 0.5f);
+  for (uint8_t i = 0; i < BREATH_RAMP_POINTS; i++) {
+    float delta = (pip - peep) * (i + 0.5f) / BREATH_RAMP_POINTS;
+    inspire_ramp_[i] = static_cast<int16_t>(peep + delta + 0.5f);
+    expire_ramp_[i] = static_cast<int16_t>(pip - delta + 0.5f);
+  }
+
+  tick_ = 0;
+  setPhase(pid_fsm_state::inspire, plateau_tick_);
+}
@@ -0,0 +1,99 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef BREATH_H
+#define BREATH_H
+
+#include <stdint.h>
+
+enum class pid_fsm_state : uint8_t {
+  reset = 0,
+  inspire = 1,
+  plateau = 2,
+  expire = 3,
+  expire_dwell = 4,
+
+  count /* Sentinel */
+};
+
+// Number of points in each of the per-breath ramp tables.
+inline constexpr uint8_t BREATH_RAMP_POINTS = 32;
+
+// Conversion from the cmH2O used by the ventilation parameters to Pa.
+inline constexpr float PA_PER_CMH2O = 98.0665f;
+
+// Pressure-controlled breath state machine.
+//
+// Call tick() once per scheduler tick.  At the start of every breath the
+// settings are read from parameters.cpp and turned into phase durations (in
+// ticks) and tables of the setpoints along the inspiratory and expiratory
+// ramps, so that settings changes only ever take effect at a breath boundary,
+// and each tick costs a comparison, an addition and a table lookup.
+//
+// A breath lasts 60 / RR seconds, split between inspiration and expiration
+// according to the I:E ratio.  Each of those is split again between a linear
+// ramp (PEEP to PIP, or back) and a dwell at constant pressure (plateau at
+// PIP, then PEEP); the dwell parameter is the percentage of each half spent
+// dwelling.  PIP and PEEP are in cmH2O.
+class BreathFsm {
+public:
+  BreathFsm();
+
+  // Abandons the current breath; the next tick() starts a new one.
+  void reset();
+
+  // Advances one tick and returns the setpoint for it, in Pa.
+  int32_t tick();
+
+  pid_fsm_state phase() const { return phase_; }
+
+  // True if the last tick() changed the phase.
+  bool phaseChanged() const { return phase_changed_; }
+
+  // Ticks since the start of the current breath.
+  uint16_t breathTick() const { return tick_; }
+
+  // Duration of the current breath, in ticks.
+  uint16_t breathTicks() const { return end_tick_; }
+
+private:
+  void startBreath();
+  void setPhase(pid_fsm_state phase, uint16_t phase_ticks);
+
+  pid_fsm_state phase_;
+  bool phase_changed_;
+
+  // Ticks since the start of the breath, and the ticks at which each phase
+  // after inspire starts.
+  uint16_t tick_;
+  uint16_t plateau_tick_;
+  uint16_t expire_tick_;
+  uint16_t dwell_tick_;
+  uint16_t end_tick_;
+
+  // Setpoints in Pa.  The ramps are sampled at the middle of each of
+  // BREATH_RAMP_POINTS equal slices of the ramp.
+  int16_t pip_;
+  int16_t peep_;
+  int16_t inspire_ramp_[BREATH_RAMP_POINTS];
+  int16_t expire_ramp_[BREATH_RAMP_POINTS];
+
+  // Position in the current ramp table as a Q8.16 index, and how far it
+  // advances per tick.  Unused while dwelling.
+  uint32_t ramp_pos_;
+  uint32_t ramp_step_;
+};
+
+#endif // BREATH_H
@@ -0,0 +1,115 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "breath_metrics.h"
+
+#include "scheduler.h"
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static int16_t saturate(int32_t value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return static_cast<int16_t>(value);
+}
+
+static uint16_t ticks_to_ms(uint16_t ticks) {
+  return static_cast<uint16_t>(uint32_t{ticks} * 1000 / SCHEDULER_TICK_HZ);
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void BreathMetrics::reset() {
+  ticks_ = 0;
+  inspire_ticks_ = 0;
+  dwell_ticks_ = 0;
+  max_pressure_ = INT16_MIN;
+  min_pressure_ = INT16_MAX;
+  max_volume_ = INT16_MIN;
+  max_flow_ = INT16_MIN;
+  last_pressure_ = 0;
+  pressure_sum_ = 0;
+  dwell_pressure_sum_ = 0;
+}
+
+void BreathMetrics::add(pid_fsm_state phase, int32_t pressure_pa,
+                        int32_t volume_ml, int32_t flow_ml_s) {
+  if (ticks_ == UINT16_MAX) {
+    return;
+  }
+  ticks_++;
+
+  int16_t pressure = saturate(pressure_pa);
+  int16_t volume = saturate(volume_ml);
+  int16_t flow = saturate(flow_ml_s);
+
+  if (pressure > max_pressure_) {
+    max_pressure_ = pressure;
+  }
+  if (pressure < min_pressure_) {
+    min_pressure_ = pressure;
+  }
+  if (volume > max_volume_) {
+    max_volume_ = volume;
+  }
+  if (flow > max_flow_) {
+    max_flow_ = flow;
+  }
+  last_pressure_ = pressure;
+  pressure_sum_ += pressure;
+
+  switch (phase) {
+  case pid_fsm_state::inspire:
+  case pid_fsm_state::plateau:
+    inspire_ticks_++;
+    break;
+  case pid_fsm_state::expire_dwell:
+    dwell_ticks_++;
+    dwell_pressure_sum_ += pressure;
+    break;
+  default:
+    break;
+  }
+}
+
+BreathSummary BreathMetrics::summary(uint32_t time_ms) const {
+  BreathSummary summary = {};
+  summary.time_ms = time_ms;
+  if (ticks_ == 0) {
+    return summary;
+  }
+
+  summary.duration_ms = ticks_to_ms(ticks_);
+  summary.inspire_ms = ticks_to_ms(inspire_ticks_);
+  summary.pip_pa = max_pressure_;
+  // A breath cut short before its dwell ends at whatever pressure it reached.
+  summary.peep_pa = dwell_ticks_ == 0
+                        ? last_pressure_
+                        : static_cast<int16_t>(dwell_pressure_sum_ /
+                                               dwell_ticks_);
+  summary.mean_pa = static_cast<int16_t>(pressure_sum_ / ticks_);
+  summary.min_pa = min_pressure_;
+  summary.vt_ml = max_volume_;
+  summary.peak_flow_ml_s = max_flow_;
+  return summary;
+}
@@ -0,0 +1,63 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef BREATH_METRICS_H
+#define BREATH_METRICS_H
+
+#include <stdint.h>
+
+#include "breath.h"
+#include "telemetry_codec.h"
+
+// Statistics of one breath, for dataID::breath_summary.
+//
+// Fed one reading per scheduler tick, it keeps running extremes and sums
+// rather than the readings themselves, so its state and the cost of each
+// tick are constant however long the breath.  Readings outside the int16_t
+// range are saturated.
+class BreathMetrics {
+public:
+  BreathMetrics() { reset(); }
+
+  // Forgets the readings, ready for the next breath.
+  void reset();
+
+  // Adds the readings of one tick, taken in the given phase.
+  void add(pid_fsm_state phase, int32_t pressure_pa, int32_t volume_ml,
+           int32_t flow_ml_s);
+
+  // Ticks added since the last reset().
+  uint16_t ticks() const { return ticks_; }
+
+  // Summarizes the readings added so far, as a breath which ended at time_ms.
+  BreathSummary summary(uint32_t time_ms) const;
+
+private:
+  uint16_t ticks_;
+  uint16_t inspire_ticks_;
+  uint16_t dwell_ticks_;
+
+  int16_t max_pressure_;
+  int16_t min_pressure_;
+  int16_t max_volume_;
+  int16_t max_flow_;
+  int16_t last_pressure_;
+
+  // At most UINT16_MAX ticks of int16_t readings, which fits.
+  int32_t pressure_sum_;
+  int32_t dwell_pressure_sum_;
+};
+
+#endif // BREATH_METRICS_H
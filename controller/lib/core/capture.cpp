@@ -0,0 +1,142 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "capture.h"
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+static captureSample_t samples[CAPTURE_SAMPLES];
+// Where the next sample goes, and how many of the ring are filled.
+static uint8_t head;
+static uint8_t filled;
+
+static enum captureState state = captureState::idle;
+static enum captureTrigger trigger;
+static uint16_t threshold;
+static uint8_t divider;
+static uint8_t pre;
+// Ticks until the next sample, and once triggered, samples still to take.
+static uint8_t countdown;
+static uint8_t remaining;
+static uint8_t triggerIndex;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static int16_t clamp_int16(int32_t value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)value;
+}
+
+static bool triggered(const BreathFsm &breath, int32_t error) {
+  switch (trigger) {
+  case captureTrigger::now:
+    return true;
+  case captureTrigger::phase_change:
+    return breath.phaseChanged();
+  case captureTrigger::inspire:
+    return breath.phaseChanged() && breath.phase() == pid_fsm_state::inspire;
+  case captureTrigger::expire:
+    return breath.phaseChanged() && breath.phase() == pid_fsm_state::expire;
+  case captureTrigger::error:
+    return error >= threshold || -error >= threshold;
+  default:
+    return false;
+  }
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void capture_init() {
+  state = captureState::idle;
+  filled = 0;
+}
+
+void capture_arm(enum captureTrigger trig, uint16_t threshold_pa,
+                 uint8_t div, uint8_t preSamples) {
+  trigger = trig;
+  threshold = threshold_pa;
+  divider = div > 0 ? div : 1;
+  pre = preSamples < CAPTURE_SAMPLES ? preSamples : CAPTURE_SAMPLES - 1;
+  head = 0;
+  filled = 0;
+  countdown = 0;
+  state = captureState::armed;
+}
+
+void capture_tick(const BreathFsm &breath, int32_t setpoint, int32_t input,
+                  int16_t output) {
+  if (state == captureState::armed && triggered(breath, setpoint - input)) {
+    // Keeps what there is of the PRE samples, and fills the rest of the ring
+    // from here on.  The samples stay DIV ticks apart, so the one at the
+    // trigger is the first at or after it.
+    uint8_t kept = filled < pre ? filled : pre;
+    filled = kept;
+    triggerIndex = kept;
+    remaining = CAPTURE_SAMPLES - kept;
+    state = captureState::triggered;
+  }
+  if (state != captureState::armed && state != captureState::triggered) {
+    return;
+  }
+
+  if (countdown > 0) {
+    countdown--;
+    return;
+  }
+  countdown = divider - 1;
+
+  captureSample_t &sample = samples[head];
+  sample.setpoint = clamp_int16(setpoint);
+  sample.input = clamp_int16(input);
+  sample.output =
+      (uint8_t)(output < 0 ? 0 : output > UINT8_MAX ? UINT8_MAX : output);
+  head = head + 1 < CAPTURE_SAMPLES ? head + 1 : 0;
+  if (filled < CAPTURE_SAMPLES) {
+    filled++;
+  }
+
+  if (state == captureState::triggered && --remaining == 0) {
+    state = captureState::done;
+  }
+}
+
+enum captureState capture_getState() { return state; }
+
+uint8_t capture_getCount() {
+  return state == captureState::done ? filled : 0;
+}
+
+uint8_t capture_getTriggerIndex() { return triggerIndex; }
+
+bool capture_getSample(uint8_t index, captureSample_t *sample) {
+  if (index >= capture_getCount()) {
+    return false;
+  }
+  // The oldest sample is `filled` behind the head.
+  uint16_t slot = (uint16_t)head + CAPTURE_SAMPLES - filled + index;
+  *sample = samples[slot % CAPTURE_SAMPLES];
+  return true;
+}
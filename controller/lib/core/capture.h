@@ -0,0 +1,64 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#include "breath.h"
+#include "packet_types.h"
+
+// Engineering mode capture of the PID loop, see command::arm_capture.
+//
+// Once armed, every DIV-th tick of the loop is recorded into a ring of
+// CAPTURE_SAMPLES, so that the PRE samples before the trigger are still there
+// when it fires.  The capture is done once the ring holds those and as many
+// again after the trigger as fit, and stays put until it's armed again.
+// 10 Hz telemetry is far too slow to show the step response of the loop;
+// this shows it without streaming at loop rate.
+
+// 5 bytes of RAM each.  At 1 kHz, 64 ms of samples, but DIV stretches that.
+inline constexpr uint8_t CAPTURE_SAMPLES = 64;
+
+struct captureSample_t {
+  int16_t setpoint; /* Pa */
+  int16_t input;    /* Pa */
+  uint8_t output;   /* Blower PWM duty */
+};
+
+// Idle, with nothing captured.
+void capture_init();
+
+// Throws away the last capture, and waits for `trigger`.  `threshold_pa` is
+// for captureTrigger::error.  `pre` is clamped to leave room for the sample
+// at the trigger.
+void capture_arm(enum captureTrigger trigger, uint16_t threshold_pa,
+                 uint8_t divider, uint8_t pre);
+
+// Call once per tick of the PID loop, after computing its output.
+void capture_tick(const BreathFsm &breath, int32_t setpoint, int32_t input,
+                  int16_t output);
+
+enum captureState capture_getState();
+// Samples captured, 0 until the capture is done.
+uint8_t capture_getCount();
+// Index of the sample taken at the trigger, or the first after it for a DIV
+// over 1.
+uint8_t capture_getTriggerIndex();
+// Sample `index`, oldest first.  Returns false past capture_getCount().
+bool capture_getSample(uint8_t index, captureSample_t *sample);
+
+#endif // CAPTURE_H
@@ -0,0 +1,466 @@
+/* Copyright 2020, Edwin Chiu
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "command.h"
+#include "actuators.h"
+#include "autotune.h"
+#include "capture.h"
+#include "comms.h"
+#include "flow.h"
+#include "hal.h"
+#include "memstats.h"
+#include "scheduler.h"
+#include "serialization.h"
+#include "subscription.h"
+
+/****************************************************************************************
+ *    TYPE DEFINITIONS
+ ****************************************************************************************/
+
+// Runs a command whose payload has already been checked against the table.
+// The response buffer has room for the table's response length.
+typedef void (*command_handler_t)(const char *data, char *response);
+
+// Operating modes a command is allowed in
+#define CMD_MEDICAL (0x01)
+#define CMD_ENG (0x02)
+#define CMD_ANY (CMD_MEDICAL | CMD_ENG)
+
+namespace {
+struct command_entry_t {
+  command_handler_t handler; /* nullptr if there is no such command */
+  uint8_t argLen;            /* Payload length */
+  uint8_t modes;             /* CMD_* */
+  uint8_t responseLen;
+};
+} // anonymous namespace
+
+/****************************************************************************************
+ *    COMMAND HANDLERS
+ ****************************************************************************************/
+
+static void cmd_none(const char *, char *) {}
+
+template <void (*Set)(float)>
+static void cmd_setFloat(const char *data, char *) {
+  Set(wire_getFloat(data));
+}
+
+template <float (*Get)()>
+static void cmd_getFloat(const char *, char *response) {
+  wire_put(response, Get());
+}
+
+template <typename E, void (*Set)(E)>
+static void cmd_setEnum(const char *data, char *) {
+  Set((E)data[0]);
+}
+
+template <typename E, E (*Get)()>
+static void cmd_getEnum(const char *, char *response) {
+  response[0] = (char)Get();
+}
+
+// Flow [mL/s] and volume [mL], as floats like the other readings
+static float get_flow() { return flow_getFlow(); }
+static float get_volume() { return flow_getVolume(); }
+
+static void cmd_resetVc(const char *, char *) {
+  // TODO Do any necessary cleaning up before reset
+  Hal.reboot();
+}
+
+static void cmd_commsCheck(const char *, char *) {
+  // Proves the link works at the current baud rate.
+  serialIO_confirmBaud();
+}
+
+// RR[4] TV[4] PEEP[4] PIP[4] DWELL[4] IER[4]
+#define SETTINGS_LEN                                                           \
+  (wire_size<float, float, float, float, float, float>())
+
+static void put_settings(char *response, const ventilatorSettings_t &settings) {
+  WireWriter out(response, SETTINGS_LEN);
+  out.put(settings.rr);
+  out.put(settings.tv);
+  out.put(settings.peep);
+  out.put(settings.pip);
+  out.put(settings.dwell);
+  out.put(settings.ier);
+}
+
+static void cmd_setSettings(const char *data, char *response) {
+  ventilatorSettings_t settings;
+  WireReader in(data, SETTINGS_LEN);
+  settings.rr = in.getFloat();
+  settings.tv = in.getFloat();
+  settings.peep = in.getFloat();
+  settings.pip = in.getFloat();
+  settings.dwell = in.getFloat();
+  settings.ier = in.getFloat();
+  parameters_stageSettings(&settings);
+
+  parameters_getStagedSettings(&settings);
+  put_settings(response, settings);
+}
+
+static void cmd_getSettings(const char *, char *response) {
+  ventilatorSettings_t settings;
+  parameters_getSettings(&settings);
+  put_settings(response, settings);
+}
+
+// LOAD[2] MISSED[2] PERIODS[2 * SCHEDULER_PERIOD_BINS]
+#define LOOP_STATS_LEN                                                         \
+  (wire_size<uint16_t, uint16_t>() +                                           \
+   SCHEDULER_PERIOD_BINS * wire_size<uint16_t>())
+
+static void cmd_getLoopStats(const char *, char *response) {
+  WireWriter out(response, LOOP_STATS_LEN);
+  out.put(scheduler_getLoad());
+  out.put(scheduler_getMissedTicks());
+  for (uint8_t bin = 0; bin < SCHEDULER_PERIOD_BINS; bin++) {
+    out.put(scheduler_getPeriodCount(bin));
+  }
+}
+
+// MIN[2] MAX[2] MEAN[2] RUNS[2] OVERRUNS[2]
+#define TASK_STATS_LEN                                                         \
+  (wire_size<uint16_t, uint16_t, uint16_t, uint16_t, uint16_t>())
+
+static void cmd_getTaskStats(const char *data, char *response) {
+  uint8_t task = (uint8_t)data[0];
+  scheduler_taskStats_t stats;
+  scheduler_getTaskStats(task, &stats);
+
+  WireWriter out(response, TASK_STATS_LEN);
+  out.put(stats.min_us);
+  out.put(stats.max_us);
+  out.put(stats.mean_us);
+  out.put(stats.runs);
+  out.put(scheduler_getOverruns(task));
+}
+
+static void cmd_resetLoopStats(const char *, char *) {
+  scheduler_resetStats();
+}
+
+// DATA[2] BSS[2] HEAP_TOP[2] FREE[2] MIN_FREE[2]
+#define MEMORY_STATS_LEN                                                       \
+  (wire_size<uint16_t, uint16_t, uint16_t, uint16_t, uint16_t>())
+
+static void cmd_getMemoryStats(const char *, char *response) {
+  memoryStats_t stats;
+  memstats_get(&stats);
+
+  WireWriter out(response, MEMORY_STATS_LEN);
+  out.put(stats.data);
+  out.put(stats.bss);
+  out.put(stats.heap_top);
+  out.put(stats.free);
+  out.put(stats.min_free);
+}
+
+// TRIGGER[1] THRESHOLD[2] DIV[1] PRE[1]
+#define ARM_CAPTURE_LEN                                                        \
+  (wire_size<uint8_t, uint16_t, uint8_t, uint8_t>())
+
+static void cmd_armCapture(const char *data, char *) {
+  WireReader in(data, ARM_CAPTURE_LEN);
+  enum captureTrigger trigger = (enum captureTrigger)in.getUint8();
+  uint16_t threshold = in.getUint16();
+  uint8_t divider = in.getUint8();
+  uint8_t pre = in.getUint8();
+  capture_arm(trigger, threshold, divider, pre);
+}
+
+// Samples in each response to get_capture
+#define CAPTURE_FRAME_SAMPLES (4)
+// STATE[1] COUNT[1] AT[1] SAMPLE[CAPTURE_FRAME_SAMPLES * 5]
+#define CAPTURE_FRAME_LEN                                                      \
+  (wire_size<uint8_t, uint8_t, uint8_t>() +                                    \
+   CAPTURE_FRAME_SAMPLES * wire_size<int16_t, int16_t, uint8_t>())
+
+static void cmd_getCapture(const char *data, char *response) {
+  uint8_t first = (uint8_t)data[0];
+  WireWriter out(response, CAPTURE_FRAME_LEN);
+  out.put((uint8_t)capture_getState());
+  out.put(capture_getCount());
+  out.put(capture_getTriggerIndex());
+  for (uint8_t i = 0; i < CAPTURE_FRAME_SAMPLES; i++) {
+    captureSample_t sample = {0, 0, 0};
+    capture_getSample((uint8_t)(first + i), &sample);
+    out.put(sample.setpoint);
+    out.put(sample.input);
+    out.put(sample.output);
+  }
+}
+
+// KP[4] KI[4] KD[4]
+#define GAINS_LEN (wire_size<float, float, float>())
+
+static void cmd_setPhaseGains(const char *data, char *response) {
+  pidGains_t gains;
+  WireReader in(data + 1, GAINS_LEN);
+  gains.kp = in.getFloat();
+  gains.ki = in.getFloat();
+  gains.kd = in.getFloat();
+  response[0] =
+      parameters_setPhaseGains((pid_fsm_state)data[0], &gains) ? 1 : 0;
+}
+
+static void cmd_getPhaseGains(const char *data, char *response) {
+  pidGains_t gains = {0, 0, 0};
+  parameters_getPhaseGains((pid_fsm_state)data[0], &gains);
+
+  WireWriter out(response, GAINS_LEN);
+  out.put(gains.kp);
+  out.put(gains.ki);
+  out.put(gains.kd);
+}
+
+// SWITCHES[2] LAST_US[2] MAX_US[2] LAST_MS[4]
+#define ACTUATOR_STATS_LEN                                                     \
+  (wire_size<uint16_t, uint16_t, uint16_t, uint32_t>())
+
+static void cmd_getActuatorStats(const char *, char *response) {
+  actuatorStats_t stats;
+  actuators_getStats(&stats);
+
+  WireWriter out(response, ACTUATOR_STATS_LEN);
+  out.put(stats.switches);
+  out.put(stats.last_us);
+  out.put(stats.max_us);
+  out.put(stats.last_ms);
+}
+
+// Responds with 1 if the autotune started, 0 if the step is invalid.
+static void cmd_startAutotune(const char *data, char *response) {
+  response[0] = autotune_start((uint8_t)data[0], (uint8_t)data[1]) ? 1 : 0;
+}
+
+static void cmd_stopAutotune(const char *, char *) { autotune_stop(); }
+
+// STATE[1] GAIN[4] TAU[4] DEAD[4] KP[4] KI[4] KD[4]
+#define AUTOTUNE_LEN                                                           \
+  (wire_size<uint8_t, float, float, float, float, float, float>())
+
+static void cmd_getAutotune(const char *, char *response) {
+  autotuneModel_t model;
+  autotune_getModel(&model);
+
+  WireWriter out(response, AUTOTUNE_LEN);
+  out.put((uint8_t)autotune_getState());
+  out.put(model.gain_pa);
+  out.put(model.tau_s);
+  out.put(model.dead_s);
+  out.put(model.kp);
+  out.put(model.ki);
+  out.put(model.kd);
+}
+
+// Responds with 1 if the rate will be switched to, 0 if it's invalid.
+static void cmd_setBaud(const char *data, char *response) {
+  response[0] = serialIO_requestBaud((enum baudRate)data[0]) ? 1 : 0;
+}
+
+// DIV[1] for each telemetryChannel
+static void put_subscription(char *response) {
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    response[c] = (char)subscription_getDivider((enum telemetryChannel)c);
+  }
+}
+
+static void cmd_setSubscription(const char *data, char *response) {
+  // Readings batched for the old subscription go out ahead of the response,
+  // rather than with the first of the new one.
+  comms_flushChannels();
+  subscription_set((const uint8_t *)data);
+  put_subscription(response);
+}
+
+static void cmd_getSubscription(const char *, char *response) {
+  put_subscription(response);
+}
+
+/****************************************************************************************
+ *    COMMAND TABLE
+ ****************************************************************************************/
+
+// Commands are numbered in groups of 0x20: medical, engineering and mixed
+// mode.  Each group has its own table, indexed by the low bits of the
+// command, so a lookup is two indexing operations.
+//
+// The tables live in flash.  On the Uno a table in RAM would cost as much
+// SRAM as it does flash.
+
+#define CMD_GROUP_BITS (5)
+#define CMD_INDEX_MASK ((1 << CMD_GROUP_BITS) - 1)
+
+#define SET_FLOAT(set, modes)                                                  \
+  { cmd_setFloat<set>, wire_size<float>(), modes, 0 }
+#define GET_FLOAT(get, modes)                                                  \
+  { cmd_getFloat<get>, 0, modes, wire_size<float>() }
+#define SET_ENUM(type, set, modes)                                             \
+  { cmd_setEnum<enum type, set>, 1, modes, 0 }
+#define GET_ENUM(type, get, modes)                                             \
+  { cmd_getEnum<enum type, get>, 0, modes, 1 }
+
+static constexpr command_entry_t MEDICAL_COMMANDS[] HAL_FLASH = {
+    SET_FLOAT(parameters_setRR, CMD_ANY),                 /* set_rr */
+    GET_FLOAT(parameters_getRR, CMD_ANY),                 /* get_rr */
+    SET_FLOAT(parameters_setTV, CMD_ANY),                 /* set_tv */
+    GET_FLOAT(parameters_getTV, CMD_ANY),                 /* get_tv */
+    SET_FLOAT(parameters_setPEEP, CMD_ANY),               /* set_peep */
+    GET_FLOAT(parameters_getPEEP, CMD_ANY),               /* get_peep */
+    SET_FLOAT(parameters_setPIP, CMD_ANY),                /* set_pip */
+    GET_FLOAT(parameters_getPIP, CMD_ANY),                /* get_pip */
+    SET_FLOAT(parameters_setDwell, CMD_ANY),              /* set_dwell */
+    GET_FLOAT(parameters_getDwell, CMD_ANY),              /* get_dwell */
+    SET_FLOAT(parameters_setInspireExpireRatio, CMD_ANY), /* set_ier */
+    GET_FLOAT(parameters_getInspireExpireRatio, CMD_ANY), /* get_ier */
+    {cmd_none, 0, CMD_ANY, 0},                            /* get_pressure */
+    GET_FLOAT(get_flow, CMD_ANY),                         /* get_flow */
+    GET_FLOAT(get_volume, CMD_ANY),                       /* get_volume */
+
+    {cmd_setSettings, SETTINGS_LEN, CMD_ANY, SETTINGS_LEN}, /* set_settings */
+    {cmd_getSettings, 0, CMD_ANY, SETTINGS_LEN},            /* get_settings */
+};
+
+static constexpr command_entry_t ENG_COMMANDS[] HAL_FLASH = {
+    SET_FLOAT(parameters_setKp, CMD_ENG), /* set_kp */
+    GET_FLOAT(parameters_getKp, CMD_ENG), /* get_Kp */
+    SET_FLOAT(parameters_setKi, CMD_ENG), /* set_Ki */
+    GET_FLOAT(parameters_getKi, CMD_ENG), /* get_Ki */
+    SET_FLOAT(parameters_setKd, CMD_ENG), /* set_Kd */
+    GET_FLOAT(parameters_getKd, CMD_ENG), /* get_Kd */
+    {cmd_none, 0, CMD_ENG, 0},            /* set_blower */
+    {cmd_resetVc, 0, CMD_ENG, 0},         /* reset_vc */
+    SET_ENUM(solenoidNormaleState, parameters_setSolenoidNormalState,
+             CMD_ENG), /* set_solenoidNormalState */
+    {cmd_getLoopStats, 0, CMD_ENG, LOOP_STATS_LEN}, /* get_loop_stats */
+    {cmd_getTaskStats, 1, CMD_ENG, TASK_STATS_LEN}, /* get_task_stats */
+    {cmd_resetLoopStats, 0, CMD_ENG, 0},            /* reset_loop_stats */
+    {cmd_getMemoryStats, 0, CMD_ENG, MEMORY_STATS_LEN}, /* get_memory_stats */
+    {cmd_armCapture, ARM_CAPTURE_LEN, CMD_ENG, 0},      /* arm_capture */
+    {cmd_getCapture, 1, CMD_ENG, CAPTURE_FRAME_LEN},    /* get_capture */
+    {cmd_startAutotune, 2, CMD_ENG, 1},                 /* start_autotune */
+    {cmd_stopAutotune, 0, CMD_ENG, 0},                  /* stop_autotune */
+    {cmd_getAutotune, 0, CMD_ENG, AUTOTUNE_LEN},        /* get_autotune */
+    {cmd_setPhaseGains, 1 + GAINS_LEN, CMD_ENG, 1},     /* set_phase_gains */
+    {cmd_getPhaseGains, 1, CMD_ENG, GAINS_LEN},         /* get_phase_gains */
+    {cmd_getActuatorStats, 0, CMD_ENG,
+     ACTUATOR_STATS_LEN}, /* get_actuator_stats */
+};
+
+static constexpr command_entry_t MIXED_COMMANDS[] HAL_FLASH = {
+    SET_ENUM(periodicMode, parameters_setPeriodicMode, CMD_ANY),
+    GET_ENUM(periodicMode, parameters_getPeriodicMode, CMD_ANY),
+    SET_ENUM(operatingMode, parameters_setOperatingMode, CMD_ANY),
+    GET_ENUM(operatingMode, parameters_getOperatingMode, CMD_ANY),
+    {cmd_commsCheck, 0, CMD_ANY, 0}, /* comms_check */
+    SET_ENUM(ventilatorMode, parameters_setVentilatorMode, CMD_ANY),
+    GET_ENUM(ventilatorMode, parameters_getVentilatorMode, CMD_ANY),
+    {cmd_none, 0, CMD_ANY, 0},    /* start_ventilator */
+    {cmd_none, 0, CMD_ANY, 0},    /* stop_ventilator */
+    {cmd_setBaud, 1, CMD_ANY, 1}, /* set_baud */
+    {cmd_setSubscription, TELEMETRY_CHANNELS, CMD_ANY,
+     TELEMETRY_CHANNELS}, /* set_subscription */
+    {cmd_getSubscription, 0, CMD_ANY,
+     TELEMETRY_CHANNELS}, /* get_subscription */
+};
+
+#undef SET_FLOAT
+#undef GET_FLOAT
+#undef SET_ENUM
+#undef GET_ENUM
+
+#define TABLE_SIZE(table) (sizeof(table) / sizeof(table[0]))
+
+static_assert(TABLE_SIZE(MEDICAL_COMMANDS) ==
+                  (uint8_t)command::get_settings - (uint8_t)command::set_rr + 1,
+              "Medical mode command table doesn't match enum command");
+static_assert(TABLE_SIZE(ENG_COMMANDS) ==
+                  (uint8_t)command::get_actuator_stats -
+                      (uint8_t)command::set_kp + 1,
+              "Engineering mode command table doesn't match enum command");
+static_assert(TABLE_SIZE(MIXED_COMMANDS) ==
+                  (uint8_t)command::get_subscription -
+                      (uint8_t)command::set_periodic + 1,
+              "Mixed mode command table doesn't match enum command");
+
+// Copies the command's entry out of flash.  Returns false if there's no such
+// command.
+static bool command_lookup(enum command cmd, command_entry_t *entry) {
+  const command_entry_t *table;
+  uint8_t size;
+
+  switch ((uint8_t)cmd >> CMD_GROUP_BITS) {
+  case 0:
+    table = MEDICAL_COMMANDS;
+    size = TABLE_SIZE(MEDICAL_COMMANDS);
+    break;
+  case 1:
+    table = ENG_COMMANDS;
+    size = TABLE_SIZE(ENG_COMMANDS);
+    break;
+  case 2:
+    table = MIXED_COMMANDS;
+    size = TABLE_SIZE(MIXED_COMMANDS);
+    break;
+  default:
+    return false;
+  }
+
+  uint8_t index = (uint8_t)cmd & CMD_INDEX_MASK;
+  if (index >= size) {
+    return false;
+  }
+  hal_flashRead(entry, &table[index], sizeof(*entry));
+  return entry->handler != nullptr;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+enum commandStatus command_execute(enum command cmd, char *dataTx,
+                                   uint8_t lenTx, char *dataRx, uint8_t *lenRx,
+                                   uint8_t lenRxMax) {
+  command_entry_t entry;
+  *lenRx = 0; // Initialise the value to zero
+
+  if (!command_lookup(cmd, &entry) || lenTx != entry.argLen ||
+      entry.responseLen > lenRxMax) {
+    return commandStatus::invalid;
+  }
+
+  uint8_t mode = parameters_getOperatingMode() == operatingMode::medical
+                     ? CMD_MEDICAL
+                     : CMD_ENG;
+  if (!(entry.modes & mode)) {
+    return commandStatus::modeErr;
+  }
+
+  entry.handler(dataTx, dataRx);
+  *lenRx = entry.responseLen;
+  return commandStatus::ok;
+}
+
+void command_responseSend(uint8_t cmd, bool tagged, char *packet,
+                          uint8_t len) {
+  serialIO_send(tagged ? msgType::rAckTagged : msgType::rAck, (enum dataID)cmd,
+                packet, len);
+}
@@ -26,10 +26,23 @@
 #include "packet_types.h"
 #include "parameters.h"
 #include "serialIO.h"
-#include "watchdog.h"
 
-void command_execute(enum command cmd, char *dataTx, uint8_t lenTx,
-                     char *dataRx, uint8_t *lenRx, uint8_t lenRxMax);
-void command_responseSend(uint8_t cmd, char *packet, uint8_t len);
+enum class commandStatus {
+  ok = 0x00,
+  invalid = 0x01, /* Unknown command, or wrong payload length */
+  modeErr = 0x02, /* Not allowed in the current operating mode */
+
+  count /* Sentinel */
+};
+
+// Looks the command up in the command table, checks it against the table's
+// payload length and operating modes, and runs it.  The response is only
+// written if the command is run.
+enum commandStatus command_execute(enum command cmd, char *dataTx,
+                                   uint8_t lenTx, char *dataRx, uint8_t *lenRx,
+                                   uint8_t lenRxMax);
+// Answers `cmd` with rAck, or with rAckTagged if it was a cmdTagged, in
+// which case `packet` starts with its REQ.
+void command_responseSend(uint8_t cmd, bool tagged, char *packet, uint8_t len);
 
 #endif // COMMAND_H
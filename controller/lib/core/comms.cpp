@@ -0,0 +1,694 @@
+/* Copyright 2020, Edwin Chiu
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string.h>
+
+#include "comms.h"
+#include "hal.h"
+#include "serialization.h"
+#include "subscription.h"
+#include "telemetry.h"
+
+/****************************************************************************************
+ *    PRIVATE FUNCTION PROTOTYPES
+ ****************************************************************************************/
+
+static void packet_reset();
+static bool packet_receive(char *packet, uint8_t *packet_len,
+                           uint16_t *checksum);
+static bool packet_checksumValidation(uint16_t checksum);
+static enum processPacket process_packet(char *packet, uint8_t len,
+                                        uint16_t checksum);
+static void comms_sendModeERR(char *packet);
+static void comms_sendChecksumERR(char *packet);
+static void comms_sendCommandERR(char *packet);
+static void comms_sendError(enum msgType type, const char *packet);
+static void send_alarm(const alarm_t &alarm);
+static bool alarm_nextToSend(alarm_t *alarm);
+static int8_t window_find(enum dataID alarm);
+static int8_t window_findSeq(uint8_t seq);
+static int8_t window_free();
+static void window_release(int8_t slot);
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// 4 (MSGTYPE[1] + SEQ[1] + CHECKSUM[2])
+#define PACKET_ACK_LEN (4)
+
+// Number of alarms that can be waiting for an ack at once
+#define ALARM_WINDOW (3)
+
+/****************************************************************************************
+ *    TYPE DEFINITIONS
+ ****************************************************************************************/
+
+enum class handler_state {
+  idle = 0x00,
+  packet_arriving = 0x01,
+  packet_process = 0x02,
+  alarm_waiting = 0x03,
+  alarm_process = 0x04,
+
+  count /* Sentinel */
+};
+
+// The fields of a packet, which are also their offsets in rx_packet, up to
+// data.  PACKET_SOF isn't stored.
+enum class packet_field {
+  msg_type = 0x00,
+  cmd = 0x01,
+  len = 0x02,
+  data = 0x03,
+  checksumA = 0x04,
+  checksumB = 0x05,
+  sof = 0x06,
+
+  count /* Sentinel */
+};
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+static enum handler_state state = handler_state::idle;
+
+static char rx_packet[PACKET_LEN_MAX];
+// How far packet_receive() has got with the packet in rx_packet, and when it
+// last had a byte of it.
+static enum packet_field rxField = packet_field::sof;
+static uint8_t rxPacketLen = 0;
+static uint8_t rxDataLen = 0;
+static Fletcher16 rxChecksum;
+static uint32_t rxLastByteTime = 0;
+static commsRxErrors_t rxErrors;
+
+static char cmdResponse_data[PACKET_DATA_LEN_MAX];
+// Periodic readings waiting to be sent, in whichever format
+// parameters_getPeriodicMode() selects.
+static TelemetryBatch telemetryBatch;
+static CompressedTelemetryBatch compressedBatch;
+static ChannelBatch channelBatch;
+// Alarms sent and waiting for an ack.  An ack or nack carries the sequence
+// number of the alarm frame it answers.
+namespace {
+struct alarm_inFlight_t {
+  bool used;
+  uint8_t seq;
+  enum dataID alarm;
+  uint16_t count; /* Occurrences reported, removed on ack */
+  uint32_t sentTime;
+};
+} // anonymous namespace
+
+static alarm_inFlight_t alarmWindow[ALARM_WINDOW];
+static uint8_t alarmsInFlight = 0;
+static uint8_t alarmSeq = 0;
+// Set when there may be an alarm to send: one was added, or a window slot
+// was freed.  Cleared once alarm_nextToSend() finds nothing.
+static bool alarmsToSend = false;
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+static void packet_reset();
+static bool packet_receive(char *packet, uint8_t *packet_len,
+                           uint16_t *checksum);
+static bool packet_checksumValidation(uint16_t checksum);
+static enum processPacket process_packet(char *packet, uint8_t len,
+                                        uint16_t checksum);
+static void comms_sendModeERR(char *packet);
+static void comms_sendChecksumERR(char *packet);
+static void comms_sendCommandERR(char *packet);
+static void comms_sendError(enum msgType type, const char *packet);
+static void send_alarm(const alarm_t &alarm);
+static bool alarm_nextToSend(alarm_t *alarm);
+static int8_t window_find(enum dataID alarm);
+static int8_t window_findSeq(uint8_t seq);
+static int8_t window_free();
+static void window_release(int8_t slot);
+
+void comms_init() {
+  serialIO_init();
+
+  state = handler_state::idle;
+  packet_reset();
+  memset(&rxErrors, 0, sizeof(rxErrors));
+  for (uint8_t i = 0; i < ALARM_WINDOW; i++) {
+    alarmWindow[i].used = false;
+  }
+  alarmsInFlight = 0;
+  alarmsToSend = false;
+
+  subscription_init();
+  channelBatch.reset();
+}
+
+void comms_handler() {
+  static uint8_t packet_len = 0;
+  static uint16_t packet_checksum = 0;
+  static alarm_t alarm;
+  uint8_t cmdResponseData_len;
+  enum processPacket packetStatus;
+
+  serialIO_handler();
+
+  if (alarm_takeAdded()) {
+    alarmsToSend = true;
+  }
+
+  // Alarms whose ack hasn't arrived within DELAY_100MS are still queued, free
+  // their slots so that they get sent again
+  if (alarmsInFlight > 0) {
+    for (uint8_t i = 0; i < ALARM_WINDOW; i++) {
+      if (alarmWindow[i].used &&
+          (Hal.millis() - alarmWindow[i].sentTime) >= DELAY_100MS) {
+        window_release(i);
+      }
+    }
+  }
+
+  // The rest of a packet should follow within a few byte times.  If it
+  // doesn't, a byte was lost (or the packet was really noise), so drop it
+  // rather than reading the next packet as the rest of it.
+  if (rxField != packet_field::sof && !serialIO_dataAvailable() &&
+      Hal.millis() - rxLastByteTime >= COMMS_RX_TIMEOUT_MS) {
+    packet_reset();
+    rxErrors.timeouts++;
+    if (state == handler_state::packet_arriving) {
+      state = handler_state::idle;
+    }
+  }
+
+  // Nothing arrived and nothing to send, don't bother with the FSM.  The RX
+  // ring's head index, moved by the RX interrupt, is the flag for arrivals.
+  if (state == handler_state::idle && !serialIO_dataAvailable() &&
+      !alarmsToSend) {
+    return;
+  }
+
+  // Run the FSM until it has to wait, so that a packet is received,
+  // processed and answered in a single call.
+  bool waiting = false;
+  while (!waiting) {
+    switch (state) {
+    case handler_state::idle:
+      // Do we have any incoming packets?
+      if (serialIO_dataAvailable()) {
+        /* Serial data received */
+        state = handler_state::packet_arriving;
+      } else if (alarmsToSend && alarm_nextToSend(&alarm)) {
+        // Change state to process alarm
+        // This has lower priority than a packet recieved via serialIO
+        state = handler_state::alarm_waiting;
+      } else {
+        alarmsToSend = false;
+        waiting = true;
+      }
+      break;
+
+    case handler_state::packet_arriving: /* Don't know what the packet is yet */
+      // Keep receiving packet until completion, or the RX ring runs dry
+      if (packet_receive(rx_packet, &packet_len, &packet_checksum)) {
+        state = handler_state::packet_process;
+      } else {
+        waiting = true;
+      }
+      break;
+
+    case handler_state::packet_process: /* Alarm ACK or Command */
+      packetStatus = process_packet(rx_packet, packet_len, packet_checksum);
+      switch (packetStatus) {
+      case processPacket::command: {
+        // A tagged command starts with its REQ, which goes back in front of
+        // the response
+        uint8_t tag = rx_packet[(uint8_t)packet_field::msg_type] ==
+                              (char)msgType::cmdTagged
+                          ? 1
+                          : 0;
+        uint8_t len = (uint8_t)rx_packet[(uint8_t)packet_field::len];
+        if (len < tag) {
+          comms_sendCommandERR(rx_packet);
+          break;
+        }
+        if (tag) {
+          cmdResponse_data[0] = rx_packet[(uint8_t)packet_field::data];
+        }
+
+        switch (command_execute(
+            (enum command)rx_packet[(uint8_t)packet_field::cmd],
+            &rx_packet[(uint8_t)packet_field::data + tag], len - tag,
+            &cmdResponse_data[tag], &cmdResponseData_len,
+            sizeof(cmdResponse_data) - tag)) {
+        case commandStatus::ok:
+          // Send response to Interface Controller
+          command_responseSend((uint8_t)rx_packet[(uint8_t)packet_field::cmd],
+                               tag != 0, cmdResponse_data,
+                               cmdResponseData_len + tag);
+          break;
+        case commandStatus::modeErr:
+          // Not allowed in this mode, send mode error
+          comms_sendModeERR(rx_packet);
+          break;
+        default:
+          // Unknown command or bad payload, send error
+          comms_sendCommandERR(rx_packet);
+          break;
+        }
+        break;
+      }
+
+      case processPacket::ack: {
+        // We've received an alarm acknowledgement, remove the occurrences that
+        // alarm frame reported from the buffer
+        int8_t slot = window_findSeq((uint8_t)rx_packet[1]);
+        if (slot >= 0) {
+          alarm_remove(alarmWindow[slot].alarm, alarmWindow[slot].count);
+          window_release(slot);
+        }
+        break;
+      }
+
+      case processPacket::nack: {
+        // The IC didn't take the alarm, or we couldn't read its answer.  Keep
+        // the alarm in the buffer, and if we know which one it was, send it
+        // again straight away
+        int8_t slot = window_findSeq((uint8_t)rx_packet[1]);
+        if (slot >= 0) {
+          window_release(slot);
+        }
+        break;
+      }
+
+      case processPacket::checksumErr:
+        // The received packet had an invalid checksum, send error
+        rxErrors.checksum++;
+        comms_sendChecksumERR(rx_packet);
+        break;
+
+      case processPacket::msgTypeUnknown:
+        // TODO Handle this error case
+        break;
+
+      default:
+        // TODO handle this error case
+        break;
+      }
+
+      state = handler_state::idle;
+      break;
+
+    case handler_state::alarm_waiting:
+      send_alarm(alarm);
+      state = handler_state::idle;
+      break;
+
+    default:
+      // TODO Undefined state, log Error
+      state = handler_state::idle; // Make sure FSM always ends in defined state
+      break;
+    }
+  }
+}
+
+void comms_sendResetState() {
+  // NOTE : Given the bootloader clears MCUSR, it's not possible to determine
+  // what reset the CPU without modifying the bootloader
+
+  const char *version = version_getVersion();
+  uint32_t time = Hal.millis();
+
+  // TIME[4] VERSION[8]
+  char resetData[wire_size<uint32_t>() + 8];
+  wire_put(&resetData[0], time);
+  memcpy(&resetData[wire_size<uint32_t>()], version, 8);
+
+  serialIO_send(msgType::status, dataID::vc_boot, resetData, sizeof(resetData));
+}
+
+void comms_sendPeriodicSample(int32_t pressure_pa, int32_t volume_ml,
+                              int32_t flow_ml_s) {
+  uint32_t time = Hal.millis();
+
+  // Readings batched in the other format, before the mode changed, are
+  // dropped.
+  if (parameters_getPeriodicMode() == periodicMode::compressed) {
+    if (telemetryBatch.samples() > 0) {
+      telemetryBatch.reset();
+    }
+    if (compressedBatch.add(time, pressure_pa, volume_ml, flow_ml_s)) {
+      serialIO_send(msgType::data, dataID::data_compressed,
+                    compressedBatch.data(), compressedBatch.length());
+      compressedBatch.reset();
+    }
+  } else {
+    if (compressedBatch.samples() > 0) {
+      compressedBatch.reset();
+    }
+    if (telemetryBatch.add(time, pressure_pa, volume_ml, flow_ml_s)) {
+      serialIO_send(msgType::data, dataID::data_batch, telemetryBatch.data(),
+                    telemetryBatch.length());
+      telemetryBatch.reset();
+    }
+  }
+}
+
+void comms_sendChannels(uint8_t due, const int32_t *values) {
+  uint32_t time = Hal.millis();
+
+  if (due != 0 && !channelBatch.add(time, due, values)) {
+    comms_flushChannels();
+    channelBatch.add(time, due, values);
+  }
+  if (channelBatch.records() > 0 &&
+      time - channelBatch.firstTime() >= COMMS_CHANNELS_LATENCY_MS) {
+    comms_flushChannels();
+  }
+}
+
+void comms_flushChannels() {
+  if (channelBatch.records() > 0) {
+    serialIO_send(msgType::data, dataID::data_channels, channelBatch.data(),
+                  channelBatch.length());
+    channelBatch.reset();
+  }
+}
+
+void comms_sendBreathSummary(const BreathSummary &summary) {
+  char data[BREATH_SUMMARY_LEN];
+  breath_encodeSummary(summary, data);
+  serialIO_send(msgType::data, dataID::breath_summary, data, sizeof(data));
+}
+
+void comms_getRxErrors(commsRxErrors_t *errors) { *errors = rxErrors; }
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+// Sends an alarm and records it in a free window slot.  The caller makes
+// sure there is one, see alarm_nextToSend().
+static void send_alarm(const alarm_t &alarm) {
+  // SEQ[1] FIRST_SEEN[4] LAST_SEEN[4] COUNT[2] SEVERITY[1] DATA[ALARM_DATALEN]
+  char data[wire_size<uint8_t, uint32_t, uint32_t, uint16_t, uint8_t>() +
+            ALARM_DATALEN];
+  int8_t slot = window_free();
+  if (slot < 0) {
+    return;
+  }
+
+  alarm_inFlight_t &sent = alarmWindow[slot];
+  sent.used = true;
+  sent.seq = alarmSeq++;
+  sent.alarm = alarm.alarm;
+  sent.count = alarm.count;
+  sent.sentTime = Hal.millis();
+  alarmsInFlight++;
+
+  WireWriter writer(data, sizeof(data));
+  writer.put(sent.seq);
+  writer.put(alarm.timestamp);
+  writer.put(alarm.last_seen);
+  writer.put(alarm.count);
+  writer.put((uint8_t)alarm.severity);
+  memcpy(&data[writer.length()], alarm.data, ALARM_DATALEN);
+
+  serialIO_send(msgType::alarm, alarm.alarm, data, sizeof(data));
+}
+
+// Finds the first alarm in the queue that isn't already waiting for an ack,
+// provided there is room in the window to send it.
+static bool alarm_nextToSend(alarm_t *alarm) {
+  if (window_free() < 0) {
+    return false;
+  }
+  for (uint8_t pos = 0; alarm_readAt(pos, alarm) == VC_STATUS_SUCCESS; pos++) {
+    if (window_find(alarm->alarm) < 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int8_t window_find(enum dataID alarm) {
+  for (uint8_t i = 0; i < ALARM_WINDOW; i++) {
+    if (alarmWindow[i].used && alarmWindow[i].alarm == alarm) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int8_t window_findSeq(uint8_t seq) {
+  for (uint8_t i = 0; i < ALARM_WINDOW; i++) {
+    if (alarmWindow[i].used && alarmWindow[i].seq == seq) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int8_t window_free() {
+  for (uint8_t i = 0; i < ALARM_WINDOW; i++) {
+    if (!alarmWindow[i].used) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Frees a slot.  Whatever it held is still queued until acked, so look for
+// something to send again.
+static void window_release(int8_t slot) {
+  alarmWindow[slot].used = false;
+  alarmsInFlight--;
+  alarmsToSend = true;
+}
+
+static enum processPacket process_packet(char *packet, uint8_t len,
+                                        uint16_t checksum) {
+
+  // Validate packet checksum
+  if (!packet_checksumValidation(checksum)) {
+    // Checksum invalid
+    // Therefore cannot be 100% sure that received msgType is correct
+    // Can we assume however that the length is correct? If yes,
+    // An Ack packet only has four bytes.
+    // Treat an Ack with checksum error as a nack
+    // The alarm will stay in the queue and we'll try to resend it later
+
+    if (len == PACKET_ACK_LEN) {
+      // Assume that the recieved packet is a ack/nack following
+      // the transmission of an alarm
+      return processPacket::nack;
+    }
+
+    return processPacket::checksumErr;
+  }
+
+  // What packet type is it?
+  if (packet[(uint8_t)packet_field::msg_type] == (uint8_t)msgType::cmd ||
+      packet[(uint8_t)packet_field::msg_type] == (uint8_t)msgType::cmdTagged) {
+    // It's a command packet, command_execute() checks it against the
+    // command table
+    return processPacket::command;
+  } else if (packet[(uint8_t)packet_field::msg_type] == (uint8_t)msgType::ack) {
+    // An ACK packet
+    return processPacket::ack;
+  } else if (packet[(uint8_t)packet_field::msg_type] ==
+             (uint8_t)msgType::nAck) {
+    // A NACK packet
+    return processPacket::nack;
+  }
+
+  // Error condition - unexpected msg_type
+  return processPacket::msgTypeUnknown;
+}
+
+// The checksum covers the whole packet, including the check bytes, so a
+// valid packet sums to zero.
+static bool packet_checksumValidation(uint16_t checksum) {
+  return checksum == 0;
+}
+
+// Starts looking for the next packet.
+static void packet_reset() {
+  rxField = packet_field::sof;
+  rxPacketLen = 0;
+  rxDataLen = 0;
+  rxChecksum.reset();
+}
+
+// Parses packets out of the RX ring.  Bytes are taken a contiguous span at a
+// time, with the payload copied in bulk, and every byte of the packet is
+// folded into the checksum as it arrives.  Returns true once a whole packet
+// has been received, and leaves any following bytes in the ring.
+//
+// Bytes are skipped until PACKET_SOF.  Whatever can't be part of a packet of
+// ours, an unknown type or an oversized length, drops the packet, and the
+// search for the next SOF starts again from the following byte.
+static bool packet_receive(char *packet, uint8_t *len, uint16_t *checksum) {
+  bool packet_complete = false;
+
+  const char *span;
+  uint8_t span_len;
+  while (!packet_complete && (span_len = serialIO_peek(&span)) > 0) {
+    uint8_t used = 0;
+
+    while (!packet_complete && used < span_len) {
+      switch (rxField) {
+      case packet_field::sof: {
+        // Anything before the start of a packet is skipped in one go
+        const char *sof = static_cast<const char *>(
+            memchr(&span[used], PACKET_SOF, span_len - used));
+        uint8_t skip =
+            sof != nullptr ? (uint8_t)(sof - &span[used]) : span_len - used;
+        rxErrors.skipped += skip;
+        used += skip;
+        if (sof != nullptr) {
+          used++;
+          rxField = packet_field::msg_type;
+        }
+        break;
+      }
+
+      case packet_field::msg_type:
+        packet[rxPacketLen] = span[used++];
+
+        // Process field - what kind of packet is this? Command or Ack?
+        if (packet[rxPacketLen] == (char)msgType::cmd ||
+            packet[rxPacketLen] == (char)msgType::cmdTagged) {
+          // Command packet
+          rxField = packet_field::cmd;
+          rxChecksum.add(packet[rxPacketLen++]);
+        } else if (packet[rxPacketLen] == (char)msgType::ack ||
+                   packet[rxPacketLen] == (char)msgType::nAck) {
+          // Alarm acknowledgement, followed by its sequence number
+          rxField = packet_field::cmd;
+          rxChecksum.add(packet[rxPacketLen++]);
+        } else if (packet[rxPacketLen] == (char)PACKET_SOF) {
+          // The SOF before was noise, or a packet lost its end
+        } else {
+          // Not a packet of ours, look for the next one
+          rxErrors.invalid++;
+          packet_reset();
+        }
+        break;
+
+      case packet_field::cmd:
+        packet[rxPacketLen] = span[used++];
+        rxChecksum.add(packet[rxPacketLen++]);
+        if (packet[(uint8_t)packet_field::msg_type] == (char)msgType::cmd ||
+            packet[(uint8_t)packet_field::msg_type] ==
+                (char)msgType::cmdTagged) {
+          rxField = packet_field::len;
+        } else {
+          // Acks have a sequence number in place of the command, and no
+          // payload
+          rxField = packet_field::checksumA;
+        }
+        break;
+
+      case packet_field::len:
+        packet[rxPacketLen] = span[used++];
+        rxChecksum.add(packet[rxPacketLen++]);
+
+        if ((uint8_t)packet[(uint8_t)packet_field::len] >
+            PACKET_DATA_LEN_MAX) {
+          // Can't be a packet of ours, and would overflow the buffer.  Drop
+          // what we have and look for the start of the next packet.
+          rxErrors.invalid++;
+          packet_reset();
+        } else if (packet[(uint8_t)packet_field::len] == 0) {
+          // If no data, skip straight to the checksum
+          rxField = packet_field::checksumA;
+        } else {
+          rxField = packet_field::data;
+        }
+        break;
+
+      case packet_field::data: {
+        uint8_t count = packet[(uint8_t)packet_field::len] - rxDataLen;
+        if (count > span_len - used) {
+          count = span_len - used;
+        }
+        memcpy(&packet[rxPacketLen], &span[used], count);
+        rxChecksum.add(&packet[rxPacketLen], count);
+        used += count;
+        rxPacketLen += count;
+        rxDataLen += count;
+        if (rxDataLen == packet[(uint8_t)packet_field::len]) {
+          rxField = packet_field::checksumA;
+        }
+        break;
+      }
+
+      case packet_field::checksumA:
+        packet[rxPacketLen] = span[used++];
+        rxChecksum.add(packet[rxPacketLen++]);
+        rxField = packet_field::checksumB;
+        break;
+
+      case packet_field::checksumB:
+        packet[rxPacketLen] = span[used++];
+        rxChecksum.add(packet[rxPacketLen++]);
+        packet_complete = true;
+        break;
+
+      default:
+        // Should never arrive there
+        // TODO Log error
+        packet_reset();
+        break;
+      }
+    }
+
+    serialIO_consume(used);
+    rxLastByteTime = Hal.millis();
+  }
+
+  if (packet_complete) {
+    *len = rxPacketLen; // Save packet length
+    *checksum = rxChecksum.value();
+    packet_reset();
+  }
+
+  return packet_complete;
+}
+
+static void comms_sendModeERR(char *packet) {
+  comms_sendError(msgType::rErrMode, packet);
+}
+
+static void comms_sendChecksumERR(char *packet) {
+  comms_sendError(msgType::rErrChecksum, packet);
+}
+
+static void comms_sendCommandERR(char *packet) {
+  comms_sendError(msgType::rErrCmd, packet);
+}
+
+// An error about a tagged command is tagged too, and carries just its REQ.
+// One which arrived without its REQ gets an untagged error.
+static void comms_sendError(enum msgType type, const char *packet) {
+  bool tagged =
+      packet[(uint8_t)packet_field::msg_type] == (char)msgType::cmdTagged &&
+      packet[(uint8_t)packet_field::len] != 0;
+  serialIO_send(tagged ? (enum msgType)((uint8_t)type | MSGTYPE_TAGGED) : type,
+                (enum dataID)packet[(uint8_t)packet_field::cmd],
+                &packet[(uint8_t)packet_field::data], tagged ? 1 : 0);
+}
@@ -0,0 +1,83 @@
+/* Copyright 2020, Edwin Chiu
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef COMMS_H
+#define COMMS_H
+
+#include <stdint.h>
+
+#include "checksum.h"
+#include "command.h"
+#include "packet_types.h"
+#include "parameters.h"
+#include "serialIO.h"
+#include "telemetry_codec.h"
+#include "types.h"
+#include "version.h"
+
+enum class processPacket {
+  checksumErr = 0x00,
+  command = 0x03,
+  ack = 0x04,
+  nack = 0x05,
+  msgTypeUnknown = 0x06,
+
+  count /* Sentinel */
+};
+
+// A packet which has started arriving is dropped if no more of it arrives
+// for this long, and the next PACKET_SOF is looked for.  Several times the
+// ~3 ms a full packet takes at 115200 baud, to allow for a USB serial
+// adapter splitting it up.
+inline constexpr uint32_t COMMS_RX_TIMEOUT_MS = 10;
+
+// Subscribed channels are held back to share packets for at most this long.
+inline constexpr uint32_t COMMS_CHANNELS_LATENCY_MS = 100;
+
+void comms_init();
+void comms_handler();
+void comms_sendFlow(float flow);
+void comms_sendPressure(float pressure);
+void comms_sendVolume(float volume);
+void comms_sendFlowPressureVolume(float flow, float pressure, float volume);
+void comms_sendResetState();
+// Queues a reading for periodic telemetry.  Readings are sent in batches,
+// as dataID::data_batch or, in periodicMode::compressed, as
+// dataID::data_compressed; see telemetry.h.
+void comms_sendPeriodicSample(int32_t pressure_pa, int32_t volume_ml,
+                              int32_t flow_ml_s);
+// Called at each telemetry sample while subscription_active(), with the
+// channels due and a reading for every channel, indexed by telemetryChannel.
+// The channels due are batched as dataID::data_channels, and sent once a
+// packet is full or COMMS_CHANNELS_LATENCY_MS old.
+void comms_sendChannels(uint8_t due, const int32_t *values);
+// Sends whatever channels are batched now.  For when the subscription
+// changes, as comms_sendChannels() is only called while one is active, and
+// the batch would otherwise wait for the next.
+void comms_flushChannels();
+// Sends the metrics of a breath as dataID::breath_summary.  Unlike the
+// periodic readings, these are sent whatever the periodic mode.
+void comms_sendBreathSummary(const BreathSummary &summary);
+
+// Counts of the ways incoming packets have failed, since comms_init().
+struct commsRxErrors_t {
+  uint16_t skipped;  /* Bytes thrown away looking for PACKET_SOF */
+  uint16_t timeouts; /* Packets which stopped arriving part way through */
+  uint16_t invalid;  /* Packets of an unknown type, or too long */
+  uint16_t checksum; /* Packets with a bad checksum */
+};
+void comms_getRxErrors(commsRxErrors_t *errors);
+
+#endif // COMMS_H
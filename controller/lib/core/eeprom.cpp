@@ -12,6 +12,153 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <string.h>
+
+#include "checksum.h"
 #include "eeprom.h"
+#include "serialization.h"
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+namespace {
+enum class record_field {
+  version = 0x00,
+  len = 0x01,
+  seq = 0x02,
+  data = 0x04,
+
+  count /* Sentinel */
+};
+
+// The record being written
+struct eeprom_write_t {
+  char record[EEPROM_SLOT_SIZE];
+  uint8_t len; /* Bytes in the record */
+  uint8_t pos; /* Next byte to write */
+  uint8_t slot;
+  uint16_t seq;
+};
+} // anonymous namespace
+
+static bool have_record = false;
+static uint8_t newest_slot;
+static uint16_t newest_seq;
+
+static bool writing = false;
+static eeprom_write_t pending;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static uint16_t slot_addr(uint8_t slot) {
+  return static_cast<uint16_t>(slot) * EEPROM_SLOT_SIZE;
+}
+
+// Reads the record in a slot into record.  Returns its length, or 0 if the
+// slot doesn't hold an intact record.
+static uint8_t read_record(uint8_t slot, char *record) {
+  Hal.eepromRead(slot_addr(slot), record, (uint8_t)record_field::data);
+  uint8_t data_len = (uint8_t)record[(uint8_t)record_field::len];
+  if (data_len > EEPROM_DATA_LEN_MAX) {
+    // An erased slot reads as 0xff, which lands here too
+    return 0;
+  }
+
+  uint8_t len = data_len + EEPROM_RECORD_OVERHEAD;
+  Hal.eepromRead(slot_addr(slot) + (uint8_t)record_field::data,
+                 &record[(uint8_t)record_field::data],
+                 len - (uint8_t)record_field::data);
+  return checksum_check(record, len) ? len : 0;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void eeprom_init() {
+  char record[EEPROM_SLOT_SIZE];
+  have_record = false;
+  writing = false;
+
+  for (uint8_t slot = 0; slot < EEPROM_SLOTS; slot++) {
+    if (read_record(slot, record) == 0) {
+      continue;
+    }
+    uint16_t seq = wire_getUint16(&record[(uint8_t)record_field::seq]);
+    // Sequence numbers wrap, so compare them by their difference
+    if (!have_record || static_cast<int16_t>(seq - newest_seq) > 0) {
+      have_record = true;
+      newest_slot = slot;
+      newest_seq = seq;
+    }
+  }
+}
+
+bool eeprom_load(uint8_t version, char *data, uint8_t len) {
+  char record[EEPROM_SLOT_SIZE];
+  if (!have_record || read_record(newest_slot, record) == 0 ||
+      (uint8_t)record[(uint8_t)record_field::version] != version ||
+      (uint8_t)record[(uint8_t)record_field::len] != len) {
+    return false;
+  }
+  memcpy(data, &record[(uint8_t)record_field::data], len);
+  return true;
+}
+
+bool eeprom_save(uint8_t version, const char *data, uint8_t len) {
+  if (writing || len > EEPROM_DATA_LEN_MAX) {
+    return false;
+  }
+
+  pending.slot = have_record ? (newest_slot + 1) % EEPROM_SLOTS : 0;
+  pending.seq = have_record ? newest_seq + 1 : 0;
+  pending.len = len + EEPROM_RECORD_OVERHEAD;
+  pending.pos = 0;
+
+  char *record = pending.record;
+  record[(uint8_t)record_field::version] = (char)version;
+  record[(uint8_t)record_field::len] = (char)len;
+  wire_put(&record[(uint8_t)record_field::seq], pending.seq);
+  memcpy(&record[(uint8_t)record_field::data], data, len);
+
+  uint8_t checked = pending.len - 2;
+  uint16_t check_bytes =
+      check_bytes_fletcher16(checksum_fletcher16(record, checked));
+  record[checked] = (char)(check_bytes >> 8);
+  record[checked + 1] = (char)(check_bytes & 0xff);
+
+  writing = true;
+  return true;
+}
+
+void eeprom_handler() {
+  if (!writing || !Hal.eepromReady()) {
+    return;
+  }
+
+  // Skip over bytes which are already right, and start writing the first
+  // one that isn't.
+  uint16_t addr = slot_addr(pending.slot);
+  while (pending.pos < pending.len) {
+    uint8_t value = (uint8_t)pending.record[pending.pos];
+    uint8_t current;
+    Hal.eepromRead(addr + pending.pos, &current, 1);
+    pending.pos++;
+    if (current != value) {
+      Hal.eepromWriteByte(addr + pending.pos - 1, value);
+      break;
+    }
+  }
+
+  if (pending.pos == pending.len) {
+    writing = false;
+    have_record = true;
+    newest_slot = pending.slot;
+    newest_seq = pending.seq;
+  }
+}
 
-void eeprom_init() {}
+bool eeprom_busy() { return writing; }
@@ -16,6 +16,50 @@ limitations under the License.
 #ifndef EEPROM_H
 #define EEPROM_H
 
+#include <stdint.h>
+
+#include "hal.h"
+
+// A store for one record, e.g. the saved parameters, which survives resets.
+//
+// The EEPROM is split into fixed size slots, and each save goes into the slot
+// after the newest record, so the writes are spread over the whole EEPROM
+// instead of wearing out one spot.  Each record is
+//
+//   VERSION[1] LEN[1] SEQ[2] DATA[LEN] CHECKSUM[2]
+//
+// and the newest is the valid one with the highest sequence number.  A record
+// torn by a reset or power loss part way through being written fails its
+// checksum, so the previous one is used instead.
+//
+// Writing a byte takes ~3.4ms, so saves don't block: eeprom_save() queues the
+// record, and eeprom_handler() writes it a byte at a time from the main loop.
+// Bytes which already hold the right value aren't written again.
+
+inline constexpr uint8_t EEPROM_SLOT_SIZE = 80;
+inline constexpr uint8_t EEPROM_SLOTS = HalApi::EEPROM_SIZE / EEPROM_SLOT_SIZE;
+// VERSION[1] + LEN[1] + SEQ[2] + CHECKSUM[2]
+inline constexpr uint8_t EEPROM_RECORD_OVERHEAD = 6;
+inline constexpr uint8_t EEPROM_DATA_LEN_MAX =
+    EEPROM_SLOT_SIZE - EEPROM_RECORD_OVERHEAD;
+
+// Finds the newest record.
 void eeprom_init();
 
+// Copies the data of the newest record.  Returns false if there is none, or
+// it has a different version or length, i.e. it was saved by firmware with a
+// different layout.
+bool eeprom_load(uint8_t version, char *data, uint8_t len);
+
+// Queues a record to be written.  Returns false, and saves nothing, if the
+// previous record is still being written or the data is too long.
+bool eeprom_save(uint8_t version, const char *data, uint8_t len);
+
+// Writes the queued record, one byte per call whenever the EEPROM is ready.
+// Call this from the main loop.
+void eeprom_handler();
+
+// True while a record is being written.
+bool eeprom_busy();
+
 #endif // EEPROM_H
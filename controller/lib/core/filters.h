@@ -0,0 +1,123 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdint.h>
+
+// Streaming filters for integer sample streams.  Every new sample is folded in
+// with add() in O(1), so the amount of smoothing doesn't affect how long it
+// takes to produce a reading.
+//
+// These classes do no locking.  If add() is called from an interrupt handler,
+// read the filter with interrupts blocked.
+
+// Moving average ("boxcar") over the most recent `window()` samples, using a
+// running sum.  N is the largest supported window and must be a power of two
+// no larger than 128.
+template <uint8_t N> class BoxcarFilter {
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0,
+                "N must be a power of two no larger than 128");
+
+public:
+  BoxcarFilter() { reset(0); }
+
+  // Forgets all previous samples and acts as if the last N samples had all
+  // been `value`.
+  void reset(uint16_t value) {
+    for (uint8_t i = 0; i < N; i++) {
+      samples_[i] = value;
+    }
+    head_ = 0;
+    sum_ = int32_t{value} * window_;
+  }
+
+  // Changes the number of samples averaged over, between 1 and N inclusive.
+  // O(window); intended to be called rarely.
+  void setWindow(uint8_t window) {
+    if (window < 1 || window > N) {
+      return;
+    }
+    window_ = window;
+    sum_ = sumOfLatest(window);
+  }
+
+  uint8_t window() const { return window_; }
+
+  void add(uint16_t sample) {
+    sum_ += int32_t{sample} - samples_[(head_ - window_) & (N - 1)];
+    samples_[head_] = sample;
+    head_ = (head_ + 1) & (N - 1);
+  }
+
+  // Sum of the last window() samples.
+  int32_t sum() const { return sum_; }
+
+  // Mean of the last window() samples, rounded down.
+  uint16_t value() const { return static_cast<uint16_t>(sum_ / window_); }
+
+  // Most recent sample.
+  uint16_t latest() const { return samples_[(head_ - 1) & (N - 1)]; }
+
+  // Sum of the last `count` samples, for count <= N.  O(count).
+  int32_t sumOfLatest(uint8_t count) const {
+    int32_t sum = 0;
+    uint8_t idx = head_;
+    for (uint8_t i = 0; i < count; i++) {
+      idx = (idx - 1) & (N - 1);
+      sum += samples_[idx];
+    }
+    return sum;
+  }
+
+private:
+  uint16_t samples_[N];
+  // Index the next sample will be written to.
+  uint8_t head_;
+  uint8_t window_ = N;
+  int32_t sum_;
+};
+
+// First-order IIR low-pass ("exponential moving average"):
+//
+//   y[n] = y[n-1] + (x[n] - y[n-1]) / 2^SHIFT
+//
+// The state keeps FRACTION_BITS of extra precision so that small steps aren't
+// lost to truncation.  The time constant is about 2^SHIFT samples.
+template <uint8_t SHIFT> class IirFilter {
+  static_assert(SHIFT > 0 && SHIFT <= 8, "SHIFT must be between 1 and 8");
+
+public:
+  IirFilter() { reset(0); }
+
+  void reset(uint16_t value) { state_ = int32_t{value} << FRACTION_BITS; }
+
+  void add(uint16_t sample) {
+    state_ += ((int32_t{sample} << FRACTION_BITS) - state_) >> SHIFT;
+  }
+
+  // Current output, rounded to the nearest integer.
+  uint16_t value() const {
+    return static_cast<uint16_t>(
+        (state_ + (int32_t{1} << (FRACTION_BITS - 1))) >> FRACTION_BITS);
+  }
+
+private:
+  static constexpr uint8_t FRACTION_BITS = 8;
+  int32_t state_;
+};
+
+#endif // FILTERS_H
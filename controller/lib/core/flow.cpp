@@ -0,0 +1,153 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "flow.h"
+#include "hal.h"
+#include "scheduler.h"
+
+/****************************************************************************************
+ *    FLOW TABLE
+ ****************************************************************************************/
+
+// Entries every FINE_STEP_PA up to COARSE_START_PA, then every COARSE_STEP_PA
+// up to the sensor's full scale.
+static constexpr uint8_t FINE_STEP_SHIFT = 2; /* 4 Pa */
+static constexpr uint8_t COARSE_STEP_SHIFT = 5; /* 32 Pa */
+static constexpr int32_t COARSE_START_PA = 256;
+static constexpr int32_t TABLE_END_PA = 2048;
+static constexpr uint8_t FINE_POINTS = COARSE_START_PA >> FINE_STEP_SHIFT;
+static constexpr uint8_t TABLE_POINTS =
+    FINE_POINTS +
+    ((TABLE_END_PA - COARSE_START_PA) >> COARSE_STEP_SHIFT) + 1;
+
+static constexpr float table_sqrt(float x) {
+  // Newton's method, which is plenty for a table built at compile time
+  float root = x > 1.0f ? x : 1.0f;
+  for (int i = 0; i < 32; i++) {
+    root = 0.5f * (root + x / root);
+  }
+  return root;
+}
+
+// Q = Cd * A2 * sqrt(2 * dP / (rho * (1 - (A2 / A1)^2)))
+static constexpr float venturi_flow(float dp_pa) {
+  constexpr float PI = 3.14159265f;
+  float throat_m = VENTURI_THROAT_DIAMETER_MM * 0.001f;
+  float area_m2 = PI * throat_m * throat_m / 4.0f;
+  float ratio = VENTURI_THROAT_DIAMETER_MM / VENTURI_INLET_DIAMETER_MM;
+  float beta4 = ratio * ratio * ratio * ratio;
+  float m3_s = VENTURI_DISCHARGE_COEFFICIENT * area_m2 *
+               table_sqrt(2.0f * dp_pa / (AIR_DENSITY * (1.0f - beta4)));
+  return m3_s * 1.0e6f;
+}
+
+static constexpr int32_t table_pa(uint8_t index) {
+  return index < FINE_POINTS
+             ? int32_t{index} << FINE_STEP_SHIFT
+             : COARSE_START_PA + (int32_t{index - FINE_POINTS}
+                                  << COARSE_STEP_SHIFT);
+}
+
+namespace {
+struct flow_table_t {
+  uint16_t flow[TABLE_POINTS]; /* mL/s */
+};
+} // anonymous namespace
+
+static constexpr flow_table_t make_table() {
+  flow_table_t table{};
+  for (uint8_t i = 0; i < TABLE_POINTS; i++) {
+    table.flow[i] = static_cast<uint16_t>(venturi_flow(table_pa(i)) + 0.5f);
+  }
+  return table;
+}
+
+static constexpr flow_table_t FLOW_TABLE HAL_FLASH = make_table();
+
+static_assert(venturi_flow(TABLE_END_PA) < UINT16_MAX,
+              "Flow table entries don't fit in uint16_t");
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+// Microlitres per (mL/s) of flow over one scheduler tick
+static constexpr int32_t UL_PER_TICK = 1000000 / 1000 / SCHEDULER_TICK_HZ;
+static_assert(1000 % SCHEDULER_TICK_HZ == 0,
+              "Volume integration assumes whole microlitres per tick");
+
+static int32_t flow_ml_s;
+static int32_t volume_ul;
+static int32_t peak_volume_ul;
+static int32_t tidal_volume_ml;
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+int32_t venturi_flow_ml_s(int32_t dp_pa) {
+  bool negative = dp_pa < 0;
+  uint16_t dp = static_cast<uint16_t>(
+      negative ? (dp_pa < -TABLE_END_PA ? TABLE_END_PA : -dp_pa)
+               : (dp_pa > TABLE_END_PA ? TABLE_END_PA : dp_pa));
+
+  uint8_t index;
+  uint8_t shift;
+  if (dp < COARSE_START_PA) {
+    shift = FINE_STEP_SHIFT;
+    index = static_cast<uint8_t>(dp >> FINE_STEP_SHIFT);
+  } else {
+    shift = COARSE_STEP_SHIFT;
+    index = static_cast<uint8_t>(FINE_POINTS +
+                                 ((dp - COARSE_START_PA) >> COARSE_STEP_SHIFT));
+  }
+
+  int32_t flow = hal_flashReadUint16(&FLOW_TABLE.flow[index]);
+  uint16_t frac = dp - static_cast<uint16_t>(table_pa(index));
+  if (frac != 0) {
+    int32_t next = hal_flashReadUint16(&FLOW_TABLE.flow[index + 1]);
+    flow += ((next - flow) * frac) >> shift;
+  }
+  return negative ? -flow : flow;
+}
+
+void flow_init() {
+  flow_ml_s = 0;
+  volume_ul = 0;
+  peak_volume_ul = 0;
+  tidal_volume_ml = 0;
+}
+
+void flow_update(int32_t inhale_dp_pa, int32_t exhale_dp_pa) {
+  // Flow in through the inhalation limb, less the flow out through the
+  // exhalation limb
+  flow_ml_s = venturi_flow_ml_s(inhale_dp_pa) - venturi_flow_ml_s(exhale_dp_pa);
+  volume_ul += flow_ml_s * UL_PER_TICK;
+  if (volume_ul > peak_volume_ul) {
+    peak_volume_ul = volume_ul;
+  }
+}
+
+void flow_startBreath() {
+  tidal_volume_ml = peak_volume_ul / 1000;
+  volume_ul = 0;
+  peak_volume_ul = 0;
+}
+
+int32_t flow_getFlow() { return flow_ml_s; }
+
+int32_t flow_getVolume() { return volume_ul / 1000; }
+
+int32_t flow_getTidalVolume() { return tidal_volume_ml; }
@@ -0,0 +1,60 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef FLOW_H
+#define FLOW_H
+
+#include <stdint.h>
+
+// Flow and volume, from the differential pressure across the venturis in the
+// inhalation and exhalation limbs.
+//
+// A venturi's flow goes with the square root of its pressure drop.  There's
+// no sqrt() at run time: the flow is interpolated from a table, computed at
+// compile time, which is fine-grained at low pressures where the square root
+// is steep and coarse above.  Each update costs two lookups and an addition.
+
+// Venturi geometry.
+// TODO: Measure these on the assembled ventilator.
+inline constexpr float VENTURI_INLET_DIAMETER_MM = 15.0f;
+inline constexpr float VENTURI_THROAT_DIAMETER_MM = 6.0f;
+inline constexpr float VENTURI_DISCHARGE_COEFFICIENT = 0.98f;
+// Density of air [kg/m^3]
+inline constexpr float AIR_DENSITY = 1.2f;
+
+// Flow through one venturi, in mL/s, for a differential pressure in Pa.  The
+// sign of the flow follows the sign of the pressure.
+int32_t venturi_flow_ml_s(int32_t dp_pa);
+
+// Clears the flow and volume.
+void flow_init();
+
+// Updates the flow and integrates it into the volume.  Call once per
+// scheduler tick, with the differential pressures across the inhalation and
+// exhalation venturis.
+void flow_update(int32_t inhale_dp_pa, int32_t exhale_dp_pa);
+
+// Starts a new breath: the volume goes back to zero, and the largest volume
+// of the breath just finished becomes the tidal volume.
+void flow_startBreath();
+
+// Net flow into the patient [mL/s]
+int32_t flow_getFlow();
+// Volume delivered since the start of the breath [mL]
+int32_t flow_getVolume();
+// Tidal volume of the last complete breath [mL]
+int32_t flow_getTidalVolume();
+
+#endif // FLOW_H
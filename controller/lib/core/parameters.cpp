@@ -13,6 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "parameters.h"
+#include "eeprom.h"
+#include "hal.h"
+#include "serialization.h"
 
 /****************************************************************************************
  *    PRIVATE FUNCTION PROTOTYPES
@@ -21,6 +24,11 @@ limitations under the License.
 static void init_defaultVentilatorParameters();
 static void init_defaultPIDParameters();
 static void init_defaultCalibrationParameters();
+static float clamp(float value, float min, float max);
+static int8_t pid_profile(pid_fsm_state phase);
+static void mark_dirty();
+static void save_parameters();
+static bool load_parameters();
 
 /****************************************************************************************
  *    PRIVATE VARIABLES
@@ -34,6 +42,10 @@ static float ier; /* Inspire / expire ratio */
 static float pip;
 static float dwell;
 
+// A settings block waiting for the next breath, see parameters_stageSettings()
+static ventilatorSettings_t stagedSettings;
+static bool settingsStaged = false;
+
 static bool periodicReadings;
 
 static enum operatingMode operationMode;
@@ -43,121 +55,190 @@ static enum solenoidNormaleState normalState;
 
 // Calibration parameters
 
-// PID parameters
-static float Kp_pid;
-static float Ki_pid;
-static float Kd_pid;
+// PID parameters, a profile per phase from pid_fsm_state::inspire on
+static pidGains_t pidGains[PID_PROFILES];
+// Incremented whenever one of the PID gains changes.
+static uint8_t pidRevision;
+
+// Saved parameters, see parameters_handler()
+static bool dirty = false;
+static uint32_t lastChangeTime;
+static uint32_t lastSaveTime;
 
 /****************************************************************************************
  *    PUBLIC FUNCTIONS
  ****************************************************************************************/
 
 void parameters_init() {
-  // eeprom_init();
-
   init_defaultVentilatorParameters();
   init_defaultPIDParameters();
   init_defaultCalibrationParameters();
+
+  // Carry on with the settings from before the reset, if they were saved
+  eeprom_init();
+  load_parameters();
+
+  dirty = false;
+  // Don't hold back the first save after boot
+  lastSaveTime = Hal.millis() - PARAMETERS_SAVE_INTERVAL_MS;
 }
 
-void parameters_setKp(float kp_value) { Kp_pid = kp_value; }
+void parameters_handler() {
+  eeprom_handler();
+
+  uint32_t now = Hal.millis();
+  if (dirty && !eeprom_busy() &&
+      now - lastChangeTime >= PARAMETERS_SAVE_DELAY_MS &&
+      now - lastSaveTime >= PARAMETERS_SAVE_INTERVAL_MS) {
+    save_parameters();
+    dirty = false;
+    lastSaveTime = now;
+  }
+}
 
-float parameters_getKp() { return Kp_pid; }
+void parameters_setKp(float kp_value) {
+  for (pidGains_t &gains : pidGains) {
+    gains.kp = kp_value;
+  }
+  pidRevision++;
+  mark_dirty();
+}
 
-void parameters_setKi(float ki_value) { Ki_pid = ki_value; }
+float parameters_getKp() { return pidGains[0].kp; }
 
-float parameters_getKi() { return Ki_pid; }
+void parameters_setKi(float ki_value) {
+  for (pidGains_t &gains : pidGains) {
+    gains.ki = ki_value;
+  }
+  pidRevision++;
+  mark_dirty();
+}
 
-void parameters_setKd(float kd_value) { Kd_pid = kd_value; }
+float parameters_getKi() { return pidGains[0].ki; }
 
-float parameters_getKd() { return Kd_pid; }
+void parameters_setKd(float kd_value) {
+  for (pidGains_t &gains : pidGains) {
+    gains.kd = kd_value;
+  }
+  pidRevision++;
+  mark_dirty();
+}
 
-void parameters_setRR(float rr_value) {
+float parameters_getKd() { return pidGains[0].kd; }
+
+bool parameters_setPhaseGains(pid_fsm_state phase, const pidGains_t *gains) {
+  int8_t profile = pid_profile(phase);
+  if (profile < 0) {
+    return false;
+  }
+  pidGains[profile] = *gains;
+  pidRevision++;
+  mark_dirty();
+  return true;
+}
 
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (rr_value > RR_MAX)
-    rr = RR_MAX;
-  else if (rr_value < RR_MIN)
-    rr = RR_MIN;
-  else
-    rr = rr_value;
+bool parameters_getPhaseGains(pid_fsm_state phase, pidGains_t *gains) {
+  int8_t profile = pid_profile(phase);
+  if (profile < 0) {
+    return false;
+  }
+  *gains = pidGains[profile];
+  return true;
+}
+
+uint8_t parameters_getPidRevision() { return pidRevision; }
+
+void parameters_setRR(float rr_value) {
+  rr = clamp(rr_value, RR_MIN, RR_MAX);
+  mark_dirty();
 }
 
 float parameters_getRR() { return rr; }
 
 void parameters_setTV(float tv_value) {
-
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (tv_value > TV_MAX)
-    tv = TV_MAX;
-  else if (tv_value < TV_MIN)
-    tv = TV_MIN;
-  else
-    tv = tv_value;
+  tv = clamp(tv_value, TV_MIN, TV_MAX);
+  mark_dirty();
 }
 
 float parameters_getTV() { return tv; }
 
 void parameters_setPEEP(float peep_value) {
-
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (peep_value > PEEP_MAX)
-    peep = PEEP_MAX;
-  else if (peep_value < PEEP_MIN)
-    peep = PEEP_MIN;
-  else
-    peep = peep_value;
+  peep = clamp(peep_value, PEEP_MIN, PEEP_MAX);
+  mark_dirty();
 }
 
 float parameters_getPEEP() { return peep; }
 
 void parameters_setInspireExpireRatio(float ier_value) {
-
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (ier_value > IER_MAX)
-    ier = IER_MAX;
-  else if (ier_value < IER_MIN)
-    ier = IER_MIN;
-  else
-    ier = ier_value;
+  ier = clamp(ier_value, IER_MIN, IER_MAX);
+  mark_dirty();
 }
 
 float parameters_getInspireExpireRatio() { return ier; }
 
 void parameters_setPIP(float pip_value) {
-
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (pip_value > PIP_MAX)
-    pip = PIP_MAX;
-  else if (pip_value < PIP_MIN)
-    pip = PIP_MIN;
-  else
-    pip = pip_value;
+  pip = clamp(pip_value, PIP_MIN, PIP_MAX);
+  mark_dirty();
 }
 
 float parameters_getPIP() { return pip; }
 
 void parameters_setDwell(float dwell_value) {
-
-  // Make sure the uploaded values are within safe minimums and maximums
-  // If not, clamp them
-  if (dwell_value > DWELL_MAX)
-    dwell = DWELL_MAX;
-  else if (dwell_value < DWELL_MIN)
-    dwell = DWELL_MIN;
-  else
-    dwell = dwell_value;
+  dwell = clamp(dwell_value, DWELL_MIN, DWELL_MAX);
+  mark_dirty();
 }
 
 float parameters_getDwell() { return dwell; }
 
+void parameters_stageSettings(const ventilatorSettings_t *settings) {
+  stagedSettings.rr = clamp(settings->rr, RR_MIN, RR_MAX);
+  stagedSettings.tv = clamp(settings->tv, TV_MIN, TV_MAX);
+  stagedSettings.peep = clamp(settings->peep, PEEP_MIN, PEEP_MAX);
+  stagedSettings.pip = clamp(settings->pip, PIP_MIN, PIP_MAX);
+  stagedSettings.dwell = clamp(settings->dwell, DWELL_MIN, DWELL_MAX);
+  stagedSettings.ier = clamp(settings->ier, IER_MIN, IER_MAX);
+  settingsStaged = true;
+}
+
+void parameters_getSettings(ventilatorSettings_t *settings) {
+  settings->rr = rr;
+  settings->tv = tv;
+  settings->peep = peep;
+  settings->pip = pip;
+  settings->dwell = dwell;
+  settings->ier = ier;
+}
+
+void parameters_getStagedSettings(ventilatorSettings_t *settings) {
+  if (settingsStaged) {
+    *settings = stagedSettings;
+  } else {
+    parameters_getSettings(settings);
+  }
+}
+
+bool parameters_applyStagedSettings() {
+  if (!settingsStaged) {
+    return false;
+  }
+  rr = stagedSettings.rr;
+  tv = stagedSettings.tv;
+  peep = stagedSettings.peep;
+  pip = stagedSettings.pip;
+  dwell = stagedSettings.dwell;
+  ier = stagedSettings.ier;
+  settingsStaged = false;
+  mark_dirty();
+  return true;
+}
+
 void parameters_setPeriodicMode(enum periodicMode periodicMode_value) {
+  // The mode comes straight off the wire, so reject unknown values.
+  if (periodicMode_value >= periodicMode::count) {
+    periodicMode_value = periodicMode::off;
+  }
   periodicDataMode = periodicMode_value;
+  periodicReadings = periodicMode_value != periodicMode::off;
 }
 
 enum periodicMode parameters_getPeriodicMode() { return periodicDataMode; }
@@ -174,6 +255,7 @@ bool parameters_getPeriodicReadings() { return periodicReadings; }
 
 void parameters_setVentilatorMode(enum ventilatorMode ventilatorMode_value) {
   ventilatorOperatingMode = ventilatorMode_value;
+  mark_dirty();
 }
 
 enum ventilatorMode parameters_getVentilatorMode() {
@@ -183,6 +265,7 @@ enum ventilatorMode parameters_getVentilatorMode() {
 void parameters_setSolenoidNormalState(
     enum solenoidNormaleState normalState_value) {
   normalState = normalState_value;
+  mark_dirty();
 }
 
 enum solenoidNormaleState parameters_getSolenoidNormalState() {
@@ -200,6 +283,7 @@ static void init_defaultVentilatorParameters() {
   ier = IER_DEFAULT;
   pip = PIP_DEFAULT;
   dwell = DWELL_DEFAULT;
+  settingsStaged = false;
   periodicReadings = PERIODIC_READINGS_DEFAULT;
 
   operationMode = OPERATING_MODE_DEFAULT;
@@ -209,9 +293,100 @@ static void init_defaultVentilatorParameters() {
 }
 
 static void init_defaultPIDParameters() {
-  Kp_pid = KP_DEFAULT;
-  Ki_pid = KI_DEFAULT;
-  Kd_pid = KD_DEFAULT;
+  for (pidGains_t &gains : pidGains) {
+    gains.kp = KP_DEFAULT;
+    gains.ki = KI_DEFAULT;
+    gains.kd = KD_DEFAULT;
+  }
+  pidRevision++;
 }
 
 static void init_defaultCalibrationParameters() {}
+
+// Index of the phase's profile in pidGains, or -1 if it has none.
+static int8_t pid_profile(pid_fsm_state phase) {
+  if (phase < pid_fsm_state::inspire || phase >= pid_fsm_state::count) {
+    return -1;
+  }
+  return (int8_t)phase - (int8_t)pid_fsm_state::inspire;
+}
+
+// Make sure the uploaded values are within safe minimums and maximums
+// If not, clamp them
+static float clamp(float value, float min, float max) {
+  if (value > max)
+    return max;
+  else if (value < min)
+    return min;
+  else
+    return value;
+}
+
+static void mark_dirty() {
+  dirty = true;
+  lastChangeTime = Hal.millis();
+}
+
+// Saved as
+// RR[4] TV[4] PEEP[4] IER[4] PIP[4] DWELL[4]
+// (KP[4] KI[4] KD[4]) for each profile
+// VENTILATOR_MODE[1] SOLENOID_NORMAL_STATE[1]
+#define PARAMETERS_RECORD_LEN                                                  \
+  (wire_size<float, float, float, float, float, float>() +                     \
+   PID_PROFILES * wire_size<float, float, float>() +                           \
+   wire_size<uint8_t, uint8_t>())
+
+static_assert(PARAMETERS_RECORD_LEN <= EEPROM_DATA_LEN_MAX,
+              "Saved parameters don't fit in an EEPROM slot");
+
+static void save_parameters() {
+  char record[PARAMETERS_RECORD_LEN];
+  WireWriter out(record, sizeof(record));
+  out.put(rr);
+  out.put(tv);
+  out.put(peep);
+  out.put(ier);
+  out.put(pip);
+  out.put(dwell);
+  for (const pidGains_t &gains : pidGains) {
+    out.put(gains.kp);
+    out.put(gains.ki);
+    out.put(gains.kd);
+  }
+  out.put((uint8_t)ventilatorOperatingMode);
+  out.put((uint8_t)normalState);
+  eeprom_save(PARAMETERS_RECORD_VERSION, record, sizeof(record));
+}
+
+// Values are checked as they would be if they'd been sent by the GUI, so a
+// record from firmware with different limits can't bring in unsafe settings.
+static bool load_parameters() {
+  char record[PARAMETERS_RECORD_LEN];
+  if (!eeprom_load(PARAMETERS_RECORD_VERSION, record, sizeof(record))) {
+    return false;
+  }
+
+  WireReader in(record, sizeof(record));
+  rr = clamp(in.getFloat(), RR_MIN, RR_MAX);
+  tv = clamp(in.getFloat(), TV_MIN, TV_MAX);
+  peep = clamp(in.getFloat(), PEEP_MIN, PEEP_MAX);
+  ier = clamp(in.getFloat(), IER_MIN, IER_MAX);
+  pip = clamp(in.getFloat(), PIP_MIN, PIP_MAX);
+  dwell = clamp(in.getFloat(), DWELL_MIN, DWELL_MAX);
+  for (pidGains_t &gains : pidGains) {
+    gains.kp = in.getFloat();
+    gains.ki = in.getFloat();
+    gains.kd = in.getFloat();
+  }
+  pidRevision++;
+
+  uint8_t mode = in.getUint8();
+  if (mode < (uint8_t)ventilatorMode::count) {
+    ventilatorOperatingMode = (enum ventilatorMode)mode;
+  }
+  uint8_t state = in.getUint8();
+  if (state < (uint8_t)solenoidNormaleState::count) {
+    normalState = (enum solenoidNormaleState)state;
+  }
+  return true;
+}
@@ -16,24 +16,59 @@ limitations under the License.
 #ifndef PARAMETERS_H
 #define PARAMETERS_H
 
+#include <stdint.h>
+
+#include "breath.h"
 #include "packet_types.h"
 #include "ventilator_defaults.h"
 #include "ventilator_limits.h"
 
-void parameters_setKp(float kp_value);
+// PID gains, as for PidController::setTunings()
+struct pidGains_t {
+  float kp;
+  float ki;
+  float kd;
+};
 
-float parameters_getKp();
+// Each phase of the breath has a PID profile of its own, since the pressure
+// rises and falls very differently, except pid_fsm_state::reset, which only
+// lasts until the first tick and uses the inspire profile.
+inline constexpr uint8_t PID_PROFILES = (uint8_t)pid_fsm_state::count - 1;
 
+// Set the gain in every profile.
+void parameters_setKp(float kp_value);
 void parameters_setKi(float ki_value);
+void parameters_setKd(float kd_value);
 
+// The gains of the inspire profile.
+float parameters_getKp();
 float parameters_getKi();
+float parameters_getKd();
 
-void parameters_setKd(float kd_value);
+// The profile of one phase.  Return false for a phase with no profile of its
+// own.
+bool parameters_setPhaseGains(pid_fsm_state phase, const pidGains_t *gains);
+bool parameters_getPhaseGains(pid_fsm_state phase, pidGains_t *gains);
 
-float parameters_getKd();
+// Changes whenever a gain is set, so that the controller can tell when it
+// needs to reload its gains without comparing floats every tick.
+uint8_t parameters_getPidRevision();
 
+// Sets the defaults, or the settings saved before the last reset.
 void parameters_init();
 
+// Saves changed ventilation and PID settings to EEPROM, so that they survive
+// a reset.  Saves wait until nothing has changed for
+// PARAMETERS_SAVE_DELAY_MS, so a burst of changes is saved once, and are at
+// least PARAMETERS_SAVE_INTERVAL_MS apart to limit EEPROM wear.  Call this
+// from the main loop.
+void parameters_handler();
+
+inline constexpr uint16_t PARAMETERS_SAVE_DELAY_MS = 2000;
+inline constexpr uint16_t PARAMETERS_SAVE_INTERVAL_MS = 10000;
+// Bump this whenever the saved layout changes, so old records are ignored.
+inline constexpr uint8_t PARAMETERS_RECORD_VERSION = 2;
+
 // Respiratory rate
 float parameters_getRR();
 void parameters_setRR(float rr_value);
@@ -59,6 +94,28 @@ float parameters_getPIP();
 void parameters_setDwell(float Dwell);
 float parameters_getDwell();
 
+// The settings that shape a breath, as sent by command::set_settings.
+struct ventilatorSettings_t {
+  float rr;
+  float tv;
+  float peep;
+  float pip;
+  float dwell;
+  float ier;
+};
+
+// Stages a whole settings block, clamped as the individual setters would.
+// The block replaces the current settings in one go at the start of the next
+// breath, when the breath FSM calls parameters_applyStagedSettings(), so a
+// breath never runs on a mix of old and new settings.  Values set one at a
+// time in the meantime are overwritten.
+void parameters_stageSettings(const ventilatorSettings_t *settings);
+void parameters_getSettings(ventilatorSettings_t *settings);
+// The settings the next breath will use: the staged block if there is one.
+void parameters_getStagedSettings(ventilatorSettings_t *settings);
+// Returns true if there was a staged block to apply.
+bool parameters_applyStagedSettings();
+
 enum operatingMode parameters_getOperatingMode();
 void parameters_setOperatingMode(enum operatingMode);
 
@@ -0,0 +1,156 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pid_controller.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// Errors and input deltas are clamped to +/- this many Pa, and every gain to
+// at most GAIN_MAX, so that each gain * error product fits in 31 bits.  Far
+// beyond the range of any of the pressure sensors.
+static const int32_t ERROR_LIMIT = int32_t{1} << 14;
+static const int32_t GAIN_MAX = int32_t{1} << 16;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static int32_t clamp(int32_t value, int32_t min, int32_t max) {
+  if (value < min) {
+    return min;
+  }
+  if (value > max) {
+    return max;
+  }
+  return value;
+}
+
+// Converts `value` to fixed-point with `frac_bits` fractional bits,
+// saturating to [0, GAIN_MAX].
+static int32_t to_gain(float value, uint8_t frac_bits) {
+  float scaled = value * static_cast<float>(int32_t{1} << frac_bits) + 0.5f;
+  if (!(scaled > 0)) {
+    return 0;
+  }
+  if (scaled >= static_cast<float>(GAIN_MAX)) {
+    return GAIN_MAX;
+  }
+  return static_cast<int32_t>(scaled);
+}
+
+// Rounds a Q16 value to an integer.
+static int32_t round_q16(int32_t value) {
+  return (value + (int32_t{1} << 15)) >> 16;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+PidController::PidController() {}
+
+void PidController::setTunings(float kp, float ki, float kd,
+                               uint16_t sample_period_us) {
+  // Gains are given per kPa; we work per Pa.
+  float dt = sample_period_us * 1e-6f;
+  kp_q16_ = to_gain(kp / 1000.0f, 16);
+  ki_q20_ = to_gain(ki / 1000.0f * dt, 20);
+  kd_q16_ = to_gain(kd / 1000.0f / dt, 16);
+}
+
+void PidController::transferTunings(float kp, float ki, float kd,
+                                    uint16_t sample_period_us,
+                                    int32_t setpoint) {
+  int32_t error = clamp(setpoint - last_input_, -ERROR_LIMIT, ERROR_LIMIT);
+  int32_t p_before = round_q16(kp_q16_ * error);
+  setTunings(kp, ki, kd, sample_period_us);
+  int32_t p_after = round_q16(kp_q16_ * error);
+
+  // Limited to what keeps the integrator within the output limits, which
+  // also keeps it from overflowing.
+  int32_t shift = clamp(p_before - p_after, out_min_ - integral(),
+                        out_max_ - integral());
+  integrator_q20_ = clamp(integrator_q20_ + shift * (int32_t{1} << 20),
+                          int32_t{out_min_} << 20, int32_t{out_max_} << 20);
+}
+
+void PidController::setOutputLimits(int16_t min, int16_t max) {
+  if (min >= max || min < -PID_OUTPUT_LIMIT || max > PID_OUTPUT_LIMIT) {
+    return;
+  }
+  out_min_ = min;
+  out_max_ = max;
+  integrator_q20_ = clamp(integrator_q20_, int32_t{min} << 20,
+                          int32_t{max} << 20);
+}
+
+void PidController::setFeedForward(float gain_per_kpa, int16_t offset) {
+  float scaled = gain_per_kpa / 1000.0f * 65536.0f;
+  if (scaled > GAIN_MAX) {
+    scaled = GAIN_MAX;
+  } else if (scaled < -GAIN_MAX) {
+    scaled = -GAIN_MAX;
+  }
+  ff_gain_q16_ = static_cast<int32_t>(scaled);
+  ff_offset_ = offset;
+}
+
+void PidController::reset(int32_t setpoint, int32_t input, int16_t output) {
+  last_input_ = clamp(input, -ERROR_LIMIT, ERROR_LIMIT);
+  int32_t integral = clamp(output, out_min_, out_max_) - feedForward(setpoint);
+  integrator_q20_ =
+      clamp(integral, out_min_, out_max_) * (int32_t{1} << 20);
+}
+
+int16_t PidController::compute(int32_t setpoint, int32_t input) {
+  input = clamp(input, -ERROR_LIMIT, ERROR_LIMIT);
+  int32_t error = clamp(setpoint - input, -ERROR_LIMIT, ERROR_LIMIT);
+  int32_t d_input = clamp(input - last_input_, -ERROR_LIMIT, ERROR_LIMIT);
+  last_input_ = input;
+
+  int32_t p = round_q16(kp_q16_ * error);
+  int32_t d = -round_q16(kd_q16_ * d_input);
+  int32_t ff = feedForward(setpoint);
+
+  int32_t min_q20 = int32_t{out_min_} << 20;
+  int32_t max_q20 = int32_t{out_max_} << 20;
+  int32_t integrator = integrator_q20_ + ki_q20_ * error;
+  integrator = clamp(integrator, min_q20, max_q20);
+
+  int32_t output = p + d + ff + ((integrator + (int32_t{1} << 19)) >> 20);
+  if ((output > out_max_ && error > 0) || (output < out_min_ && error < 0)) {
+    // The output is saturated; integrating further would only wind up.
+    integrator = integrator_q20_;
+    output = p + d + ff + ((integrator + (int32_t{1} << 19)) >> 20);
+  }
+  integrator_q20_ = integrator;
+
+  return static_cast<int16_t>(clamp(output, out_min_, out_max_));
+}
+
+int16_t PidController::integral() const {
+  return static_cast<int16_t>((integrator_q20_ + (int32_t{1} << 19)) >> 20);
+}
+
+/****************************************************************************************
+ *    PRIVATE METHODS
+ ****************************************************************************************/
+
+int32_t PidController::feedForward(int32_t setpoint) const {
+  setpoint = clamp(setpoint, -ERROR_LIMIT, ERROR_LIMIT);
+  return ff_offset_ + round_q16(ff_gain_q16_ * setpoint);
+}
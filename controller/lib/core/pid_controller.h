@@ -0,0 +1,98 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+#include <stdint.h>
+
+// Largest magnitude of an output limit; keeps the integrator within 32 bits.
+inline constexpr int16_t PID_OUTPUT_LIMIT = 1023;
+
+// Integer-only PID controller with a fixed sample period.
+//
+// compute() must be called exactly once per sample period (e.g. from a
+// scheduler task); the period is passed to setTunings() and baked into the
+// fixed-point gains, so there's no timekeeping or division per sample.
+//
+// Inputs and setpoints are pressures in Pa; the output is in arbitrary
+// integer units (e.g. PWM duty) between the configured limits.  Gains are
+// specified the usual way, in output units per kPa of error (Kp), per kPa*s
+// (Ki) and per kPa/s (Kd).
+//
+//  - The derivative term acts on the measurement rather than the error, so
+//    setpoint steps don't kick the output.
+//  - Anti-windup: the integrator is clamped to the output limits, and doesn't
+//    grow further while the output is saturated in the same direction.
+//  - An optional feed-forward term, offset + gain * setpoint, is added to the
+//    output, so the feedback terms only have to correct the residual error.
+class PidController {
+public:
+  PidController();
+
+  // Sets the gains.  Converted to fixed-point, so this uses floating point
+  // and should only be called when the gains change.  Negative gains are
+  // treated as zero, and very large gains are saturated.
+  void setTunings(float kp, float ki, float kd, uint16_t sample_period_us);
+
+  // Switches to new gains, e.g. at a change of gain schedule, without a bump
+  // in the output: the integrator takes up the change in the proportional
+  // term for the error at the last sample, against `setpoint`.  Within the
+  // output limits, the next output is then as the old gains would have had
+  // it, and only moves away from it as the error does.
+  void transferTunings(float kp, float ki, float kd, uint16_t sample_period_us,
+                       int32_t setpoint);
+
+  // Limits must be within +/- PID_OUTPUT_LIMIT, and min < max.  Defaults to
+  // [0, 255].
+  void setOutputLimits(int16_t min, int16_t max);
+
+  // output += offset + gain_per_kpa * setpoint[kPa].  Disabled (both zero) by
+  // default.
+  void setFeedForward(float gain_per_kpa, int16_t offset);
+
+  // Restarts the controller so that, for a constant `input` equal to the
+  // setpoint, it keeps producing `output`: the integrator absorbs whatever the
+  // feed-forward doesn't provide.  Use this to switch the controller on
+  // without a bump in the output.
+  void reset(int32_t setpoint, int32_t input, int16_t output);
+
+  // Runs one sample period and returns the new output.
+  int16_t compute(int32_t setpoint, int32_t input);
+
+  // Current integrator contribution to the output, in output units.
+  int16_t integral() const;
+
+private:
+  int32_t feedForward(int32_t setpoint) const;
+
+  // Proportional and derivative gains in Q16.16, output units per Pa
+  // (per Pa per sample, for kd).  Integral gain in Q12.20, output units per
+  // Pa*sample.
+  int32_t kp_q16_ = 0;
+  int32_t ki_q20_ = 0;
+  int32_t kd_q16_ = 0;
+  int32_t ff_gain_q16_ = 0;
+  int16_t ff_offset_ = 0;
+
+  int16_t out_min_ = 0;
+  int16_t out_max_ = 255;
+
+  // Integrator state in Q12.20 output units.
+  int32_t integrator_q20_ = 0;
+  int32_t last_input_ = 0;
+};
+
+#endif // PID_CONTROLLER_H
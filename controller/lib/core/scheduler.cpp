@@ -0,0 +1,222 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "scheduler.h"
+
+#include "hal.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+static const uint32_t COUNTS_PER_US = HalApi::LOOP_TIMER_HZ / 1000000;
+static const uint32_t US_PER_TICK = 1000000UL / SCHEDULER_TICK_HZ;
+// Keeps stats_ticks * US_PER_TICK in range.
+static const uint32_t STATS_TICKS_MAX = UINT32_MAX / 2 / US_PER_TICK;
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+// Incremented from the timer ISR.  8 bits so that reading it from the main
+// loop is atomic on AVR; the main loop folds it into `ticks` often enough
+// that it can't wrap unnoticed.
+static volatile uint8_t isr_ticks;
+
+static const scheduler_task_t *task_table;
+static uint8_t task_count;
+
+// Tick on which each task last ran and how many times it overran.
+static uint32_t task_lastRun[SCHEDULER_MAX_TASKS];
+static uint16_t task_overruns[SCHEDULER_MAX_TASKS];
+
+// Ticks which have been accounted for by scheduler_run().
+static uint32_t ticks;
+static uint8_t ticks_seen;
+static uint16_t missed_ticks;
+
+// Timing statistics.  Durations are summed for the means, and the sums and
+// run counts are halved together before the counts saturate, which keeps
+// the means while giving recent runs more weight.
+struct task_timing_t {
+  uint16_t min_us;
+  uint16_t max_us;
+  uint32_t sum_us;
+  uint16_t runs;
+};
+static task_timing_t task_timing[SCHEDULER_MAX_TASKS];
+static uint16_t period_counts[SCHEDULER_PERIOD_BINS];
+// Loop timer count at the start of the last run of the first task.
+static uint32_t last_start;
+static bool started;
+// Time spent in tasks, and the ticks elapsed, since the stats were reset.
+// Halved together before either overflows, like the sums above.
+static uint32_t busy_us;
+static uint32_t stats_ticks;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static uint16_t counts_to_us(uint32_t counts) {
+  uint32_t us = counts / COUNTS_PER_US;
+  return us > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(us);
+}
+
+static void count_period(uint32_t start) {
+  if (started) {
+    uint16_t period_us = counts_to_us(start - last_start);
+    uint8_t bin = 0;
+    while (bin < SCHEDULER_PERIOD_BINS - 1 &&
+           period_us >= SCHEDULER_PERIOD_BIN_LIMITS_US[bin]) {
+      bin++;
+    }
+    if (period_counts[bin] < UINT16_MAX) {
+      period_counts[bin]++;
+    }
+  }
+  last_start = start;
+  started = true;
+}
+
+static void count_run(uint8_t index, uint32_t counts) {
+  task_timing_t &timing = task_timing[index];
+  uint16_t us = counts_to_us(counts);
+
+  if (timing.runs == UINT16_MAX) {
+    timing.runs /= 2;
+    timing.sum_us /= 2;
+  }
+  if (timing.runs == 0 || us < timing.min_us) {
+    timing.min_us = us;
+  }
+  if (us > timing.max_us) {
+    timing.max_us = us;
+  }
+  timing.sum_us += us;
+  timing.runs++;
+  busy_us += us;
+}
+
+static void count_ticks(uint8_t elapsed) {
+  if (busy_us > UINT32_MAX / 2 || stats_ticks > STATS_TICKS_MAX) {
+    busy_us /= 2;
+    stats_ticks /= 2;
+  }
+  stats_ticks += elapsed;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void scheduler_init(const scheduler_task_t *tasks, uint8_t count) {
+  task_table = tasks;
+  task_count = count > SCHEDULER_MAX_TASKS ? SCHEDULER_MAX_TASKS : count;
+
+  ticks = 0;
+  ticks_seen = isr_ticks;
+  missed_ticks = 0;
+
+  for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+    task_lastRun[i] = 0;
+    task_overruns[i] = 0;
+  }
+  scheduler_resetStats();
+}
+
+void scheduler_tick() { isr_ticks = isr_ticks + 1; }
+
+void scheduler_run() {
+  uint8_t elapsed = isr_ticks - ticks_seen;
+  if (elapsed == 0) {
+    return;
+  }
+
+  ticks_seen += elapsed;
+  ticks += elapsed;
+  missed_ticks += elapsed - 1;
+  count_ticks(elapsed);
+
+  for (uint8_t i = 0; i < task_count; i++) {
+    const scheduler_task_t &task = task_table[i];
+    if (ticks - task_lastRun[i] < task.period_ticks) {
+      continue;
+    }
+
+    task_lastRun[i] = ticks;
+    uint32_t start = Hal.loopTimerCounts();
+    if (i == 0) {
+      count_period(start);
+    }
+    hal_profileMark(i);
+    task.run();
+    hal_profileMark(HAL_PROFILE_IDLE);
+    count_run(i, Hal.loopTimerCounts() - start);
+
+    if (isr_ticks != ticks_seen) {
+      // A new tick arrived while the task was running.  Give the new tick's
+      // higher-priority tasks a chance to run before any lower-priority ones.
+      task_overruns[i]++;
+      return;
+    }
+  }
+}
+
+uint32_t scheduler_getTicks() { return ticks; }
+
+uint16_t scheduler_getOverruns(uint8_t index) {
+  return index < task_count ? task_overruns[index] : 0;
+}
+
+uint16_t scheduler_getMissedTicks() { return missed_ticks; }
+
+void scheduler_getTaskStats(uint8_t index, scheduler_taskStats_t *stats) {
+  if (index >= task_count || task_timing[index].runs == 0) {
+    *stats = {0, 0, 0, 0};
+    return;
+  }
+  const task_timing_t &timing = task_timing[index];
+  stats->min_us = timing.min_us;
+  stats->max_us = timing.max_us;
+  stats->mean_us = static_cast<uint16_t>(timing.sum_us / timing.runs);
+  stats->runs = timing.runs;
+}
+
+uint16_t scheduler_getPeriodCount(uint8_t bin) {
+  return bin < SCHEDULER_PERIOD_BINS ? period_counts[bin] : 0;
+}
+
+uint16_t scheduler_getLoad() {
+  // us busy per ms is thousandths.
+  uint32_t elapsed_ms = stats_ticks * US_PER_TICK / 1000;
+  if (elapsed_ms == 0) {
+    return 0;
+  }
+  uint32_t load = busy_us / elapsed_ms;
+  return load > 1000 ? 1000 : static_cast<uint16_t>(load);
+}
+
+void scheduler_resetStats() {
+  for (task_timing_t &timing : task_timing) {
+    timing = {0, 0, 0, 0};
+  }
+  for (uint16_t &count : period_counts) {
+    count = 0;
+  }
+  started = false;
+  busy_us = 0;
+  stats_ticks = 0;
+}
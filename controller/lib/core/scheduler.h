@@ -0,0 +1,104 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Fixed-rate cooperative scheduler for the control loop.
+//
+// A hardware timer calls scheduler_tick() SCHEDULER_TICK_HZ times per second.
+// The main loop calls scheduler_run() repeatedly; each pass runs, in table
+// order, every task whose period has elapsed.  Tasks earlier in the table
+// have higher priority: if a new tick arrives while a task is running, the
+// remaining lower-priority tasks are deferred until the high-priority tasks
+// of the new tick have run.
+//
+// A task "overruns" if a tick arrives while it is running, i.e. it didn't
+// finish within the tick it was started in.  Ticks which arrive while a
+// previous tick is still being serviced are counted as missed.
+
+// Number of scheduler ticks per second.
+inline constexpr uint16_t SCHEDULER_TICK_HZ = 1000;
+
+// Maximum number of tasks which can be registered.
+inline constexpr uint8_t SCHEDULER_MAX_TASKS = 5;
+
+struct scheduler_task_t {
+  void (*run)();
+  // Run the task every `period_ticks` ticks.  Must be at least 1.
+  uint8_t period_ticks;
+};
+
+// Registers the task table.  `tasks` must outlive the scheduler, and is
+// ordered from highest to lowest priority.  Tasks beyond SCHEDULER_MAX_TASKS
+// are ignored.
+void scheduler_init(const scheduler_task_t *tasks, uint8_t count);
+
+// Advances the scheduler time base.  Called from the timer interrupt.
+void scheduler_tick();
+
+// Runs any tasks which are due.  Returns immediately if there is nothing to
+// do.
+void scheduler_run();
+
+// Number of ticks since scheduler_init().
+uint32_t scheduler_getTicks();
+
+// Number of times task `index` (its position in the task table) overran.
+uint16_t scheduler_getOverruns(uint8_t index);
+
+// Number of ticks which elapsed without the highest-priority task running.
+uint16_t scheduler_getMissedTicks();
+
+/****************************************************************************************
+ *    Timing statistics
+ ****************************************************************************************/
+
+// Each task run is timed against the loop timer (see
+// HalApi::loopTimerCounts()), as is the period between the starts of
+// successive runs of the highest-priority task.  The statistics cover the
+// time since scheduler_init() or scheduler_resetStats().  Times are in us,
+// saturating at UINT16_MAX.
+
+struct scheduler_taskStats_t {
+  uint16_t min_us;
+  uint16_t max_us;
+  uint16_t mean_us;
+  uint16_t runs; /* Saturates */
+};
+
+// Number of bins in the histogram of loop periods, and the upper bound of
+// each but the last, which is open-ended.  The bins are narrow around the
+// nominal period of one tick.
+inline constexpr uint8_t SCHEDULER_PERIOD_BINS = 8;
+inline constexpr uint16_t SCHEDULER_PERIOD_BIN_LIMITS_US[SCHEDULER_PERIOD_BINS -
+                                                         1] = {
+    950, 1050, 1100, 1250, 1500, 2000, 4000};
+
+// Timing of task `index`.  All zero if it hasn't run.
+void scheduler_getTaskStats(uint8_t index, scheduler_taskStats_t *stats);
+
+// Number of loop periods in histogram bin `bin`.  Saturates.
+uint16_t scheduler_getPeriodCount(uint8_t bin);
+
+// Fraction of the time spent running tasks, in thousandths.
+uint16_t scheduler_getLoad();
+
+// Clears the timing statistics.
+void scheduler_resetStats();
+
+#endif // SCHEDULER_H
@@ -20,28 +20,91 @@ Arduino Nano and the MPXV5004GP and MPXV7002DP pressure sensors.
 
 #include "hal.h"
 
-#include "blower.h"
+#include "actuators.h"
+#include "filters.h"
 #include "sensors.h"
 
-//@TODO: Replace floats with equivalent integer only operations to save program
-// space/time
-
-// Arduino Nano ADC is 10 bit, default 5V Vref_P (~4.9 mV
-// per count) [V];
-static const float ADC_LSB = 5.0f / 1024.0f;
+// Number of pressure sensors, and the ADC pins they're attached to in the order
+// they're sampled.
+static const int NUM_SENSORS = 3;
+static const AnalogPinId sensorPins[NUM_SENSORS] = {
+    PressureSensors::PATIENT_PIN,
+    PressureSensors::INHALATION_PIN,
+    PressureSensors::EXHALATION_PIN,
+};
 
 // zero calibration values for [0]: patient pressure sensor;[1]:
 // inhalation diff pressure sensor;[2]: exhalation diff pressure
 // sensor; [ADC Counts]
-static int sensorZeroVals[] = {0, 0, 0};
+static int sensorZeroVals[NUM_SENSORS] = {0, 0, 0};
+
+// Calibration of the sensor type attached to each pin.
+static const PressureSensorCalibration *const sensorCalibrations[NUM_SENSORS] =
+    {
+        &MPXV5004GP_CALIBRATION,
+        &MPXV7002DP_CALIBRATION,
+        &MPXV7002DP_CALIBRATION,
+};
 
 // number of samples to perform averaging over during sensor zeroization
 static int zeroingAvgSize = 4;
 // number of samples to perform averaging over during calibrated sensor reads
 static int sensorAvgSize = 2;
 
+// Largest supported averaging window.
+static const uint8_t MAX_AVG_SAMPLES = 32;
+
+// Streaming filters for each sensor, fed from the ADC interrupt.  The boxcar
+// filter also serves as the buffer of recent raw samples.  Both filters are
+// always updated, so switching between them doesn't need a warm-up period.
+//
+// Not volatile: the main loop only touches these with interrupts blocked,
+// which is also a compiler memory barrier.
+struct sensor_filters_t {
+  BoxcarFilter<MAX_AVG_SAMPLES> boxcar;
+  IirFilter<SENSOR_IIR_SHIFT> iir;
+  SensorFilter selected;
+};
+
+static sensor_filters_t sensorFilters[NUM_SENSORS];
+static bool samplingActive = false;
+
+// Index of `pinId` into the per-sensor arrays above.
+static int sensor_index(AnalogPinId pinId) {
+  return static_cast<int>(pinId) -
+         static_cast<int>(PressureSensors::PATIENT_PIN);
+}
+
+// Called from the ADC interrupt with each new conversion.
+static void on_adc_sample(AnalogPinId pinId, uint16_t value) {
+  sensor_filters_t &filters = sensorFilters[sensor_index(pinId)];
+  filters.boxcar.add(value);
+  filters.iir.add(value);
+}
+
+// Sum of the `count` most recent samples from `pinId`.
+static int32_t sum_recent_samples(AnalogPinId pinId, int count) {
+  BlockInterrupts block;
+  return sensorFilters[sensor_index(pinId)].boxcar.sumOfLatest(count);
+}
+
+// Current output of the filter selected for `pinId`, in ADC counts.
+static int filtered_sample(AnalogPinId pinId) {
+  const sensor_filters_t &filters = sensorFilters[sensor_index(pinId)];
+  BlockInterrupts block;
+  switch (filters.selected) {
+  case SensorFilter::iir:
+    return filters.iir.value();
+  case SensorFilter::none:
+    return filters.boxcar.latest();
+  case SensorFilter::boxcar:
+  default:
+    return filters.boxcar.value();
+  }
+}
+
 void set_zero_avg_samples(int numAvgSamples) {
-  if (numAvgSamples < 1 || numAvgSamples > 32) {
+  if (numAvgSamples < 1 || numAvgSamples > MAX_AVG_SAMPLES) {
     return;
   }
   zeroingAvgSize = numAvgSamples;
@@ -50,19 +113,35 @@ void set_zero_avg_samples(int numAvgSamples) {
 int get_zero_avg_samples() { return zeroingAvgSize; }
 
 void set_sensor_avg_samples(int numAvgSamples) {
-  if (numAvgSamples < 1 || numAvgSamples > 32) {
+  if (numAvgSamples < 1 || numAvgSamples > MAX_AVG_SAMPLES) {
     return;
   }
   sensorAvgSize = numAvgSamples;
+
+  BlockInterrupts block;
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    sensorFilters[i].boxcar.setWindow(static_cast<uint8_t>(sensorAvgSize));
+  }
 }
 
 int get_sensor_avg_samples() { return sensorAvgSize; }
 
+void set_sensor_filter(AnalogPinId pinId, SensorFilter filter) {
+  sensorFilters[sensor_index(pinId)].selected = filter;
+}
+
+SensorFilter get_sensor_filter(AnalogPinId pinId) {
+  return sensorFilters[sensor_index(pinId)].selected;
+}
+
 /*
  * @brief This method gets the zero pressure readings from the specified sensor
  * and averages them according to zeroingAvgSize. Called from zero_sensors(),
  * not for external use as zero_sensors() ensures correct system configuration.
  *
+ * Before sampling has started the ADC is read directly; afterwards the most
+ * recent background samples are used.
+ *
  * @param pressureSensor the sensor from the pressureSensor enum that a reading
  * is desired from
  *
@@ -70,42 +149,66 @@ int get_sensor_avg_samples() { return sensorAvgSize; }
  * pressureSensor enum member
  */
 static int get_raw_sensor_zero_reading(AnalogPinId pinId) {
-  int runningSum = 0;
-  for (int i = 0; i < zeroingAvgSize; i++) {
-    runningSum += Hal.analogRead(pinId);
+  int32_t runningSum = 0;
+  if (samplingActive) {
+    runningSum = sum_recent_samples(pinId, zeroingAvgSize);
+  } else {
+    for (int i = 0; i < zeroingAvgSize; i++) {
+      runningSum += Hal.analogRead(pinId);
+    }
   }
   // disregarding remainder because that's in the noise floor anyway
-  return runningSum / zeroingAvgSize;
+  return static_cast<int>(runningSum / zeroingAvgSize);
 }
 
 void zero_sensors() {
-  blower_disable();
+  actuators_disableBlower();
   Hal.delay(100); // some arbitrary time to wait for the pressure of the system
                   // to equalize at all points
-  sensorZeroVals[static_cast<int>(PressureSensors::PATIENT_PIN)] =
-      get_raw_sensor_zero_reading(PressureSensors::PATIENT_PIN);
-  sensorZeroVals[static_cast<int>(PressureSensors::INHALATION_PIN)] =
-      get_raw_sensor_zero_reading(PressureSensors::INHALATION_PIN);
-  sensorZeroVals[static_cast<int>(PressureSensors::EXHALATION_PIN)] =
-      get_raw_sensor_zero_reading(PressureSensors::EXHALATION_PIN);
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    sensorZeroVals[i] = get_raw_sensor_zero_reading(sensorPins[i]);
+  }
 }
 
 void sensors_init() {
   // must wait at least 20 ms from Power-On-Reset for pressure sensors to
   // warm-up
   Hal.delay(20);
+  // Zero against direct ADC reads; the background sampler isn't running yet.
+  samplingActive = false;
   zero_sensors();
+
+  // Seed the filters with the zero readings, so that reads made before the
+  // filters have settled return something sensible.
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    uint16_t zero = static_cast<uint16_t>(sensorZeroVals[i]);
+    sensorFilters[i].boxcar.setWindow(static_cast<uint8_t>(sensorAvgSize));
+    sensorFilters[i].boxcar.reset(zero);
+    sensorFilters[i].iir.reset(zero);
+  }
+
+  samplingActive = true;
+  Hal.startAnalogSampling(sensorPins, NUM_SENSORS, on_adc_sample);
+}
+
+int get_raw_sensor_reading(AnalogPinId pinId) {
+  return static_cast<int>(sum_recent_samples(pinId, 1));
+}
+
+const PressureSensorCalibration &get_sensor_calibration(AnalogPinId pinId) {
+  return *sensorCalibrations[sensor_index(pinId)];
+}
+
+// Readings out of the expected range raise alarms, see alarm_rules.h.
+int32_t get_pressure_reading_pa(AnalogPinId pinId) {
+  int idx = sensor_index(pinId);
+  int32_t counts = filtered_sample(pinId) - sensorZeroVals[idx];
+  // Round to the nearest Pa.
+  return (counts * sensorCalibrations[idx]->pa_per_count_q16 +
+          (int32_t{1} << 15)) >>
+         16;
 }
 
-//@TODO: Add alarms if sensor value is out of expected range?
 float get_pressure_reading(AnalogPinId pinId) {
-  int runningSum = 0;
-  for (int i = 0; i < sensorAvgSize; i++) {
-    runningSum +=
-        (Hal.analogRead(pinId) - sensorZeroVals[static_cast<int>(pinId)]);
-  }
-  // disregarding remainder because that's in the noise floor anyway
-  runningSum /= sensorAvgSize;
-  // Sensitivity of all pressure sensors is 1 V/kPa; no division needed.
-  return ((float)runningSum * ADC_LSB);
+  return get_pressure_reading_pa(pinId) * 0.001f;
 }
@@ -46,6 +46,58 @@ private:
   PressureSensors() = delete;
 };
 
+// The streaming filters which can be applied to a sensor's samples.
+enum class SensorFilter : uint8_t {
+  // Moving average over the last get_sensor_avg_samples() samples.
+  boxcar = 0,
+  // First-order low-pass with a time constant of 2^SENSOR_IIR_SHIFT samples.
+  iir = 1,
+  // The most recent sample only.
+  none = 2,
+};
+
+inline constexpr uint8_t SENSOR_IIR_SHIFT = 4;
+
+// Integer calibration data for one type of pressure sensor.
+struct PressureSensorCalibration {
+  // Conversion factor from zero-relative ADC counts to pressure, in Pa per
+  // count as a Q16.16 fixed-point number.
+  int32_t pa_per_count_q16;
+  // min/max possible reading [Pa]
+  int16_t min_pa;
+  int16_t max_pa;
+};
+
+// Computes PressureSensorCalibration::pa_per_count_q16 for a sensor with the
+// given sensitivity, read by a 10 bit ADC referenced to `vref` volts.
+constexpr int32_t pressure_pa_per_count_q16(float vref,
+                                            float volts_per_kpa) {
+  return static_cast<int32_t>(vref / 1024.0f / volts_per_kpa * 1000.0f *
+                                  65536.0f +
+                              0.5f);
+}
+
+// Per-type calibration tables.  Both sensors have a sensitivity of 1 V/kPa
+// when powered from 5V.
+inline constexpr PressureSensorCalibration MPXV5004GP_CALIBRATION = {
+    pressure_pa_per_count_q16(5.0f, 1.0f),
+    static_cast<int16_t>(PressureSensors::P_VAL_MIN * 1000),
+    static_cast<int16_t>(PressureSensors::P_VAL_MAX * 1000),
+};
+inline constexpr PressureSensorCalibration MPXV7002DP_CALIBRATION = {
+    pressure_pa_per_count_q16(5.0f, 1.0f),
+    static_cast<int16_t>(PressureSensors::DP_VAL_MIN * 1000),
+    static_cast<int16_t>(PressureSensors::DP_VAL_MAX * 1000),
+};
+
+/*
+ * @brief Gets the calibration table entry for the sensor type which is
+ * attached to the specified pin.
+ *
+ * @param pinId one of the PressureSensors pins
+ */
+const PressureSensorCalibration &get_sensor_calibration(AnalogPinId pinId);
+
 /*
  * @brief This method is to be called once on POR to initialize the module.
  * It calls zero_sensors() for an initial calibration. Call before
@@ -69,8 +121,13 @@ void sensors_init();
 void zero_sensors();
 
 /*
- * @brief This method gets the specified calibrated sensor reading and performs
- * simple averaging if configured to do so.
+ * @brief This method gets the specified calibrated sensor reading, filtered
+ * as configured with set_sensor_filter().
+ *
+ * The ADC is sampled continuously in the background once sensors_init() has
+ * been called, and every sample updates the filters as it arrives, so this
+ * never waits for a conversion and its cost doesn't depend on the amount of
+ * smoothing.
  *
  * @param pinId the pressure sensor pin that a reading is desired from
  *
@@ -78,6 +135,27 @@ void zero_sensors();
  */
 float get_pressure_reading(AnalogPinId pinId);
 
+/*
+ * @brief Integer-only equivalent of get_pressure_reading(), for callers which
+ * want to avoid floating point math.
+ *
+ * @param pinId the pressure sensor pin that a reading is desired from
+ *
+ * @return The specified pressure sensor calibrated reading in Pa (i.e.
+ * thousandths of a kPa)
+ */
+int32_t get_pressure_reading_pa(AnalogPinId pinId);
+
+/*
+ * @brief This method gets the most recent uncalibrated sample from the
+ * specified sensor, without waiting for a conversion.
+ *
+ * @param pinId the pressure sensor pin that a reading is desired from
+ *
+ * @return The most recent ADC reading, in counts
+ */
+int get_raw_sensor_reading(AnalogPinId pinId);
+
 /*
  * @brief Method for setting the number of samples to use for average during
  * sensor zeroization.
@@ -97,7 +175,7 @@ int get_zero_avg_samples();
 
 /*
  * @brief Method for setting the number of samples to use for average during
- * sensor zeroization.
+ * calibrated sensor reads.
  *
  * @param numAvgSamples the number of samples to use for averaging, between 1
  * and 32 inclusive
@@ -112,4 +190,19 @@ void set_sensor_avg_samples(int numAvgSamples);
  */
 int get_sensor_avg_samples();
 
+/*
+ * @brief Method for selecting the filter applied to calibrated reads from one
+ * sensor. Defaults to SensorFilter::boxcar.
+ *
+ * @param pinId the pressure sensor pin to configure
+ * @param filter the filter to use
+ */
+void set_sensor_filter(AnalogPinId pinId, SensorFilter filter);
+
+/*
+ * @brief Method for getting the filter applied to calibrated reads from one
+ * sensor.
+ */
+SensorFilter get_sensor_filter(AnalogPinId pinId);
+
 #endif // SENSORS_H
@@ -0,0 +1,209 @@
+/* Copyright 2020, Edwin Chiu
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "serialIO.h"
+#include "hal.h"
+#include "spsc_ring.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// Bits per second of each baudRate.
+static const uint32_t BAUD_RATES[] HAL_FLASH = {
+    115200,  // baudRate::b115200
+    250000,  // baudRate::b250000
+    500000,  // baudRate::b500000
+    1000000, // baudRate::b1000000
+};
+static_assert(sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]) ==
+                  static_cast<uint8_t>(baudRate::count),
+              "A rate is needed for each baudRate");
+
+// Frames and serialIO_peek() count in bytes of the rings.
+static_assert(SERIALIO_TX_BUFFER_SIZE <= 128 && SERIALIO_RX_BUFFER_SIZE <= 128,
+              "Ring sizes must fit the rings' single byte indices");
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+// The UART's interrupts are the consumer of the TX ring and the producer of
+// the RX ring; the main loop is the other side of each.
+static SpscRing<char, SERIALIO_TX_BUFFER_SIZE> txRing;
+// Bytes claimed past the TX ring's head by the open frame.
+static uint8_t txReserved;
+
+static SpscRing<char, SERIALIO_RX_BUFFER_SIZE> rxRing;
+
+// Baud rate negotiation.  A requested rate becomes current once the TX ring
+// has drained; it's then on probation until confirmed.
+static enum baudRate baud;
+static enum baudRate requestedBaud;
+static bool baudConfirmed;
+static uint32_t baudSwitchTime;
+
+static uint8_t txHighWater;
+static uint16_t txDroppedFrames;
+static volatile uint16_t rxOverruns;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+static void set_baud(enum baudRate rate) {
+  uint32_t bps;
+  hal_flashRead(&bps, &BAUD_RATES[static_cast<uint8_t>(rate)], sizeof(bps));
+  Hal.serialSetBaud(bps);
+  baud = rate;
+  requestedBaud = rate;
+  baudConfirmed = rate == baudRate::b115200;
+  baudSwitchTime = Hal.millis();
+}
+
+// Called from the UART's interrupts, see HalApi::startSerial().
+static bool tx_byte(char *c) { return txRing.pop(c); }
+
+static void rx_byte(char c) {
+  if (!rxRing.push(c)) {
+    rxOverruns++;
+  }
+}
+
+static void frame_putByte(serialIO_frame_t *frame, char c) {
+  txRing.pending(frame->pos++) = c;
+  frame->csum.add(c);
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void serialIO_init() {
+  txRing.clear();
+  txReserved = 0;
+  rxRing.clear();
+  txHighWater = 0;
+  txDroppedFrames = 0;
+  rxOverruns = 0;
+
+  set_baud(baudRate::b115200);
+  Hal.startSerial(rx_byte, tx_byte);
+}
+
+bool serialIO_frameBegin(serialIO_frame_t *frame, enum msgType type,
+                         enum dataID id, uint8_t len) {
+  uint16_t frame_len = len + SERIALIO_FRAME_OVERHEAD;
+  if (frame_len > txRing.space() - txReserved) {
+    txDroppedFrames++;
+    return false;
+  }
+
+  frame->pos = txReserved;
+  frame->csum.reset();
+  txReserved += frame_len;
+  frame->end = txReserved - 2;
+
+  // Send the packet: [SOF, DATA_TYPE, DATA_ID, LEN, DATA, check bytes].  The
+  // checksum starts after SOF.
+  txRing.pending(frame->pos++) = static_cast<char>(PACKET_SOF);
+  frame_putByte(frame, static_cast<char>(type));
+  frame_putByte(frame, static_cast<char>(id));
+  frame_putByte(frame, static_cast<char>(len));
+  return true;
+}
+
+void serialIO_frameWrite(serialIO_frame_t *frame, const char *data,
+                         uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) {
+    serialIO_frameWriteByte(frame, data[i]);
+  }
+}
+
+void serialIO_frameWriteByte(serialIO_frame_t *frame, char c) {
+  if (frame->pos != frame->end) {
+    frame_putByte(frame, c);
+  }
+}
+
+void serialIO_frameCommit(serialIO_frame_t *frame) {
+  while (frame->pos != frame->end) {
+    frame_putByte(frame, 0);
+  }
+
+  uint16_t check_bytes = check_bytes_fletcher16(frame->csum.value());
+  txRing.pending(frame->pos++) = static_cast<char>(check_bytes >> 8);
+  txRing.pending(frame->pos++) = static_cast<char>(check_bytes & 0xff);
+
+  // Publish the frame to the UART, then make sure it's sending.
+  txRing.publish(frame->pos);
+  txReserved -= frame->pos;
+  Hal.serialStartTx();
+
+  uint8_t used = txRing.size();
+  if (used > txHighWater) {
+    txHighWater = used;
+  }
+}
+
+void serialIO_send(enum msgType type, enum dataID id, const char *data,
+                   uint8_t len) {
+  serialIO_frame_t frame;
+  if (serialIO_frameBegin(&frame, type, id, len)) {
+    serialIO_frameWrite(&frame, data, len);
+    serialIO_frameCommit(&frame);
+  }
+}
+
+bool serialIO_dataAvailable() { return !rxRing.empty(); }
+
+uint8_t serialIO_peek(const char **data) { return rxRing.peek(data); }
+
+void serialIO_consume(uint8_t count) { rxRing.consume(count); }
+
+bool serialIO_requestBaud(enum baudRate rate) {
+  if (rate >= baudRate::count) {
+    return false;
+  }
+  requestedBaud = rate;
+  return true;
+}
+
+void serialIO_confirmBaud() { baudConfirmed = true; }
+
+enum baudRate serialIO_getBaud() { return baud; }
+
+void serialIO_handler() {
+  if (requestedBaud != baud) {
+    // Switch once the last byte has left the shift register, so nothing
+    // queued at the old rate is garbled.
+    if (txRing.empty() && Hal.serialTxDone()) {
+      set_baud(requestedBaud);
+    }
+  } else if (!baudConfirmed &&
+             Hal.millis() - baudSwitchTime >= SERIALIO_BAUD_CONFIRM_MS) {
+    // Nobody's talking to us at this rate.
+    set_baud(baudRate::b115200);
+  }
+}
+
+uint8_t serialIO_getTxHighWater() { return txHighWater; }
+
+uint16_t serialIO_getTxDroppedFrames() { return txDroppedFrames; }
+
+uint16_t serialIO_getRxOverruns() {
+  BlockInterrupts block;
+  return rxOverruns;
+}
@@ -0,0 +1,110 @@
+/* Copyright 2020, Edwin Chiu
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SERIALIO_H
+#define SERIALIO_H
+
+#include <stdint.h>
+
+#include "checksum.h"
+#include "comms.h"
+#include "packet_types.h"
+
+// Interrupt driven UART driver.  This replaces Arduino's Serial, which blocks
+// once its 64 byte TX buffer is full.
+//
+// Packets are written straight into the TX ring, which the UART drains from
+// its interrupt, through HalApi::startSerial(); received bytes come the other
+// way through the RX ring.  Both are SpscRings.  Nothing here ever waits for
+// the UART: if a packet doesn't fit in the ring it is dropped whole, and
+// counted.
+
+// Ring sizes.  Powers of two no larger than 128, see SpscRing.
+inline constexpr uint16_t SERIALIO_TX_BUFFER_SIZE = 128;
+inline constexpr uint16_t SERIALIO_RX_BUFFER_SIZE = 64;
+
+// SOF[1] + MSGTYPE[1] + DATAID[1] + LEN[1] + CHECKSUM[2]
+inline constexpr uint8_t SERIALIO_FRAME_OVERHEAD = 6;
+
+// A packet being written into the TX ring, see serialIO_frameBegin().
+struct serialIO_frame_t {
+  uint8_t pos;     // Offset past the ring's head of the next payload byte.
+  uint8_t end;     // Offset past the ring's head just past the payload.
+  Fletcher16 csum; // Checksum of the bytes written so far.
+};
+
+void serialIO_init();
+
+// Reserves room in the TX ring for a packet with a len byte payload, and
+// writes its header.  Returns false, and counts a dropped frame, if there
+// isn't room; the packet is then not sent.
+//
+// Write the payload with serialIO_frameWrite() and then publish the packet
+// with serialIO_frameCommit().  Only one frame may be open at a time, and
+// frames must only be written from the main loop (not from an ISR).
+bool serialIO_frameBegin(serialIO_frame_t *frame, enum msgType type,
+                         enum dataID id, uint8_t len);
+
+// Appends payload bytes to the frame.  Bytes beyond the length passed to
+// serialIO_frameBegin() are discarded.
+void serialIO_frameWrite(serialIO_frame_t *frame, const char *data,
+                         uint8_t len);
+void serialIO_frameWriteByte(serialIO_frame_t *frame, char c);
+
+// Appends the check bytes and hands the packet to the UART.  Payload bytes
+// which weren't written are sent as zeros.
+void serialIO_frameCommit(serialIO_frame_t *frame);
+
+// Sends a packet whose payload is already in a buffer.
+void serialIO_send(enum msgType type, enum dataID id, const char *data,
+                   uint8_t len);
+
+bool serialIO_dataAvailable();
+
+// Points *data at the oldest received bytes and returns how many of them are
+// contiguous in the RX ring (which may be fewer than are available, if the
+// data wraps).  The bytes stay in the ring until serialIO_consume().
+uint8_t serialIO_peek(const char **data);
+
+// Removes count bytes, at most the number last returned by serialIO_peek(),
+// from the RX ring.
+void serialIO_consume(uint8_t count);
+
+// Switches the link to `rate` once everything already queued has been sent
+// (including the response to the command which asked for it).  Unless
+// serialIO_confirmBaud() is called within SERIALIO_BAUD_CONFIRM_MS of the
+// switch, the link falls back to baudRate::b115200.  Returns false, and
+// changes nothing, if the rate isn't valid.
+bool serialIO_requestBaud(enum baudRate rate);
+
+// Tells the driver that a packet has been received intact at the current
+// rate, so the link is working.
+void serialIO_confirmBaud();
+
+enum baudRate serialIO_getBaud();
+
+// Carries out baud rate switches and fallbacks; call from the main loop.
+void serialIO_handler();
+
+inline constexpr uint16_t SERIALIO_BAUD_CONFIRM_MS = 1000;
+
+// Most bytes ever waiting in the TX ring, for sizing it.
+uint8_t serialIO_getTxHighWater();
+// Packets dropped because the TX ring was full.
+uint16_t serialIO_getTxDroppedFrames();
+// Bytes dropped because the RX ring was full.
+uint16_t serialIO_getRxOverruns();
+
+#endif // SERIALIO_H
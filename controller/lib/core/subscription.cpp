@@ -0,0 +1,65 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "subscription.h"
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+static uint8_t dividers[TELEMETRY_CHANNELS];
+// Samples until each channel is next due.
+static uint8_t countdowns[TELEMETRY_CHANNELS];
+static bool active = false;
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void subscription_init() {
+  const uint8_t none[TELEMETRY_CHANNELS] = {};
+  subscription_set(none);
+}
+
+void subscription_set(const uint8_t *divs) {
+  active = false;
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    dividers[c] = divs[c];
+    countdowns[c] = 0;
+    active = active || divs[c] != 0;
+  }
+}
+
+uint8_t subscription_getDivider(enum telemetryChannel channel) {
+  return (uint8_t)channel < TELEMETRY_CHANNELS ? dividers[(uint8_t)channel]
+                                               : 0;
+}
+
+bool subscription_active() { return active; }
+
+uint8_t subscription_tick() {
+  uint8_t due = 0;
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    if (dividers[c] == 0) {
+      continue;
+    }
+    if (countdowns[c] == 0) {
+      due |= 1 << c;
+      countdowns[c] = dividers[c];
+    }
+    countdowns[c]--;
+  }
+  return due;
+}
@@ -0,0 +1,49 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+#include <stdint.h>
+
+#include "packet_types.h"
+#include "telemetry_codec.h"
+
+// Which telemetry channels the Interface Controller subscribed to, with
+// command::set_subscription, and when each is due.
+//
+// Each channel has a divider: it's sent every divider-th telemetry sample,
+// or never for 0.  Channels with the same divider fall due together, and so
+// share records of dataID::data_channels.
+
+static_assert(TELEMETRY_CHANNELS == (uint8_t)telemetryChannel::count,
+              "telemetry_codec.h doesn't match enum telemetryChannel");
+
+// Nothing subscribed.
+void subscription_init();
+
+// Takes a divider for each channel, indexed by telemetryChannel.  Every
+// channel subscribed to is due at the next sample.
+void subscription_set(const uint8_t *dividers);
+uint8_t subscription_getDivider(enum telemetryChannel channel);
+
+// Whether any channel is subscribed to.
+bool subscription_active();
+
+// Moves on to the next telemetry sample.  Returns the channels due at it, as
+// a mask with bit n for telemetryChannel n.
+uint8_t subscription_tick();
+
+#endif // SUBSCRIPTION_H
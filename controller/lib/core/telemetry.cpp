@@ -0,0 +1,159 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string.h>
+
+#include "telemetry.h"
+
+// Readings outside the int16_t range are sent as its limits.
+static int16_t saturate_int16(int32_t value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return static_cast<int16_t>(value);
+}
+
+void TelemetryBatch::reset() {
+  // Leave room for the header, which is written with the first sample.
+  len_ = TELEMETRY_BATCH_HEADER_LEN;
+  count_ = 0;
+  buffer_[4] = 0;
+}
+
+bool TelemetryBatch::add(uint32_t time_ms, int32_t pressure_pa,
+                         int32_t volume_ml, int32_t flow_ml_s) {
+  if (full()) {
+    return true;
+  }
+
+  uint32_t dt = 0;
+  if (count_ == 0) {
+    wire_put(&buffer_[0], time_ms);
+  } else {
+    dt = time_ms - last_ms_;
+  }
+  last_ms_ = time_ms;
+
+  putByte(dt > UINT8_MAX ? UINT8_MAX : static_cast<uint8_t>(dt));
+  putInt16(pressure_pa);
+  putInt16(volume_ml);
+  putInt16(flow_ml_s);
+  buffer_[4] = static_cast<char>(++count_);
+  return full();
+}
+
+void TelemetryBatch::putInt16(int32_t value) {
+  wire_put(&buffer_[len_], saturate_int16(value));
+  len_ += wire_size<int16_t>();
+}
+
+void CompressedTelemetryBatch::reset() {
+  len_ = TELEMETRY_COMPRESSED_HEADER_LEN;
+  count_ = 0;
+  buffer_[4] = 0;
+  if (pending_) {
+    pending_ = false;
+    // Always fits in an empty batch.
+    append(pending_sample_);
+  }
+}
+
+bool CompressedTelemetryBatch::add(uint32_t time_ms, int32_t pressure_pa,
+                                   int32_t volume_ml, int32_t flow_ml_s) {
+  if (full()) {
+    return true;
+  }
+
+  TelemetrySample sample = {time_ms, pressure_pa, volume_ml, flow_ml_s};
+  if (!append(sample)) {
+    pending_ = true;
+    pending_sample_ = sample;
+  }
+  return full();
+}
+
+bool CompressedTelemetryBatch::append(const TelemetrySample &sample) {
+  if (count_ == 0) {
+    // Keyframe: relative to zero, at the time in the header.
+    last_ = {sample.time_ms, 0, 0, 0};
+  }
+
+  // Differences are taken modulo 2^32, so that they can't overflow.
+  int32_t deltas[3] = {
+      static_cast<int32_t>(static_cast<uint32_t>(sample.pressure_pa) -
+                           static_cast<uint32_t>(last_.pressure_pa)),
+      static_cast<int32_t>(static_cast<uint32_t>(sample.volume_ml) -
+                           static_cast<uint32_t>(last_.volume_ml)),
+      static_cast<int32_t>(static_cast<uint32_t>(sample.flow_ml_s) -
+                           static_cast<uint32_t>(last_.flow_ml_s)),
+  };
+
+  char encoded[TELEMETRY_COMPRESSED_SAMPLE_LEN_MAX];
+  uint8_t len = varint_put(sample.time_ms - last_.time_ms, encoded);
+  for (uint8_t c = 0; c < 3; c++) {
+    len += varint_put(zigzag_encode(deltas[c]), &encoded[len]);
+  }
+  if (len_ + len > TELEMETRY_COMPRESSED_LEN_MAX) {
+    return false;
+  }
+
+  if (count_ == 0) {
+    wire_put(&buffer_[0], sample.time_ms);
+  }
+  memcpy(&buffer_[len_], encoded, len);
+  len_ += len;
+  last_ = sample;
+  buffer_[4] = static_cast<char>(++count_);
+  return true;
+}
+
+void ChannelBatch::reset() {
+  len_ = TELEMETRY_CHANNELS_HEADER_LEN;
+  count_ = 0;
+  buffer_[4] = 0;
+}
+
+bool ChannelBatch::add(uint32_t time_ms, uint8_t mask, const int32_t *values) {
+  uint8_t len = 2;
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    if (mask & (1 << c)) {
+      len += wire_size<int16_t>();
+    }
+  }
+  if (len_ + len > TELEMETRY_CHANNELS_LEN_MAX ||
+      (count_ > 0 && time_ms - last_ms_ > UINT8_MAX)) {
+    return false;
+  }
+
+  if (count_ == 0) {
+    wire_put(&buffer_[0], time_ms);
+    first_ms_ = time_ms;
+    last_ms_ = time_ms;
+  }
+  buffer_[len_++] = static_cast<char>(time_ms - last_ms_);
+  buffer_[len_++] = static_cast<char>(mask);
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    if (mask & (1 << c)) {
+      wire_put(&buffer_[len_], saturate_int16(values[c]));
+      len_ += wire_size<int16_t>();
+    }
+  }
+  last_ms_ = time_ms;
+  buffer_[4] = static_cast<char>(++count_);
+  return true;
+}
@@ -0,0 +1,148 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#include "telemetry_codec.h"
+
+// Rate at which readings are sampled for periodic telemetry.
+inline constexpr uint16_t TELEMETRY_SAMPLE_HZ = 100;
+
+// Samples sent in each dataID::data_batch packet.  At 100 Hz that's 12.5
+// packets a second of 67 bytes, header and checksum included: ~840 B/s, or
+// about 7% of the 11520 B/s a 115200 baud link carries.
+inline constexpr uint8_t TELEMETRY_BATCH_SAMPLES = 8;
+
+inline constexpr uint8_t TELEMETRY_BATCH_LEN_MAX =
+    TELEMETRY_BATCH_HEADER_LEN +
+    TELEMETRY_BATCH_SAMPLES * TELEMETRY_SAMPLE_LEN;
+
+// Accumulates readings into the payload of a dataID::data_batch packet, so
+// that the per-packet header and checksum are paid once per batch rather
+// than once per reading.
+//
+// The payload is built in wire format (see telemetry_codec.h) as samples are
+// added, so a full batch can be sent as is.  Readings outside the int16_t
+// range are saturated.
+class TelemetryBatch {
+public:
+  TelemetryBatch() { reset(); }
+
+  // Empties the batch.
+  void reset();
+
+  // Appends a sample.  Returns true once the batch is full; it must then be
+  // sent and reset before adding more samples, which are otherwise ignored.
+  bool add(uint32_t time_ms, int32_t pressure_pa, int32_t volume_ml,
+           int32_t flow_ml_s);
+
+  uint8_t samples() const { return count_; }
+  bool full() const { return count_ == TELEMETRY_BATCH_SAMPLES; }
+
+  // The payload, and its length in bytes.
+  const char *data() const { return buffer_; }
+  uint8_t length() const { return len_; }
+
+private:
+  void putByte(uint8_t b) { buffer_[len_++] = static_cast<char>(b); }
+  void putInt16(int32_t value);
+
+  char buffer_[TELEMETRY_BATCH_LEN_MAX];
+  uint8_t len_;
+  uint8_t count_;
+  uint32_t last_ms_;
+};
+
+// Most samples sent in each dataID::data_compressed packet, and the largest
+// payload.
+inline constexpr uint8_t TELEMETRY_COMPRESSED_SAMPLES = 16;
+inline constexpr uint8_t TELEMETRY_COMPRESSED_LEN_MAX = 80;
+
+// Like TelemetryBatch, but builds the payload of a dataID::data_compressed
+// packet, which sends each reading as the difference from the one before.
+// Typical samples take four bytes, against seven for TelemetryBatch.
+class CompressedTelemetryBatch {
+public:
+  CompressedTelemetryBatch() : pending_(false) { reset(); }
+
+  // Empties the batch.  A sample which didn't fit in the previous batch
+  // becomes the first of this one.
+  void reset();
+
+  // Appends a sample.  Returns true once the batch is full; it must then be
+  // sent and reset before adding more samples, which are otherwise ignored.
+  //
+  // The batch is also full if this sample didn't fit, in which case it's
+  // held over to the next batch.
+  bool add(uint32_t time_ms, int32_t pressure_pa, int32_t volume_ml,
+           int32_t flow_ml_s);
+
+  uint8_t samples() const { return count_; }
+  bool full() const {
+    return count_ == TELEMETRY_COMPRESSED_SAMPLES || pending_;
+  }
+
+  const char *data() const { return buffer_; }
+  uint8_t length() const { return len_; }
+
+private:
+  // Encodes the sample relative to the previous one; returns false, leaving
+  // the batch unchanged, if it doesn't fit.
+  bool append(const TelemetrySample &sample);
+
+  char buffer_[TELEMETRY_COMPRESSED_LEN_MAX];
+  uint8_t len_;
+  uint8_t count_;
+  // The previous sample, which the next is encoded relative to.
+  TelemetrySample last_;
+  // A sample which didn't fit.
+  bool pending_;
+  TelemetrySample pending_sample_;
+};
+
+// Builds the payload of a dataID::data_channels packet, of records holding
+// whichever channels are due.
+class ChannelBatch {
+public:
+  ChannelBatch() { reset(); }
+
+  // Empties the batch.
+  void reset();
+
+  // Appends a record of the channels in `mask`, taking each from `values`,
+  // which is indexed by telemetryChannel.  Returns false, leaving the batch
+  // unchanged, if the record doesn't fit: the batch must then be sent and
+  // reset, after which it will.
+  bool add(uint32_t time_ms, uint8_t mask, const int32_t *values);
+
+  uint8_t records() const { return count_; }
+  // Time of the first record.
+  uint32_t firstTime() const { return first_ms_; }
+
+  const char *data() const { return buffer_; }
+  uint8_t length() const { return len_; }
+
+private:
+  char buffer_[TELEMETRY_CHANNELS_LEN_MAX];
+  uint8_t len_;
+  uint8_t count_;
+  uint32_t first_ms_;
+  uint32_t last_ms_;
+};
+
+#endif // TELEMETRY_H
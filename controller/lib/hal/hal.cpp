@@ -1,3 +1,160 @@
 #include "hal.h"
 
 HalApi Hal;
+
+#ifdef AVR
+
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+
+static void (*volatile loop_timer_callback)() = nullptr;
+// Timer counts per tick, and the count at the start of the current tick.
+static uint16_t loop_timer_period;
+static volatile uint32_t loop_timer_base;
+
+void HalApi::startLoopTimer(uint16_t hz, void (*callback)()) {
+  cli();
+  loop_timer_callback = callback;
+  loop_timer_period = static_cast<uint16_t>(F_CPU / hz);
+  loop_timer_base = 0;
+  // CTC mode with TOP = OCR1A, no prescaler.
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS10);
+  OCR1A = loop_timer_period - 1;
+  TCNT1 = 0;
+  TIMSK1 = _BV(OCIE1A);
+  sei();
+}
+
+ISR(TIMER1_COMPA_vect) {
+  loop_timer_base = loop_timer_base + loop_timer_period;
+  if (loop_timer_callback != nullptr) {
+    loop_timer_callback();
+  }
+}
+
+uint32_t HalApi::loopTimerCounts() {
+  BlockInterrupts block;
+  uint32_t base = loop_timer_base;
+  uint16_t count = TCNT1;
+  // The counter may have wrapped since interrupts were blocked, before the
+  // ISR could move the base on.  A low count says it wrapped before it was
+  // read.
+  if ((TIFR1 & _BV(OCF1A)) && count < loop_timer_period / 2) {
+    base += loop_timer_period;
+  }
+  return base + count;
+}
+
+uint16_t HalApi::loopTimerTickCounts() {
+  // Reading a 16-bit timer register goes through a temporary register which
+  // interrupts may also use.
+  BlockInterrupts block;
+  return TCNT1;
+}
+
+void HalApi::pwmStart(PwmPinId) {
+  OCR2B = 0;
+  // Phase correct PWM with TOP = 0xff, non-inverting on OC2B, no prescaler:
+  // 16 MHz / 510 = 31.4 kHz.  This is Timer2's only user.
+  TCCR2A = _BV(COM2B1) | _BV(WGM20);
+  TCCR2B = _BV(CS20);
+  Hal.setDigitalPinMode(static_cast<int>(PwmPinId::PWM_3),
+                        PinMode::HAL_OUTPUT);
+}
+
+void HalApi::pwmStop(PwmPinId) {
+  // With OC2B disconnected the pin is back under PORTD, where it's low.
+  TCCR2A &= static_cast<uint8_t>(~(_BV(COM2B1) | _BV(COM2B0)));
+  ::digitalWrite(static_cast<int>(PwmPinId::PWM_3), LOW);
+  OCR2B = 0;
+}
+
+static const AnalogPinId *sampled_pins;
+static uint8_t sampled_pin_count;
+static volatile uint8_t sampled_pin_index;
+static void (*analog_sample_callback)(AnalogPinId, uint16_t);
+
+// Selects the ADC input for `pin`, keeping AVcc as the reference that
+// analogRead() uses.
+static void adc_select(AnalogPinId pin) {
+  ADMUX = _BV(REFS0) | ((static_cast<uint8_t>(pin) - A0) & 0x07);
+}
+
+void HalApi::startAnalogSampling(const AnalogPinId *pins, uint8_t count,
+                                 void (*callback)(AnalogPinId pin,
+                                                  uint16_t value)) {
+  cli();
+  sampled_pins = pins;
+  sampled_pin_count = count;
+  sampled_pin_index = 0;
+  analog_sample_callback = callback;
+
+  adc_select(pins[0]);
+  // Enable the ADC with its completion interrupt, keeping the clk/128
+  // prescaler set up by the Arduino core, and start the first conversion.
+  // Each following conversion is started from the ISR once the multiplexer
+  // has been switched to the next pin, so no result is ever taken from a
+  // half-switched input.
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1) |
+           _BV(ADPS0);
+  sei();
+}
+
+ISR(ADC_vect) {
+  uint16_t value = ADC;
+  uint8_t index = sampled_pin_index;
+  AnalogPinId pin = sampled_pins[index];
+
+  if (++index == sampled_pin_count) {
+    index = 0;
+  }
+  sampled_pin_index = index;
+  adc_select(sampled_pins[index]);
+  ADCSRA |= _BV(ADSC);
+
+  analog_sample_callback(pin, value);
+}
+
+static void (*serial_rx_callback)(char);
+static bool (*serial_tx_callback)(char *);
+
+void HalApi::startSerial(void (*rx)(char c), bool (*tx)(char *c)) {
+  serial_rx_callback = rx;
+  serial_tx_callback = tx;
+  // 8N1 in double speed mode, which gives the smallest baud rate error at
+  // 16 MHz.  The UDRE interrupt is only enabled while there is something to
+  // send.
+  UCSR0A = _BV(U2X0);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void HalApi::serialSetBaud(uint32_t bps) {
+  UBRR0 = static_cast<uint16_t>((F_CPU / 4 / bps - 1) / 2);
+}
+
+// UART data register empty: send the next byte, or stop once there are no
+// more.
+ISR(USART_UDRE_vect) {
+  char c;
+  if (!serial_tx_callback(&c)) {
+    UCSR0B &= ~_BV(UDRIE0);
+    return;
+  }
+  UDR0 = c;
+  // Clear TXC0, by writing a one to it, so it shows when this byte has been
+  // sent.  The rest of UCSR0A mustn't change.
+  UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+}
+
+// UART byte received.  Reading UDR0 clears the interrupt.
+ISR(USART_RX_vect) { serial_rx_callback(UDR0); }
+
+void HalApi::reboot() {
+  wdt_enable(WDTO_15MS);
+  while (true) {
+  }
+}
+
+#endif
@@ -48,6 +48,8 @@ limitations under the License.
 #error "TEST_MODE intended to be run only on native, but AVR is defined"
 #endif
 
+#include <string.h>
+
 #include "gmock/gmock.h"
 #define HAL_MOCK_METHOD(returntype, name, args)                                \
   MOCK_METHOD(returntype, name, args)
@@ -59,6 +61,8 @@ limitations under the License.
 #error "When running without TEST_MODE, expecting AVR to be defined"
 #endif
 #include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 
 #define HAL_MOCK_METHOD(returntype, name, args) returntype name args
 
@@ -122,17 +126,169 @@ public:
   // to a PWM pin - some of the digital pins are PWM pins.
 
   // In test mode, will return the last value set via test_setAnalogPin.
+  //
+  // Blocks for a full conversion (~100us on the Uno).  Must not be called
+  // once startAnalogSampling() has been called, because the sampler owns the
+  // ADC from then on.
   int analogRead(AnalogPinId pin);
 #ifdef TEST_MODE
   void test_setAnalogPin(AnalogPinId pin, int value);
 #endif
 
+  // Starts converting `pins` round-robin in the background, one after the
+  // other, forever.  `callback` is called from interrupt context with the
+  // result of each conversion.  `pins` must outlive the sampler, and `count`
+  // must be at least 1.
+  //
+  // At the Uno's default ADC clock each conversion takes ~104us, so each of
+  // N pins is sampled at ~9.6kHz / N.
+  //
+  // Faked when mocking.  Conversions only happen when the test calls
+  // test_sampleAnalogPins(), which does one round over all pins using the
+  // values set via test_setAnalogPin.
+  void startAnalogSampling(const AnalogPinId *pins, uint8_t count,
+                           void (*callback)(AnalogPinId pin, uint16_t value));
+#ifdef TEST_MODE
+  void test_sampleAnalogPins();
+#endif
+
+  // In test mode, test_getPwmPin returns the last value written.
   void analogWrite(PwmPinId pin, int value);
+#ifdef TEST_MODE
+  int test_getPwmPin(PwmPinId pin);
+#endif
+
+  // Runs `pin` off its timer at a PWM rate above hearing, rather than the
+  // ~490 Hz analogWrite() leaves it at, starting at a duty of 0.  The pin is
+  // then written with pwmWrite(), not analogWrite().
+  //
+  // On the Uno, pin 3 is OC2B, and this takes over Timer2 for phase correct
+  // PWM at the full CPU clock, 31.4 kHz.  Unlike Arduino's fast PWM, a duty
+  // of 0 is then steadily low, and 255 steadily high, so every duty can go
+  // straight to the compare register.
+  void pwmStart(PwmPinId pin);
+  // Sets the duty, out of 255, of a pin started with pwmStart().
+  void pwmWrite(PwmPinId pin, uint8_t duty);
+  // Disconnects the pin from its timer and holds it low, until pwmStart().
+  void pwmStop(PwmPinId pin);
+#ifdef TEST_MODE
+  bool test_pwmRunning(PwmPinId pin);
+#endif
 
   void setDigitalPinMode(int pin, PinMode mode);
   void digitalWrite(int pin, VoltageLevel value);
+#ifdef TEST_MODE
+  VoltageLevel test_getDigitalPin(int pin);
+#endif
+
+  // Starts a hardware timer which calls `callback` from interrupt context
+  // `hz` times per second.  Used to drive the control loop scheduler.
+  //
+  // On the Uno this takes over Timer1 (so PWM on pins 9 and 10 is no longer
+  // available) and runs it at the full CPU clock, so `hz` must be at least
+  // F_CPU / 65536 (~245 Hz).
+  //
+  // Faked when mocking.  The callback is only called when the test calls
+  // test_fireLoopTimer().
+  void startLoopTimer(uint16_t hz, void (*callback)());
+#ifdef TEST_MODE
+  void test_fireLoopTimer();
+#endif
+
+  // Rate at which the loop timer counts.  On the Uno it's the CPU clock.
+#ifdef AVR
+  static constexpr uint32_t LOOP_TIMER_HZ = F_CPU;
+#else
+  static constexpr uint32_t LOOP_TIMER_HZ = 16000000;
+#endif
 
-  // TODO: Need at least one HAL_MOCK_METHOD.
+  // Counts of the loop timer since startLoopTimer(), wrapping at 2^32, so
+  // that the difference of two readings is the time between them.  Cheap
+  // enough to time sections of code with: the counter itself is read, rather
+  // than the ticks.
+  //
+  // Faked when mocking.  Each test_fireLoopTimer() counts one tick, to which
+  // the count within the tick set by the test is added.  That goes back to 0
+  // at each tick.
+  uint32_t loopTimerCounts();
+  // Counts of the loop timer since the start of the current tick, e.g. for
+  // how long after the tick something happened.
+  uint16_t loopTimerTickCounts();
+#ifdef TEST_MODE
+  void test_setLoopTimerCount(uint16_t count);
+#endif
+
+  // Size of the EEPROM, in bytes.
+  static constexpr uint16_t EEPROM_SIZE = 1024;
+
+  // Reads len bytes of EEPROM, starting at addr.  Waits for any write in
+  // progress to finish first.
+  void eepromRead(uint16_t addr, void *data, uint16_t len);
+
+  // True when no EEPROM write is in progress.  Each byte takes ~3.4ms to
+  // write, so callers must not wait for this in the control loop.
+  bool eepromReady();
+
+  // Starts writing a byte to the EEPROM and returns without waiting for it.
+  // Only call this when eepromReady(), or it blocks until the previous write
+  // has finished.
+  //
+  // Faked when mocking.  Writes finish at once, and are counted.
+  void eepromWriteByte(uint16_t addr, uint8_t value);
+#ifdef TEST_MODE
+  // Bytes written to the EEPROM so far, for checking wear.
+  uint32_t test_eepromWrites();
+  // Puts the EEPROM back in its erased (all 0xFF) state.
+  void test_eraseEeprom();
+#endif
+
+  // Starts the UART, 8N1, at the rate last set with serialSetBaud().
+  //
+  // `rx` is called from interrupt context with each byte received.  `tx` is
+  // called from interrupt context whenever the UART can take another byte,
+  // for as long as sending is enabled (see serialStartTx()).  It stores the
+  // byte to send and returns true, or returns false if there's nothing left
+  // to send, which disables sending.
+  //
+  // Faked when mocking.  Bytes are only received when the test calls
+  // test_serialReceive(), and only sent when it calls test_serialTransmit().
+  void startSerial(void (*rx)(char c), bool (*tx)(char *c));
+
+  // Sets the baud rate.  Bytes still being sent are garbled, so wait for
+  // serialTxDone() before changing it.
+  //
+  // On the Uno the UART runs in double speed mode, where rates up to 1 Mbaud
+  // that divide 2 MHz are exact, and 115200 is 2.1% fast.
+  void serialSetBaud(uint32_t bps);
+
+  // Enables sending, so that `tx` is called until it runs out of bytes.  Call
+  // this after queueing bytes for it.
+  void serialStartTx();
+
+  // True once sending is disabled and every byte has left the UART.
+  bool serialTxDone();
+#ifdef TEST_MODE
+  // Delivers len bytes to the rx callback, as if they had just arrived.
+  void test_serialReceive(const char *data, size_t len);
+  // Takes up to max bytes from the tx callback, as the UART would while
+  // sending is enabled, and returns how many it took.
+  size_t test_serialTransmit(char *data, size_t max);
+  // The rate last set with serialSetBaud().
+  uint32_t test_serialBaud();
+#endif
+
+  // Resets the controller, by letting the watchdog time out.  Doesn't
+  // return.
+  //
+  // Faked when mocking.  Returns, and counts the resets.
+  void reboot();
+#ifdef TEST_MODE
+  uint32_t test_reboots();
+#endif
+
+#ifdef TEST_MODE
+  HalApi() { test_eraseEeprom(); }
+#endif
 
 private:
 #ifdef TEST_MODE
@@ -152,6 +308,26 @@ private:
   // TODO: Really, PWM pins are digital pins - i.e., "writing to a PWM pin"
   // means "asking the device to set the digital pin to HIGH this% of the time".
   int pwm_pin_values_[14] = {0};
+  bool pwm_pin_running_[14] = {false};
+
+  void (*loop_timer_callback_)() = nullptr;
+  uint32_t loop_timer_base_ = 0;
+  uint16_t loop_timer_period_ = 0;
+  uint16_t loop_timer_count_ = 0;
+
+  const AnalogPinId *sampled_pins_ = nullptr;
+  uint8_t sampled_pin_count_ = 0;
+  void (*analog_sample_callback_)(AnalogPinId, uint16_t) = nullptr;
+
+  uint8_t eeprom_[EEPROM_SIZE];
+  uint32_t eeprom_writes_ = 0;
+
+  void (*serial_rx_callback_)(char) = nullptr;
+  bool (*serial_tx_callback_)(char *) = nullptr;
+  bool serial_tx_enabled_ = false;
+  uint32_t serial_baud_ = 0;
+
+  uint32_t reboots_ = 0;
 #endif
 };
 
@@ -159,6 +335,75 @@ private:
 
 extern HalApi Hal;
 
+// Marks a constant table to be kept in flash.  On AVR, constants otherwise
+// get copied into RAM at boot, and the Uno only has 2 KB of it.  Tables in
+// flash must be read with hal_flashReadUint16() and friends.
+//
+//   static const uint16_t TABLE[] HAL_FLASH = {...};
+//   uint16_t value = hal_flashReadUint16(&TABLE[i]);
+//
+// When mocking, these are ordinary constants.
+uint16_t hal_flashReadUint16(const uint16_t *addr);
+// Copies len bytes of a table in flash to RAM.
+void hal_flashRead(void *dst, const void *src, size_t len);
+
+// Marks the start of section `id` of the code, or the end of the current
+// one with HAL_PROFILE_IDLE, for the simavr profiler in
+// controller/tools/simavr_profile.  The profiler watches for writes to the
+// otherwise unused GPIOR0 and counts cycles between them.
+//
+// Only does anything in firmware built with PROFILE_MODE.
+inline constexpr uint8_t HAL_PROFILE_IDLE = 0xff;
+void hal_profileMark(uint8_t id);
+
+// A digital output written straight to its port register.  digitalWrite()
+// looks the pin's port and bit up in flash, and checks for PWM on it, on
+// every call, ~4us on the Uno; this looks them up once, in init(), and each
+// write() is then a few instructions.
+//
+//   static DigitalOutput valve;
+//   valve.init(5);
+//   valve.write(VoltageLevel::HAL_HIGH);
+//
+// When mocking, writes go to Hal.digitalWrite().
+class DigitalOutput {
+public:
+  // Makes `pin` an output.
+  void init(int pin);
+  void write(VoltageLevel value);
+
+private:
+#ifdef AVR
+  volatile uint8_t *port_ = nullptr;
+  uint8_t mask_ = 0;
+#else
+  int pin_ = -1;
+#endif
+};
+
+// Disables interrupts for as long as it's in scope, and then restores the
+// previous interrupt state.  Use this to read multi-byte values which are
+// written from interrupt handlers, since such reads aren't atomic on AVR.
+//
+//   {
+//     BlockInterrupts block;
+//     copy = shared_value;
+//   }
+//
+// A no-op when mocking.
+class BlockInterrupts {
+public:
+  BlockInterrupts();
+  ~BlockInterrupts();
+  BlockInterrupts(const BlockInterrupts &) = delete;
+  BlockInterrupts &operator=(const BlockInterrupts &) = delete;
+
+private:
+#ifdef AVR
+  uint8_t sreg_;
+#endif
+};
+
 #ifdef AVR
 
 inline uint32_t HalApi::millis() { return ::millis(); }
@@ -175,6 +420,60 @@ inline void HalApi::digitalWrite(int pin, VoltageLevel value) {
 inline void HalApi::analogWrite(PwmPinId pin, int value) {
   ::analogWrite(static_cast<int>(pin), value);
 }
+// PwmPinId::PWM_3 is the only PWM pin, so its compare register is the only
+// one there is to write.
+inline void HalApi::pwmWrite(PwmPinId, uint8_t duty) { OCR2B = duty; }
+
+inline void DigitalOutput::init(int pin) {
+  Hal.setDigitalPinMode(pin, PinMode::HAL_OUTPUT);
+  port_ = portOutputRegister(digitalPinToPort(pin));
+  mask_ = digitalPinToBitMask(pin);
+}
+inline void DigitalOutput::write(VoltageLevel value) {
+  // The port may hold pins other code writes, from interrupts too, so the
+  // read-modify-write has to be atomic.
+  BlockInterrupts block;
+  if (value == VoltageLevel::HAL_HIGH) {
+    *port_ |= mask_;
+  } else {
+    *port_ &= static_cast<uint8_t>(~mask_);
+  }
+}
+
+inline void HalApi::eepromRead(uint16_t addr, void *data, uint16_t len) {
+  eeprom_read_block(data, reinterpret_cast<const void *>(addr), len);
+}
+inline bool HalApi::eepromReady() { return eeprom_is_ready(); }
+inline void HalApi::eepromWriteByte(uint16_t addr, uint8_t value) {
+  eeprom_write_byte(reinterpret_cast<uint8_t *>(addr), value);
+}
+
+inline BlockInterrupts::BlockInterrupts() : sreg_(SREG) { cli(); }
+inline BlockInterrupts::~BlockInterrupts() { SREG = sreg_; }
+
+#define HAL_FLASH PROGMEM
+inline uint16_t hal_flashReadUint16(const uint16_t *addr) {
+  return pgm_read_word(addr);
+}
+inline void hal_flashRead(void *dst, const void *src, size_t len) {
+  memcpy_P(dst, src, len);
+}
+
+inline void HalApi::serialStartTx() {
+  // UCSR0B is also written by the UDRE ISR, so the read-modify-write has to
+  // be atomic.
+  BlockInterrupts block;
+  UCSR0B |= _BV(UDRIE0);
+}
+inline bool HalApi::serialTxDone() {
+  return !(UCSR0B & _BV(UDRIE0)) && (UCSR0A & _BV(TXC0));
+}
+
+#ifdef PROFILE_MODE
+inline void hal_profileMark(uint8_t id) { GPIOR0 = id; }
+#else
+inline void hal_profileMark(uint8_t) {}
+#endif
 
 #else
 
@@ -195,9 +494,126 @@ inline void HalApi::digitalWrite(int pin, VoltageLevel value) {
   }
   digital_pin_values_[pin] = value;
 }
+inline VoltageLevel HalApi::test_getDigitalPin(int pin) {
+  return digital_pin_values_[pin];
+}
 inline void HalApi::analogWrite(PwmPinId pin, int value) {
   pwm_pin_values_[static_cast<int>(pin)] = value;
 }
+inline int HalApi::test_getPwmPin(PwmPinId pin) {
+  return pwm_pin_values_[static_cast<int>(pin)];
+}
+inline void HalApi::pwmStart(PwmPinId pin) {
+  pwm_pin_running_[static_cast<int>(pin)] = true;
+  pwm_pin_values_[static_cast<int>(pin)] = 0;
+}
+inline void HalApi::pwmWrite(PwmPinId pin, uint8_t duty) {
+  if (!pwm_pin_running_[static_cast<int>(pin)]) {
+    throw "Can only pwmWrite() to a started pin";
+  }
+  pwm_pin_values_[static_cast<int>(pin)] = duty;
+}
+inline void HalApi::pwmStop(PwmPinId pin) {
+  pwm_pin_running_[static_cast<int>(pin)] = false;
+  pwm_pin_values_[static_cast<int>(pin)] = 0;
+}
+inline bool HalApi::test_pwmRunning(PwmPinId pin) {
+  return pwm_pin_running_[static_cast<int>(pin)];
+}
+inline void DigitalOutput::init(int pin) {
+  pin_ = pin;
+  Hal.setDigitalPinMode(pin, PinMode::HAL_OUTPUT);
+}
+inline void DigitalOutput::write(VoltageLevel value) {
+  Hal.digitalWrite(pin_, value);
+}
+inline void HalApi::startLoopTimer(uint16_t hz, void (*callback)()) {
+  loop_timer_callback_ = callback;
+  loop_timer_period_ = static_cast<uint16_t>(LOOP_TIMER_HZ / hz);
+  loop_timer_base_ = 0;
+  loop_timer_count_ = 0;
+}
+inline void HalApi::test_fireLoopTimer() {
+  loop_timer_base_ += loop_timer_period_;
+  loop_timer_count_ = 0;
+  if (loop_timer_callback_ != nullptr) {
+    loop_timer_callback_();
+  }
+}
+inline uint32_t HalApi::loopTimerCounts() {
+  return loop_timer_base_ + loop_timer_count_;
+}
+inline uint16_t HalApi::loopTimerTickCounts() { return loop_timer_count_; }
+inline void HalApi::test_setLoopTimerCount(uint16_t count) {
+  loop_timer_count_ = count;
+}
+inline void HalApi::startAnalogSampling(
+    const AnalogPinId *pins, uint8_t count,
+    void (*callback)(AnalogPinId pin, uint16_t value)) {
+  sampled_pins_ = pins;
+  sampled_pin_count_ = count;
+  analog_sample_callback_ = callback;
+}
+inline void HalApi::test_sampleAnalogPins() {
+  for (uint8_t i = 0; i < sampled_pin_count_; i++) {
+    analog_sample_callback_(sampled_pins_[i],
+                            static_cast<uint16_t>(analogRead(sampled_pins_[i])));
+  }
+}
+
+inline void HalApi::eepromRead(uint16_t addr, void *data, uint16_t len) {
+  memcpy(data, &eeprom_[addr], len);
+}
+inline bool HalApi::eepromReady() { return true; }
+inline void HalApi::eepromWriteByte(uint16_t addr, uint8_t value) {
+  eeprom_[addr] = value;
+  eeprom_writes_++;
+}
+inline uint32_t HalApi::test_eepromWrites() { return eeprom_writes_; }
+inline void HalApi::test_eraseEeprom() {
+  memset(eeprom_, 0xff, sizeof(eeprom_));
+  eeprom_writes_ = 0;
+}
+
+inline void HalApi::startSerial(void (*rx)(char c), bool (*tx)(char *c)) {
+  serial_rx_callback_ = rx;
+  serial_tx_callback_ = tx;
+  serial_tx_enabled_ = false;
+}
+inline void HalApi::serialSetBaud(uint32_t bps) { serial_baud_ = bps; }
+inline void HalApi::serialStartTx() { serial_tx_enabled_ = true; }
+inline bool HalApi::serialTxDone() { return !serial_tx_enabled_; }
+inline void HalApi::test_serialReceive(const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    serial_rx_callback_(data[i]);
+  }
+}
+inline size_t HalApi::test_serialTransmit(char *data, size_t max) {
+  size_t len = 0;
+  while (serial_tx_enabled_ && len < max) {
+    if (serial_tx_callback_(&data[len])) {
+      len++;
+    } else {
+      serial_tx_enabled_ = false;
+    }
+  }
+  return len;
+}
+inline uint32_t HalApi::test_serialBaud() { return serial_baud_; }
+
+inline void HalApi::reboot() { reboots_++; }
+inline uint32_t HalApi::test_reboots() { return reboots_; }
+
+inline BlockInterrupts::BlockInterrupts() {}
+inline BlockInterrupts::~BlockInterrupts() {}
+
+#define HAL_FLASH
+inline uint16_t hal_flashReadUint16(const uint16_t *addr) { return *addr; }
+inline void hal_flashRead(void *dst, const void *src, size_t len) {
+  memcpy(dst, src, len);
+}
+
+inline void hal_profileMark(uint8_t) {}
 
 #endif
 
@@ -0,0 +1,102 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "memstats.h"
+#include "hal.h"
+
+#ifdef AVR
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+#define STACK_PAINT (0xc5)
+
+// Section boundaries and the heap, from the linker and avr-libc.
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+extern char *__brkval; /* Top of the heap, or 0 if malloc() was never used */
+
+/****************************************************************************************
+ *    PRIVATE VARIABLES
+ ****************************************************************************************/
+
+// Next byte to check, and the fewest free bytes found so far.
+static uint8_t *scan;
+static uint16_t min_free = UINT16_MAX;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+// Runs from .init3, after the stack pointer is set up and before .data and
+// .bss are initialized.  It's not called but falls through to the next init
+// section, so it must not have a prologue or use the stack.
+void stack_paint() __attribute__((naked, used, section(".init3")));
+void stack_paint() {
+  for (uint8_t *p = &__heap_start; p <= (uint8_t *)(uintptr_t)RAMEND; p++) {
+    *p = STACK_PAINT;
+  }
+}
+
+static uint8_t *heap_top() {
+  return __brkval != nullptr ? (uint8_t *)__brkval : &__heap_start;
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+void memstats_handler() {
+  uint8_t *top = heap_top();
+  uint8_t *sp = (uint8_t *)(uintptr_t)SP;
+  if (scan < top) {
+    scan = top;
+  }
+
+  for (uint8_t i = 0; i < MEMSTATS_SCAN_BYTES; i++, scan++) {
+    // The stack is still in use above its pointer, so the pattern can't
+    // be there.
+    if (scan >= sp || *scan != STACK_PAINT) {
+      uint16_t free = (uint16_t)(scan - top);
+      if (free < min_free) {
+        min_free = free;
+      }
+      // Start over, in case the stack has grown since.
+      scan = top;
+      return;
+    }
+  }
+}
+
+void memstats_get(memoryStats_t *stats) {
+  uint8_t *top = heap_top();
+  stats->data = (uint16_t)(&__data_end - &__data_start);
+  stats->bss = (uint16_t)(&__bss_end - &__bss_start);
+  stats->heap_top = (uint16_t)(uintptr_t)top;
+  stats->free = (uint16_t)((uint8_t *)(uintptr_t)SP - top);
+  stats->min_free = min_free < stats->free ? min_free : stats->free;
+}
+
+#else
+
+// Nothing to measure when mocking.
+void memstats_handler() {}
+
+void memstats_get(memoryStats_t *stats) { memset(stats, 0, sizeof(*stats)); }
+
+#endif
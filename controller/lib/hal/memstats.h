@@ -0,0 +1,46 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stdint.h>
+
+// RAM usage on the Uno's 2 KB of SRAM.
+//
+// The RAM between the end of the heap and the top of the stack is painted
+// with a known pattern at boot, before the C runtime starts up.  The stack
+// overwrites the pattern as it grows, and memstats_handler() looks for the
+// lowest byte it has overwritten, a few bytes per call so that it never
+// holds up the control loop.  Nothing here uses malloc(), so the heap is
+// normally empty.
+//
+// When mocking, everything reads as zero.
+
+struct memoryStats_t {
+  uint16_t data;      /* Size of .data, in bytes */
+  uint16_t bss;       /* Size of .bss, in bytes */
+  uint16_t heap_top;  /* Address of the end of the heap */
+  uint16_t free;      /* Bytes between the heap and the stack right now */
+  uint16_t min_free;  /* Fewest bytes there have been, as far as scanned */
+};
+
+// Every call scans at most this many bytes.
+#define MEMSTATS_SCAN_BYTES (32)
+
+void memstats_handler();
+void memstats_get(memoryStats_t *stats);
+
+#endif // MEMSTATS_H
@@ -0,0 +1,136 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "lung_sim.h"
+
+#include <math.h>
+
+#include "breath.h"
+#include "flow.h"
+#include "sensors.h"
+
+/****************************************************************************************
+ *    DEFINE STATEMENTS
+ ****************************************************************************************/
+
+// Longest step the model is integrated with [s]
+static const float MAX_STEP_S = 0.0001f;
+
+// The sensors' outputs at zero pressure [V].  Both have a sensitivity of
+// 1 V/kPa, as in sensors.h.
+static const float PATIENT_SENSOR_OFFSET_V = 1.0f;
+static const float DP_SENSOR_OFFSET_V = 2.5f;
+static const float ADC_VREF = 5.0f;
+
+/****************************************************************************************
+ *    PRIVATE FUNCTIONS
+ ****************************************************************************************/
+
+// cmH2O/(L/s) to Pa/(mL/s)
+static float resistance_pa_per_ml_s(float cmh2o_per_l_s) {
+  return cmh2o_per_l_s * PA_PER_CMH2O / 1000.0f;
+}
+
+// Pressure drop across a venturi of flow.h's geometry [Pa], the inverse of
+// venturi_flow_ml_s().
+static float venturi_dp_pa(float flow_ml_s) {
+  float area = static_cast<float>(M_PI) *
+               powf(VENTURI_THROAT_DIAMETER_MM * 0.001f, 2) / 4;
+  float beta4 =
+      powf(VENTURI_THROAT_DIAMETER_MM / VENTURI_INLET_DIAMETER_MM, 4);
+  float velocity =
+      flow_ml_s * 1e-6f / (VENTURI_DISCHARGE_COEFFICIENT * area);
+  float dp = AIR_DENSITY * (1 - beta4) / 2 * velocity * velocity;
+  return flow_ml_s < 0 ? -dp : dp;
+}
+
+// ADC count for a sensor output, clipped to the ADC's range like the real
+// thing.
+static int adc_counts(float offset_v, float pa, float min_pa, float max_pa) {
+  pa = fminf(fmaxf(pa, min_pa), max_pa);
+  float volts = offset_v + pa / 1000.0f;
+  int counts = static_cast<int>(lroundf(volts / ADC_VREF * 1024.0f));
+  return counts < 0 ? 0 : (counts > 1023 ? 1023 : counts);
+}
+
+/****************************************************************************************
+ *    PUBLIC FUNCTIONS
+ ****************************************************************************************/
+
+LungSim::LungSim(const LungSimParams &params)
+    : params_(params),
+      r_tube_(resistance_pa_per_ml_s(params.tube_resistance_cmh2o_per_l_s)),
+      r_airway_(
+          resistance_pa_per_ml_s(params.airway_resistance_cmh2o_per_l_s)),
+      r_leak_(resistance_pa_per_ml_s(params.leak_resistance_cmh2o_per_l_s)),
+      compliance_(params.compliance_ml_per_cmh2o / PA_PER_CMH2O) {
+  reset();
+}
+
+void LungSim::reset() {
+  speed_ = 0;
+  volume_ml_ = 0;
+  setSensorPins();
+}
+
+void LungSim::step(float dt_s) {
+  float duty = Hal.test_getPwmPin(params_.blower_pin) / 255.0f;
+  duty = fminf(fmaxf(duty, 0.0f), 1.0f);
+
+  while (dt_s > 0) {
+    float dt = fminf(dt_s, MAX_STEP_S);
+    dt_s -= dt;
+    speed_ += (duty - speed_) * dt / params_.blower_time_constant_s;
+    volume_ml_ += lungFlowMlS() * dt;
+  }
+  setSensorPins();
+}
+
+float LungSim::blowerPressurePa() const {
+  return params_.blower_max_pa * speed_ * speed_;
+}
+
+float LungSim::airwayPressurePa() const {
+  // Flows into the wye sum to zero.
+  float lung_pa = volume_ml_ / compliance_;
+  return (blowerPressurePa() / r_tube_ + lung_pa / r_airway_) /
+         (1 / r_tube_ + 1 / r_airway_ + 1 / r_leak_);
+}
+
+float LungSim::lungFlowMlS() const {
+  return (airwayPressurePa() - volume_ml_ / compliance_) / r_airway_;
+}
+
+void LungSim::setSensorPins() const {
+  float wye_pa = airwayPressurePa();
+  float blower_flow = (blowerPressurePa() - wye_pa) / r_tube_;
+  float leak_flow = wye_pa / r_leak_;
+
+  Hal.test_setAnalogPin(
+      PressureSensors::PATIENT_PIN,
+      adc_counts(PATIENT_SENSOR_OFFSET_V, wye_pa,
+                 PressureSensors::P_VAL_MIN * 1000,
+                 PressureSensors::P_VAL_MAX * 1000));
+  Hal.test_setAnalogPin(
+      PressureSensors::INHALATION_PIN,
+      adc_counts(DP_SENSOR_OFFSET_V, venturi_dp_pa(blower_flow),
+                 PressureSensors::DP_VAL_MIN * 1000,
+                 PressureSensors::DP_VAL_MAX * 1000));
+  Hal.test_setAnalogPin(
+      PressureSensors::EXHALATION_PIN,
+      adc_counts(DP_SENSOR_OFFSET_V, venturi_dp_pa(leak_flow),
+                 PressureSensors::DP_VAL_MIN * 1000,
+                 PressureSensors::DP_VAL_MAX * 1000));
+}
@@ -0,0 +1,87 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LUNG_SIM_H
+#define LUNG_SIM_H
+
+#include "hal.h"
+
+// Model of the blower, patient circuit and lung, for closing the control
+// loop in native tests.  Only meant for TEST_MODE.
+//
+// It reads the blower duty written with Hal.analogWrite() and answers with
+// the voltages the pressure sensors would see, through
+// Hal.test_setAnalogPin(), so the controller code runs unmodified against
+// it:
+//
+//   blower --R_tube--+--R_airway-- lung (compliance C)
+//                    |
+//                 R_leak (exhalation port)
+//                    |
+//                 ambient
+//
+// The blower is a pressure source, which goes with the square of its speed,
+// and its speed follows the duty with a first-order lag.  The patient sensor
+// reads the pressure at the wye; the inhalation venturi sees the flow from
+// the blower, and the exhalation venturi the flow out of the port.
+//
+// Time only advances with step(), so tests run much faster than real time.
+struct LungSimParams {
+  float compliance_ml_per_cmh2o = 50;
+  float airway_resistance_cmh2o_per_l_s = 5;
+  float tube_resistance_cmh2o_per_l_s = 5;
+  float leak_resistance_cmh2o_per_l_s = 30;
+  // Pressure at full duty, with no flow [Pa]
+  float blower_max_pa = 5000;
+  // Time constant of the blower's speed [s]
+  float blower_time_constant_s = 0.05f;
+  PwmPinId blower_pin = PwmPinId::PWM_3;
+};
+
+class LungSim {
+public:
+  explicit LungSim(const LungSimParams &params = LungSimParams());
+
+  // Stops the blower and empties the lung to ambient.
+  void reset();
+
+  // Advances the model by dt_s seconds, with the blower duty currently
+  // written to its pin, and updates the sensor pins.
+  void step(float dt_s);
+
+  // Pressure at the wye, where the patient sensor is [Pa]
+  float airwayPressurePa() const;
+  // Flow into the lung [mL/s]
+  float lungFlowMlS() const;
+  // Volume in the lung above its relaxed volume [mL]
+  float lungVolumeMl() const { return volume_ml_; }
+
+private:
+  float blowerPressurePa() const;
+  void setSensorPins() const;
+
+  LungSimParams params_;
+  // Derived from params_: resistances in Pa per mL/s, compliance in mL/Pa.
+  float r_tube_;
+  float r_airway_;
+  float r_leak_;
+  float compliance_;
+
+  // Blower speed as a fraction of full speed, and the lung volume.
+  float speed_;
+  float volume_ml_;
+};
+
+#endif // LUNG_SIM_H
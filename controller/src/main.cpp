@@ -46,20 +46,34 @@ limitations under the License.
 */
 #include <Arduino.h>
 
+#include "actuators.h"
 #include "alarm.h"
-#include "blower.h"
 #include "comms.h"
+#include "hal.h"
+#include "memstats.h"
 #include "parameters.h"
 #include "pid.h"
+#include "scheduler.h"
 #include "sensors.h"
-#include "solenoid.h"
 #include "watchdog.h"
 
+// Control loop tasks, highest priority first.  Periods are in scheduler ticks
+// (1 / SCHEDULER_TICK_HZ seconds).
+static const scheduler_task_t controller_tasks[] = {
+    {pid_execute, 1},
+    {comms_handler, 1},
+    {parameters_handler, 1},
+    {watchdog_handler, 10},
+    {memstats_handler, 10},
+};
+
 static void controller_loop() {
+  scheduler_init(controller_tasks,
+                 sizeof(controller_tasks) / sizeof(controller_tasks[0]));
+  Hal.startLoopTimer(SCHEDULER_TICK_HZ, scheduler_tick);
+
   while (true) {
-    comms_handler();
-    pid_execute();
-    watchdog_handler();
+    scheduler_run();
   }
 }
 
@@ -67,9 +81,9 @@ void setup() {
 
   parameters_init();
   comms_init();
+  // Before the sensors are zeroed, which stops the blower for it
+  actuators_init();
   sensors_init();
-  blower_init();
-  solenoid_init();
 
   watchdog_init();
   pid_init();
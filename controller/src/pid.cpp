@@ -14,136 +14,160 @@ limitations under the License.
 */
 
 #include "pid.h"
+#include "actuators.h"
+#include "alarm_rules.h"
+#include "autotune.h"
+#include "breath.h"
+#include "breath_metrics.h"
+#include "capture.h"
 #include "comms.h"
+#include "flow.h"
 #include "hal.h"
 #include "parameters.h"
+#include "pid_controller.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "subscription.h"
+#include "telemetry.h"
 #include "types.h"
 
 // Define Variables we'll be connecting to
-static double Setpoint, Input, Output;
-
-// Configure the PID
-// Specify the links and initial tuning parameters
-static float Kp = 2, Ki = 8, Kd = 0;
-static PID myPID(&Input, &Output, &Setpoint, Kp, Ki, Kd, DIRECT);
+// Setpoint and Input are in Pa, Output is the blower PWM duty.
+static int32_t Setpoint, Input;
+static int16_t Output;
+
+// pid_execute() runs once per scheduler tick.
+static const uint16_t PID_SAMPLE_PERIOD_US = 1000000UL / SCHEDULER_TICK_HZ;
+
+static PidController myPID;
+// Revision of the gains in parameters.cpp, and the phase whose profile,
+// myPID was configured with.
+static uint8_t pidRevision;
+static pid_fsm_state pidPhase;
+// Whether the autotune drove the blower last tick, rather than myPID.
+static bool autotuning;
+
+// Reloads the gains if the breath has moved on to a phase with a different
+// profile, or they've changed over the wire, since the last call.  The
+// switch is bumpless, so the output doesn't kick at each change of phase.
+static void update_tunings(pid_fsm_state phase) {
+  if (phase == pid_fsm_state::reset) {
+    phase = pid_fsm_state::inspire;
+  }
+  uint8_t revision = parameters_getPidRevision();
+  if (revision != pidRevision || phase != pidPhase) {
+    pidRevision = revision;
+    pidPhase = phase;
+    pidGains_t gains;
+    parameters_getPhaseGains(phase, &gains);
+    myPID.transferTunings(gains.kp, gains.ki, gains.kd, PID_SAMPLE_PERIOD_US,
+                          Setpoint);
+  }
+}
 
 // These constants won't change. They're used to give names to the pins used:
 // Analog output pin that the LED is attached to
 static const int analogOutPin = LED_BUILTIN;
 
-static void send_periodicData(uint32_t delay, uint16_t pressure,
-                              uint16_t volume, uint16_t flow) {
-  static uint32_t time;
-  static bool first_call = true;
+// pid_execute() ticks between periodic telemetry samples.
+static const uint8_t TELEMETRY_PERIOD_TICKS =
+    SCHEDULER_TICK_HZ / TELEMETRY_SAMPLE_HZ;
 
-  if (first_call == true) {
-    first_call = false;
-    time = Hal.millis();
-  } else {
-    if ((Hal.millis() - time) > delay) {
-      if (parameters_getPeriodicReadings()) {
-        // Send readings data
-        comms_sendPeriodicReadings(pressure * 1.0, volume * 0.0, flow * 0.0);
-      }
+static void send_periodicData(int32_t pressure, int32_t volume,
+                              int32_t flow) {
+  static uint8_t ticks;
 
-      time = Hal.millis();
+  if (++ticks >= TELEMETRY_PERIOD_TICKS) {
+    ticks = 0;
+    if (parameters_getPeriodicReadings()) {
+      comms_sendPeriodicSample(pressure, volume, flow);
+    }
+    if (subscription_active()) {
+      int32_t values[TELEMETRY_CHANNELS];
+      values[(uint8_t)telemetryChannel::pressure] = pressure;
+      values[(uint8_t)telemetryChannel::volume] = volume;
+      values[(uint8_t)telemetryChannel::flow] = flow;
+      values[(uint8_t)telemetryChannel::sensor_raw] =
+          get_raw_sensor_reading(DPSENSOR_PIN);
+      values[(uint8_t)telemetryChannel::pid_output] = Output;
+      values[(uint8_t)telemetryChannel::setpoint] = Setpoint;
+      comms_sendChannels(subscription_tick(), values);
     }
   }
 }
 
-
-enum class pid_fsm_state {
-  reset = 0,
-  inspire = 1,
-  plateau = 2,
-  expire = 3,
-  expire_dwell = 4,
-
-  count /* Sentinel */
-};
+// Persistent across calls to pid_execute(), so that breaths run to completion.
+static BreathFsm breath;
+// Readings of the current breath, summarized when the next one starts.
+static BreathMetrics metrics;
 
 void pid_init() {
 
   // Initialize PID
-  Input = map(Hal.analogRead(DPSENSOR_PIN), 0, 1023, 0, 255);
-  Setpoint = BLOWER_LOW;
+  Input = get_pressure_reading_pa(DPSENSOR_PIN);
+  breath.reset();
+  metrics.reset();
+  alarmRules_init();
+  autotune_init();
+  capture_init();
+  flow_init();
+  Setpoint = Input;
+  Output = BLOWER_MIN;
+
+  myPID.setOutputLimits(BLOWER_MIN, BLOWER_MAX);
+  pidRevision = parameters_getPidRevision();
+  pidPhase = pid_fsm_state::inspire;
+  myPID.setTunings(parameters_getKp(), parameters_getKi(), parameters_getKd(),
+                   PID_SAMPLE_PERIOD_US);
 
   // turn the PID on
-  myPID.SetMode(AUTOMATIC);
+  myPID.reset(Setpoint, Input, Output);
+  actuators_enableBlower();
 }
 
 void pid_execute() {
 
-  uint16_t cyclecounter = 0;
-  int16_t sensorValue = 0; // value read from the pot
-  enum pid_fsm_state state = pid_fsm_state::reset;
-
-  switch (state) {
-  case pid_fsm_state::reset: // reset
-    cyclecounter = 0;
-    Setpoint = PEEP;
-    state = pid_fsm_state::inspire; // update state
-    break;
-
-  case pid_fsm_state::inspire: // Inspire
-    cyclecounter++;
-    // set command
-    Setpoint += INSPIRE_RATE;
-    if (Setpoint > PIP) {
-      Setpoint = PIP;
-    }
-    // update state
-    if (cyclecounter > INSPIRE_TIME) {
-      cyclecounter = 0;
-      state = pid_fsm_state::plateau;
-    }
-    break;
-
-  case pid_fsm_state::plateau: // Inspiratory plateau
-    cyclecounter++;
-    // set command
-    Setpoint = INSPIRE_DWELL_PRESSURE;
-    // update state
-    if (cyclecounter > INSPIRE_DWELL) {
-      cyclecounter = 0;
-      state = pid_fsm_state::expire;
-    }
-    break;
-
-  case pid_fsm_state::expire: // Expire
-    cyclecounter++;
-    // set command
-    Setpoint -= EXPIRE_RATE;
-    if (Setpoint < PEEP) {
-      Setpoint = PEEP;
-    }
-    // update state
-    if (cyclecounter > EXPIRE_TIME) {
-      cyclecounter = 0;
-      state = pid_fsm_state::expire_dwell;
-    }
-    break;
-
-  case pid_fsm_state::expire_dwell: // Expiratory Dwell
-    cyclecounter++;
-    // set command
-    Setpoint = PEEP;
-    // update state
-    if (cyclecounter > EXPIRE_DWELL) {
-      cyclecounter = 0;
-      state = pid_fsm_state::reset;
-    }
-    break;
+  Setpoint = breath.tick();
+  if (autotune_running() && !autotuning) {
+    // The step test measures the circuit with the valve closed throughout
+    autotuning = true;
+    actuators_holdSolenoidClosed();
+  }
+  if (breath.phaseChanged()) {
+    // First, to switch the valve as close to the start of the tick as can be.
+    // Ignored while the autotune holds it.
+    actuators_startPhase(breath.phase());
+  }
 
-  default:
-    state = pid_fsm_state::reset;
-    break;
+  flow_update(get_pressure_reading_pa(PressureSensors::INHALATION_PIN),
+              get_pressure_reading_pa(PressureSensors::EXHALATION_PIN));
+  if (breath.phaseChanged() && breath.phase() == pid_fsm_state::inspire) {
+    if (metrics.ticks() > 0) {
+      comms_sendBreathSummary(metrics.summary(Hal.millis()));
+      metrics.reset();
+    }
+    flow_startBreath();
+    alarmRules_startBreath();
   }
 
   // Update PID Loop
-  sensorValue = Hal.analogRead(DPSENSOR_PIN); // read sensor
-  Input = map(sensorValue, 0, 1023, 0, 255);  // map to output scale
-  myPID.Compute();                            // computer PID command
-  Hal.analogWrite(BLOWERSPD_PIN, Output);     // write output
-  send_periodicData(DELAY_100MS, sensorValue, 0, 0);
+  update_tunings(breath.phase());
+  Input = get_pressure_reading_pa(DPSENSOR_PIN); // read sensor
+  if (autotune_running()) {
+    Output = autotune_tick(Input);
+  } else {
+    if (autotuning) {
+      // However the autotune ended, the PID carries on from its last output,
+      // and the valve follows the breath again
+      autotuning = false;
+      myPID.reset(Setpoint, Input, Output);
+      actuators_releaseSolenoid(breath.phase());
+    }
+    Output = myPID.compute(Setpoint, Input); // computer PID command
+  }
+  actuators_setBlower(Output); // write output
+  capture_tick(breath, Setpoint, Input, Output);
+  alarmRules_evaluate(breath.phase(), Input, flow_getFlow());
+  metrics.add(breath.phase(), Input, flow_getVolume(), flow_getFlow());
+  send_periodicData(Input, flow_getVolume(), flow_getFlow());
 }
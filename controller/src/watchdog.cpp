@@ -36,9 +36,3 @@ void watchdog_handler() {
     }
   }
 }
-
-void watchdog_reboot() {
-  wdt_enable(WDTO_15MS);
-  while (1) {
-  }
-}
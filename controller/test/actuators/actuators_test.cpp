@@ -0,0 +1,116 @@
+#include "actuators.h"
+#include "hal.h"
+#include "parameters.h"
+#include "gtest/gtest.h"
+
+class ActuatorsTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+    actuators_init();
+  }
+
+  static VoltageLevel solenoid() {
+    return Hal.test_getDigitalPin(ACTUATORS_SOLENOID_PIN);
+  }
+};
+
+TEST_F(ActuatorsTest, StartsOpenWithBlowerStopped) {
+  EXPECT_TRUE(actuators_solenoidOpen());
+  // Open is unpowered for the default, normally open, valve
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_LOW);
+  EXPECT_TRUE(Hal.test_pwmRunning(ACTUATORS_BLOWER_PIN));
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 0);
+}
+
+TEST_F(ActuatorsTest, SwitchesAtPhaseChanges) {
+  actuators_startPhase(pid_fsm_state::inspire);
+  EXPECT_FALSE(actuators_solenoidOpen());
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_HIGH);
+  actuators_startPhase(pid_fsm_state::plateau);
+  EXPECT_FALSE(actuators_solenoidOpen());
+  actuators_startPhase(pid_fsm_state::expire);
+  EXPECT_TRUE(actuators_solenoidOpen());
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_LOW);
+  actuators_startPhase(pid_fsm_state::expire_dwell);
+  EXPECT_TRUE(actuators_solenoidOpen());
+
+  actuatorStats_t stats;
+  actuators_getStats(&stats);
+  EXPECT_EQ(stats.switches, 2);
+}
+
+TEST_F(ActuatorsTest, PolarityChangesAtNextBreath) {
+  parameters_setSolenoidNormalState(solenoidNormaleState::normally_closed);
+  actuators_startPhase(pid_fsm_state::inspire);
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_LOW);
+  actuators_startPhase(pid_fsm_state::expire);
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_HIGH);
+}
+
+TEST_F(ActuatorsTest, TimesSwitches) {
+  const uint16_t counts_per_us = HalApi::LOOP_TIMER_HZ / 1000000;
+  Hal.delay(1234);
+  Hal.test_setLoopTimerCount(40 * counts_per_us);
+  actuators_startPhase(pid_fsm_state::inspire);
+  Hal.test_setLoopTimerCount(25 * counts_per_us);
+  actuators_startPhase(pid_fsm_state::expire);
+
+  actuatorStats_t stats;
+  actuators_getStats(&stats);
+  EXPECT_EQ(stats.switches, 2);
+  EXPECT_EQ(stats.last_us, 25);
+  EXPECT_EQ(stats.max_us, 40);
+  EXPECT_EQ(stats.last_ms, Hal.millis());
+}
+
+TEST_F(ActuatorsTest, BlowerDuty) {
+  actuators_setBlower(100);
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 100);
+  actuators_setBlower(-5);
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 0);
+  actuators_setBlower(300);
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 255);
+}
+
+TEST_F(ActuatorsTest, DisabledBlowerStaysOff) {
+  actuators_setBlower(100);
+  actuators_disableBlower();
+  EXPECT_FALSE(Hal.test_pwmRunning(ACTUATORS_BLOWER_PIN));
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 0);
+  actuators_setBlower(100);
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 0);
+
+  actuators_enableBlower();
+  EXPECT_TRUE(Hal.test_pwmRunning(ACTUATORS_BLOWER_PIN));
+  actuators_setBlower(100);
+  EXPECT_EQ(Hal.test_getPwmPin(ACTUATORS_BLOWER_PIN), 100);
+}
+
+// As while an autotune runs: phases come and go without touching the valve.
+TEST_F(ActuatorsTest, HeldClosedThroughPhaseChanges) {
+  actuators_startPhase(pid_fsm_state::expire);
+  actuators_holdSolenoidClosed();
+  EXPECT_FALSE(actuators_solenoidOpen());
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_HIGH);
+
+  actuatorStats_t before;
+  actuators_getStats(&before);
+  for (pid_fsm_state phase :
+       {pid_fsm_state::inspire, pid_fsm_state::plateau, pid_fsm_state::expire,
+        pid_fsm_state::expire_dwell}) {
+    actuators_startPhase(phase);
+    EXPECT_FALSE(actuators_solenoidOpen());
+    EXPECT_EQ(solenoid(), VoltageLevel::HAL_HIGH);
+  }
+  actuatorStats_t after;
+  actuators_getStats(&after);
+  EXPECT_EQ(after.switches, before.switches);
+
+  actuators_releaseSolenoid(pid_fsm_state::expire);
+  EXPECT_TRUE(actuators_solenoidOpen());
+  EXPECT_EQ(solenoid(), VoltageLevel::HAL_LOW);
+  actuators_startPhase(pid_fsm_state::inspire);
+  EXPECT_FALSE(actuators_solenoidOpen());
+}
@@ -8,9 +8,27 @@ public:
     alarm_init();
     // TODO: Reset Hal mock object.
   }
+
+  static void add(enum dataID id, char fill,
+                  alarmSeverity severity = alarmSeverity::medium) {
+    char alarm_data[ALARM_DATALEN];
+    memset(alarm_data, fill, sizeof(alarm_data));
+    alarm_add(id, alarm_data, severity);
+  }
+
+  static alarm_t head() {
+    alarm_t alarm;
+    EXPECT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+    return alarm;
+  }
 };
 
-TEST_F(AlarmTest, NotAvailableAfterInit) { ASSERT_FALSE(alarm_available()); }
+TEST_F(AlarmTest, NotAvailableAfterInit) {
+  alarm_t alarm;
+  ASSERT_FALSE(alarm_available());
+  EXPECT_EQ(alarm_read(&alarm), VC_STATUS_FAILURE);
+  EXPECT_EQ(alarm_getDropped(), 0);
+}
 
 TEST_F(AlarmTest, AddOneAlarm) {
   char alarm_data[ALARM_DATALEN];
@@ -20,10 +38,183 @@ TEST_F(AlarmTest, AddOneAlarm) {
   ASSERT_TRUE(alarm_available());
 }
 
-TEST_F(AlarmTest, Timestamp) {}
+TEST_F(AlarmTest, DataIsCopied) {
+  char alarm_data[ALARM_DATALEN];
+  memset(alarm_data, 'x', sizeof(alarm_data));
+  alarm_add(dataID::alarm_1, alarm_data);
+  memset(alarm_data, 'y', sizeof(alarm_data));
+
+  alarm_t alarm = head();
+  EXPECT_EQ(alarm.alarm, dataID::alarm_1);
+  EXPECT_EQ(alarm.count, 1);
+  for (char c : alarm.data) {
+    EXPECT_EQ(c, 'x');
+  }
+}
+
+TEST_F(AlarmTest, Timestamp) {
+  uint32_t start = Hal.millis();
+  add(dataID::alarm_1, 'a');
+  alarm_t alarm = head();
+  EXPECT_EQ(alarm.timestamp, start);
+  EXPECT_EQ(alarm.last_seen, start);
+}
+
+TEST_F(AlarmTest, SameSeverityIsFifo) {
+  add(dataID::alarm_1, 'a');
+  add(dataID::alarm_2, 'b');
+
+  EXPECT_EQ(head().alarm, dataID::alarm_1);
+  alarm_remove(dataID::alarm_1, 1);
+  EXPECT_EQ(head().alarm, dataID::alarm_2);
+  alarm_remove(dataID::alarm_2, 1);
+  EXPECT_FALSE(alarm_available());
+}
+
+TEST_F(AlarmTest, HigherSeverityFirst) {
+  add(dataID::alarm_1, 'a', alarmSeverity::low);
+  add(dataID::alarm_2, 'b', alarmSeverity::high);
+
+  EXPECT_EQ(head().alarm, dataID::alarm_2);
+  alarm_remove(dataID::alarm_2, 1);
+  EXPECT_EQ(head().alarm, dataID::alarm_1);
+}
+
+TEST_F(AlarmTest, RepeatsCoalesce) {
+  uint32_t start = Hal.millis();
+  add(dataID::alarm_1, 'a');
+  Hal.delay(50);
+  add(dataID::alarm_1, 'b');
+  add(dataID::alarm_1, 'c');
+
+  alarm_t alarm = head();
+  EXPECT_EQ(alarm.count, 3);
+  EXPECT_EQ(alarm.timestamp, start);
+  EXPECT_EQ(alarm.last_seen, start + 50);
+  EXPECT_EQ(alarm.data[0], 'c');
+
+  alarm_remove(dataID::alarm_1, 3);
+  EXPECT_FALSE(alarm_available());
+}
+
+TEST_F(AlarmTest, RepeatRaisesSeverity) {
+  add(dataID::alarm_1, 'a', alarmSeverity::low);
+  add(dataID::alarm_2, 'b', alarmSeverity::medium);
+  add(dataID::alarm_1, 'c', alarmSeverity::high);
+
+  alarm_t alarm = head();
+  EXPECT_EQ(alarm.alarm, dataID::alarm_1);
+  EXPECT_EQ(alarm.severity, alarmSeverity::high);
+  EXPECT_EQ(alarm.count, 2);
+}
+
+// An alarm raised again between being sent and being acked stays queued with
+// the occurrences the ack didn't cover.
+TEST_F(AlarmTest, RemoveKeepsLaterOccurrences) {
+  add(dataID::alarm_1, 'a');
+  alarm_t sent = head();
+  add(dataID::alarm_1, 'b');
+
+  alarm_remove(sent.alarm, sent.count);
+  ASSERT_TRUE(alarm_available());
+  EXPECT_EQ(head().count, 1);
+  EXPECT_EQ(head().data[0], 'b');
+}
+
+TEST_F(AlarmTest, RemoveUnknownAlarmIsIgnored) {
+  add(dataID::alarm_1, 'a');
+  alarm_remove(dataID::alarm_2, 1);
+  EXPECT_EQ(head().alarm, dataID::alarm_1);
+}
+
+// Only two alarm IDs exist, so fill the queue with other values cast to
+// dataID.
+static enum dataID nth_alarm(int n) {
+  return static_cast<enum dataID>(static_cast<int>(dataID::alarm_1) + n);
+}
+
+TEST_F(AlarmTest, DropsWhenFull) {
+  for (int i = 0; i < ALARM_NODES; i++) {
+    add(nth_alarm(i), 'a');
+  }
+  EXPECT_EQ(alarm_getDropped(), 0);
+
+  add(nth_alarm(ALARM_NODES), 'a');
+  EXPECT_EQ(alarm_getDropped(), 1);
 
-// TODO(jlebar): Add more tests, checking that:
-//  - Alarms get dropped after a certain point.
-//  - Alarms can be popped.
-//  - Alarm data gets copied into storage (not just referring to the pointer
-//    passed to alarm_add).
+  // Oldest alarms aren't starved by the newer ones
+  for (int i = 0; i < ALARM_NODES; i++) {
+    EXPECT_EQ(head().alarm, nth_alarm(i));
+    alarm_remove(nth_alarm(i), 1);
+  }
+  EXPECT_FALSE(alarm_available());
+}
+
+TEST_F(AlarmTest, RepeatWhenFullIsNotDropped) {
+  for (int i = 0; i < ALARM_NODES; i++) {
+    add(nth_alarm(i), 'a');
+  }
+  add(nth_alarm(0), 'b');
+  EXPECT_EQ(alarm_getDropped(), 0);
+  EXPECT_EQ(head().count, 2);
+}
+
+TEST_F(AlarmTest, SevereAlarmEvictsLeastSevere) {
+  add(nth_alarm(0), 'a', alarmSeverity::low);
+  for (int i = 1; i < ALARM_NODES; i++) {
+    add(nth_alarm(i), 'a', alarmSeverity::medium);
+  }
+
+  add(nth_alarm(ALARM_NODES), 'a', alarmSeverity::high);
+  EXPECT_EQ(alarm_getDropped(), 1);
+  EXPECT_EQ(head().alarm, nth_alarm(ALARM_NODES));
+
+  // The low severity alarm was the one pushed out
+  for (int i = 0; i <= ALARM_NODES; i++) {
+    alarm_remove(nth_alarm(i), 1);
+  }
+  EXPECT_FALSE(alarm_available());
+}
+
+// Wraps the ring buffer a few times with a mix of severities.
+TEST_F(AlarmTest, OrderAcrossWrap) {
+  for (int round = 0; round < 3; round++) {
+    add(nth_alarm(0), 'a', alarmSeverity::low);
+    add(nth_alarm(1), 'a', alarmSeverity::medium);
+    add(nth_alarm(2), 'a', alarmSeverity::high);
+    add(nth_alarm(3), 'a', alarmSeverity::medium);
+
+    EXPECT_EQ(head().alarm, nth_alarm(2));
+    alarm_remove(nth_alarm(2), 1);
+    EXPECT_EQ(head().alarm, nth_alarm(1));
+    alarm_remove(nth_alarm(1), 1);
+    EXPECT_EQ(head().alarm, nth_alarm(3));
+    alarm_remove(nth_alarm(3), 1);
+    EXPECT_EQ(head().alarm, nth_alarm(0));
+    alarm_remove(nth_alarm(0), 1);
+    EXPECT_FALSE(alarm_available());
+  }
+}
+
+TEST_F(AlarmTest, ReadAt) {
+  add(dataID::alarm_1, 'a', alarmSeverity::low);
+  add(dataID::alarm_2, 'b', alarmSeverity::high);
+
+  alarm_t alarm;
+  ASSERT_EQ(alarm_readAt(0, &alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.alarm, dataID::alarm_2);
+  ASSERT_EQ(alarm_readAt(1, &alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.alarm, dataID::alarm_1);
+  EXPECT_EQ(alarm_readAt(2, &alarm), VC_STATUS_FAILURE);
+}
+
+TEST_F(AlarmTest, TakeAdded) {
+  EXPECT_FALSE(alarm_takeAdded());
+  add(dataID::alarm_1, 'a');
+  EXPECT_TRUE(alarm_takeAdded());
+  EXPECT_FALSE(alarm_takeAdded());
+
+  // A repeat changes the count the alarm is sent with
+  add(dataID::alarm_1, 'a');
+  EXPECT_TRUE(alarm_takeAdded());
+}
@@ -0,0 +1,143 @@
+#include "alarm.h"
+#include "alarm_rules.h"
+#include "hal.h"
+#include "parameters.h"
+#include "scheduler.h"
+#include "serialization.h"
+#include "gtest/gtest.h"
+
+class AlarmRulesTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+    parameters_setPIP(20);
+    parameters_setPEEP(5);
+    alarm_init();
+    alarmRules_init();
+  }
+
+  static int32_t pa(float cmh2o) {
+    return static_cast<int32_t>(cmh2o * PA_PER_CMH2O);
+  }
+
+  // Runs ticks ticks with the same readings.
+  static void run(uint32_t ticks, pid_fsm_state phase, int32_t pressure_pa,
+                  int32_t flow_ml_s = 500) {
+    for (uint32_t i = 0; i < ticks; i++) {
+      alarmRules_evaluate(phase, pressure_pa, flow_ml_s);
+    }
+  }
+};
+
+TEST_F(AlarmRulesTest, LimitsFollowParameters) {
+  EXPECT_EQ(alarmRules_getLimit(alarmRule::pressure_high), pa(30));
+  EXPECT_EQ(alarmRules_getLimit(alarmRule::pressure_low), pa(15));
+  EXPECT_EQ(alarmRules_getLimit(alarmRule::peep_loss), pa(2));
+
+  // Only once the next breath starts.
+  parameters_setPIP(95);
+  EXPECT_EQ(alarmRules_getLimit(alarmRule::pressure_high), pa(30));
+  alarmRules_startBreath();
+  EXPECT_EQ(alarmRules_getLimit(alarmRule::pressure_high), pa(PIP_MAX));
+}
+
+TEST_F(AlarmRulesTest, NormalBreathRaisesNothing) {
+  for (int breath = 0; breath < 10; breath++) {
+    run(500, pid_fsm_state::inspire, pa(12));
+    run(500, pid_fsm_state::plateau, pa(20));
+    run(500, pid_fsm_state::expire, pa(10), -500);
+    run(1500, pid_fsm_state::expire_dwell, pa(5), 0);
+  }
+  EXPECT_FALSE(alarm_available());
+  for (uint8_t i = 0; i < static_cast<uint8_t>(alarmRule::count); i++) {
+    EXPECT_FALSE(alarmRules_active(static_cast<alarmRule>(i)));
+  }
+}
+
+TEST_F(AlarmRulesTest, Debounce) {
+  // A spike shorter than the debounce is ignored...
+  run(19, pid_fsm_state::plateau, pa(35));
+  run(1, pid_fsm_state::plateau, pa(20));
+  run(19, pid_fsm_state::plateau, pa(35));
+  EXPECT_FALSE(alarmRules_active(alarmRule::pressure_high));
+  EXPECT_FALSE(alarm_available());
+
+  // ...but not one that lasts.
+  run(1, pid_fsm_state::plateau, pa(35));
+  EXPECT_TRUE(alarmRules_active(alarmRule::pressure_high));
+
+  alarm_t alarm;
+  ASSERT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.alarm, dataID::alarm_pressure_high);
+  EXPECT_EQ(alarm.severity, alarmSeverity::high);
+  EXPECT_EQ(wire_getInt32(&alarm.data[0]), pa(35));
+  EXPECT_EQ(wire_getInt32(&alarm.data[4]), pa(30));
+}
+
+TEST_F(AlarmRulesTest, Hysteresis) {
+  run(20, pid_fsm_state::plateau, pa(35));
+  ASSERT_TRUE(alarmRules_active(alarmRule::pressure_high));
+
+  // Hovering around the limit neither clears nor raises it again.
+  for (int i = 0; i < 100; i++) {
+    run(30, pid_fsm_state::plateau, pa(29));
+    run(30, pid_fsm_state::plateau, pa(31));
+  }
+  EXPECT_TRUE(alarmRules_active(alarmRule::pressure_high));
+  alarm_t alarm;
+  ASSERT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.count, 1);
+
+  run(1, pid_fsm_state::plateau, pa(27));
+  EXPECT_FALSE(alarmRules_active(alarmRule::pressure_high));
+
+  // Trips again after clearing.
+  run(20, pid_fsm_state::plateau, pa(35));
+  ASSERT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.count, 2);
+}
+
+TEST_F(AlarmRulesTest, PeepLossOnlyInDwell) {
+  // Low pressure while expiring isn't a loss of PEEP.
+  run(1000, pid_fsm_state::expire, pa(0), -500);
+  EXPECT_FALSE(alarmRules_active(alarmRule::peep_loss));
+
+  // The debounce count carries across the other phases.
+  run(150, pid_fsm_state::expire_dwell, pa(1), 0);
+  run(500, pid_fsm_state::inspire, pa(12));
+  EXPECT_FALSE(alarmRules_active(alarmRule::peep_loss));
+  run(50, pid_fsm_state::expire_dwell, pa(1), 0);
+  EXPECT_TRUE(alarmRules_active(alarmRule::peep_loss));
+
+  alarm_t alarm;
+  ASSERT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.alarm, dataID::alarm_peep_loss);
+  EXPECT_EQ(alarm.severity, alarmSeverity::medium);
+}
+
+TEST_F(AlarmRulesTest, Disconnect) {
+  run(499, pid_fsm_state::inspire, 0, 2000);
+  EXPECT_FALSE(alarmRules_active(alarmRule::disconnect));
+  run(1, pid_fsm_state::plateau, 0, 2000);
+  EXPECT_TRUE(alarmRules_active(alarmRule::disconnect));
+  // The plateau is also well below PIP.
+  run(100, pid_fsm_state::plateau, 0, 2000);
+  EXPECT_TRUE(alarmRules_active(alarmRule::pressure_low));
+
+  alarm_t alarm;
+  ASSERT_EQ(alarm_read(&alarm), VC_STATUS_SUCCESS);
+  EXPECT_EQ(alarm.alarm, dataID::alarm_disconnect);
+}
+
+TEST_F(AlarmRulesTest, Apnea) {
+  uint32_t ticks = 20000 * SCHEDULER_TICK_HZ / 1000;
+  run(ticks - 1, pid_fsm_state::expire_dwell, pa(5), 0);
+  EXPECT_FALSE(alarmRules_active(alarmRule::apnea));
+  // One tick of inspiratory flow restarts the count.
+  run(1, pid_fsm_state::inspire, pa(12), ALARM_APNEA_FLOW_ML_S);
+  run(ticks - 1, pid_fsm_state::expire_dwell, pa(5), 0);
+  EXPECT_FALSE(alarmRules_active(alarmRule::apnea));
+  run(1, pid_fsm_state::expire_dwell, pa(5), 0);
+  EXPECT_TRUE(alarmRules_active(alarmRule::apnea));
+}
@@ -0,0 +1,174 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <deque>
+
+#include "autotune.h"
+#include "breath.h"
+#include "hal.h"
+#include "lung_sim.h"
+#include "parameters.h"
+#include "pid_controller.h"
+#include "sensors.h"
+#include "gtest/gtest.h"
+
+static const float TICK_S = 1.0f / SCHEDULER_TICK_HZ;
+
+// A first order plant with dead time, ticked along with the autotune.
+struct Plant {
+  float gain_pa;
+  float tau_s;
+  int dead_ticks;
+  float pressure = 0;
+  std::deque<int16_t> pipe;
+
+  // Takes the duty for this tick, and returns the pressure it reads next.
+  int32_t step(int16_t duty) {
+    pipe.push_back(duty);
+    int16_t delayed = 0;
+    if (static_cast<int>(pipe.size()) > dead_ticks) {
+      delayed = pipe.front();
+      pipe.pop_front();
+    }
+    pressure += (gain_pa * delayed - pressure) * TICK_S / tau_s;
+    return static_cast<int32_t>(lroundf(pressure));
+  }
+};
+
+// Runs the autotune against `plant` until it stops, or for `max_ticks`.
+static void run(Plant *plant, int max_ticks = 30 * SCHEDULER_TICK_HZ) {
+  int32_t pressure = 0;
+  for (int i = 0; i < max_ticks && autotune_running(); i++) {
+    pressure = plant->step(autotune_tick(pressure));
+  }
+}
+
+class AutotuneTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+    autotune_init();
+  }
+};
+
+TEST_F(AutotuneTest, RefusesInvalidSteps) {
+  EXPECT_EQ(autotune_getState(), autotuneState::idle);
+  EXPECT_FALSE(autotune_start(100, 0));
+  EXPECT_FALSE(autotune_start(200, 56));
+  EXPECT_FALSE(autotune_running());
+  EXPECT_TRUE(autotune_start(200, 55));
+  EXPECT_TRUE(autotune_running());
+  autotune_stop();
+  EXPECT_EQ(autotune_getState(), autotuneState::idle);
+}
+
+TEST_F(AutotuneTest, FitsFirstOrderPlantWithDeadTime) {
+  Plant plant = {20, 0.2f, 30};
+  uint8_t revision = parameters_getPidRevision();
+  ASSERT_TRUE(autotune_start(100, 40));
+  run(&plant);
+  ASSERT_EQ(autotune_getState(), autotuneState::done);
+
+  autotuneModel_t model;
+  autotune_getModel(&model);
+  EXPECT_NEAR(model.gain_pa, 20, 0.5);
+  EXPECT_NEAR(model.tau_s, 0.2, 0.01);
+  EXPECT_NEAR(model.dead_s, 0.03, 0.005);
+
+  // SIMC, with a closed loop time constant of tau / 2
+  float kp = 0.2f / (0.02f * (0.1f + 0.03f));
+  EXPECT_NEAR(model.kp, kp, kp * 0.05);
+  EXPECT_NEAR(model.ki, kp / 0.2f, kp / 0.2f * 0.05);
+  EXPECT_EQ(model.kd, 0);
+  EXPECT_NE(parameters_getPidRevision(), revision);
+  EXPECT_EQ(parameters_getKp(), model.kp);
+  EXPECT_EQ(parameters_getKi(), model.ki);
+  EXPECT_EQ(parameters_getKd(), model.kd);
+}
+
+TEST_F(AutotuneTest, FailsWithoutResponse) {
+  Plant plant = {0.5f, 0.2f, 0};
+  ASSERT_TRUE(autotune_start(100, 40));
+  run(&plant);
+  EXPECT_EQ(autotune_getState(), autotuneState::failed_response);
+}
+
+TEST_F(AutotuneTest, StopsAtPressureLimit) {
+  Plant plant = {40, 0.2f, 0};
+  ASSERT_TRUE(autotune_start(100, 40));
+  int32_t pressure = 0;
+  int16_t duty = 0;
+  while (autotune_running()) {
+    duty = autotune_tick(pressure);
+    pressure = plant.step(duty);
+  }
+  EXPECT_EQ(autotune_getState(), autotuneState::failed_pressure);
+  EXPECT_EQ(duty, 0);
+  EXPECT_LE(pressure, AUTOTUNE_PRESSURE_LIMIT_CMH2O * PA_PER_CMH2O + 100);
+}
+
+// Tunes the pressure loop against the lung model, then checks the tuning
+// holds PIP after the rise of a breath, as the test in test/lung_sim does.
+TEST_F(AutotuneTest, TunesLungModel) {
+  LungSim sim;
+  sim.reset();
+  sensors_init();
+  Hal.analogWrite(PwmPinId::PWM_3, 0);
+
+  auto step_plant = [&sim]() {
+    sim.step(TICK_S);
+    for (int i = 0; i < 3; i++) {
+      Hal.test_sampleAnalogPins();
+    }
+    return get_pressure_reading_pa(PressureSensors::PATIENT_PIN);
+  };
+
+  ASSERT_TRUE(autotune_start(120, 40));
+  int32_t pressure = step_plant();
+  for (int i = 0; i < 20 * SCHEDULER_TICK_HZ && autotune_running(); i++) {
+    Hal.analogWrite(PwmPinId::PWM_3, autotune_tick(pressure));
+    pressure = step_plant();
+  }
+  ASSERT_EQ(autotune_getState(), autotuneState::done);
+  autotuneModel_t model;
+  autotune_getModel(&model);
+  printf("gain %.1f Pa/duty, tau %.0f ms, dead %.0f ms, "
+         "Kp %.1f, Ki %.1f, Kd %.1f\n",
+         model.gain_pa, model.tau_s * 1000, model.dead_s * 1000, model.kp,
+         model.ki, model.kd);
+  EXPECT_GT(model.gain_pa, 0);
+  EXPECT_GT(model.tau_s, 0.05);
+  EXPECT_LT(model.tau_s, 2);
+
+  parameters_setPIP(20);
+  parameters_setPEEP(5);
+  parameters_setRR(12);
+  parameters_setDwell(80);
+  BreathFsm breath;
+  PidController pid;
+  pid.setTunings(parameters_getKp(), parameters_getKi(), parameters_getKd(),
+                 1000000 / SCHEDULER_TICK_HZ);
+  pid.reset(0, pressure, 0);
+
+  const int32_t pip = static_cast<int32_t>(20 * PA_PER_CMH2O);
+  const int32_t band = static_cast<int32_t>(1 * PA_PER_CMH2O);
+  int breaths = 0;
+  int32_t peak = INT32_MIN;
+  bool settled = false;
+  while (breaths < 4) {
+    int32_t setpoint = breath.tick();
+    if (breath.phaseChanged() && breath.phase() == pid_fsm_state::inspire) {
+      breaths++;
+    }
+    Hal.analogWrite(PwmPinId::PWM_3, pid.compute(setpoint, pressure));
+    pressure = step_plant();
+    // The last breath, once the first have settled the loop
+    if (breaths == 3 && breath.phase() == pid_fsm_state::plateau) {
+      peak = pressure > peak ? pressure : peak;
+      settled = pressure > pip - band && pressure < pip + band;
+    }
+  }
+  EXPECT_TRUE(settled) << "Not within 1 cmH2O of PIP at the end of plateau";
+  EXPECT_LT((peak - pip) / PA_PER_CMH2O, 3);
+}
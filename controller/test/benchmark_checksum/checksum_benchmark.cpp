@@ -0,0 +1,95 @@
+// Benchmarks for the Fletcher-16 implementations.  Run with
+//
+//   platformio test -e native_benchmark
+//
+// Besides the time and throughput which Google Benchmark reports, each
+// benchmark reports cycles per byte where the host has a timestamp counter.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles() { return __rdtsc(); }
+#define HAVE_CYCLES
+#endif
+
+// The textbook definition, reducing modulo 255 after every byte, as a
+// baseline.
+static uint16_t reference_fletcher16(const char *data, size_t count) {
+  uint16_t s1 = 0;
+  uint16_t s2 = 0;
+  for (size_t i = 0; i < count; ++i) {
+    s1 = (s1 + static_cast<uint8_t>(data[i])) % 255;
+    s2 = (s2 + s1) % 255;
+  }
+  return (s2 << 8) | s1;
+}
+
+static std::vector<char> random_data(size_t len) {
+  std::vector<char> data(len);
+  srand(0);
+  for (char &c : data) {
+    c = static_cast<char>(rand());
+  }
+  return data;
+}
+
+// Runs fn over a buffer of state.range(0) bytes.
+template <typename Fn>
+static void run_checksum(benchmark::State &state, Fn fn) {
+  size_t len = state.range(0);
+  std::vector<char> data = random_data(len);
+
+#ifdef HAVE_CYCLES
+  uint64_t start = cycles();
+#endif
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fn(data.data(), len));
+  }
+#ifdef HAVE_CYCLES
+  uint64_t elapsed = cycles() - start;
+  state.counters["cycles/byte"] =
+      static_cast<double>(elapsed) / (state.iterations() * len);
+#endif
+  state.SetBytesProcessed(state.iterations() * len);
+}
+
+static void BM_Fletcher16Reference(benchmark::State &state) {
+  run_checksum(state, [](const char *data, size_t len) {
+    return reference_fletcher16(data, len);
+  });
+}
+BENCHMARK(BM_Fletcher16Reference)->Arg(32)->Arg(255)->Arg(65536);
+
+static void BM_Fletcher16(benchmark::State &state) {
+  run_checksum(state, [](const char *data, size_t len) {
+    return checksum_fletcher16(data, static_cast<uint8_t>(len));
+  });
+}
+BENCHMARK(BM_Fletcher16)->Arg(32)->Arg(255);
+
+static void BM_Fletcher16Streaming(benchmark::State &state) {
+  run_checksum(state, [](const char *data, size_t len) {
+    Fletcher16 csum;
+    for (size_t i = 0; i < len; i++) {
+      csum.add(data[i]);
+    }
+    return csum.value();
+  });
+}
+BENCHMARK(BM_Fletcher16Streaming)->Arg(32)->Arg(255);
+
+static void BM_Fletcher16Simd(benchmark::State &state) {
+  run_checksum(state, [](const char *data, size_t len) {
+    return checksum_fletcher16_simd(data, len);
+  });
+}
+BENCHMARK(BM_Fletcher16Simd)->Arg(32)->Arg(255)->Arg(65536);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+// Throughput of the packet parser and command dispatch, fed through the HAL's
+// serial fake.  Run with
+//
+//   platformio test -e native_benchmark
+//
+// Each iteration delivers as much as the RX ring holds and runs
+// comms_handler() once, so bytes_per_second is the rate the parser sustains
+// on the host.  At 115200 baud the link carries ~11.5 kB/s.
+
+#include <stdint.h>
+
+#include <random>
+#include <string>
+
+#include "alarm.h"
+#include "benchmark/benchmark.h"
+#include "checksum.h"
+#include "comms.h"
+#include "hal.h"
+#include "parameters.h"
+#include "serialIO.h"
+
+static std::string command_frame(enum command cmd, const std::string &data) {
+  std::string f;
+  f += static_cast<char>(msgType::cmd);
+  f += static_cast<char>(cmd);
+  f += static_cast<char>(data.size());
+  f += data;
+  uint16_t check = check_bytes_fletcher16(
+      checksum_fletcher16(f.data(), static_cast<uint8_t>(f.size())));
+  f += static_cast<char>(check >> 8);
+  f += static_cast<char>(check & 0xff);
+  return static_cast<char>(PACKET_SOF) + f;
+}
+
+static void init_comms() {
+  Hal.test_eraseEeprom();
+  parameters_init();
+  alarm_init();
+  comms_init();
+}
+
+// Runs the stream through the controller a ring's worth at a time, throwing
+// away whatever it sends back.
+static void run_stream(benchmark::State &state, const std::string &stream) {
+  init_comms();
+  size_t pos = 0;
+  int64_t bytes = 0;
+  char sink[SERIALIO_TX_BUFFER_SIZE];
+  for (auto _ : state) {
+    size_t len = SERIALIO_RX_BUFFER_SIZE;
+    if (len > stream.size() - pos) {
+      len = stream.size() - pos;
+    }
+    Hal.test_serialReceive(stream.data() + pos, len);
+    pos = (pos + len) % stream.size();
+    comms_handler();
+    while (Hal.test_serialTransmit(sink, sizeof(sink)) > 0) {
+    }
+    bytes += len;
+  }
+  state.SetBytesProcessed(bytes);
+}
+
+// Repeats `frame` to make a stream which splits into whole RX rings.
+static std::string repeat(const std::string &frame) {
+  std::string stream;
+  while (stream.size() % SERIALIO_RX_BUFFER_SIZE != 0 || stream.empty()) {
+    stream += frame;
+  }
+  return stream;
+}
+
+static void BM_CommsGetCommands(benchmark::State &state) {
+  run_stream(state, repeat(command_frame(command::get_rr, "")));
+}
+BENCHMARK(BM_CommsGetCommands);
+
+static void BM_CommsSetSettings(benchmark::State &state) {
+  // RR 20, TV 500, PEEP 5, PIP 20, dwell 100, I:E 0.5, as big endian floats
+  std::string settings("\x41\xa0\x00\x00\x43\xfa\x00\x00\x40\xa0\x00\x00"
+                       "\x41\xa0\x00\x00\x42\xc8\x00\x00\x3f\x00\x00\x00",
+                       24);
+  run_stream(state, repeat(command_frame(command::set_settings, settings)));
+}
+BENCHMARK(BM_CommsSetSettings);
+
+// Line noise, which is mostly skipped or rejected by the checksum.
+static void BM_CommsRandomBytes(benchmark::State &state) {
+  std::mt19937 rng(1);
+  std::string stream(1 << 16, 0);
+  for (char &c : stream) {
+    c = static_cast<char>(rng() & 0xff);
+  }
+  run_stream(state, stream);
+}
+BENCHMARK(BM_CommsRandomBytes);
+
+BENCHMARK_MAIN();
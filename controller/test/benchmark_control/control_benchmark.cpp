@@ -0,0 +1,190 @@
+// Benchmarks for the per-tick work of the control loop, against the HAL
+// fake.  Run with
+//
+//   platformio test -e native_benchmark
+//
+// These time the host build, so only compare them with each other and with
+// earlier runs on the same machine; the Uno is several hundred times slower.
+
+#include <stdint.h>
+
+#include "alarm.h"
+#include "alarm_rules.h"
+#include "benchmark/benchmark.h"
+#include "breath.h"
+#include "breath_metrics.h"
+#include "flow.h"
+#include "hal.h"
+#include "parameters.h"
+#include "pid_controller.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "telemetry.h"
+
+// Brings up the sensors with varying readings in their filters.
+static void init_sensors() {
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 200);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512);
+  Hal.test_setAnalogPin(PressureSensors::EXHALATION_PIN, 512);
+  sensors_init();
+  for (int i = 0; i < 64; i++) {
+    Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 200 + i);
+    Hal.test_sampleAnalogPins();
+  }
+}
+
+static void run_pressure_reading(benchmark::State &state,
+                                 SensorFilter filter) {
+  init_sensors();
+  set_sensor_filter(PressureSensors::PATIENT_PIN, filter);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        get_pressure_reading_pa(PressureSensors::PATIENT_PIN));
+  }
+  state.SetItemsProcessed(state.iterations());
+  set_sensor_filter(PressureSensors::PATIENT_PIN, SensorFilter::boxcar);
+}
+
+static void BM_PressureReadingBoxcar(benchmark::State &state) {
+  run_pressure_reading(state, SensorFilter::boxcar);
+}
+BENCHMARK(BM_PressureReadingBoxcar);
+
+static void BM_PressureReadingIir(benchmark::State &state) {
+  run_pressure_reading(state, SensorFilter::iir);
+}
+BENCHMARK(BM_PressureReadingIir);
+
+static void BM_PressureReadingFloat(benchmark::State &state) {
+  init_sensors();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        get_pressure_reading(PressureSensors::PATIENT_PIN));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PressureReadingFloat);
+
+// One round of ADC conversions, as handled in the ADC interrupt.
+static void BM_AdcSampleRound(benchmark::State &state) {
+  init_sensors();
+  for (auto _ : state) {
+    Hal.test_sampleAnalogPins();
+  }
+  state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_AdcSampleRound);
+
+static void BM_PidCompute(benchmark::State &state) {
+  PidController pid;
+  pid.setOutputLimits(0, 255);
+  pid.setTunings(102, 408, 5, 1000000 / SCHEDULER_TICK_HZ);
+  pid.reset(1000, 1000, 100);
+
+  int32_t input = 1000;
+  for (auto _ : state) {
+    // Keeps the output off its limits.
+    input = input == 1000 ? 1010 : 1000;
+    benchmark::DoNotOptimize(pid.compute(1005, input));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PidCompute);
+
+static void BM_BreathTick(benchmark::State &state) {
+  parameters_init();
+  BreathFsm breath;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(breath.tick());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BreathTick);
+
+static void BM_FlowUpdate(benchmark::State &state) {
+  flow_init();
+  int32_t dp = 0;
+  for (auto _ : state) {
+    dp = (dp + 37) & 1023;
+    flow_update(dp, dp / 4);
+  }
+  benchmark::DoNotOptimize(flow_getVolume());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlowUpdate);
+
+static void BM_AlarmRulesEvaluate(benchmark::State &state) {
+  parameters_init();
+  alarm_init();
+  alarmRules_init();
+  int32_t pressure = 500;
+  for (auto _ : state) {
+    // Within all the limits, so no alarms are raised.
+    pressure = pressure == 500 ? 600 : 500;
+    alarmRules_evaluate(pid_fsm_state::expire_dwell, pressure, 100);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AlarmRulesEvaluate);
+
+static void BM_BreathMetricsAdd(benchmark::State &state) {
+  BreathMetrics metrics;
+  int32_t pressure = 0;
+  for (auto _ : state) {
+    if (metrics.ticks() == UINT16_MAX) {
+      metrics.reset();
+    }
+    pressure = (pressure + 13) & 2047;
+    metrics.add(pid_fsm_state::inspire, pressure, pressure / 4, pressure / 2);
+  }
+  benchmark::DoNotOptimize(metrics.summary(0));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BreathMetricsAdd);
+
+// Fills batches with a slowly varying signal, reporting the bytes of payload
+// produced.
+template <typename Batch>
+static void run_telemetry(benchmark::State &state) {
+  Batch batch;
+  uint32_t time = 0;
+  int32_t pressure = 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    time += 10;
+    pressure = (pressure + 3) & 1023;
+    if (batch.add(time, pressure, pressure / 2, -pressure)) {
+      bytes += batch.length();
+      batch.reset();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+}
+
+static void BM_TelemetryBatchAdd(benchmark::State &state) {
+  run_telemetry<TelemetryBatch>(state);
+}
+BENCHMARK(BM_TelemetryBatchAdd);
+
+static void BM_CompressedTelemetryBatchAdd(benchmark::State &state) {
+  run_telemetry<CompressedTelemetryBatch>(state);
+}
+BENCHMARK(BM_CompressedTelemetryBatchAdd);
+
+static void BM_TelemetryDecodeCompressed(benchmark::State &state) {
+  CompressedTelemetryBatch batch;
+  for (uint32_t i = 0; !batch.full(); i++) {
+    batch.add(i * 10, static_cast<int32_t>(i * 3), 0, -1);
+  }
+  TelemetrySample samples[TELEMETRY_COMPRESSED_SAMPLES];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        telemetry_decodeCompressed(batch.data(), batch.length(), samples,
+                                   TELEMETRY_COMPRESSED_SAMPLES));
+  }
+  state.SetBytesProcessed(state.iterations() * batch.length());
+}
+BENCHMARK(BM_TelemetryDecodeCompressed);
+
+BENCHMARK_MAIN();
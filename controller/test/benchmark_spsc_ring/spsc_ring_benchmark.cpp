@@ -0,0 +1,96 @@
+// Benchmarks for SpscRing.  Run with
+//
+//   platformio test -e native_benchmark
+//
+// items_per_second is the rate at which items get through the ring: on one
+// thread, as the serial driver and its ISR use it, and between two threads,
+// as the GUI does, where the indices' cache lines move between cores.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "spsc_ring.h"
+
+// One item in, one out, the way UART bytes come and go.
+static void BM_SpscRingPushPop(benchmark::State &state) {
+  SpscRing<char, 64> ring;
+  char c = 0;
+  for (auto _ : state) {
+    ring.push(c);
+    ring.pop(&c);
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpscRingPushPop);
+
+// Filling the ring and emptying it again a byte at a time.
+static void BM_SpscRingFillDrain(benchmark::State &state) {
+  SpscRing<char, 128> ring;
+  char c = 0;
+  for (auto _ : state) {
+    while (ring.push(c)) {
+    }
+    while (ring.pop(&c)) {
+    }
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * 128);
+}
+BENCHMARK(BM_SpscRingFillDrain);
+
+// Frames of `state.range(0)` bytes written through pending() and read with
+// peek(), as serialIO writes packets and comms parses them.
+static void BM_SpscRingFrames(benchmark::State &state) {
+  SpscRing<char, 128> ring;
+  uint8_t len = static_cast<uint8_t>(state.range(0));
+  for (auto _ : state) {
+    for (uint8_t i = 0; i < len; i++) {
+      ring.pending(i) = static_cast<char>(i);
+    }
+    ring.publish(len);
+    while (!ring.empty()) {
+      const char *items;
+      uint8_t n = ring.peek(&items);
+      benchmark::DoNotOptimize(items);
+      ring.consume(n);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_SpscRingFrames)->Arg(8)->Arg(33);
+
+// A consumer thread draining the ring while this thread fills it.  Both
+// yield while they wait, so on a single core this measures the handover
+// through the scheduler instead.
+static void BM_SpscRingThreads(benchmark::State &state) {
+  static SpscRing<uint32_t, 4096> ring;
+  std::atomic<bool> done(false);
+  std::thread consumer([&done] {
+    uint32_t value;
+    while (!done.load(std::memory_order_relaxed) || !ring.empty()) {
+      if (ring.pop(&value)) {
+        benchmark::DoNotOptimize(value);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t i = 0;
+  for (auto _ : state) {
+    while (!ring.push(i)) {
+      std::this_thread::yield();
+    }
+    i++;
+  }
+  done.store(true);
+  consumer.join();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpscRingThreads)->UseRealTime();
+
+BENCHMARK_MAIN();
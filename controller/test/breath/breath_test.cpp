@@ -0,0 +1,154 @@
+#include "breath.h"
+#include "parameters.h"
+#include "gtest/gtest.h"
+
+class BreathTest : public testing::Test {
+public:
+  void SetUp() override {
+    // 20 breaths/min at 1 kHz is 3000 ticks: 1000 inspiring and 2000
+    // expiring, each spending half its time at constant pressure.
+    parameters_setRR(20);
+    parameters_setInspireExpireRatio(0.5f);
+    parameters_setDwell(50);
+    parameters_setPEEP(5);
+    parameters_setPIP(20);
+  }
+
+  // Runs one whole breath, recording how long each phase lasted.
+  void runBreath(BreathFsm &fsm, uint16_t *durations) {
+    for (int i = 0; i < static_cast<int>(pid_fsm_state::count); i++) {
+      durations[i] = 0;
+    }
+    do {
+      fsm.tick();
+      durations[static_cast<int>(fsm.phase())]++;
+    } while (fsm.breathTick() + 1 < fsm.breathTicks());
+  }
+};
+
+static const int32_t PEEP_PA = static_cast<int32_t>(5 * PA_PER_CMH2O + 0.5f);
+static const int32_t PIP_PA = static_cast<int32_t>(20 * PA_PER_CMH2O + 0.5f);
+
+TEST_F(BreathTest, PhaseDurations) {
+  BreathFsm fsm;
+  uint16_t durations[static_cast<int>(pid_fsm_state::count)];
+
+  // Every breath has the same timings, not just the first.
+  for (int breath = 0; breath < 3; breath++) {
+    runBreath(fsm, durations);
+    EXPECT_EQ(fsm.breathTicks(), 3000);
+    EXPECT_EQ(durations[static_cast<int>(pid_fsm_state::reset)], 0);
+    EXPECT_EQ(durations[static_cast<int>(pid_fsm_state::inspire)], 500);
+    EXPECT_EQ(durations[static_cast<int>(pid_fsm_state::plateau)], 500);
+    EXPECT_EQ(durations[static_cast<int>(pid_fsm_state::expire)], 1000);
+    EXPECT_EQ(durations[static_cast<int>(pid_fsm_state::expire_dwell)],
+              1000);
+  }
+}
+
+TEST_F(BreathTest, PhaseChangedFlag) {
+  BreathFsm fsm;
+  int changes = 0;
+  for (int i = 0; i < 3000 * 2; i++) {
+    fsm.tick();
+    if (fsm.phaseChanged()) {
+      changes++;
+    }
+  }
+  EXPECT_EQ(changes, 4 * 2);
+}
+
+TEST_F(BreathTest, Setpoints) {
+  BreathFsm fsm;
+  int32_t prev = fsm.tick();
+  EXPECT_NEAR(prev, PEEP_PA, (PIP_PA - PEEP_PA) / 16);
+
+  while (fsm.phase() == pid_fsm_state::inspire) {
+    int32_t setpoint = fsm.tick();
+    if (fsm.phase() == pid_fsm_state::inspire) {
+      EXPECT_GE(setpoint, prev);
+    }
+    prev = setpoint;
+  }
+  while (fsm.phase() == pid_fsm_state::plateau) {
+    EXPECT_EQ(prev, PIP_PA);
+    prev = fsm.tick();
+  }
+  while (fsm.phase() == pid_fsm_state::expire) {
+    int32_t setpoint = fsm.tick();
+    EXPECT_LE(setpoint, prev);
+    prev = setpoint;
+  }
+  while (fsm.phase() == pid_fsm_state::expire_dwell) {
+    EXPECT_EQ(prev, PEEP_PA);
+    prev = fsm.tick();
+  }
+}
+
+TEST_F(BreathTest, SettingsApplyAtBreathBoundary) {
+  BreathFsm fsm;
+  fsm.tick();
+  EXPECT_EQ(fsm.breathTicks(), 3000);
+
+  parameters_setRR(30);
+  for (int i = 1; i < 3000; i++) {
+    fsm.tick();
+    EXPECT_EQ(fsm.breathTicks(), 3000);
+  }
+  fsm.tick();
+  EXPECT_EQ(fsm.breathTick(), 0);
+  EXPECT_EQ(fsm.breathTicks(), 2000);
+}
+
+TEST_F(BreathTest, ZeroRespiratoryRate) {
+  // RR_MIN is zero; the FSM pins it at one breath per minute.
+  parameters_setRR(0);
+  BreathFsm fsm;
+  fsm.tick();
+  EXPECT_EQ(fsm.breathTicks(), 60000);
+}
+
+TEST_F(BreathTest, StagedSettingsWaitForNextBreath) {
+  BreathFsm fsm;
+  uint16_t durations[static_cast<int>(pid_fsm_state::count)];
+  fsm.tick();
+
+  // 30 breaths/min is 2000 ticks.  Staged mid-breath, it must not change the
+  // breath already running, and the PIP must change along with it.
+  ventilatorSettings_t settings;
+  parameters_getSettings(&settings);
+  settings.rr = 30;
+  settings.pip = 25;
+  parameters_stageSettings(&settings);
+
+  while (fsm.breathTick() + 1 < fsm.breathTicks()) {
+    fsm.tick();
+    EXPECT_EQ(fsm.breathTicks(), 3000);
+  }
+  EXPECT_EQ(parameters_getRR(), 20);
+
+  runBreath(fsm, durations);
+  EXPECT_EQ(fsm.breathTicks(), 2000);
+  EXPECT_EQ(parameters_getRR(), 30);
+  EXPECT_EQ(parameters_getPIP(), 25);
+  EXPECT_FALSE(parameters_applyStagedSettings());
+}
+
+TEST_F(BreathTest, StagedSettingsAreClamped) {
+  ventilatorSettings_t settings;
+  parameters_getSettings(&settings);
+  settings.rr = RR_MAX + 100;
+  settings.peep = PEEP_MIN - 100;
+  parameters_stageSettings(&settings);
+
+  ventilatorSettings_t staged;
+  parameters_getStagedSettings(&staged);
+  EXPECT_EQ(staged.rr, RR_MAX);
+  EXPECT_EQ(staged.peep, PEEP_MIN);
+  EXPECT_EQ(staged.pip, settings.pip);
+
+  // Settings in use don't change until applied
+  EXPECT_EQ(parameters_getRR(), 20);
+  EXPECT_TRUE(parameters_applyStagedSettings());
+  EXPECT_EQ(parameters_getRR(), RR_MAX);
+}
@@ -0,0 +1,102 @@
+#include "breath_metrics.h"
+#include "scheduler.h"
+#include "gtest/gtest.h"
+
+static void add_ticks(BreathMetrics *metrics, pid_fsm_state phase,
+                      uint16_t ticks, int32_t pressure, int32_t volume = 0,
+                      int32_t flow = 0) {
+  for (uint16_t i = 0; i < ticks; i++) {
+    metrics->add(phase, pressure, volume, flow);
+  }
+}
+
+TEST(BreathMetrics, EmptySummary) {
+  BreathMetrics metrics;
+  EXPECT_EQ(metrics.ticks(), 0);
+  BreathSummary summary = metrics.summary(1234);
+  EXPECT_EQ(summary.time_ms, 1234u);
+  EXPECT_EQ(summary.duration_ms, 0);
+  EXPECT_EQ(breath_rate(summary), 0.0f);
+  EXPECT_EQ(breath_ieRatio(summary), 0.0f);
+}
+
+TEST(BreathMetrics, Summary) {
+  BreathMetrics metrics;
+  add_ticks(&metrics, pid_fsm_state::inspire, 400, 1000, 200, 900);
+  add_ticks(&metrics, pid_fsm_state::plateau, 600, 2000, 450, 100);
+  add_ticks(&metrics, pid_fsm_state::expire, 1000, 500, 100, -800);
+  add_ticks(&metrics, pid_fsm_state::expire_dwell, 1000, 490, 0, 0);
+  add_ticks(&metrics, pid_fsm_state::expire_dwell, 1000, 510, 0, 0);
+  EXPECT_EQ(metrics.ticks(), 4000);
+
+  BreathSummary summary = metrics.summary(50000);
+  EXPECT_EQ(summary.time_ms, 50000u);
+  EXPECT_EQ(summary.duration_ms, 4000u * 1000 / SCHEDULER_TICK_HZ);
+  EXPECT_EQ(summary.inspire_ms, 1000u * 1000 / SCHEDULER_TICK_HZ);
+  EXPECT_EQ(summary.pip_pa, 2000);
+  EXPECT_EQ(summary.peep_pa, 500);
+  EXPECT_EQ(summary.mean_pa,
+            (400 * 1000 + 600 * 2000 + 1000 * 500 + 1000 * 490 + 1000 * 510) /
+                4000);
+  EXPECT_EQ(summary.min_pa, 490);
+  EXPECT_EQ(summary.vt_ml, 450);
+  EXPECT_EQ(summary.peak_flow_ml_s, 900);
+  EXPECT_FLOAT_EQ(breath_rate(summary),
+                  60.0f * SCHEDULER_TICK_HZ / 4000);
+  EXPECT_FLOAT_EQ(breath_ieRatio(summary), 3.0f);
+}
+
+TEST(BreathMetrics, ResetForgetsReadings) {
+  BreathMetrics metrics;
+  add_ticks(&metrics, pid_fsm_state::inspire, 10, 3000, 600, 1000);
+  metrics.reset();
+  add_ticks(&metrics, pid_fsm_state::expire_dwell, 10, 400);
+
+  BreathSummary summary = metrics.summary(0);
+  EXPECT_EQ(summary.pip_pa, 400);
+  EXPECT_EQ(summary.vt_ml, 0);
+  EXPECT_EQ(summary.inspire_ms, 0);
+}
+
+// A breath which never reached its dwell reports the last pressure as PEEP.
+TEST(BreathMetrics, NoDwell) {
+  BreathMetrics metrics;
+  add_ticks(&metrics, pid_fsm_state::inspire, 10, 1500);
+  add_ticks(&metrics, pid_fsm_state::expire, 10, 700);
+  EXPECT_EQ(metrics.summary(0).peep_pa, 700);
+}
+
+TEST(BreathMetrics, Saturates) {
+  BreathMetrics metrics;
+  metrics.add(pid_fsm_state::inspire, 100000, 100000, 100000);
+  metrics.add(pid_fsm_state::expire, -100000, 0, 0);
+
+  BreathSummary summary = metrics.summary(0);
+  EXPECT_EQ(summary.pip_pa, INT16_MAX);
+  EXPECT_EQ(summary.min_pa, INT16_MIN);
+  EXPECT_EQ(summary.vt_ml, INT16_MAX);
+  EXPECT_EQ(summary.peak_flow_ml_s, INT16_MAX);
+}
+
+TEST(BreathMetrics, CodecRoundTrip) {
+  BreathSummary summary = {0x01020304, 4000, 1000, 1960, -490, 1200,
+                           -3,         520,  -1500};
+  char data[BREATH_SUMMARY_LEN];
+  breath_encodeSummary(summary, data);
+  EXPECT_EQ(data[0], 0x01);
+  EXPECT_EQ(data[3], 0x04);
+
+  BreathSummary decoded;
+  ASSERT_TRUE(breath_decodeSummary(data, sizeof(data), &decoded));
+  EXPECT_EQ(decoded.time_ms, summary.time_ms);
+  EXPECT_EQ(decoded.duration_ms, summary.duration_ms);
+  EXPECT_EQ(decoded.inspire_ms, summary.inspire_ms);
+  EXPECT_EQ(decoded.pip_pa, summary.pip_pa);
+  EXPECT_EQ(decoded.peep_pa, summary.peep_pa);
+  EXPECT_EQ(decoded.mean_pa, summary.mean_pa);
+  EXPECT_EQ(decoded.min_pa, summary.min_pa);
+  EXPECT_EQ(decoded.vt_ml, summary.vt_ml);
+  EXPECT_EQ(decoded.peak_flow_ml_s, summary.peak_flow_ml_s);
+
+  EXPECT_FALSE(breath_decodeSummary(data, sizeof(data) - 1, &decoded));
+}
@@ -0,0 +1,137 @@
+#include "capture.h"
+#include "gtest/gtest.h"
+
+// Stands in for the setpoint at `tick`, within the range a sample holds.
+static int setpoint_at(int tick) { return tick % 30000; }
+
+// Runs `breath` for `ticks`, capturing a setpoint of setpoint_at() the tick,
+// an input 1 Pa below, and an output of the tick number mod 256.
+static void run(BreathFsm *breath, int ticks, int *tick) {
+  for (int i = 0; i < ticks; i++, (*tick)++) {
+    breath->tick();
+    capture_tick(*breath, setpoint_at(*tick), setpoint_at(*tick) - 1,
+                 static_cast<int16_t>(*tick & 0xff));
+  }
+}
+
+TEST(Capture, StartsIdle) {
+  capture_init();
+  EXPECT_EQ(capture_getState(), captureState::idle);
+  EXPECT_EQ(capture_getCount(), 0);
+  captureSample_t sample;
+  EXPECT_FALSE(capture_getSample(0, &sample));
+}
+
+TEST(Capture, CapturesEveryTickFromNow) {
+  capture_init();
+  BreathFsm breath;
+  int tick = 0;
+  run(&breath, 10, &tick);
+  capture_arm(captureTrigger::now, 0, 1, 0);
+  EXPECT_EQ(capture_getState(), captureState::armed);
+
+  int start = tick;
+  run(&breath, CAPTURE_SAMPLES - 1, &tick);
+  EXPECT_EQ(capture_getState(), captureState::triggered);
+  EXPECT_EQ(capture_getCount(), 0);
+  run(&breath, 1, &tick);
+  ASSERT_EQ(capture_getState(), captureState::done);
+  ASSERT_EQ(capture_getCount(), CAPTURE_SAMPLES);
+  EXPECT_EQ(capture_getTriggerIndex(), 0);
+
+  for (uint8_t i = 0; i < CAPTURE_SAMPLES; i++) {
+    captureSample_t sample;
+    ASSERT_TRUE(capture_getSample(i, &sample));
+    EXPECT_EQ(sample.setpoint, start + i);
+    EXPECT_EQ(sample.input, start + i - 1);
+    EXPECT_EQ(sample.output, (start + i) & 0xff);
+  }
+  captureSample_t sample;
+  EXPECT_FALSE(capture_getSample(CAPTURE_SAMPLES, &sample));
+
+  // A finished capture stays put
+  run(&breath, 100, &tick);
+  ASSERT_TRUE(capture_getSample(0, &sample));
+  EXPECT_EQ(sample.setpoint, start);
+}
+
+TEST(Capture, KeepsSamplesFromBeforeTheTrigger) {
+  capture_init();
+  BreathFsm breath;
+  int tick = 0;
+  run(&breath, 1000, &tick);
+  capture_arm(captureTrigger::inspire, 0, 2, 10);
+
+  // Runs until the start of the next breath, long enough for the ring to
+  // wrap several times over while armed.
+  do {
+    run(&breath, 1, &tick);
+  } while (!breath.phaseChanged() ||
+           breath.phase() != pid_fsm_state::inspire);
+  ASSERT_GT(tick, 1000 + 4 * CAPTURE_SAMPLES);
+  int at = tick - 1;
+  EXPECT_EQ(capture_getState(), captureState::triggered);
+  while (capture_getState() != captureState::done) {
+    run(&breath, 1, &tick);
+  }
+
+  ASSERT_EQ(capture_getCount(), CAPTURE_SAMPLES);
+  ASSERT_EQ(capture_getTriggerIndex(), 10);
+  captureSample_t sample;
+  ASSERT_TRUE(capture_getSample(10, &sample));
+  // The first sample at or after the trigger
+  int taken = sample.setpoint == setpoint_at(at) ? at : at + 1;
+  EXPECT_EQ(sample.setpoint, setpoint_at(taken));
+  // Every other tick, either side of the trigger
+  ASSERT_TRUE(capture_getSample(9, &sample));
+  EXPECT_EQ(sample.setpoint, setpoint_at(taken - 2));
+  ASSERT_TRUE(capture_getSample(0, &sample));
+  EXPECT_EQ(sample.setpoint, setpoint_at(taken - 20));
+  ASSERT_TRUE(capture_getSample(CAPTURE_SAMPLES - 1, &sample));
+  EXPECT_EQ(sample.setpoint,
+            setpoint_at(taken + 2 * (CAPTURE_SAMPLES - 11)));
+}
+
+TEST(Capture, KeepsWhatThereIsFromBeforeAnEarlyTrigger) {
+  capture_init();
+  BreathFsm breath;
+  int tick = 0;
+  capture_arm(captureTrigger::now, 0, 1, 200);
+  run(&breath, CAPTURE_SAMPLES, &tick);
+  ASSERT_EQ(capture_getState(), captureState::done);
+  EXPECT_EQ(capture_getTriggerIndex(), 0);
+  EXPECT_EQ(capture_getCount(), CAPTURE_SAMPLES);
+}
+
+TEST(Capture, TriggersOnError) {
+  capture_init();
+  BreathFsm breath;
+  breath.tick();
+  capture_arm(captureTrigger::error, 50, 1, 4);
+  for (int error = 0; error < 5; error++) {
+    capture_tick(breath, 1000, 1000 - 10 * error, 0);
+  }
+  EXPECT_EQ(capture_getState(), captureState::armed);
+  // Below the setpoint or above it
+  capture_tick(breath, 1000, 1050, 0);
+  EXPECT_EQ(capture_getState(), captureState::triggered);
+
+  capture_arm(captureTrigger::error, 50, 1, 4);
+  capture_tick(breath, 1000, 950, 0);
+  EXPECT_EQ(capture_getState(), captureState::triggered);
+}
+
+TEST(Capture, SaturatesReadings) {
+  capture_init();
+  BreathFsm breath;
+  breath.tick();
+  capture_arm(captureTrigger::now, 0, 1, 0);
+  for (int i = 0; i < CAPTURE_SAMPLES; i++) {
+    capture_tick(breath, 100000, -100000, 300);
+  }
+  captureSample_t sample;
+  ASSERT_TRUE(capture_getSample(0, &sample));
+  EXPECT_EQ(sample.setpoint, INT16_MAX);
+  EXPECT_EQ(sample.input, INT16_MIN);
+  EXPECT_EQ(sample.output, 255);
+}
@@ -6,9 +6,23 @@
 #include <algorithm>
 #include <map>
 
+#include <vector>
+
 #include "checksum.h"
 #include "gtest/gtest.h"
 
+// The textbook definition, reducing modulo 255 after every byte.
+static uint16_t reference_fletcher16(const char *data, size_t count,
+                                     uint16_t state = 0) {
+  uint16_t s1 = state & 0xff;
+  uint16_t s2 = (state >> 8) & 0xff;
+  for (size_t i = 0; i < count; ++i) {
+    s1 = (s1 + static_cast<uint8_t>(data[i])) % 255;
+    s2 = (s2 + s1) % 255;
+  }
+  return (s2 << 8) | s1;
+}
+
 TEST(Checksum, KnownValues) {
   EXPECT_EQ(0, checksum_fletcher16(NULL, 0));
   EXPECT_EQ(0, checksum_fletcher16("", 0));
@@ -19,6 +33,69 @@ TEST(Checksum, KnownValues) {
   EXPECT_EQ(0xfefe, checksum_fletcher16("\xff\xfe", 2));
 }
 
+TEST(Checksum, SimdKnownValues) {
+  EXPECT_EQ(0, checksum_fletcher16_simd(NULL, 0));
+  EXPECT_EQ(24929, checksum_fletcher16_simd("a", 1));
+  EXPECT_EQ(51440, checksum_fletcher16_simd("abcde", 5));
+  EXPECT_EQ(8279, checksum_fletcher16_simd("abcdef", 6));
+  EXPECT_EQ(1575, checksum_fletcher16_simd("abcdefgh", 8));
+  EXPECT_EQ(0xfefe, checksum_fletcher16_simd("\xff\xfe", 2));
+}
+
+// Every length a packet can have, across the block boundaries of the
+// deferred reduction, with the worst case all-0xff input as well as random
+// data.
+TEST(Checksum, MatchesReference) {
+  srand(0);
+  char random[255];
+  char ones[255];
+  for (size_t i = 0; i < sizeof(random); i++) {
+    random[i] = static_cast<char>(rand());
+    ones[i] = '\xff';
+  }
+
+  for (int len = 0; len <= 255; len++) {
+    uint16_t state = reference_fletcher16(random, len % 7);
+    EXPECT_EQ(reference_fletcher16(random, len),
+              checksum_fletcher16(random, len))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(ones, len), checksum_fletcher16(ones, len))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(random, len, state),
+              checksum_fletcher16(random, len, state))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(random, len),
+              checksum_fletcher16_simd(random, len))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(ones, len),
+              checksum_fletcher16_simd(ones, len))
+        << "len " << len;
+  }
+}
+
+// Long buffers, spanning the SIMD variant's reduction chunks.
+TEST(Checksum, SimdMatchesReferenceOnLongBuffers) {
+  srand(0);
+  std::vector<char> random(100000);
+  for (char &c : random) {
+    c = static_cast<char>(rand());
+  }
+  std::vector<char> ones(random.size(), '\xff');
+
+  for (size_t len : {15, 16, 17, 4095, 4096, 4097, 65535, 65536, 100000}) {
+    uint16_t state = reference_fletcher16(random.data(), len % 13);
+    EXPECT_EQ(reference_fletcher16(random.data(), len),
+              checksum_fletcher16_simd(random.data(), len))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(ones.data(), len),
+              checksum_fletcher16_simd(ones.data(), len))
+        << "len " << len;
+    EXPECT_EQ(reference_fletcher16(random.data() + 1, len - 1, state),
+              checksum_fletcher16_simd(random.data() + 1, len - 1, state))
+        << "len " << len;
+  }
+}
+
 TEST(Checksum, CheckBytes) {
   uint16_t csum = checksum_fletcher16("abcde", 5);
 
@@ -79,3 +156,43 @@ TEST(Checksum, BitFlips) {
   EXPECT_LE(maxCollisionsFrac, 0.0002)
       << "Too many collisions on worst checksum; is the checksum broken?";
 }
+
+TEST(Checksum, StreamingMatchesBuffer) {
+  srand(0);
+  char data[64];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = static_cast<char>(rand());
+  }
+
+  for (int trial = 0; trial < 100; trial++) {
+    uint8_t len = rand() % sizeof(data);
+    uint8_t split = len == 0 ? 0 : rand() % len;
+
+    // Feed a run of bytes one at a time, then the rest in bulk.
+    Fletcher16 csum;
+    for (uint8_t i = 0; i < split; i++) {
+      csum.add(data[i]);
+    }
+    csum.add(&data[split], len - split);
+    EXPECT_EQ(csum.value(), checksum_fletcher16(data, len));
+
+    // Resuming from a chained state gives the same answer.
+    Fletcher16 resumed(checksum_fletcher16(data, split));
+    resumed.add(&data[split], len - split);
+    EXPECT_EQ(resumed.value(), csum.value());
+  }
+}
+
+TEST(Checksum, StreamingValid) {
+  Fletcher16 csum;
+  csum.add("abcde", 5);
+  EXPECT_FALSE(csum.valid());
+
+  uint16_t checkBytes = check_bytes_fletcher16(csum.value());
+  csum.add(static_cast<char>(checkBytes >> 8));
+  csum.add(static_cast<char>(checkBytes & 0xff));
+  EXPECT_TRUE(csum.valid());
+
+  csum.reset();
+  EXPECT_EQ(csum.value(), 0);
+}
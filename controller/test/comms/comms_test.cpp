@@ -0,0 +1,554 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "alarm.h"
+#include "capture.h"
+#include "checksum.h"
+#include "comms.h"
+#include "hal.h"
+#include "parameters.h"
+#include "serialIO.h"
+#include "serialization.h"
+#include "subscription.h"
+#include "gtest/gtest.h"
+
+// A packet as the Interface Controller would send it, check bytes and all.
+static std::string frame(uint8_t type, uint8_t id,
+                         const std::string &data = "") {
+  std::string f;
+  f += static_cast<char>(type);
+  f += static_cast<char>(id);
+  f += static_cast<char>(data.size());
+  f += data;
+  uint16_t check = check_bytes_fletcher16(
+      checksum_fletcher16(f.data(), static_cast<uint8_t>(f.size())));
+  f += static_cast<char>(check >> 8);
+  f += static_cast<char>(check & 0xff);
+  return static_cast<char>(PACKET_SOF) + f;
+}
+
+static std::string command_frame(enum command cmd,
+                                 const std::string &data = "") {
+  return frame(static_cast<uint8_t>(msgType::cmd), static_cast<uint8_t>(cmd),
+               data);
+}
+
+// A command carrying request ID `req`.
+static std::string tagged_frame(enum command cmd, uint8_t req,
+                                const std::string &data = "") {
+  return frame(static_cast<uint8_t>(msgType::cmdTagged),
+               static_cast<uint8_t>(cmd), static_cast<char>(req) + data);
+}
+
+struct Packet {
+  msgType type;
+  uint8_t id;
+  std::string data;
+};
+
+// Splits what the controller sent into packets, and fails the test if any of
+// it isn't a well formed packet.
+static std::vector<Packet> parse(const std::string &bytes) {
+  std::vector<Packet> packets;
+  size_t pos = 0;
+  while (pos < bytes.size()) {
+    if (bytes.size() - pos < SERIALIO_FRAME_OVERHEAD) {
+      ADD_FAILURE() << "Truncated packet at " << pos;
+      break;
+    }
+    EXPECT_EQ(static_cast<uint8_t>(bytes[pos]), PACKET_SOF)
+        << "No SOF at " << pos;
+    uint8_t len = static_cast<uint8_t>(bytes[pos + 3]);
+    size_t total = len + SERIALIO_FRAME_OVERHEAD;
+    if (bytes.size() - pos < total) {
+      ADD_FAILURE() << "Truncated packet at " << pos;
+      break;
+    }
+    Fletcher16 csum;
+    csum.add(&bytes[pos + 1], static_cast<uint8_t>(total - 1));
+    EXPECT_TRUE(csum.valid()) << "Bad checksum at " << pos;
+
+    packets.push_back({static_cast<msgType>(bytes[pos + 1]),
+                       static_cast<uint8_t>(bytes[pos + 2]),
+                       bytes.substr(pos + 4, len)});
+    pos += total;
+  }
+  return packets;
+}
+
+// Feeds `in` to the controller no faster than the RX ring takes it, running
+// comms_handler() after each chunk, and returns everything sent meanwhile.
+static std::string exchange(const std::string &in) {
+  std::string out;
+  size_t pos = 0;
+  do {
+    size_t len = std::min<size_t>(in.size() - pos, SERIALIO_RX_BUFFER_SIZE);
+    Hal.test_serialReceive(in.data() + pos, len);
+    pos += len;
+    comms_handler();
+
+    char buf[SERIALIO_TX_BUFFER_SIZE];
+    while ((len = Hal.test_serialTransmit(buf, sizeof(buf))) > 0) {
+      out.append(buf, len);
+    }
+  } while (pos < in.size());
+  return out;
+}
+
+static std::string random_bytes(std::mt19937 *rng, size_t len) {
+  std::string bytes(len, 0);
+  for (char &c : bytes) {
+    c = static_cast<char>((*rng)() & 0xff);
+  }
+  return bytes;
+}
+
+class CommsTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+    alarm_init();
+    comms_init();
+  }
+
+  static void set_engineering() {
+    std::vector<Packet> out = parse(exchange(command_frame(
+        command::set_mode,
+        std::string(1, static_cast<char>(operatingMode::engineering)))));
+    ASSERT_EQ(out.size(), 1u);
+    ASSERT_EQ(out[0].type, msgType::rAck);
+  }
+};
+
+TEST_F(CommsTest, StartsAt115200) {
+  EXPECT_EQ(Hal.test_serialBaud(), 115200u);
+  EXPECT_EQ(serialIO_getBaud(), baudRate::b115200);
+}
+
+TEST_F(CommsTest, SendsResetState) {
+  comms_sendResetState();
+  std::vector<Packet> out = parse(exchange(""));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::status);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(dataID::vc_boot));
+}
+
+TEST_F(CommsTest, AnswersCommand) {
+  parameters_setRR(17);
+  std::vector<Packet> out = parse(exchange(command_frame(command::get_rr)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(command::get_rr));
+  ASSERT_EQ(out[0].data.size(), 4u);
+  EXPECT_EQ(wire_getFloat(out[0].data.data()), 17);
+}
+
+TEST_F(CommsTest, AnswersBackToBackCommands) {
+  std::string in;
+  for (int i = 0; i < 12; i++) {
+    in += command_frame(command::get_tv);
+  }
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 12u);
+  for (const Packet &p : out) {
+    EXPECT_EQ(p.type, msgType::rAck);
+    EXPECT_EQ(p.id, static_cast<uint8_t>(command::get_tv));
+  }
+}
+
+// Each response echoes its command's request ID, so several of the same
+// command can be outstanding.
+TEST_F(CommsTest, EchoesRequestId) {
+  parameters_setRR(17);
+  std::string in;
+  for (uint8_t req = 0; req < 4; req++) {
+    in += tagged_frame(command::get_rr, 0xf0 + req);
+  }
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 4u);
+  for (uint8_t req = 0; req < 4; req++) {
+    EXPECT_EQ(out[req].type, msgType::rAckTagged);
+    EXPECT_EQ(out[req].id, static_cast<uint8_t>(command::get_rr));
+    ASSERT_EQ(out[req].data.size(), 5u);
+    EXPECT_EQ(static_cast<uint8_t>(out[req].data[0]), 0xf0 + req);
+    EXPECT_EQ(wire_getFloat(&out[req].data[1]), 17);
+  }
+}
+
+TEST_F(CommsTest, RunsTaggedCommandWithArguments) {
+  char rr[4];
+  wire_put(rr, 21.0f);
+  std::vector<Packet> out = parse(
+      exchange(tagged_frame(command::set_rr, 0x42, std::string(rr, 4))));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAckTagged);
+  EXPECT_EQ(out[0].data, "\x42");
+  EXPECT_EQ(parameters_getRR(), 21);
+}
+
+TEST_F(CommsTest, TagsErrors) {
+  std::vector<Packet> out =
+      parse(exchange(tagged_frame(command::get_Kp, 0x07)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrModeTagged);
+  EXPECT_EQ(out[0].data, "\x07");
+
+  // The wrong payload length for the command, once its REQ is taken off
+  out = parse(exchange(tagged_frame(command::set_rr, 0x08, "ab")));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrCmdTagged);
+  EXPECT_EQ(out[0].data, "\x08");
+
+  std::string in = tagged_frame(command::get_rr, 0x09);
+  in.back() ^= 0x01;
+  out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrChecksumTagged);
+  EXPECT_EQ(out[0].data, "\x09");
+}
+
+TEST_F(CommsTest, RejectsTaggedCommandWithoutRequestId) {
+  std::vector<Packet> out = parse(exchange(
+      frame(static_cast<uint8_t>(msgType::cmdTagged),
+            static_cast<uint8_t>(command::get_rr))));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrCmd);
+  EXPECT_EQ(out[0].data, "");
+}
+
+TEST_F(CommsTest, Subscribes) {
+  std::string dividers = {1, 0, 2, 0, 0, 5};
+  std::vector<Packet> out =
+      parse(exchange(command_frame(command::set_subscription, dividers)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+  EXPECT_EQ(out[0].data, dividers);
+  EXPECT_TRUE(subscription_active());
+
+  out = parse(exchange(command_frame(command::get_subscription)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].data, dividers);
+}
+
+// Subscribed channels are batched, but not for longer than
+// COMMS_CHANNELS_LATENCY_MS.
+TEST_F(CommsTest, SendsSubscribedChannels) {
+  uint8_t dividers[TELEMETRY_CHANNELS] = {0, 0, 0, 0, 0, 20};
+  subscription_set(dividers);
+  int32_t values[TELEMETRY_CHANNELS] = {0, 0, 0, 0, 0, 1234};
+
+  std::vector<Packet> out;
+  uint32_t start = Hal.millis();
+  while (out.empty()) {
+    comms_sendChannels(subscription_tick(), values);
+    out = parse(exchange(""));
+    Hal.delay(10);
+    ASSERT_LE(Hal.millis() - start, 1000u);
+  }
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::data);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(dataID::data_channels));
+  EXPECT_LE(Hal.millis() - start, COMMS_CHANNELS_LATENCY_MS + 20);
+
+  // A single record, of the setpoint alone: at 100 Hz a divider of 20 is
+  // 200 ms, longer than the latency
+  ChannelRecord records[4];
+  ASSERT_EQ(telemetry_decodeChannels(out[0].data.data(),
+                                     static_cast<uint8_t>(out[0].data.size()),
+                                     records, 4),
+            1);
+  EXPECT_EQ(records[0].mask, 1 << 5);
+  EXPECT_EQ(records[0].values[5], 1234);
+}
+
+// Readings batched when the subscription is cleared go out then, and
+// nothing of the old subscription turns up once there's a new one.
+TEST_F(CommsTest, FlushesChannelsWhenSubscriptionChanges) {
+  std::string dividers = {1, 0, 0, 0, 0, 0};
+  parse(exchange(command_frame(command::set_subscription, dividers)));
+  int32_t values[TELEMETRY_CHANNELS] = {100, 0, 0, 0, 0, 0};
+  uint32_t before = Hal.millis();
+  for (int i = 0; i < 3; i++) {
+    comms_sendChannels(subscription_tick(), values);
+    Hal.delay(10);
+  }
+  ASSERT_TRUE(parse(exchange("")).empty());
+
+  std::vector<Packet> out = parse(exchange(
+      command_frame(command::set_subscription, std::string(6, 0))));
+  ASSERT_EQ(out.size(), 2u);
+  EXPECT_EQ(out[0].type, msgType::data);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(dataID::data_channels));
+  ChannelRecord records[4];
+  ASSERT_EQ(telemetry_decodeChannels(out[0].data.data(),
+                                     static_cast<uint8_t>(out[0].data.size()),
+                                     records, 4),
+            3);
+  EXPECT_EQ(records[0].time_ms, before);
+  EXPECT_EQ(out[1].type, msgType::rAck);
+  EXPECT_FALSE(subscription_active());
+
+  // While nothing's subscribed, pid_execute() doesn't call
+  // comms_sendChannels() at all
+  Hal.delay(1000);
+  uint32_t resubscribed = Hal.millis();
+  out = parse(exchange(command_frame(command::set_subscription, dividers)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+
+  values[0] = 200;
+  while (out.size() < 2) {
+    comms_sendChannels(subscription_tick(), values);
+    std::vector<Packet> sent = parse(exchange(""));
+    out.insert(out.end(), sent.begin(), sent.end());
+    Hal.delay(10);
+    ASSERT_LE(Hal.millis() - resubscribed, 1000u);
+  }
+  ASSERT_EQ(out[1].id, static_cast<uint8_t>(dataID::data_channels));
+  ChannelRecord batch[TELEMETRY_CHANNELS_LEN_MAX];
+  int count =
+      telemetry_decodeChannels(out[1].data.data(),
+                               static_cast<uint8_t>(out[1].data.size()),
+                               batch, TELEMETRY_CHANNELS_LEN_MAX);
+  ASSERT_GT(count, 0);
+  for (int i = 0; i < count; i++) {
+    EXPECT_GE(batch[i].time_ms, resubscribed);
+    EXPECT_EQ(batch[i].values[0], 200);
+  }
+}
+
+// A capture is armed, and then downloaded a few samples at a time.
+TEST_F(CommsTest, DownloadsCapture) {
+  set_engineering();
+  capture_init();
+  std::string arm(5, 0);
+  arm[0] = static_cast<char>(captureTrigger::now);
+  arm[3] = 1;
+  std::vector<Packet> out =
+      parse(exchange(command_frame(command::arm_capture, arm)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+  EXPECT_EQ(capture_getState(), captureState::armed);
+
+  BreathFsm breath;
+  breath.tick();
+  for (int i = 0; i < CAPTURE_SAMPLES; i++) {
+    capture_tick(breath, 1000 + i, 900 + i, static_cast<int16_t>(i));
+  }
+
+  for (uint8_t first = 0; first < CAPTURE_SAMPLES; first += 4) {
+    out = parse(exchange(
+        tagged_frame(command::get_capture, first, std::string(1, first))));
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].type, msgType::rAckTagged);
+    const std::string &data = out[0].data;
+    ASSERT_EQ(data.size(), 1u + 3 + 4 * 5);
+    EXPECT_EQ(data[0], static_cast<char>(first));
+    EXPECT_EQ(data[1], static_cast<char>(captureState::done));
+    EXPECT_EQ(static_cast<uint8_t>(data[2]), CAPTURE_SAMPLES);
+    EXPECT_EQ(data[3], 0);
+    for (int i = 0; i < 4; i++) {
+      const char *sample = &data[4 + 5 * i];
+      EXPECT_EQ(wire_getInt16(sample), 1000 + first + i);
+      EXPECT_EQ(wire_getInt16(sample + 2), 900 + first + i);
+      EXPECT_EQ(wire_getUint8(sample + 4), first + i);
+    }
+  }
+}
+
+TEST_F(CommsTest, ReportsChecksumError) {
+  std::string in = command_frame(command::get_rr);
+  in.back() ^= 0x01;
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrChecksum);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(command::get_rr));
+}
+
+TEST_F(CommsTest, ReportsUnknownCommand) {
+  std::vector<Packet> out = parse(exchange(frame(0, 0x1f)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrCmd);
+}
+
+TEST_F(CommsTest, ReportsModeError) {
+  std::vector<Packet> out = parse(exchange(command_frame(command::get_Kp)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rErrMode);
+}
+
+TEST_F(CommsTest, ResetsController) {
+  set_engineering();
+  uint32_t reboots = Hal.test_reboots();
+  parse(exchange(command_frame(command::reset_vc)));
+  EXPECT_EQ(Hal.test_reboots(), reboots + 1);
+}
+
+// Bytes which can't start a packet are skipped, rather than stalling the
+// parser.
+TEST_F(CommsTest, SkipsUnknownMessageTypes) {
+  std::string in = "\x55\x77\x30\x40";
+  in += command_frame(command::get_rr);
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+}
+
+TEST_F(CommsTest, DropsOversizedPacket) {
+  std::string in = std::string("\x7e\x00\x01\xc8", 4);
+  in += command_frame(command::get_rr);
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+
+  commsRxErrors_t errors;
+  comms_getRxErrors(&errors);
+  EXPECT_EQ(errors.invalid, 1);
+}
+
+TEST_F(CommsTest, SkipsToSof) {
+  std::string in = "\x55\x01\x02\x03\x04";
+  in += command_frame(command::get_rr);
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+
+  commsRxErrors_t errors;
+  comms_getRxErrors(&errors);
+  EXPECT_EQ(errors.skipped, 5);
+  EXPECT_EQ(errors.invalid, 0);
+}
+
+// Idle SOFs, or one left by a broken packet, are passed over.
+TEST_F(CommsTest, RepeatedSofIsNotAnError) {
+  std::string in = "\x7e\x7e\x7e";
+  in += command_frame(command::get_rr);
+  std::vector<Packet> out = parse(exchange(in));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+}
+
+// Without the timeout, the broken packet would take the first byte of the
+// next one as its last.
+TEST_F(CommsTest, DropsPacketWithLostByte) {
+  std::string broken = command_frame(command::get_tv);
+  broken.pop_back();
+  EXPECT_TRUE(parse(exchange(broken)).empty());
+
+  // The handler runs every tick, so it sees the line go quiet.
+  Hal.delay(COMMS_RX_TIMEOUT_MS);
+  exchange("");
+  std::vector<Packet> out = parse(exchange(command_frame(command::get_rr)));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+  EXPECT_EQ(out[0].id, static_cast<uint8_t>(command::get_rr));
+
+  commsRxErrors_t errors;
+  comms_getRxErrors(&errors);
+  EXPECT_EQ(errors.timeouts, 1);
+}
+
+TEST_F(CommsTest, KeepsSlowPacket) {
+  std::string sent;
+  for (char c : command_frame(command::get_rr)) {
+    sent += exchange(std::string(1, c));
+    Hal.delay(COMMS_RX_TIMEOUT_MS - 1);
+  }
+  std::vector<Packet> out = parse(sent);
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].type, msgType::rAck);
+}
+
+TEST_F(CommsTest, SwitchesBaudRate) {
+  std::vector<Packet> out = parse(exchange(command_frame(
+      command::set_baud,
+      std::string(1, static_cast<char>(baudRate::b500000)))));
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].data, std::string(1, 1));
+  // The ack went out at the old rate, and then the rate changed.
+  exchange("");
+  EXPECT_EQ(Hal.test_serialBaud(), 500000u);
+
+  // Nobody confirmed the new rate, so it falls back.
+  Hal.delay(SERIALIO_BAUD_CONFIRM_MS);
+  exchange("");
+  EXPECT_EQ(Hal.test_serialBaud(), 115200u);
+}
+
+TEST_F(CommsTest, KeepsConfirmedBaudRate) {
+  exchange(command_frame(
+      command::set_baud,
+      std::string(1, static_cast<char>(baudRate::b1000000))));
+  exchange("");
+  exchange(command_frame(command::comms_check));
+  Hal.delay(SERIALIO_BAUD_CONFIRM_MS);
+  exchange("");
+  EXPECT_EQ(Hal.test_serialBaud(), 1000000u);
+}
+
+// Whatever arrives, the controller only ever sends well formed packets, and
+// keeps up without losing received bytes.
+TEST_F(CommsTest, FuzzRandomBytes) {
+  std::mt19937 rng(1);
+  for (int i = 0; i < 2000; i++) {
+    std::vector<Packet> out = parse(exchange(random_bytes(&rng, 100)));
+    for (const Packet &p : out) {
+      // Tagged or not
+      msgType type = static_cast<msgType>(static_cast<uint8_t>(p.type) &
+                                          ~MSGTYPE_TAGGED);
+      EXPECT_TRUE(type == msgType::rAck || type == msgType::rErrChecksum ||
+                  type == msgType::rErrMode || type == msgType::rErrCmd ||
+                  type == msgType::alarm)
+          << static_cast<int>(p.type);
+    }
+  }
+  EXPECT_EQ(serialIO_getRxOverruns(), 0);
+}
+
+// Valid commands mixed with line noise.  Those that are answered are
+// answered correctly, and none is answered twice.
+TEST_F(CommsTest, FuzzCommandsInNoise) {
+  std::mt19937 rng(2);
+  parameters_setRR(12);
+  int sent = 0;
+  int answered = 0;
+  for (int i = 0; i < 2000; i++) {
+    std::string in = random_bytes(&rng, rng() % 16);
+    in += command_frame(command::get_rr);
+    sent++;
+    for (const Packet &p : parse(exchange(in))) {
+      if (p.type == msgType::rAck &&
+          p.id == static_cast<uint8_t>(command::get_rr)) {
+        ASSERT_EQ(p.data.size(), 4u);
+        EXPECT_EQ(wire_getFloat(p.data.data()), 12);
+        answered++;
+      }
+    }
+  }
+  EXPECT_LE(answered, sent);
+  EXPECT_GT(answered, 0);
+  EXPECT_EQ(serialIO_getRxOverruns(), 0);
+}
+
+// Once the line has been quiet for COMMS_RX_TIMEOUT_MS, whatever noise came
+// before, the next command is answered.
+TEST_F(CommsTest, FuzzRecoversAfterNoise) {
+  std::mt19937 rng(3);
+  for (int i = 0; i < 2000; i++) {
+    exchange(random_bytes(&rng, rng() % 64));
+    Hal.delay(COMMS_RX_TIMEOUT_MS);
+    exchange("");
+
+    bool answered = false;
+    for (const Packet &p : parse(exchange(command_frame(command::get_rr)))) {
+      answered |= p.type == msgType::rAck &&
+                  p.id == static_cast<uint8_t>(command::get_rr);
+    }
+    ASSERT_TRUE(answered) << "Not answered after noise " << i;
+  }
+}
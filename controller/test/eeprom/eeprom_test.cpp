@@ -0,0 +1,122 @@
+#include "eeprom.h"
+#include "hal.h"
+#include "gtest/gtest.h"
+
+class EepromTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    eeprom_init();
+  }
+
+  // Saves a record and writes it out completely.
+  static void save(uint8_t version, const char *data, uint8_t len) {
+    ASSERT_TRUE(eeprom_save(version, data, len));
+    while (eeprom_busy()) {
+      eeprom_handler();
+    }
+  }
+};
+
+TEST_F(EepromTest, NothingToLoadWhenErased) {
+  char data[4];
+  EXPECT_FALSE(eeprom_load(1, data, sizeof(data)));
+}
+
+TEST_F(EepromTest, SaveAndLoadAfterReset) {
+  save(1, "abcd", 4);
+
+  eeprom_init();
+  char data[4];
+  ASSERT_TRUE(eeprom_load(1, data, sizeof(data)));
+  EXPECT_EQ(memcmp(data, "abcd", 4), 0);
+}
+
+TEST_F(EepromTest, NewestRecordWins) {
+  save(1, "aaaa", 4);
+  save(1, "bbbb", 4);
+  save(1, "cccc", 4);
+
+  eeprom_init();
+  char data[4];
+  ASSERT_TRUE(eeprom_load(1, data, sizeof(data)));
+  EXPECT_EQ(memcmp(data, "cccc", 4), 0);
+}
+
+TEST_F(EepromTest, OtherVersionOrLengthIsIgnored) {
+  save(1, "abcd", 4);
+  char data[4];
+  EXPECT_FALSE(eeprom_load(2, data, sizeof(data)));
+  EXPECT_FALSE(eeprom_load(1, data, 3));
+}
+
+TEST_F(EepromTest, SaveDoesNotBlock) {
+  ASSERT_TRUE(eeprom_save(1, "abcd", 4));
+  EXPECT_TRUE(eeprom_busy());
+  EXPECT_EQ(Hal.test_eepromWrites(), 0);
+
+  // One byte per call
+  eeprom_handler();
+  EXPECT_EQ(Hal.test_eepromWrites(), 1);
+
+  // Can't queue another record until this one is done
+  EXPECT_FALSE(eeprom_save(1, "efgh", 4));
+}
+
+TEST_F(EepromTest, TooLongIsRejected) {
+  char data[EEPROM_DATA_LEN_MAX + 1] = {0};
+  EXPECT_FALSE(eeprom_save(1, data, sizeof(data)));
+  EXPECT_TRUE(eeprom_save(1, data, EEPROM_DATA_LEN_MAX));
+}
+
+// A reset part way through a save leaves the previous record in use.
+TEST_F(EepromTest, TornWriteKeepsPreviousRecord) {
+  save(1, "aaaa", 4);
+  ASSERT_TRUE(eeprom_save(1, "bbbb", 4));
+  for (int i = 0; i < 5; i++) {
+    eeprom_handler();
+  }
+
+  eeprom_init();
+  char data[4];
+  ASSERT_TRUE(eeprom_load(1, data, sizeof(data)));
+  EXPECT_EQ(memcmp(data, "aaaa", 4), 0);
+}
+
+TEST_F(EepromTest, WearIsSpreadOverSlots) {
+  // Once every slot has been used, saving the same data again rewrites only
+  // the changed sequence number and check bytes.
+  char data[EEPROM_DATA_LEN_MAX];
+  memset(data, 'x', sizeof(data));
+  for (int i = 0; i < EEPROM_SLOTS; i++) {
+    save(1, data, sizeof(data));
+  }
+  uint32_t first_pass = Hal.test_eepromWrites();
+  EXPECT_LE(first_pass, EEPROM_SLOTS * EEPROM_SLOT_SIZE);
+
+  for (int i = 0; i < EEPROM_SLOTS; i++) {
+    save(1, data, sizeof(data));
+  }
+  EXPECT_LE(Hal.test_eepromWrites() - first_pass, EEPROM_SLOTS * 4);
+
+  eeprom_init();
+  char loaded[EEPROM_DATA_LEN_MAX];
+  ASSERT_TRUE(eeprom_load(1, loaded, sizeof(loaded)));
+  EXPECT_EQ(memcmp(data, loaded, sizeof(data)), 0);
+}
+
+// Sequence numbers are compared modulo 2^16, so the newest record is still
+// found after they wrap.
+TEST_F(EepromTest, SequenceWraps) {
+  char data[2];
+  for (uint32_t i = 0; i < 0x10000 + 3; i++) {
+    data[0] = static_cast<char>(i);
+    data[1] = static_cast<char>(i >> 8);
+    save(1, data, sizeof(data));
+  }
+
+  eeprom_init();
+  ASSERT_TRUE(eeprom_load(1, data, sizeof(data)));
+  EXPECT_EQ(static_cast<uint8_t>(data[0]), 2);
+  EXPECT_EQ(static_cast<uint8_t>(data[1]), 0);
+}
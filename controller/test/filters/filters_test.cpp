@@ -0,0 +1,98 @@
+#include <stdlib.h>
+
+#include "filters.h"
+#include "gtest/gtest.h"
+
+TEST(BoxcarFilter, StartsAtResetValue) {
+  BoxcarFilter<8> f;
+  EXPECT_EQ(f.value(), 0);
+  f.reset(100);
+  EXPECT_EQ(f.value(), 100);
+  EXPECT_EQ(f.sum(), 800);
+  EXPECT_EQ(f.latest(), 100);
+}
+
+TEST(BoxcarFilter, AveragesOverWindow) {
+  BoxcarFilter<8> f;
+  f.reset(0);
+  for (uint16_t i = 1; i <= 8; i++) {
+    f.add(i * 10);
+    EXPECT_EQ(f.latest(), i * 10);
+  }
+  // (10 + 20 + ... + 80) / 8
+  EXPECT_EQ(f.value(), 45);
+
+  // Old samples fall out of the window.
+  for (int i = 0; i < 8; i++) {
+    f.add(7);
+  }
+  EXPECT_EQ(f.value(), 7);
+  EXPECT_EQ(f.sum(), 56);
+}
+
+TEST(BoxcarFilter, MatchesNaiveAverage) {
+  BoxcarFilter<32> f;
+  f.reset(0);
+  f.setWindow(5);
+  uint16_t history[1000] = {0};
+  srand(0);
+  for (int i = 0; i < 1000; i++) {
+    history[i] = rand() % 1024;
+    f.add(history[i]);
+    if (i >= 4) {
+      int32_t sum = 0;
+      for (int j = i - 4; j <= i; j++) {
+        sum += history[j];
+      }
+      ASSERT_EQ(f.sum(), sum) << i;
+    }
+  }
+}
+
+TEST(BoxcarFilter, SetWindow) {
+  BoxcarFilter<4> f;
+  f.reset(0);
+  f.add(4);
+  f.add(8);
+  f.setWindow(2);
+  EXPECT_EQ(f.window(), 2);
+  EXPECT_EQ(f.value(), 6);
+  f.setWindow(1);
+  EXPECT_EQ(f.value(), 8);
+
+  // Out of range windows are ignored.
+  f.setWindow(0);
+  f.setWindow(5);
+  EXPECT_EQ(f.window(), 1);
+
+  f.setWindow(4);
+  EXPECT_EQ(f.value(), 3);
+  EXPECT_EQ(f.sumOfLatest(3), 12);
+}
+
+TEST(IirFilter, ConvergesToStep) {
+  IirFilter<2> f;
+  f.reset(0);
+  f.add(100);
+  EXPECT_EQ(f.value(), 25);
+  f.add(100);
+  // 25 + 75 / 4
+  EXPECT_EQ(f.value(), 44);
+  for (int i = 0; i < 100; i++) {
+    f.add(100);
+  }
+  EXPECT_EQ(f.value(), 100);
+}
+
+TEST(IirFilter, SmallStepsArentLost) {
+  IirFilter<4> f;
+  f.reset(500);
+  for (int i = 0; i < 200; i++) {
+    f.add(501);
+  }
+  EXPECT_EQ(f.value(), 501);
+  for (int i = 0; i < 200; i++) {
+    f.add(499);
+  }
+  EXPECT_EQ(f.value(), 499);
+}
@@ -0,0 +1,79 @@
+#include <math.h>
+
+#include "flow.h"
+#include "scheduler.h"
+#include "gtest/gtest.h"
+
+static float expected_flow(float dp_pa) {
+  float area = M_PI * pow(VENTURI_THROAT_DIAMETER_MM * 0.001f, 2) / 4;
+  float beta4 =
+      pow(VENTURI_THROAT_DIAMETER_MM / VENTURI_INLET_DIAMETER_MM, 4);
+  return VENTURI_DISCHARGE_COEFFICIENT * area *
+         sqrt(2 * fabs(dp_pa) / (AIR_DENSITY * (1 - beta4))) * 1e6f *
+         (dp_pa < 0 ? -1 : 1);
+}
+
+TEST(FlowTest, MatchesVenturiEquation) {
+  EXPECT_EQ(venturi_flow_ml_s(0), 0);
+  // Within 1% and 2 mL/s, from the noise floor to full scale.
+  for (int32_t dp = 4; dp <= 2000; dp++) {
+    float expected = expected_flow(dp);
+    EXPECT_NEAR(venturi_flow_ml_s(dp), expected, 2 + expected * 0.01f)
+        << "dp " << dp;
+  }
+}
+
+TEST(FlowTest, SignFollowsPressure) {
+  for (int32_t dp = 0; dp <= 2000; dp += 7) {
+    EXPECT_EQ(venturi_flow_ml_s(-dp), -venturi_flow_ml_s(dp));
+  }
+}
+
+TEST(FlowTest, Monotonic) {
+  int32_t last = 0;
+  for (int32_t dp = 0; dp <= 2100; dp++) {
+    int32_t flow = venturi_flow_ml_s(dp);
+    EXPECT_GE(flow, last) << "dp " << dp;
+    last = flow;
+  }
+}
+
+TEST(FlowTest, SaturatesPastFullScale) {
+  EXPECT_EQ(venturi_flow_ml_s(5000), venturi_flow_ml_s(2048));
+  EXPECT_EQ(venturi_flow_ml_s(-5000), -venturi_flow_ml_s(2048));
+}
+
+TEST(FlowTest, IntegratesVolume) {
+  flow_init();
+  int32_t dp = 500;
+  int32_t flow = venturi_flow_ml_s(dp);
+
+  // One second of inhalation, with nothing leaving through exhalation
+  for (int i = 0; i < SCHEDULER_TICK_HZ; i++) {
+    flow_update(dp, 0);
+  }
+  EXPECT_EQ(flow_getFlow(), flow);
+  EXPECT_EQ(flow_getVolume(), flow);
+
+  // Then it all comes back out
+  for (int i = 0; i < SCHEDULER_TICK_HZ; i++) {
+    flow_update(0, dp);
+  }
+  EXPECT_EQ(flow_getFlow(), -flow);
+  EXPECT_EQ(flow_getVolume(), 0);
+  EXPECT_EQ(flow_getTidalVolume(), 0);
+
+  flow_startBreath();
+  EXPECT_EQ(flow_getTidalVolume(), flow);
+  EXPECT_EQ(flow_getVolume(), 0);
+}
+
+TEST(FlowTest, BreathStartResetsVolume) {
+  flow_init();
+  for (int i = 0; i < 100; i++) {
+    flow_update(200, 0);
+  }
+  EXPECT_GT(flow_getVolume(), 0);
+  flow_startBreath();
+  EXPECT_EQ(flow_getVolume(), 0);
+}
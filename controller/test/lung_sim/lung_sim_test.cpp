@@ -0,0 +1,186 @@
+#include <stdio.h>
+
+#include "breath.h"
+#include "hal.h"
+#include "lung_sim.h"
+#include "parameters.h"
+#include "pid_controller.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "gtest/gtest.h"
+
+static const PwmPinId BLOWER_PIN = PwmPinId::PWM_3;
+static const float TICK_S = 1.0f / SCHEDULER_TICK_HZ;
+// Each pin is converted ~3 times per ms with three pins sampled.
+static const int ADC_ROUNDS_PER_TICK = 3;
+
+// Runs the pressure loop the way pid_execute() does, against the model.
+class LungSimTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+    Hal.analogWrite(BLOWER_PIN, 0);
+    sim.reset();
+    sensors_init();
+
+    breath.reset();
+    pid.setTunings(parameters_getKp(), parameters_getKi(),
+                   parameters_getKd(), 1000000 / SCHEDULER_TICK_HZ);
+    pid.reset(0, 0, 0);
+  }
+
+  // Advances the model and the sensors by one tick.
+  void stepPlant() {
+    sim.step(TICK_S);
+    for (int i = 0; i < ADC_ROUNDS_PER_TICK; i++) {
+      Hal.test_sampleAnalogPins();
+    }
+  }
+
+  // One tick of the closed loop, returning the pressure it acted on.
+  int32_t tick() {
+    stepPlant();
+    int32_t setpoint = breath.tick();
+    int32_t pressure = get_pressure_reading_pa(PressureSensors::PATIENT_PIN);
+    Hal.analogWrite(BLOWER_PIN, pid.compute(setpoint, pressure));
+    return pressure;
+  }
+
+  // Runs until the start of the next breath.
+  void runToBreathStart() {
+    do {
+      tick();
+    } while (!(breath.phaseChanged() &&
+               breath.phase() == pid_fsm_state::inspire));
+  }
+
+  LungSim sim;
+  BreathFsm breath;
+  PidController pid;
+};
+
+TEST_F(LungSimTest, RestsAtAmbient) {
+  for (int i = 0; i < 100; i++) {
+    stepPlant();
+  }
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::PATIENT_PIN), 0);
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::INHALATION_PIN), 0);
+}
+
+TEST_F(LungSimTest, OpenLoopSteadyState) {
+  // Below full duty, since at full duty the patient sensor saturates.
+  const int duty = 200;
+  Hal.analogWrite(BLOWER_PIN, duty);
+  for (int i = 0; i < 20 * SCHEDULER_TICK_HZ; i++) {
+    stepPlant();
+  }
+
+  // With no flow into the lung, the wye divides the blower pressure between
+  // the tube and the leak.
+  LungSimParams params;
+  float speed = duty / 255.0f;
+  float expected = params.blower_max_pa * speed * speed *
+                   params.leak_resistance_cmh2o_per_l_s /
+                   (params.leak_resistance_cmh2o_per_l_s +
+                    params.tube_resistance_cmh2o_per_l_s);
+  EXPECT_NEAR(sim.airwayPressurePa(), expected, 1);
+  EXPECT_NEAR(sim.lungFlowMlS(), 0, 1);
+  EXPECT_NEAR(sim.lungVolumeMl(),
+              expected / PA_PER_CMH2O * params.compliance_ml_per_cmh2o, 1);
+  // Within a couple of ADC counts.
+  EXPECT_NEAR(get_pressure_reading_pa(PressureSensors::PATIENT_PIN), expected,
+              15);
+}
+
+TEST_F(LungSimTest, LungFillsAndEmpties) {
+  Hal.analogWrite(BLOWER_PIN, 200);
+  float last_volume = 0;
+  for (int i = 0; i < 500; i++) {
+    stepPlant();
+    EXPECT_GE(sim.lungVolumeMl(), last_volume);
+    last_volume = sim.lungVolumeMl();
+  }
+  EXPECT_GT(sim.lungFlowMlS(), 0);
+
+  Hal.analogWrite(BLOWER_PIN, 0);
+  for (int i = 0; i < 500; i++) {
+    stepPlant();
+  }
+  EXPECT_LT(sim.lungFlowMlS(), 0);
+  EXPECT_LT(sim.lungVolumeMl(), last_volume);
+}
+
+// Measures the step response of the pressure loop over a breath, once it has
+// settled into a steady pattern.  These bounds are loose; the point is to
+// catch changes which make the loop markedly worse, and to print the
+// figures for comparing tunings.
+TEST_F(LungSimTest, ClosedLoopStepResponse) {
+  const float pip_cmh2o = 20;
+  const float peep_cmh2o = 5;
+  parameters_setPIP(pip_cmh2o);
+  parameters_setPEEP(peep_cmh2o);
+  parameters_setRR(12);
+  parameters_setDwell(80);
+
+  for (int i = 0; i < 5; i++) {
+    runToBreathStart();
+  }
+
+  const int32_t pip = static_cast<int32_t>(pip_cmh2o * PA_PER_CMH2O);
+  const int32_t peep = static_cast<int32_t>(peep_cmh2o * PA_PER_CMH2O);
+  const int32_t rise_10 = peep + (pip - peep) / 10;
+  const int32_t rise_90 = peep + (pip - peep) * 9 / 10;
+  const int32_t band = static_cast<int32_t>(1 * PA_PER_CMH2O);
+
+  int32_t t10 = -1, t90 = -1, settled = -1;
+  int32_t peak = INT32_MIN;
+  int32_t dwell_sum = 0, dwell_ticks = 0;
+  for (int32_t t = 0;; t++) {
+    int32_t p = tick();
+    if (breath.phaseChanged() && breath.phase() == pid_fsm_state::inspire) {
+      break;
+    }
+    pid_fsm_state phase = breath.phase();
+    if (phase == pid_fsm_state::inspire || phase == pid_fsm_state::plateau) {
+      if (t10 < 0 && p >= rise_10) {
+        t10 = t;
+      }
+      if (t90 < 0 && p >= rise_90) {
+        t90 = t;
+      }
+      if (p > peak) {
+        peak = p;
+      }
+      if (phase == pid_fsm_state::plateau) {
+        bool inside = p > pip - band && p < pip + band;
+        if (!inside) {
+          settled = -1;
+        } else if (settled < 0) {
+          settled = t;
+        }
+      }
+    } else if (phase == pid_fsm_state::expire_dwell) {
+      dwell_sum += p;
+      dwell_ticks++;
+    }
+  }
+  ASSERT_GE(t10, 0);
+  ASSERT_GE(t90, 0);
+  ASSERT_GT(dwell_ticks, 0);
+
+  float ms_per_tick = 1000.0f / SCHEDULER_TICK_HZ;
+  float rise_ms = (t90 - t10) * ms_per_tick;
+  float overshoot_cmh2o = (peak - pip) / PA_PER_CMH2O;
+  float settle_ms = settled * ms_per_tick;
+  float peep_error_cmh2o = (dwell_sum / dwell_ticks - peep) / PA_PER_CMH2O;
+  printf("rise %.0f ms, overshoot %.2f cmH2O, settled at %.0f ms, "
+         "PEEP error %.2f cmH2O\n",
+         rise_ms, overshoot_cmh2o, settle_ms, peep_error_cmh2o);
+  RecordProperty("rise_ms", static_cast<int>(rise_ms));
+  RecordProperty("settle_ms", static_cast<int>(settle_ms));
+
+  EXPECT_GE(settled, 0) << "Never settled within 1 cmH2O of PIP";
+  EXPECT_LT(overshoot_cmh2o, 3);
+  EXPECT_LT(fabsf(peep_error_cmh2o), 1.5f);
+}
@@ -0,0 +1,104 @@
+#include "eeprom.h"
+#include "hal.h"
+#include "parameters.h"
+#include "gtest/gtest.h"
+
+class ParametersTest : public testing::Test {
+public:
+  void SetUp() override {
+    Hal.test_eraseEeprom();
+    parameters_init();
+  }
+
+  // Runs the handler for ms milliseconds.
+  static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+      parameters_handler();
+      Hal.delay(1);
+    }
+  }
+};
+
+TEST_F(ParametersTest, DefaultsWithoutSavedSettings) {
+  EXPECT_EQ(parameters_getRR(), RR_DEFAULT);
+  EXPECT_EQ(parameters_getKp(), KP_DEFAULT);
+}
+
+TEST_F(ParametersTest, SettingsSurviveReset) {
+  parameters_setRR(25);
+  parameters_setPEEP(7);
+  parameters_setKp(1.5f);
+  run(PARAMETERS_SAVE_DELAY_MS + 500);
+
+  parameters_init();
+  EXPECT_EQ(parameters_getRR(), 25);
+  EXPECT_EQ(parameters_getPEEP(), 7);
+  EXPECT_EQ(parameters_getKp(), 1.5f);
+}
+
+TEST_F(ParametersTest, PhaseProfiles) {
+  uint8_t revision = parameters_getPidRevision();
+  pidGains_t expire = {50, 100, 1};
+  EXPECT_TRUE(parameters_setPhaseGains(pid_fsm_state::expire, &expire));
+  EXPECT_NE(parameters_getPidRevision(), revision);
+  EXPECT_FALSE(parameters_setPhaseGains(pid_fsm_state::reset, &expire));
+  EXPECT_FALSE(parameters_setPhaseGains(pid_fsm_state::count, &expire));
+
+  pidGains_t gains;
+  ASSERT_TRUE(parameters_getPhaseGains(pid_fsm_state::expire, &gains));
+  EXPECT_EQ(gains.kp, 50);
+  EXPECT_EQ(gains.ki, 100);
+  EXPECT_EQ(gains.kd, 1);
+  ASSERT_TRUE(parameters_getPhaseGains(pid_fsm_state::inspire, &gains));
+  EXPECT_EQ(gains.kp, KP_DEFAULT);
+  EXPECT_EQ(parameters_getKp(), KP_DEFAULT);
+
+  // Saved and restored, profile by profile
+  run(PARAMETERS_SAVE_DELAY_MS + 500);
+  parameters_init();
+  ASSERT_TRUE(parameters_getPhaseGains(pid_fsm_state::expire, &gains));
+  EXPECT_EQ(gains.ki, 100);
+  ASSERT_TRUE(parameters_getPhaseGains(pid_fsm_state::plateau, &gains));
+  EXPECT_EQ(gains.ki, KI_DEFAULT);
+
+  // A single gain goes in every profile
+  parameters_setKi(7);
+  for (uint8_t phase = (uint8_t)pid_fsm_state::inspire;
+       phase < (uint8_t)pid_fsm_state::count; phase++) {
+    ASSERT_TRUE(parameters_getPhaseGains((pid_fsm_state)phase, &gains));
+    EXPECT_EQ(gains.ki, 7);
+  }
+}
+
+TEST_F(ParametersTest, SaveWaitsForChangesToSettle) {
+  parameters_setRR(25);
+  run(PARAMETERS_SAVE_DELAY_MS / 2);
+  parameters_setRR(26);
+  run(PARAMETERS_SAVE_DELAY_MS / 2);
+  EXPECT_EQ(Hal.test_eepromWrites(), 0);
+
+  run(PARAMETERS_SAVE_DELAY_MS);
+  EXPECT_GT(Hal.test_eepromWrites(), 0);
+  parameters_init();
+  EXPECT_EQ(parameters_getRR(), 26);
+}
+
+TEST_F(ParametersTest, SavesAreRateLimited) {
+  parameters_setRR(25);
+  run(PARAMETERS_SAVE_DELAY_MS + 500);
+  uint32_t writes = Hal.test_eepromWrites();
+
+  parameters_setRR(26);
+  run(PARAMETERS_SAVE_DELAY_MS + 500);
+  EXPECT_EQ(Hal.test_eepromWrites(), writes);
+
+  run(PARAMETERS_SAVE_INTERVAL_MS);
+  EXPECT_GT(Hal.test_eepromWrites(), writes);
+  parameters_init();
+  EXPECT_EQ(parameters_getRR(), 26);
+}
+
+TEST_F(ParametersTest, NoSaveWithoutChanges) {
+  run(PARAMETERS_SAVE_INTERVAL_MS + PARAMETERS_SAVE_DELAY_MS);
+  EXPECT_EQ(Hal.test_eepromWrites(), 0);
+}
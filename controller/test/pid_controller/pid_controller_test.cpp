@@ -0,0 +1,109 @@
+#include "pid_controller.h"
+#include "gtest/gtest.h"
+
+// 1 kHz, as driven by the scheduler.
+static const uint16_t PERIOD_US = 1000;
+
+TEST(PidController, Proportional) {
+  PidController pid;
+  pid.setTunings(100, 0, 0, PERIOD_US);
+  pid.reset(0, 0, 0);
+  // 100 per kPa * 0.5 kPa
+  EXPECT_EQ(pid.compute(1500, 1000), 50);
+  EXPECT_EQ(pid.compute(1000, 1500), 0) << "clamped to the output limits";
+}
+
+TEST(PidController, IntegralAccumulatesPerSample) {
+  PidController pid;
+  pid.setTunings(0, 100, 0, PERIOD_US);
+  pid.reset(0, 0, 0);
+  // 100 per kPa*s with a 1 kPa error: 100 per second, i.e. 0.1 per sample.
+  int16_t out = 0;
+  for (int i = 0; i < 1000; i++) {
+    out = pid.compute(1000, 0);
+  }
+  EXPECT_NEAR(out, 100, 1);
+  EXPECT_NEAR(pid.integral(), 100, 1);
+}
+
+TEST(PidController, DerivativeOnMeasurement) {
+  PidController pid;
+  pid.setTunings(0, 0, 1, PERIOD_US);
+  pid.setOutputLimits(-100, 100);
+  pid.reset(0, 0, 0);
+  // A setpoint step doesn't kick the output...
+  EXPECT_EQ(pid.compute(1000, 0), 0);
+  // ...but the input rising 10 Pa in one sample (10 kPa/s) does.
+  EXPECT_EQ(pid.compute(1000, 10), -10);
+  EXPECT_EQ(pid.compute(1000, 10), 0);
+}
+
+TEST(PidController, AntiWindup) {
+  PidController pid;
+  pid.setTunings(10, 1000, 0, PERIOD_US);
+  pid.reset(0, 0, 0);
+  // A large sustained error saturates the output...
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_LE(pid.compute(2000, 0), 255);
+  }
+  EXPECT_LE(pid.integral(), 255);
+  // ...and once the error reverses, the output comes off the rail right away
+  // rather than after unwinding a huge integral.
+  EXPECT_LT(pid.compute(0, 2000), 255);
+}
+
+TEST(PidController, FeedForward) {
+  PidController pid;
+  pid.setTunings(0, 0, 0, PERIOD_US);
+  pid.setFeedForward(50, 40);
+  pid.reset(0, 0, 0);
+  // 40 + 50 per kPa * 2 kPa
+  EXPECT_EQ(pid.compute(2000, 0), 140);
+}
+
+TEST(PidController, BumplessReset) {
+  PidController pid;
+  pid.setTunings(100, 100, 0, PERIOD_US);
+  pid.setFeedForward(20, 0);
+  pid.reset(1000, 1000, 130);
+  EXPECT_EQ(pid.compute(1000, 1000), 130);
+  EXPECT_EQ(pid.integral(), 110);
+}
+
+TEST(PidController, RetuningTakesEffect) {
+  PidController pid;
+  pid.setTunings(100, 0, 0, PERIOD_US);
+  pid.reset(0, 0, 0);
+  EXPECT_EQ(pid.compute(1000, 0), 100);
+  pid.setTunings(50, 0, 0, PERIOD_US);
+  EXPECT_EQ(pid.compute(1000, 0), 50);
+}
+
+TEST(PidController, TransfersTuningsWithoutBump) {
+  PidController pid;
+  pid.setTunings(100, 0, 0, PERIOD_US);
+  pid.reset(1000, 0, 0);
+  EXPECT_EQ(pid.compute(1000, 500), 50);
+
+  // Halving Kp would halve the output; the integrator makes up the rest
+  pid.transferTunings(50, 0, 0, PERIOD_US, 1000);
+  EXPECT_EQ(pid.compute(1000, 500), 50);
+  EXPECT_EQ(pid.integral(), 25);
+  // and from there on the new gain applies
+  EXPECT_EQ(pid.compute(1000, 300), 60);
+
+  // and as far as the output limits allow
+  pid.transferTunings(0, 0, 0, PERIOD_US, 1000);
+  pid.transferTunings(1000, 0, 0, PERIOD_US, 1000);
+  EXPECT_EQ(pid.integral(), 0);
+  EXPECT_EQ(pid.compute(1000, 300), 255);
+}
+
+TEST(PidController, SaturatesExtremeGains) {
+  PidController pid;
+  pid.setTunings(1e9f, -5, 0, PERIOD_US);
+  pid.setOutputLimits(-PID_OUTPUT_LIMIT, PID_OUTPUT_LIMIT);
+  pid.reset(0, 0, 0);
+  EXPECT_EQ(pid.compute(100000, -100000), PID_OUTPUT_LIMIT);
+  EXPECT_EQ(pid.compute(-100000, 100000), -PID_OUTPUT_LIMIT);
+}
@@ -0,0 +1,182 @@
+#include "hal.h"
+#include "scheduler.h"
+#include "gtest/gtest.h"
+
+static int fast_runs;
+static int slow_runs;
+static int ticks_to_block;
+
+// How long each task takes, in us, and the loop timer count within the
+// current tick.
+static uint16_t fast_us;
+static uint16_t slow_us;
+static uint16_t timer_count;
+
+static const uint16_t COUNTS_PER_US = HalApi::LOOP_TIMER_HZ / 1000000;
+
+static void advance_us(uint16_t us) {
+  timer_count += us * COUNTS_PER_US;
+  Hal.test_setLoopTimerCount(timer_count);
+}
+
+// Simulates a task that takes longer than one tick.
+static void fast_task() {
+  fast_runs++;
+  for (; ticks_to_block > 0; ticks_to_block--) {
+    Hal.test_fireLoopTimer();
+    timer_count = 0;
+  }
+  advance_us(fast_us);
+}
+
+static void slow_task() {
+  slow_runs++;
+  advance_us(slow_us);
+}
+
+static const scheduler_task_t tasks[] = {
+    {fast_task, 1},
+    {slow_task, 5},
+};
+
+class SchedulerTest : public testing::Test {
+public:
+  void SetUp() override {
+    fast_runs = 0;
+    slow_runs = 0;
+    ticks_to_block = 0;
+    fast_us = 0;
+    slow_us = 0;
+    timer_count = 0;
+    scheduler_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    Hal.startLoopTimer(SCHEDULER_TICK_HZ, scheduler_tick);
+  }
+
+  void tick() {
+    Hal.test_fireLoopTimer();
+    timer_count = 0;
+    scheduler_run();
+  }
+};
+
+TEST_F(SchedulerTest, NothingRunsWithoutTick) {
+  scheduler_run();
+  scheduler_run();
+  EXPECT_EQ(fast_runs, 0);
+  EXPECT_EQ(slow_runs, 0);
+  EXPECT_EQ(scheduler_getTicks(), 0u);
+}
+
+TEST_F(SchedulerTest, TasksRunAtTheirPeriod) {
+  for (int i = 0; i < 20; i++) {
+    tick();
+  }
+  EXPECT_EQ(fast_runs, 20);
+  EXPECT_EQ(slow_runs, 4);
+  EXPECT_EQ(scheduler_getTicks(), 20u);
+  EXPECT_EQ(scheduler_getOverruns(0), 0);
+  EXPECT_EQ(scheduler_getMissedTicks(), 0);
+}
+
+TEST_F(SchedulerTest, RunningTwiceInOneTickDoesNothing) {
+  tick();
+  scheduler_run();
+  EXPECT_EQ(fast_runs, 1);
+}
+
+TEST_F(SchedulerTest, MissedTicks) {
+  Hal.test_fireLoopTimer();
+  Hal.test_fireLoopTimer();
+  Hal.test_fireLoopTimer();
+  scheduler_run();
+  EXPECT_EQ(fast_runs, 1);
+  EXPECT_EQ(scheduler_getMissedTicks(), 2);
+  EXPECT_EQ(scheduler_getTicks(), 3u);
+}
+
+TEST_F(SchedulerTest, OverrunDefersLowerPriorityTasks) {
+  for (int i = 0; i < 4; i++) {
+    tick();
+  }
+  // The slow task is due on this tick, but the fast task overruns.
+  ticks_to_block = 1;
+  tick();
+  EXPECT_EQ(scheduler_getOverruns(0), 1);
+  EXPECT_EQ(slow_runs, 0);
+
+  // The deferred task runs on the next pass, after the fast task.
+  scheduler_run();
+  EXPECT_EQ(fast_runs, 6);
+  EXPECT_EQ(slow_runs, 1);
+  EXPECT_EQ(scheduler_getMissedTicks(), 0);
+}
+
+TEST_F(SchedulerTest, UnknownTaskHasNoOverruns) {
+  EXPECT_EQ(scheduler_getOverruns(SCHEDULER_MAX_TASKS), 0);
+}
+
+TEST_F(SchedulerTest, TaskTiming) {
+  scheduler_taskStats_t stats;
+  scheduler_getTaskStats(0, &stats);
+  EXPECT_EQ(stats.runs, 0);
+
+  fast_us = 100;
+  slow_us = 300;
+  for (int i = 0; i < 10; i++) {
+    tick();
+  }
+  fast_us = 200;
+  for (int i = 0; i < 10; i++) {
+    tick();
+  }
+
+  scheduler_getTaskStats(0, &stats);
+  EXPECT_EQ(stats.runs, 20);
+  EXPECT_EQ(stats.min_us, 100);
+  EXPECT_EQ(stats.max_us, 200);
+  EXPECT_EQ(stats.mean_us, 150);
+
+  scheduler_getTaskStats(1, &stats);
+  EXPECT_EQ(stats.runs, 4);
+  EXPECT_EQ(stats.min_us, 300);
+  EXPECT_EQ(stats.max_us, 300);
+
+  // 20 * 150 + 4 * 300 us in 20 ms.
+  EXPECT_EQ(scheduler_getLoad(), 210);
+
+  scheduler_resetStats();
+  scheduler_getTaskStats(0, &stats);
+  EXPECT_EQ(stats.runs, 0);
+  EXPECT_EQ(scheduler_getLoad(), 0);
+}
+
+TEST_F(SchedulerTest, OverrunIsTimedAcrossTicks) {
+  tick();
+  ticks_to_block = 2;
+  fast_us = 50;
+  tick();
+
+  scheduler_taskStats_t stats;
+  scheduler_getTaskStats(0, &stats);
+  EXPECT_EQ(stats.max_us, 2 * 1000000 / SCHEDULER_TICK_HZ + 50);
+}
+
+TEST_F(SchedulerTest, PeriodHistogram) {
+  for (int i = 0; i < 10; i++) {
+    tick();
+  }
+  // The first run has no period.
+  EXPECT_EQ(scheduler_getPeriodCount(1), 9);
+
+  // A tick during which the fast task couldn't run: a 2 ms period.
+  Hal.test_fireLoopTimer();
+  tick();
+  EXPECT_EQ(scheduler_getPeriodCount(6), 1);
+
+  uint32_t total = 0;
+  for (uint8_t bin = 0; bin < SCHEDULER_PERIOD_BINS; bin++) {
+    total += scheduler_getPeriodCount(bin);
+  }
+  EXPECT_EQ(total, 10u);
+  EXPECT_EQ(scheduler_getPeriodCount(SCHEDULER_PERIOD_BINS), 0);
+}
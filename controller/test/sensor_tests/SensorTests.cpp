@@ -23,6 +23,7 @@ limitations under the License.
 
 #include "SensorTests.h"
 #include "ArduinoSim.h"
+#include "hal.h"
 #include "sensors.h"
 #include "gtest/gtest.h"
 
@@ -162,3 +163,106 @@ TEST(SensorTests, DISABLED_FullScaleReading) {
         << "Patient Sensor at index" << index;
   }
 }
+
+TEST(SensorTests, ReadsBackgroundSamples) {
+  const float countsToKPa = 5.0f / 1024.0f;
+
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 205);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512);
+  Hal.test_setAnalogPin(PressureSensors::EXHALATION_PIN, 512);
+  set_sensor_avg_samples(2);
+  sensors_init();
+
+  // Readings before any background sample arrives are at the zero point.
+  EXPECT_EQ(get_raw_sensor_reading(PressureSensors::PATIENT_PIN), 205);
+  EXPECT_NEAR(get_pressure_reading(PressureSensors::PATIENT_PIN), 0,
+              COMPARISON_TOLERANCE);
+
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 305);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 412);
+  Hal.test_sampleAnalogPins();
+  EXPECT_EQ(get_raw_sensor_reading(PressureSensors::PATIENT_PIN), 305);
+  // Half of the averaging window has the new value.
+  EXPECT_NEAR(get_pressure_reading(PressureSensors::PATIENT_PIN),
+              50 * countsToKPa, COMPARISON_TOLERANCE);
+
+  Hal.test_sampleAnalogPins();
+  EXPECT_NEAR(get_pressure_reading(PressureSensors::PATIENT_PIN),
+              100 * countsToKPa, COMPARISON_TOLERANCE);
+  EXPECT_NEAR(get_pressure_reading(PressureSensors::INHALATION_PIN),
+              -100 * countsToKPa, COMPARISON_TOLERANCE);
+  EXPECT_NEAR(get_pressure_reading(PressureSensors::EXHALATION_PIN), 0,
+              COMPARISON_TOLERANCE);
+}
+
+TEST(SensorTests, CalibrationTables) {
+  // 5V / 1024 counts at 1 V/kPa is 4.8828125 Pa per count.
+  EXPECT_EQ(MPXV5004GP_CALIBRATION.pa_per_count_q16, 320000);
+  EXPECT_EQ(MPXV7002DP_CALIBRATION.pa_per_count_q16, 320000);
+  EXPECT_EQ(MPXV5004GP_CALIBRATION.min_pa, 0);
+  EXPECT_EQ(MPXV5004GP_CALIBRATION.max_pa, 3920);
+  EXPECT_EQ(MPXV7002DP_CALIBRATION.min_pa, -2000);
+  EXPECT_EQ(MPXV7002DP_CALIBRATION.max_pa, 2000);
+
+  EXPECT_EQ(&get_sensor_calibration(PressureSensors::PATIENT_PIN),
+            &MPXV5004GP_CALIBRATION);
+  EXPECT_EQ(&get_sensor_calibration(PressureSensors::INHALATION_PIN),
+            &MPXV7002DP_CALIBRATION);
+}
+
+TEST(SensorTests, FixedPointMatchesFloat) {
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 205);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512);
+  Hal.test_setAnalogPin(PressureSensors::EXHALATION_PIN, 512);
+  set_sensor_avg_samples(1);
+  sensors_init();
+
+  for (int counts = -200; counts <= 500; counts += 7) {
+    Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 205 + counts / 2 + 200);
+    Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512 + counts);
+    Hal.test_sampleAnalogPins();
+
+    float expected = counts * 5.0f / 1024.0f * 1000.0f;
+    EXPECT_NEAR(get_pressure_reading_pa(PressureSensors::INHALATION_PIN),
+                expected, 0.5f)
+        << "counts " << counts;
+    EXPECT_NEAR(get_pressure_reading(PressureSensors::INHALATION_PIN),
+                expected / 1000.0f, 0.00051f)
+        << "counts " << counts;
+  }
+}
+
+TEST(SensorTests, FilterSelection) {
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 205);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512);
+  Hal.test_setAnalogPin(PressureSensors::EXHALATION_PIN, 512);
+  set_sensor_avg_samples(4);
+  sensors_init();
+
+  set_sensor_filter(PressureSensors::PATIENT_PIN, SensorFilter::none);
+  set_sensor_filter(PressureSensors::INHALATION_PIN, SensorFilter::boxcar);
+  set_sensor_filter(PressureSensors::EXHALATION_PIN, SensorFilter::iir);
+  EXPECT_EQ(get_sensor_filter(PressureSensors::EXHALATION_PIN),
+            SensorFilter::iir);
+
+  // Step every sensor up by 64 counts (312.5 Pa) for one sample.
+  Hal.test_setAnalogPin(PressureSensors::PATIENT_PIN, 205 + 64);
+  Hal.test_setAnalogPin(PressureSensors::INHALATION_PIN, 512 + 64);
+  Hal.test_setAnalogPin(PressureSensors::EXHALATION_PIN, 512 + 64);
+  Hal.test_sampleAnalogPins();
+
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::PATIENT_PIN), 313);
+  // A quarter of the boxcar window has the new value.
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::INHALATION_PIN), 78);
+  // The IIR has moved 1/16 of the way.
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::EXHALATION_PIN), 20);
+
+  for (int i = 0; i < 200; i++) {
+    Hal.test_sampleAnalogPins();
+  }
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::INHALATION_PIN), 313);
+  EXPECT_EQ(get_pressure_reading_pa(PressureSensors::EXHALATION_PIN), 313);
+
+  set_sensor_filter(PressureSensors::PATIENT_PIN, SensorFilter::boxcar);
+  set_sensor_filter(PressureSensors::EXHALATION_PIN, SensorFilter::boxcar);
+}
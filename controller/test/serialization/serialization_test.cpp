@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+#include "serialization.h"
+#include "gtest/gtest.h"
+
+TEST(Serialization, Sizes) {
+  EXPECT_EQ(wire_size<>(), 0);
+  EXPECT_EQ(wire_size<uint8_t>(), 1);
+  EXPECT_EQ((wire_size<uint32_t, float, int16_t, int8_t>()), 11);
+
+  // Usable for array sizes.
+  char buf[wire_size<uint32_t, uint16_t>()];
+  EXPECT_EQ(sizeof(buf), 6u);
+}
+
+TEST(Serialization, BigEndian) {
+  char buf[4];
+  wire_put(buf, uint32_t{0x01020304});
+  EXPECT_EQ(buf[0], 0x01);
+  EXPECT_EQ(buf[1], 0x02);
+  EXPECT_EQ(buf[2], 0x03);
+  EXPECT_EQ(buf[3], 0x04);
+
+  wire_put(buf, int16_t{-2});
+  EXPECT_EQ(static_cast<uint8_t>(buf[0]), 0xff);
+  EXPECT_EQ(static_cast<uint8_t>(buf[1]), 0xfe);
+
+  // IEEE 754 single precision 1.0.
+  wire_put(buf, 1.0f);
+  EXPECT_EQ(static_cast<uint8_t>(buf[0]), 0x3f);
+  EXPECT_EQ(static_cast<uint8_t>(buf[1]), 0x80);
+  EXPECT_EQ(buf[2], 0);
+  EXPECT_EQ(buf[3], 0);
+}
+
+TEST(Serialization, RoundTrip) {
+  char buf[4];
+  for (int32_t v : {0, 1, -1, 12345678, INT32_MAX, INT32_MIN}) {
+    wire_put(buf, v);
+    EXPECT_EQ(wire_getInt32(buf), v);
+    wire_put(buf, static_cast<uint32_t>(v));
+    EXPECT_EQ(wire_getUint32(buf), static_cast<uint32_t>(v));
+  }
+  for (int16_t v : {0, 1, -1, INT16_MAX, INT16_MIN}) {
+    wire_put(buf, v);
+    EXPECT_EQ(wire_getInt16(buf), v);
+  }
+  for (float v : {0.0f, -0.5f, 3.14159f, 1e30f, -1e-30f}) {
+    wire_put(buf, v);
+    EXPECT_EQ(wire_getFloat(buf), v);
+  }
+  wire_put(buf, int8_t{-100});
+  EXPECT_EQ(wire_getInt8(buf), -100);
+}
+
+TEST(Serialization, ReaderWriter) {
+  char buf[wire_size<uint32_t, float, int16_t>()];
+  WireWriter out(buf, sizeof(buf));
+  out.put(uint32_t{42});
+  out.put(-2.5f);
+  out.put(int16_t{-7});
+  EXPECT_TRUE(out.ok());
+  EXPECT_EQ(out.length(), sizeof(buf));
+
+  // Doesn't fit.
+  out.put(uint8_t{1});
+  EXPECT_FALSE(out.ok());
+  EXPECT_EQ(out.length(), sizeof(buf));
+
+  WireReader in(buf, sizeof(buf));
+  EXPECT_EQ(in.getUint32(), 42u);
+  EXPECT_EQ(in.getFloat(), -2.5f);
+  EXPECT_EQ(in.getInt16(), -7);
+  EXPECT_TRUE(in.ok());
+  EXPECT_EQ(in.remaining(), 0);
+
+  // Past the end.
+  EXPECT_EQ(in.getUint8(), 0);
+  EXPECT_FALSE(in.ok());
+
+  WireReader short_in(buf, 3);
+  EXPECT_EQ(short_in.getUint32(), 0u);
+  EXPECT_FALSE(short_in.ok());
+}
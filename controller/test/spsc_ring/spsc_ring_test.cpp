@@ -0,0 +1,211 @@
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+#include "gtest/gtest.h"
+
+static_assert(sizeof(SpscRing<char, 128>::Index) == 1,
+              "Up to 128 items fit byte indices");
+static_assert(sizeof(SpscRing<char, 256>::Index) == 2,
+              "256 items don't: a full ring would look empty");
+static_assert(sizeof(SpscRing<char, 32768>::Index) == 2, "");
+static_assert(sizeof(SpscRing<char, 65536>::Index) == 4, "");
+
+TEST(SpscRing, PushesAndPopsInOrder) {
+  SpscRing<int, 4> ring;
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.space(), 4);
+
+  EXPECT_TRUE(ring.push(1));
+  EXPECT_TRUE(ring.push(2));
+  EXPECT_EQ(ring.size(), 2);
+  EXPECT_EQ(ring.space(), 2);
+
+  int value = 0;
+  EXPECT_TRUE(ring.pop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(ring.pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(ring.pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST(SpscRing, DropsWhenFull) {
+  SpscRing<int, 4> ring;
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(ring.push(i));
+  }
+  EXPECT_FALSE(ring.push(4));
+  EXPECT_EQ(ring.size(), 4);
+  EXPECT_EQ(ring.space(), 0);
+
+  int value;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.pop(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(ring.pop(&value));
+}
+
+// The byte indices wrap many times over, including with the ring full across
+// the wrap.
+TEST(SpscRing, IndicesWrap) {
+  SpscRing<uint16_t, 128> ring;
+  uint16_t pushed = 0;
+  uint16_t popped = 0;
+  for (int round = 0; round < 20; round++) {
+    while (ring.push(pushed)) {
+      pushed++;
+    }
+    EXPECT_EQ(ring.size(), 128);
+    // Leave some behind, so that the next round starts elsewhere.
+    for (int i = 0; i < 128 - round; i++) {
+      uint16_t value;
+      ASSERT_TRUE(ring.pop(&value));
+      EXPECT_EQ(value, popped++);
+    }
+  }
+  EXPECT_EQ(ring.size(), pushed - popped);
+}
+
+TEST(SpscRing, PeeksContiguousItems) {
+  SpscRing<char, 8> ring;
+  for (char c : {'a', 'b', 'c', 'd', 'e', 'f'}) {
+    ring.push(c);
+  }
+  ring.consume(4);
+  for (char c : {'g', 'h', 'i', 'j'}) {
+    ring.push(c);
+  }
+
+  // e f g h at the end of the buffer, then i j from its start
+  const char *items;
+  ASSERT_EQ(ring.peek(&items), 4);
+  EXPECT_EQ(std::string(items, 4), "efgh");
+  ring.consume(1);
+  ASSERT_EQ(ring.peek(&items), 3);
+  EXPECT_EQ(std::string(items, 3), "fgh");
+  ring.consume(3);
+  ASSERT_EQ(ring.peek(&items), 2);
+  EXPECT_EQ(std::string(items, 2), "ij");
+  ring.consume(2);
+  EXPECT_EQ(ring.peek(&items), 0);
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST(SpscRing, PublishesPendingItemsTogether) {
+  SpscRing<char, 8> ring;
+  ring.push('x');
+  char c;
+  ring.pop(&c);
+
+  // Written out of order, and across the end of the buffer
+  for (uint8_t i = 0; i < 8; i++) {
+    ring.pending(static_cast<uint8_t>(7 - i)) = static_cast<char>('0' + 7 - i);
+  }
+  EXPECT_TRUE(ring.empty());
+  EXPECT_FALSE(ring.pop(&c));
+
+  ring.publish(5);
+  EXPECT_EQ(ring.size(), 5);
+  ring.publish(3);
+  std::string out;
+  while (ring.pop(&c)) {
+    out += c;
+  }
+  EXPECT_EQ(out, "01234567");
+}
+
+TEST(SpscRing, Clears) {
+  SpscRing<int, 4> ring;
+  ring.push(1);
+  ring.push(2);
+  ring.clear();
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.space(), 4);
+  int value;
+  EXPECT_FALSE(ring.pop(&value));
+}
+
+// A producer and a consumer on two threads, with a ring small enough that
+// each keeps catching up with the other.  Every value arrives once, in
+// order.  Each side yields while it waits, in case there's only one core.
+TEST(SpscRing, HandsOverBetweenThreads) {
+  static const uint32_t COUNT = 200000;
+  SpscRing<uint32_t, 16> ring;
+
+  std::thread producer([&ring] {
+    for (uint32_t i = 0; i < COUNT;) {
+      if (ring.push(i)) {
+        i++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0;
+  bool in_order = true;
+  while (expected < COUNT) {
+    uint32_t value;
+    if (ring.pop(&value)) {
+      in_order = in_order && value == expected;
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  EXPECT_TRUE(in_order);
+  EXPECT_TRUE(ring.empty());
+}
+
+// The same with bulk transfers, as the serial driver makes them.
+TEST(SpscRing, HandsOverBlocksBetweenThreads) {
+  static const uint32_t COUNT = 200000;
+  SpscRing<uint8_t, 64> ring;
+
+  std::thread producer([&ring] {
+    uint32_t i = 0;
+    while (i < COUNT) {
+      uint8_t n = ring.space();
+      if (n > 7) {
+        n = 7;
+      }
+      if (n > COUNT - i) {
+        n = static_cast<uint8_t>(COUNT - i);
+      }
+      for (uint8_t j = 0; j < n; j++) {
+        ring.pending(j) = static_cast<uint8_t>(i + j);
+      }
+      ring.publish(n);
+      i += n;
+      if (n == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t received = 0;
+  bool in_order = true;
+  while (received < COUNT) {
+    const uint8_t *items;
+    uint8_t n = ring.peek(&items);
+    for (uint8_t j = 0; j < n; j++) {
+      in_order = in_order && items[j] == static_cast<uint8_t>(received + j);
+    }
+    ring.consume(n);
+    received += n;
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(received, COUNT);
+}
@@ -0,0 +1,52 @@
+#include "subscription.h"
+#include "gtest/gtest.h"
+
+static uint8_t bit(telemetryChannel channel) {
+  return static_cast<uint8_t>(1 << static_cast<uint8_t>(channel));
+}
+
+TEST(Subscription, StartsWithNothing) {
+  subscription_init();
+  EXPECT_FALSE(subscription_active());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(subscription_tick(), 0);
+  }
+}
+
+TEST(Subscription, SendsEachChannelAtItsRate) {
+  subscription_init();
+  uint8_t dividers[TELEMETRY_CHANNELS] = {};
+  dividers[static_cast<uint8_t>(telemetryChannel::pressure)] = 1;
+  dividers[static_cast<uint8_t>(telemetryChannel::flow)] = 4;
+  dividers[static_cast<uint8_t>(telemetryChannel::setpoint)] = 10;
+  subscription_set(dividers);
+  EXPECT_TRUE(subscription_active());
+  EXPECT_EQ(subscription_getDivider(telemetryChannel::flow), 4);
+  EXPECT_EQ(subscription_getDivider(telemetryChannel::volume), 0);
+
+  int pressure = 0, flow = 0, setpoint = 0;
+  for (int i = 0; i < 100; i++) {
+    uint8_t due = subscription_tick();
+    EXPECT_EQ(due & ~(bit(telemetryChannel::pressure) |
+                      bit(telemetryChannel::flow) |
+                      bit(telemetryChannel::setpoint)),
+              0);
+    // Every channel is due at the first sample
+    if (i == 0) {
+      EXPECT_EQ(due, bit(telemetryChannel::pressure) |
+                         bit(telemetryChannel::flow) |
+                         bit(telemetryChannel::setpoint));
+    }
+    pressure += (due & bit(telemetryChannel::pressure)) != 0;
+    flow += (due & bit(telemetryChannel::flow)) != 0;
+    setpoint += (due & bit(telemetryChannel::setpoint)) != 0;
+  }
+  EXPECT_EQ(pressure, 100);
+  EXPECT_EQ(flow, 25);
+  EXPECT_EQ(setpoint, 10);
+
+  uint8_t none[TELEMETRY_CHANNELS] = {};
+  subscription_set(none);
+  EXPECT_FALSE(subscription_active());
+  EXPECT_EQ(subscription_tick(), 0);
+}
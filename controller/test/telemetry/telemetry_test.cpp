@@ -0,0 +1,260 @@
+#include "telemetry.h"
+#include "gtest/gtest.h"
+
+static uint32_t get_uint32(const char *p) {
+  return (uint32_t{static_cast<uint8_t>(p[0])} << 24) |
+         (uint32_t{static_cast<uint8_t>(p[1])} << 16) |
+         (uint32_t{static_cast<uint8_t>(p[2])} << 8) |
+         uint32_t{static_cast<uint8_t>(p[3])};
+}
+
+static int16_t get_int16(const char *p) {
+  return static_cast<int16_t>((static_cast<uint8_t>(p[0]) << 8) |
+                              static_cast<uint8_t>(p[1]));
+}
+
+TEST(TelemetryBatch, Layout) {
+  TelemetryBatch batch;
+  EXPECT_FALSE(batch.add(100000, 1500, -20, 300));
+  EXPECT_FALSE(batch.add(100010, 1510, -10, -300));
+  EXPECT_EQ(batch.samples(), 2);
+  EXPECT_EQ(batch.length(),
+            TELEMETRY_BATCH_HEADER_LEN + 2 * TELEMETRY_SAMPLE_LEN);
+
+  const char *p = batch.data();
+  EXPECT_EQ(get_uint32(p), 100000u);
+  EXPECT_EQ(p[4], 2);
+
+  p += TELEMETRY_BATCH_HEADER_LEN;
+  EXPECT_EQ(p[0], 0);
+  EXPECT_EQ(get_int16(p + 1), 1500);
+  EXPECT_EQ(get_int16(p + 3), -20);
+  EXPECT_EQ(get_int16(p + 5), 300);
+
+  p += TELEMETRY_SAMPLE_LEN;
+  EXPECT_EQ(p[0], 10);
+  EXPECT_EQ(get_int16(p + 1), 1510);
+  EXPECT_EQ(get_int16(p + 3), -10);
+  EXPECT_EQ(get_int16(p + 5), -300);
+}
+
+TEST(TelemetryBatch, Saturation) {
+  TelemetryBatch batch;
+  batch.add(0, 100000, -100000, 0);
+  batch.add(1000, 0, 0, 0);
+
+  const char *p = batch.data() + TELEMETRY_BATCH_HEADER_LEN;
+  EXPECT_EQ(get_int16(p + 1), INT16_MAX);
+  EXPECT_EQ(get_int16(p + 3), INT16_MIN);
+  EXPECT_EQ(static_cast<uint8_t>(p[TELEMETRY_SAMPLE_LEN]), 255);
+}
+
+TEST(TelemetryBatch, FillAndReset) {
+  TelemetryBatch batch;
+  for (uint8_t i = 0; i < TELEMETRY_BATCH_SAMPLES - 1; i++) {
+    EXPECT_FALSE(batch.add(i * 10, i, 0, 0));
+  }
+  EXPECT_TRUE(batch.add(1000, 0, 0, 0));
+  EXPECT_TRUE(batch.full());
+  EXPECT_EQ(batch.length(), TELEMETRY_BATCH_LEN_MAX);
+
+  // Further samples are ignored until the batch is reset.
+  EXPECT_TRUE(batch.add(2000, 0, 0, 0));
+  EXPECT_EQ(batch.length(), TELEMETRY_BATCH_LEN_MAX);
+
+  batch.reset();
+  EXPECT_EQ(batch.samples(), 0);
+  batch.add(5000, 7, 8, 9);
+  EXPECT_EQ(get_uint32(batch.data()), 5000u);
+  EXPECT_EQ(batch.data()[TELEMETRY_BATCH_HEADER_LEN], 0);
+}
+
+TEST(TelemetryCodec, Zigzag) {
+  EXPECT_EQ(zigzag_encode(0), 0u);
+  EXPECT_EQ(zigzag_encode(-1), 1u);
+  EXPECT_EQ(zigzag_encode(1), 2u);
+  EXPECT_EQ(zigzag_encode(-2), 3u);
+  EXPECT_EQ(zigzag_encode(INT32_MAX), 0xfffffffeu);
+  EXPECT_EQ(zigzag_encode(INT32_MIN), 0xffffffffu);
+  for (int32_t v : {0, 1, -1, 63, -64, 1000, -1000, INT32_MAX, INT32_MIN}) {
+    EXPECT_EQ(zigzag_decode(zigzag_encode(v)), v);
+  }
+}
+
+TEST(TelemetryCodec, Varint) {
+  char buf[VARINT_LEN_MAX];
+  uint32_t value;
+  EXPECT_EQ(varint_put(0, buf), 1);
+  EXPECT_EQ(varint_put(127, buf), 1);
+  EXPECT_EQ(varint_put(128, buf), 2);
+  EXPECT_EQ(varint_put(UINT32_MAX, buf), VARINT_LEN_MAX);
+  EXPECT_EQ(varint_get(buf, sizeof(buf), &value), VARINT_LEN_MAX);
+  EXPECT_EQ(value, UINT32_MAX);
+
+  // Truncated.
+  EXPECT_EQ(varint_put(300, buf), 2);
+  EXPECT_EQ(varint_get(buf, 1, &value), 0);
+}
+
+TEST(TelemetryCodec, BatchRoundTrip) {
+  TelemetryBatch batch;
+  for (uint8_t i = 0; i < TELEMETRY_BATCH_SAMPLES; i++) {
+    batch.add(1000 + 10 * i, 1500 + i, -i, 3 * i);
+  }
+
+  TelemetrySample samples[TELEMETRY_BATCH_SAMPLES];
+  ASSERT_EQ(telemetry_decodeBatch(batch.data(), batch.length(), samples,
+                                  TELEMETRY_BATCH_SAMPLES),
+            TELEMETRY_BATCH_SAMPLES);
+  for (uint8_t i = 0; i < TELEMETRY_BATCH_SAMPLES; i++) {
+    EXPECT_EQ(samples[i].time_ms, 1000u + 10 * i);
+    EXPECT_EQ(samples[i].pressure_pa, 1500 + i);
+    EXPECT_EQ(samples[i].volume_ml, -i);
+    EXPECT_EQ(samples[i].flow_ml_s, 3 * i);
+  }
+
+  // Truncated payload.
+  EXPECT_EQ(telemetry_decodeBatch(batch.data(), batch.length() - 1, samples,
+                                  TELEMETRY_BATCH_SAMPLES),
+            -1);
+}
+
+TEST(TelemetryCodec, CompressedRoundTrip) {
+  CompressedTelemetryBatch batch;
+  int32_t pressure = 1500;
+  uint32_t time = 123456;
+  uint8_t added = 0;
+  do {
+    pressure += (added % 5) - 2;
+    time += 10;
+    added++;
+  } while (!batch.add(time, pressure, added, -added));
+  EXPECT_EQ(added, TELEMETRY_COMPRESSED_SAMPLES);
+
+  // Small differences take a byte per channel, plus a byte of time.
+  EXPECT_EQ(batch.length(), TELEMETRY_COMPRESSED_HEADER_LEN + 2 + 3 +
+                                (TELEMETRY_COMPRESSED_SAMPLES - 1) * 4);
+
+  TelemetrySample samples[TELEMETRY_COMPRESSED_SAMPLES];
+  ASSERT_EQ(telemetry_decodeCompressed(batch.data(), batch.length(), samples,
+                                       TELEMETRY_COMPRESSED_SAMPLES),
+            TELEMETRY_COMPRESSED_SAMPLES);
+  pressure = 1500;
+  time = 123456;
+  for (uint8_t i = 0; i < TELEMETRY_COMPRESSED_SAMPLES; i++) {
+    pressure += (i % 5) - 2;
+    time += 10;
+    EXPECT_EQ(samples[i].time_ms, time);
+    EXPECT_EQ(samples[i].pressure_pa, pressure);
+    EXPECT_EQ(samples[i].volume_ml, i + 1);
+    EXPECT_EQ(samples[i].flow_ml_s, -(i + 1));
+  }
+
+  EXPECT_EQ(telemetry_decodeCompressed(batch.data(), batch.length() - 1,
+                                       samples, TELEMETRY_COMPRESSED_SAMPLES),
+            -1);
+}
+
+TEST(TelemetryCodec, CompressedExtremes) {
+  // Large jumps take the longest varints, and end the batch early.
+  CompressedTelemetryBatch batch;
+  int32_t values[] = {INT32_MAX, INT32_MIN, 0, INT32_MIN, INT32_MAX};
+  uint8_t added = 0;
+  while (!batch.add(added * 1000, values[added % 5], -values[added % 5], 0)) {
+    added++;
+  }
+  EXPECT_EQ(batch.samples(), added);
+  EXPECT_LT(batch.samples(), TELEMETRY_COMPRESSED_SAMPLES);
+  EXPECT_LE(batch.length(), TELEMETRY_COMPRESSED_LEN_MAX);
+
+  TelemetrySample samples[TELEMETRY_COMPRESSED_SAMPLES];
+  ASSERT_EQ(telemetry_decodeCompressed(batch.data(), batch.length(), samples,
+                                       TELEMETRY_COMPRESSED_SAMPLES),
+            added);
+  for (uint8_t i = 0; i < added; i++) {
+    EXPECT_EQ(samples[i].time_ms, i * 1000u);
+    EXPECT_EQ(samples[i].pressure_pa, values[i % 5]);
+    EXPECT_EQ(samples[i].volume_ml,
+              static_cast<int32_t>(0u - static_cast<uint32_t>(values[i % 5])));
+  }
+
+  // The sample which didn't fit starts the next batch, as a keyframe.
+  batch.reset();
+  EXPECT_EQ(batch.samples(), 1);
+  ASSERT_EQ(telemetry_decodeCompressed(batch.data(), batch.length(), samples,
+                                       TELEMETRY_COMPRESSED_SAMPLES),
+            1);
+  EXPECT_EQ(samples[0].time_ms, added * 1000u);
+  EXPECT_EQ(samples[0].pressure_pa, values[added % 5]);
+}
+
+TEST(ChannelBatch, Layout) {
+  int32_t values[TELEMETRY_CHANNELS] = {1500, -20, 300, 512, 100000, 1400};
+  ChannelBatch batch;
+  EXPECT_TRUE(batch.add(100000, 0x05, values));
+  EXPECT_TRUE(batch.add(100030, 0x30, values));
+  EXPECT_EQ(batch.records(), 2);
+  EXPECT_EQ(batch.firstTime(), 100000u);
+  EXPECT_EQ(batch.length(), TELEMETRY_CHANNELS_HEADER_LEN + 2 * (2 + 4));
+
+  const char *p = batch.data();
+  EXPECT_EQ(get_uint32(p), 100000u);
+  EXPECT_EQ(p[4], 2);
+
+  p += TELEMETRY_CHANNELS_HEADER_LEN;
+  EXPECT_EQ(p[0], 0);
+  EXPECT_EQ(p[1], 0x05);
+  EXPECT_EQ(get_int16(p + 2), 1500);
+  EXPECT_EQ(get_int16(p + 4), 300);
+
+  p += 6;
+  EXPECT_EQ(p[0], 30);
+  EXPECT_EQ(p[1], 0x30);
+  EXPECT_EQ(get_int16(p + 2), INT16_MAX); // Saturated
+  EXPECT_EQ(get_int16(p + 4), 1400);
+}
+
+TEST(ChannelBatch, RefusesWhatDoesNotFit) {
+  int32_t values[TELEMETRY_CHANNELS] = {};
+  ChannelBatch batch;
+  uint32_t time = 0;
+  while (batch.add(time, 0x3f, values)) {
+    time += 10;
+  }
+  uint8_t length = batch.length();
+  EXPECT_LE(length, TELEMETRY_CHANNELS_LEN_MAX);
+  EXPECT_GT(length + 2 + 2 * TELEMETRY_CHANNELS, TELEMETRY_CHANNELS_LEN_MAX);
+
+  batch.reset();
+  EXPECT_TRUE(batch.add(time, 0x01, values));
+  // Too long after the previous record for DT
+  EXPECT_FALSE(batch.add(time + 256, 0x01, values));
+  EXPECT_EQ(batch.records(), 1);
+  EXPECT_TRUE(batch.add(time + 255, 0x01, values));
+}
+
+TEST(TelemetryCodec, ChannelsRoundTrip) {
+  int32_t values[TELEMETRY_CHANNELS] = {-5, 6, -7, 8, -9, 10};
+  ChannelBatch batch;
+  ASSERT_TRUE(batch.add(5000, 0x3f, values));
+  values[2] = 70;
+  ASSERT_TRUE(batch.add(5010, 0x04, values));
+  ASSERT_TRUE(batch.add(5010, 0x00, values));
+
+  ChannelRecord out[4];
+  ASSERT_EQ(telemetry_decodeChannels(batch.data(), batch.length(), out, 4), 3);
+  EXPECT_EQ(out[0].time_ms, 5000u);
+  EXPECT_EQ(out[0].mask, 0x3f);
+  for (uint8_t c = 0; c < TELEMETRY_CHANNELS; c++) {
+    EXPECT_EQ(out[0].values[c], c == 2 ? -7 : values[c]);
+  }
+  EXPECT_EQ(out[1].time_ms, 5010u);
+  EXPECT_EQ(out[1].mask, 0x04);
+  EXPECT_EQ(out[1].values[2], 70);
+  EXPECT_EQ(out[2].mask, 0x00);
+
+  EXPECT_EQ(telemetry_decodeChannels(batch.data(), batch.length(), out, 2),
+            -1);
+  EXPECT_EQ(telemetry_decodeChannels(batch.data(), batch.length() - 1, out, 4),
+            -1);
+}
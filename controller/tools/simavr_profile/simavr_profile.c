@@ -0,0 +1,302 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+ * Runs the controller firmware under simavr and counts the AVR cycles spent
+ * in each scheduler task.  See README.md.
+ *
+ * The firmware, built with PROFILE_MODE, writes a task's index to GPIOR0 when
+ * the task starts and HAL_PROFILE_IDLE (0xff) when it returns; see
+ * hal_profileMark().  Interrupts taken while a task runs count towards it,
+ * as they do on the real thing.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/avr_adc.h>
+#include <simavr/avr_uart.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+
+#define CPU_HZ 16000000UL
+// GPIOR0 on the ATmega328P, as a data space address.
+#define GPIOR0_ADDR 0x3e
+#define PROFILE_IDLE 0xff
+#define MAX_SECTIONS 16
+#define MAX_EVENTS 4096
+#define DEFAULT_BAUD 115200
+
+struct section {
+  const char *name;
+  uint64_t calls;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+};
+
+enum event_type { EVENT_UART, EVENT_ADC };
+
+// One line of the script.
+struct event {
+  uint64_t cycle;
+  enum event_type type;
+  uint8_t pin;        /* EVENT_ADC */
+  uint32_t millivolts; /* EVENT_ADC */
+  uint8_t len;         /* EVENT_UART */
+  uint8_t bytes[64];   /* EVENT_UART */
+};
+
+static struct section sections[MAX_SECTIONS];
+static int current = -1;
+static uint64_t section_start;
+
+static struct event events[MAX_EVENTS];
+static int event_count;
+
+static uint64_t uart_tx_bytes;
+
+static void on_profile_mark(avr_t *avr, avr_io_addr_t addr, uint8_t v,
+                            void *param) {
+  (void)param;
+  avr->data[addr] = v;
+
+  if (current >= 0) {
+    struct section *s = &sections[current];
+    uint64_t cycles = avr->cycle - section_start;
+    s->calls++;
+    s->total += cycles;
+    if (s->calls == 1 || cycles < s->min) {
+      s->min = cycles;
+    }
+    if (cycles > s->max) {
+      s->max = cycles;
+    }
+  }
+  current = v < MAX_SECTIONS ? v : -1;
+  section_start = avr->cycle;
+}
+
+static void on_uart_output(struct avr_irq_t *irq, uint32_t value,
+                           void *param) {
+  (void)irq;
+  (void)value;
+  (void)param;
+  uart_tx_bytes++;
+}
+
+static uint64_t ms_to_cycles(double ms) {
+  return (uint64_t)(ms * (CPU_HZ / 1000));
+}
+
+// Script lines are
+//
+//   <time in ms> uart <hex byte> ...
+//   <time in ms> adc <pin> <millivolts>
+//
+// in time order.  Blank lines and lines starting with # are ignored.
+static void read_script(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+
+  char line[512];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0') {
+      continue;
+    }
+    if (event_count == MAX_EVENTS) {
+      fprintf(stderr, "%s: too many events\n", path);
+      exit(1);
+    }
+
+    struct event *e = &events[event_count];
+    double ms;
+    char type[8];
+    int n;
+    if (sscanf(p, "%lf %7s%n", &ms, type, &n) != 2) {
+      fprintf(stderr, "%s:%d: malformed line\n", path, line_number);
+      exit(1);
+    }
+    e->cycle = ms_to_cycles(ms);
+    p += n;
+
+    if (strcmp(type, "uart") == 0) {
+      e->type = EVENT_UART;
+      e->len = 0;
+      unsigned byte;
+      while (e->len < sizeof(e->bytes) && sscanf(p, "%x%n", &byte, &n) == 1) {
+        e->bytes[e->len++] = (uint8_t)byte;
+        p += n;
+      }
+    } else if (strcmp(type, "adc") == 0) {
+      unsigned pin, mv;
+      if (sscanf(p, "%u %u", &pin, &mv) != 2 || pin > 7) {
+        fprintf(stderr, "%s:%d: malformed adc event\n", path, line_number);
+        exit(1);
+      }
+      e->type = EVENT_ADC;
+      e->pin = (uint8_t)pin;
+      e->millivolts = mv;
+    } else {
+      fprintf(stderr, "%s:%d: unknown event %s\n", path, line_number, type);
+      exit(1);
+    }
+
+    if (event_count > 0 && e->cycle < events[event_count - 1].cycle) {
+      fprintf(stderr, "%s:%d: events out of order\n", path, line_number);
+      exit(1);
+    }
+    event_count++;
+  }
+  fclose(file);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-t ms] [-s script] [-b baud] [-n name,name,...] "
+          "firmware.elf\n",
+          argv0);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  double run_ms = 5000;
+  const char *script = NULL;
+  char *names = NULL;
+  unsigned baud = DEFAULT_BAUD;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:s:b:n:")) != -1) {
+    switch (opt) {
+    case 't':
+      run_ms = atof(optarg);
+      break;
+    case 's':
+      script = optarg;
+      break;
+    case 'b':
+      baud = (unsigned)atoi(optarg);
+      break;
+    case 'n':
+      names = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || baud == 0) {
+    usage(argv[0]);
+  }
+
+  for (int i = 0; names != NULL && i < MAX_SECTIONS; i++) {
+    sections[i].name = strsep(&names, ",");
+  }
+  if (script != NULL) {
+    read_script(script);
+  }
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(argv[optind], &firmware) != 0) {
+    fprintf(stderr, "%s: can't read firmware\n", argv[optind]);
+    return 1;
+  }
+  avr_t *avr = avr_make_mcu_by_name("atmega328p");
+  if (avr == NULL) {
+    fprintf(stderr, "simavr doesn't support the atmega328p\n");
+    return 1;
+  }
+  avr_init(avr);
+  avr->frequency = CPU_HZ;
+  avr->vcc = avr->avcc = avr->aref = 5000;
+  avr_load_firmware(avr, &firmware);
+  avr->log = LOG_ERROR;
+
+  avr_register_io_write(avr, GPIOR0_ADDR, on_profile_mark, NULL);
+
+  // Keep the firmware's output off our stdout, and count it instead.
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+  avr_irq_register_notify(
+      avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+      on_uart_output, NULL);
+  avr_irq_t *uart_in =
+      avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+  // Bytes are fed in no faster than the line rate, 10 bits each.
+  const uint64_t cycles_per_byte = CPU_HZ * 10 / baud;
+  uint64_t end = ms_to_cycles(run_ms);
+  uint64_t next_byte = 0;
+  int next_event = 0;
+  uint8_t pending[sizeof(events[0].bytes)];
+  int pending_len = 0, pending_pos = 0;
+
+  while (avr->cycle < end) {
+    int state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      fprintf(stderr, "firmware stopped at cycle %" PRIu64 "\n",
+              (uint64_t)avr->cycle);
+      return 1;
+    }
+
+    while (next_event < event_count &&
+           events[next_event].cycle <= avr->cycle &&
+           (events[next_event].type != EVENT_UART ||
+            pending_pos == pending_len)) {
+      struct event *e = &events[next_event++];
+      if (e->type == EVENT_ADC) {
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ,
+                                    ADC_IRQ_ADC0 + e->pin),
+                      e->millivolts);
+      } else {
+        memcpy(pending, e->bytes, e->len);
+        pending_len = e->len;
+        pending_pos = 0;
+      }
+    }
+    if (pending_pos < pending_len && avr->cycle >= next_byte) {
+      avr_raise_irq(uart_in, pending[pending_pos++]);
+      next_byte = avr->cycle + cycles_per_byte;
+    }
+  }
+
+  // Machine readable: CSV, with the totals as comments.
+  printf("# cycles %" PRIu64 " uart_tx_bytes %" PRIu64 "\n",
+         (uint64_t)avr->cycle, uart_tx_bytes);
+  printf("section,name,calls,total_cycles,min_cycles,max_cycles,"
+         "mean_cycles,load\n");
+  for (int i = 0; i < MAX_SECTIONS; i++) {
+    const struct section *s = &sections[i];
+    if (s->calls == 0) {
+      continue;
+    }
+    printf("%d,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+           ",%.4f\n",
+           i, s->name != NULL ? s->name : "", s->calls, s->total, s->min,
+           s->max, s->total / s->calls, (double)s->total / avr->cycle);
+  }
+  return 0;
+}
@@ -1,4 +1,4 @@
-QT += core quick charts
+QT += core quick charts serialport
 # QT += virtualkeyboard
 
 CONFIG += c++11
@@ -14,9 +14,18 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# The protocol and wire formats shared with the controller.
+INCLUDEPATH += ../common/include ../common/libs/checksum
+
 SOURCES += \
+        commandclient.cpp \
         datasource.cpp \
-        main.cpp
+        main.cpp \
+        protocol.cpp \
+        recording.cpp \
+        replayer.cpp \
+        serialreader.cpp \
+        telemetryfeed.cpp
 
 RESOURCES += qml.qrc Logo.png
 
@@ -37,7 +46,15 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 HEADERS += \
-    datasource.h
+    commandclient.h \
+    datasource.h \
+    envelope.h \
+    protocol.h \
+    recording.h \
+    replayer.h \
+    serialreader.h \
+    sweepbuffer.h \
+    telemetryfeed.h
 
 DISTFILES += \
     Logo.png
@@ -39,6 +39,9 @@ ChartView
     backgroundColor: "#000000"
     property string color
     property string name
+    property real yMin: 0
+    property real yMax: 3
+    property int points: 1000
     property bool openGL: true
     property bool openGLSupported: true
     antialiasing: true
@@ -76,8 +79,8 @@ ChartView
     ValueAxis
     {
         id: axisY
-        min: 0
-        max: 3
+        min: chartView.yMin
+        max: chartView.yMax
         labelsColor: chartView.color
     }
 
@@ -86,7 +89,7 @@ ChartView
     {
         id: axisX
         min: 0
-        max: 1000
+        max: chartView.points
         labelsColor: chartView.color
     }
 
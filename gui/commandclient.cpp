@@ -0,0 +1,124 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "commandclient.h"
+#include <QtCore/QMutexLocker>
+
+CommandClient::CommandClient(QObject *parent)
+    : QObject(parent), m_nextReq(0) {
+  for (Pending &pending : m_pending) {
+    pending.used = false;
+  }
+  m_clock.start();
+}
+
+std::future<CommandResponse> CommandClient::send(command cmd,
+                                                 const std::string &args) {
+  if (args.size() > CMD_TAGGED_ARGS_LEN_MAX) {
+    // The controller would drop it, and it would only time out
+    return refuse(CommandResponse::Status::tooLong);
+  }
+
+  QByteArray packet;
+  std::future<CommandResponse> future;
+  {
+    QMutexLocker lock(&m_mutex);
+
+    // Request IDs go round in turn, so one is only reused long after its
+    // last answer, or timeout.
+    int req = -1;
+    for (int i = 0; i < 256 && req < 0; i++) {
+      uint8_t candidate = static_cast<uint8_t>(m_nextReq + i);
+      if (!m_pending[candidate].used) {
+        req = candidate;
+      }
+    }
+    if (req < 0) {
+      return refuse(CommandResponse::Status::busy);
+    }
+    m_nextReq = static_cast<uint8_t>(req + 1);
+
+    Pending &pending = m_pending[req];
+    pending.used = true;
+    pending.cmd = static_cast<uint8_t>(cmd);
+    pending.sentMs = m_clock.elapsed();
+    pending.promise = std::promise<CommandResponse>();
+    future = pending.promise.get_future();
+
+    std::string data = static_cast<char>(req) + args;
+    std::string frame =
+        encodePacket(msgType::cmdTagged, static_cast<uint8_t>(cmd),
+                     data.data(), static_cast<uint8_t>(data.size()));
+    packet = QByteArray(frame.data(), static_cast<int>(frame.size()));
+  }
+
+  emit packetReady(packet);
+  return future;
+}
+
+std::future<CommandResponse>
+CommandClient::refuse(CommandResponse::Status status) {
+  std::promise<CommandResponse> refused;
+  refused.set_value(CommandResponse{status, ""});
+  return refused.get_future();
+}
+
+bool CommandClient::handleResponse(const Packet &packet) {
+  CommandResponse::Status status;
+  switch (packet.type) {
+  case msgType::rAckTagged:
+    status = CommandResponse::Status::ok;
+    break;
+  case msgType::rErrChecksumTagged:
+    status = CommandResponse::Status::checksumError;
+    break;
+  case msgType::rErrModeTagged:
+    status = CommandResponse::Status::modeError;
+    break;
+  case msgType::rErrCmdTagged:
+    status = CommandResponse::Status::commandError;
+    break;
+  default:
+    return false;
+  }
+  if (packet.len < 1) {
+    return false;
+  }
+
+  QMutexLocker lock(&m_mutex);
+  Pending &pending = m_pending[static_cast<uint8_t>(packet.data[0])];
+  // An answer for a command that timed out, or came from someone else
+  if (!pending.used || pending.cmd != packet.id) {
+    return false;
+  }
+  answer(&pending, status, std::string(packet.data + 1, packet.len - 1));
+  return true;
+}
+
+void CommandClient::expire() {
+  QMutexLocker lock(&m_mutex);
+  qint64 now = m_clock.elapsed();
+  for (Pending &pending : m_pending) {
+    if (pending.used && now - pending.sentMs >= TIMEOUT_MS) {
+      answer(&pending, CommandResponse::Status::timeout);
+    }
+  }
+}
+
+void CommandClient::answer(Pending *pending, CommandResponse::Status status,
+                           const std::string &data) {
+  pending->promise.set_value(CommandResponse{status, data});
+  pending->used = false;
+}
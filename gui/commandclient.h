@@ -0,0 +1,101 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef COMMANDCLIENT_H
+#define COMMANDCLIENT_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+
+#include <future>
+#include <string>
+
+#include "protocol.h"
+
+// How the controller answered a command.
+struct CommandResponse {
+  enum class Status {
+    ok,
+    checksumError, // The controller got the command corrupted
+    modeError,     // Not allowed in the controller's operating mode
+    commandError,  // Unknown command, or the wrong payload for it
+    timeout,       // No answer
+    busy,          // Too many commands outstanding to send another
+    tooLong,       // Arguments longer than the controller takes; not sent
+  };
+
+  Status status;
+  std::string data; // The command's response, for ok
+};
+
+// Sends commands to the controller as cmdTagged, each with a request ID of
+// its own, and matches the responses to them by it.  So any number of
+// commands, up to one per request ID, can be waiting for their answers at
+// once, rather than each waiting for the last to be answered:
+//
+//   std::future<CommandResponse> rr = client->send(command::get_rr);
+//   std::future<CommandResponse> tv = client->send(command::get_tv);
+//   ... both answered in about one round trip ...
+//
+// send() can be called from any thread.  The rest belongs to the
+// SerialReader, which writes out packetReady() and hands back what the
+// controller answers.
+class CommandClient : public QObject {
+  Q_OBJECT
+public:
+  // A command not answered within this long is given up on.  Far longer than
+  // the controller takes, unless the command or its answer was lost.
+  static const qint64 TIMEOUT_MS = 500;
+
+  explicit CommandClient(QObject *parent = 0);
+
+  // Sends `cmd`, with `args` as its payload, of up to
+  // CMD_TAGGED_ARGS_LEN_MAX bytes.
+  std::future<CommandResponse> send(command cmd,
+                                    const std::string &args = std::string());
+
+  // Takes a packet from the controller.  Returns false if it isn't the
+  // answer to a command sent here.
+  bool handleResponse(const Packet &packet);
+  // Answers commands outstanding for longer than TIMEOUT_MS with timeout.
+  void expire();
+
+Q_SIGNALS:
+  // A command to write out to the controller.
+  void packetReady(const QByteArray &packet);
+
+private:
+  struct Pending {
+    bool used;
+    uint8_t cmd;
+    qint64 sentMs;
+    std::promise<CommandResponse> promise;
+  };
+
+  // A response, for a command which wasn't sent.
+  static std::future<CommandResponse> refuse(CommandResponse::Status status);
+  void answer(Pending *pending, CommandResponse::Status status,
+              const std::string &data = std::string());
+
+  QMutex m_mutex;
+  QElapsedTimer m_clock;
+  // Indexed by request ID.
+  Pending m_pending[256];
+  uint8_t m_nextReq;
+};
+
+#endif // COMMANDCLIENT_H
@@ -28,6 +28,7 @@
 ****************************************************************************/
 
 #include "datasource.h"
+#include "telemetryfeed.h"
 #include <QtCharts/QAreaSeries>
 #include <QtCharts/QXYSeries>
 #include <QtCore/QDebug>
@@ -35,75 +36,117 @@
 #include <QtQuick/QQuickItem>
 #include <QtQuick/QQuickView>
 
-#include <random>
-
 QT_CHARTS_USE_NAMESPACE
 
 Q_DECLARE_METATYPE(QAbstractSeries *)
 Q_DECLARE_METATYPE(QAbstractAxis *)
 
 DataSource::DataSource(QQuickView *appViewer, QObject *parent)
-    : QObject(parent), m_appViewer(appViewer), m_index(-1) {
+    : QObject(parent), m_appViewer(appViewer), m_index(-1),
+      m_random(std::random_device{}()), m_feed(nullptr),
+      m_channel(Channel::pressure), m_sweep(2 * SWEEP_COLUMNS),
+      m_decimator(&m_sweep, 1) {
   qRegisterMetaType<QAbstractSeries *>();
   qRegisterMetaType<QAbstractAxis *>();
-
-  generateData(1000, 1000);
 }
 
-void DataSource::update(QAbstractSeries *series) {
-  if (series) {
-    QXYSeries *xySeries = static_cast<QXYSeries *>(series);
-    m_index++;
-    if (m_index > m_data.count() - 1) {
-      m_index = 0;
-    }
-    QVector<QPointF> points = m_data.at(m_index);
-    // Use replace instead of clear + append, it's optimized for performance
-    xySeries->replace(points);
-  }
-}
+DataSource::DataSource(QQuickView *appViewer, TelemetryFeed *feed,
+                       Channel channel, uint32_t windowMs, QObject *parent)
+    : QObject(parent), m_appViewer(appViewer), m_index(-1), m_feed(feed),
+      m_channel(channel), m_sweep(2 * SWEEP_COLUMNS),
+      m_decimator(&m_sweep, windowMs / SWEEP_COLUMNS) {
+  qRegisterMetaType<QAbstractSeries *>();
+  qRegisterMetaType<QAbstractAxis *>();
 
-void DataSource::generateData(int rowCount, int colCount) {
-  std::random_device rd;
-  std::mt19937 e2{rd()};
-  std::uniform_real_distribution<> dist{0, 1};
+  feed->addSource(this);
+}
 
-  // Remove previous data
-  m_data.clear();
+void DataSource::addSample(const TelemetrySample &sample) {
+  qreal value = 0;
+  switch (m_channel) {
+  case Channel::pressure:
+    // The chart is in mmH2O.
+    value = sample.pressure_pa / 9.80665;
+    break;
+  case Channel::volume:
+    value = sample.volume_ml;
+    break;
+  case Channel::flow:
+    value = sample.flow_ml_s;
+    break;
+  }
 
-  // Append the new data depending on the type
-  QVector<QPointF> points;
-  points.reserve(colCount);
+  m_decimator.add(sample.time_ms, value);
+}
 
-  for (int j(0); j < colCount; ++j) {
-    qreal x(0);
-    qreal y(0);
+qreal DataSource::yMin() const {
+  if (!m_feed) {
+    return 0;
+  }
+  switch (m_channel) {
+  case Channel::pressure:
+    return -50;
+  case Channel::volume:
+    return -100;
+  case Channel::flow:
+    return -1500;
+  }
+  return 0;
+}
 
-    y = (qSin(M_PI / 50 * j) > 0 ? 1 : 0) + dist(e2) / 5;
-    x = j;
-    points.append(QPointF(x, y));
+qreal DataSource::yMax() const {
+  if (!m_feed) {
+    return 3;
   }
-  m_data.append(points);
+  switch (m_channel) {
+  case Channel::pressure:
+    return 500;
+  case Channel::volume:
+    return 1000;
+  case Channel::flow:
+    return 1500;
+  }
+  return 3;
+}
 
-  points.clear();
-  // Append the new data depending on the type
-  for (int i(1); i < rowCount; ++i) {
-    for (int j(0); j < colCount - 1; ++j) {
-      qreal x(0);
-      qreal y(0);
+void DataSource::update(QAbstractSeries *series) {
+  if (!series) {
+    return;
+  }
+  if (m_feed) {
+    m_feed->drain();
+  } else {
+    generateData();
+  }
+  draw(static_cast<QXYSeries *>(series));
+}
 
-      y = m_data[i - 1][j + 1].y();
-      x = j;
-      points.append(QPointF(x, y));
+void DataSource::draw(QXYSeries *series) {
+  int first;
+  int changed = m_sweep.takeChanges(&first);
+
+  if (series->count() != m_sweep.size() || changed == m_sweep.size()) {
+    // On the first frame, or when everything changed, draw every slot in one
+    // go.  Otherwise replace just the points that changed, in place.
+    QVector<QPointF> points;
+    points.reserve(m_sweep.size());
+    for (int slot = 0; slot < m_sweep.size(); slot++) {
+      points.append(QPointF(slot, m_sweep.at(slot)));
     }
-    qreal x(0);
-    qreal y(0);
-
-    y = (qSin(M_PI / 50 * i) > 0 ? 1 : 0) + dist(e2) / 5;
-    x = colCount;
-    points.append(QPointF(x, y));
+    series->replace(points);
+    return;
+  }
 
-    m_data.append(points);
-    points.clear();
+  for (int i = 0; i < changed; i++) {
+    int slot = (first + i) % m_sweep.size();
+    series->replace(slot, QPointF(slot, m_sweep.at(slot)));
   }
 }
+
+void DataSource::generateData() {
+  // A square wave with noise, one column per frame.
+  std::uniform_real_distribution<> dist{0, 1};
+  m_index++;
+  m_decimator.add(m_index,
+                  (qSin(M_PI / 50 * m_index) > 0 ? 1 : 0) + dist(m_random) / 5);
+}
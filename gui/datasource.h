@@ -33,27 +33,69 @@
 #include <QtCharts/QAbstractSeries>
 #include <QtCore/QObject>
 
+#include <random>
+
+#include "envelope.h"
+#include "sweepbuffer.h"
+#include "telemetry_codec.h"
+
 QT_BEGIN_NAMESPACE
 class QQuickView;
 QT_END_NAMESPACE
 
+QT_CHARTS_BEGIN_NAMESPACE
+class QXYSeries;
+QT_CHARTS_END_NAMESPACE
+
 QT_CHARTS_USE_NAMESPACE
 
+class TelemetryFeed;
+
 class DataSource : public QObject {
   Q_OBJECT
+  // Range of the values, for the chart's axis.
+  Q_PROPERTY(qreal yMin READ yMin CONSTANT)
+  Q_PROPERTY(qreal yMax READ yMax CONSTANT)
+  // Number of points across the chart, for its x axis.
+  Q_PROPERTY(int points READ points CONSTANT)
 public:
+  // The reading a live source shows.
+  enum class Channel { pressure, volume, flow };
+
+  // Columns across the chart, one per pixel of a typical display.  Each
+  // shows the lowest and highest reading in its span of time.
+  static const int SWEEP_COLUMNS = 800;
+
+  // Shows generated data.
   explicit DataSource(QQuickView *appViewer, QObject *parent = 0);
-  QList<QVector<QPointF>> m_data;
+  // Shows `windowMs` of the latest readings of `channel` from `feed`.
+  DataSource(QQuickView *appViewer, TelemetryFeed *feed, Channel channel,
+             uint32_t windowMs, QObject *parent = 0);
+
+  // Called by the feed with each reading.
+  void addSample(const TelemetrySample &sample);
+
+  qreal yMin() const;
+  qreal yMax() const;
+  int points() const { return m_sweep.size(); }
 
 Q_SIGNALS:
 
 public slots:
-  void generateData(int rowCount, int colCount);
   void update(QAbstractSeries *series);
 
 private:
+  void generateData();
+  void draw(QXYSeries *series);
+
   QQuickView *m_appViewer;
   int m_index;
+  std::mt19937 m_random;
+
+  TelemetryFeed *m_feed;
+  Channel m_channel;
+  SweepBuffer m_sweep;
+  EnvelopeDecimator m_decimator;
 };
 
 #endif // DATASOURCE_H
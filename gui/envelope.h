@@ -0,0 +1,74 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stdint.h>
+
+#include "sweepbuffer.h"
+
+// Decimates readings into a SweepBuffer for drawing, keeping two values for
+// each column of the chart: the lowest and highest reading in the column's
+// span of time, in the order they came.  The line through them covers every
+// reading in the column, so peaks survive however many readings a column
+// holds, and the chart costs the same to draw whatever the time window.
+//
+// The column being filled is drawn too, and revised with each reading.
+class EnvelopeDecimator {
+public:
+  // Each column covers `columnMs` of readings.
+  EnvelopeDecimator(SweepBuffer *sweep, uint32_t columnMs)
+      : m_sweep(sweep), m_columnMs(columnMs > 0 ? columnMs : 1),
+        m_column(0), m_empty(true), m_min(0), m_max(0), m_minFirst(true) {}
+
+  void add(uint32_t time_ms, double value) {
+    uint32_t column = time_ms / m_columnMs;
+    if (m_empty || column != m_column) {
+      m_column = column;
+      m_empty = false;
+      m_min = value;
+      m_max = value;
+      m_minFirst = true;
+      m_sweep->append(value);
+      m_sweep->append(value);
+      return;
+    }
+
+    if (value < m_min) {
+      m_min = value;
+      m_minFirst = false;
+    } else if (value > m_max) {
+      m_max = value;
+      m_minFirst = true;
+    } else {
+      return;
+    }
+    m_sweep->amend(2, m_minFirst ? m_min : m_max);
+    m_sweep->amend(1, m_minFirst ? m_max : m_min);
+  }
+
+private:
+  SweepBuffer *m_sweep;
+  uint32_t m_columnMs;
+  uint32_t m_column;
+  bool m_empty;
+  double m_min;
+  double m_max;
+  // Whether the lowest reading in the column came before the highest.
+  bool m_minFirst;
+};
+
+#endif // ENVELOPE_H
@@ -1,6 +1,10 @@
 #include "datasource.h"
+#include "replayer.h"
+#include "serialreader.h"
+#include "telemetryfeed.h"
 #include <QCommandLineParser>
 #include <QtCore/QDir>
+#include <QtCore/QThread>
 #include <QtQml/QQmlContext>
 #include <QtQml/QQmlEngine>
 #include <QtQuick/QQuickView>
@@ -21,6 +25,51 @@ int main(int argc, char *argv[]) {
       QApplication::translate("main", "Die right away (for testing)"));
   parser.addOption(dieOption);
 
+  QCommandLineOption portOption(
+      QStringList() << "p"
+                    << "port",
+      QApplication::translate("main",
+                              "Show readings from the controller on <port>"),
+      QApplication::translate("main", "port"));
+  parser.addOption(portOption);
+
+  QCommandLineOption baudOption(
+      "baud", QApplication::translate("main", "Baud rate of <port>"),
+      QApplication::translate("main", "rate"), "115200");
+  parser.addOption(baudOption);
+
+  QCommandLineOption windowOption(
+      "window",
+      QApplication::translate("main", "Show the last <seconds> of readings"),
+      QApplication::translate("main", "seconds"), "10");
+  parser.addOption(windowOption);
+
+  QCommandLineOption recordOption(
+      "record",
+      QApplication::translate("main",
+                              "Record everything from <port> to <file>"),
+      QApplication::translate("main", "file"));
+  parser.addOption(recordOption);
+
+  QCommandLineOption replayOption(
+      "replay", QApplication::translate("main", "Play back <file>"),
+      QApplication::translate("main", "file"));
+  parser.addOption(replayOption);
+
+  QCommandLineOption speedOption(
+      "speed",
+      QApplication::translate(
+          "main", "Play back at <factor> times real time, 0 for flat out"),
+      QApplication::translate("main", "factor"), "1");
+  parser.addOption(speedOption);
+
+  QCommandLineOption fromOption(
+      "from",
+      QApplication::translate("main",
+                              "Play back from <seconds> into the recording"),
+      QApplication::translate("main", "seconds"), "0");
+  parser.addOption(fromOption);
+
   parser.process(app);
 
   bool die_now = parser.isSet(dieOption);
@@ -34,18 +83,68 @@ int main(int argc, char *argv[]) {
                    &QWindow::close);
   mainView.setTitle(QStringLiteral("Ventilator"));
 
-  // This will need to be a source coming from the arduino
-  DataSource pressureDataSource(&mainView);
-  // This will need to be a source coming from the arduino
-  DataSource volumeDataSource(&mainView);
-  // This data source will be calulated from pressure and volume on the pi
-  DataSource flowDataSource(&mainView);
+  // With a port, the sources show the controller's readings, which a
+  // SerialReader on its own thread decodes; with a recording, a Replayer
+  // stands in for the SerialReader.  Otherwise they show generated data.
+  QScopedPointer<TelemetryRing> ring(new TelemetryRing);
+  TelemetryFeed feed(ring.data());
+  QThread workerThread;
+  QScopedPointer<QObject> worker;
+  QScopedPointer<DataSource> pressureDataSource, volumeDataSource,
+      flowDataSource;
+
+  if (parser.isSet(portOption) || parser.isSet(replayOption)) {
+    uint32_t windowMs =
+        static_cast<uint32_t>(parser.value(windowOption).toDouble() * 1000);
+    pressureDataSource.reset(new DataSource(
+        &mainView, &feed, DataSource::Channel::pressure, windowMs));
+    volumeDataSource.reset(new DataSource(
+        &mainView, &feed, DataSource::Channel::volume, windowMs));
+    flowDataSource.reset(new DataSource(&mainView, &feed,
+                                        DataSource::Channel::flow, windowMs));
+  }
+
+  if (parser.isSet(portOption)) {
+    SerialReader *reader = new SerialReader(parser.value(portOption),
+                                            parser.value(baudOption).toInt(),
+                                            ring.data());
+    worker.reset(reader);
+    if (parser.isSet(recordOption)) {
+      reader->recordTo(parser.value(recordOption));
+    }
+    QObject::connect(&workerThread, &QThread::started, reader,
+                     &SerialReader::start);
+    QObject::connect(reader, &SerialReader::error, [](const QString &message) {
+      qWarning("Serial port: %s", qPrintable(message));
+    });
+  } else if (parser.isSet(replayOption)) {
+    Replayer *replayer = new Replayer(
+        parser.value(replayOption), parser.value(speedOption).toDouble(),
+        static_cast<uint32_t>(parser.value(fromOption).toDouble() * 1000),
+        ring.data());
+    worker.reset(replayer);
+    QObject::connect(&workerThread, &QThread::started, replayer,
+                     &Replayer::start);
+    QObject::connect(replayer, &Replayer::error, [](const QString &message) {
+      qWarning("Replay: %s", qPrintable(message));
+    });
+    QObject::connect(replayer, &Replayer::finished,
+                     [](quint64 records, quint64 samples, qint64 elapsedMs) {
+                       qInfo("Replayed %llu packets, %llu readings in %lld ms",
+                             records, samples, elapsedMs);
+                     });
+  } else {
+    pressureDataSource.reset(new DataSource(&mainView));
+    volumeDataSource.reset(new DataSource(&mainView));
+    flowDataSource.reset(new DataSource(&mainView));
+  }
 
   mainView.rootContext()->setContextProperty("pressureDataSource",
-                                             &pressureDataSource);
+                                             pressureDataSource.data());
   mainView.rootContext()->setContextProperty("volumeDataSource",
-                                             &volumeDataSource);
-  mainView.rootContext()->setContextProperty("flowDataSource", &flowDataSource);
+                                             volumeDataSource.data());
+  mainView.rootContext()->setContextProperty("flowDataSource",
+                                             flowDataSource.data());
 
   mainView.setSource(QUrl("qrc:/main.qml"));
   mainView.setResizeMode(QQuickView::SizeRootObjectToView);
@@ -55,6 +154,21 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
   }
 
+  if (worker) {
+    worker->moveToThread(&workerThread);
+    // The worker belongs to its thread from here on, and goes with it.
+    QObject::connect(&workerThread, &QThread::finished, worker.take(),
+                     &QObject::deleteLater);
+    workerThread.start();
+  }
   mainView.show();
-  return app.exec();
+  int status = app.exec();
+
+  // The worker is deleted on its own thread as that stops, and has to be gone
+  // before the ring is.
+  if (workerThread.isRunning()) {
+    workerThread.quit();
+    workerThread.wait();
+  }
+  return status;
 }
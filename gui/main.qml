@@ -67,6 +67,9 @@ Item
         {
             id: flowView
             name: "Flow [mL]"
+            yMin: flowDataSource.yMin
+            yMax: flowDataSource.yMax
+            points: flowDataSource.points
             color: "green"
             Layout.fillHeight: true
             Layout.fillWidth: true
@@ -87,6 +90,9 @@ Item
         {
             id: tidalVolumeView
             name: "Tidal Volume [mL]"
+            yMin: volumeDataSource.yMin
+            yMax: volumeDataSource.yMax
+            points: volumeDataSource.points
             color: "yellow"
             Layout.fillHeight: true
             Layout.fillWidth: true
@@ -106,6 +112,9 @@ Item
         ScopeView {
             id: pressureView
             name: "Pressure [mmH2O]"
+            yMin: pressureDataSource.yMin
+            yMax: pressureDataSource.yMax
+            points: pressureDataSource.points
             color: "#4f67ff"
             Layout.fillHeight: true
             Layout.fillWidth: true
@@ -0,0 +1,129 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protocol.h"
+
+PacketDecoder::PacketDecoder()
+    : m_field(Field::sof), m_packet(), m_received(0), m_packets(0),
+      m_checksumErrors(0), m_skippedBytes(0) {}
+
+bool PacketDecoder::push(char c) {
+  if (m_field == Field::sof) {
+    if (static_cast<uint8_t>(c) == PACKET_SOF) {
+      m_checksum.reset();
+      m_field = Field::type;
+    } else {
+      m_skippedBytes++;
+    }
+    return false;
+  }
+
+  // Everything after SOF is checksummed.
+  m_checksum.add(c);
+
+  switch (m_field) {
+  case Field::type:
+    m_packet.type = static_cast<msgType>(static_cast<uint8_t>(c));
+    m_field = Field::id;
+    break;
+  case Field::id:
+    m_packet.id = static_cast<uint8_t>(c);
+    m_field = Field::len;
+    break;
+  case Field::len:
+    m_packet.len = static_cast<uint8_t>(c);
+    m_received = 0;
+    m_field = m_packet.len > 0 ? Field::data : Field::checksumA;
+    break;
+  case Field::data:
+    m_packet.data[m_received++] = c;
+    if (m_received == m_packet.len) {
+      m_field = Field::checksumA;
+    }
+    break;
+  case Field::checksumA:
+    m_field = Field::checksumB;
+    break;
+  case Field::checksumB:
+    m_field = Field::sof;
+    if (m_checksum.valid()) {
+      m_packets++;
+      return true;
+    }
+    m_checksumErrors++;
+    break;
+  case Field::sof:
+    break;
+  }
+  return false;
+}
+
+int decodeReadings(msgType type, uint8_t id, const char *data, uint8_t len,
+                   TelemetrySample *samples) {
+  if (type != msgType::data) {
+    return 0;
+  }
+
+  int count = -1;
+  if (id == static_cast<uint8_t>(dataID::data_batch)) {
+    count =
+        telemetry_decodeBatch(data, len, samples, READINGS_PER_PACKET_MAX);
+  } else if (id == static_cast<uint8_t>(dataID::data_compressed)) {
+    count = telemetry_decodeCompressed(data, len, samples,
+                                       READINGS_PER_PACKET_MAX);
+  } else if (id == static_cast<uint8_t>(dataID::data_channels)) {
+    ChannelRecord records[READINGS_PER_PACKET_MAX];
+    int found = telemetry_decodeChannels(data, len, records,
+                                         READINGS_PER_PACKET_MAX);
+    const uint8_t needed =
+        1 << static_cast<uint8_t>(telemetryChannel::pressure) |
+        1 << static_cast<uint8_t>(telemetryChannel::volume) |
+        1 << static_cast<uint8_t>(telemetryChannel::flow);
+    count = 0;
+    for (int i = 0; i < found; i++) {
+      if ((records[i].mask & needed) == needed) {
+        const int16_t *values = records[i].values;
+        TelemetrySample &sample = samples[count++];
+        sample.time_ms = records[i].time_ms;
+        sample.pressure_pa =
+            values[static_cast<uint8_t>(telemetryChannel::pressure)];
+        sample.volume_ml =
+            values[static_cast<uint8_t>(telemetryChannel::volume)];
+        sample.flow_ml_s =
+            values[static_cast<uint8_t>(telemetryChannel::flow)];
+      }
+    }
+  }
+  return count > 0 ? count : 0;
+}
+
+std::string encodePacket(msgType type, uint8_t id, const char *data,
+                         uint8_t len) {
+  std::string packet;
+  packet.reserve(len + 6);
+  packet += static_cast<char>(PACKET_SOF);
+  packet += static_cast<char>(type);
+  packet += static_cast<char>(id);
+  packet += static_cast<char>(len);
+  packet.append(data, len);
+
+  Fletcher16 checksum;
+  checksum.add(&packet[1], 3);
+  checksum.add(data, len);
+  uint16_t check = check_bytes_fletcher16(checksum.value());
+  packet += static_cast<char>(check >> 8);
+  packet += static_cast<char>(check & 0xff);
+  return packet;
+}
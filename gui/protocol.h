@@ -0,0 +1,81 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// The GUI's end of the serial protocol in common/include/packet_types.h.
+
+#include <stdint.h>
+#include <string>
+
+#include "checksum.h"
+#include "packet_types.h"
+#include "telemetry_codec.h"
+
+// A packet from the controller.
+struct Packet {
+  msgType type;
+  uint8_t id; // dataID, or the command answered for responses
+  uint8_t len;
+  char data[255];
+};
+
+// Finds the packets in the byte stream from the controller.  After anything
+// that isn't a valid packet it looks for the next PACKET_SOF, so it finds its
+// way back to the packets after dropped or corrupted bytes.
+class PacketDecoder {
+public:
+  PacketDecoder();
+
+  // Takes the next byte of the stream.  Returns true if it completes a
+  // valid packet, which is then in packet() until the next call.
+  bool push(char c);
+  const Packet &packet() const { return m_packet; }
+
+  uint64_t packets() const { return m_packets; }
+  uint64_t checksumErrors() const { return m_checksumErrors; }
+  // Bytes thrown away looking for the start of a packet.
+  uint64_t skippedBytes() const { return m_skippedBytes; }
+
+private:
+  enum class Field { sof, type, id, len, data, checksumA, checksumB };
+
+  Field m_field;
+  Packet m_packet;
+  uint8_t m_received;
+  Fletcher16 m_checksum;
+
+  uint64_t m_packets;
+  uint64_t m_checksumErrors;
+  uint64_t m_skippedBytes;
+};
+
+// Room for the readings any one packet can hold.
+static const int READINGS_PER_PACKET_MAX = 255;
+
+// Decodes the readings in a data_batch, data_compressed or data_channels
+// packet into `samples`, which has room for READINGS_PER_PACKET_MAX.
+// Returns how many there are: none for any other packet, or one that is
+// malformed.  Of data_channels, only records with all of pressure, volume
+// and flow are readings.
+int decodeReadings(msgType type, uint8_t id, const char *data, uint8_t len,
+                   TelemetrySample *samples);
+
+// Frames a packet to send to the controller.
+std::string encodePacket(msgType type, uint8_t id, const char *data,
+                         uint8_t len);
+
+#endif // PROTOCOL_H
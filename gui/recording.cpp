@@ -0,0 +1,238 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "recording.h"
+#include <QtCore/QDateTime>
+
+#include <string.h>
+
+RecordingWriter::RecordingWriter() : m_chunkOffset(0), m_chunk(nullptr) {}
+
+RecordingWriter::~RecordingWriter() { close(); }
+
+bool RecordingWriter::open(const QString &path) {
+  close();
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+    return false;
+  }
+
+  RecordingHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+  header.version = RECORDING_VERSION;
+  header.chunk_size = RECORDING_CHUNK_SIZE;
+  header.start_ms = QDateTime::currentMSecsSinceEpoch();
+  if (m_file.write(reinterpret_cast<const char *>(&header), sizeof(header)) !=
+      sizeof(header)) {
+    m_file.close();
+    return false;
+  }
+
+  m_chunkOffset = sizeof(header);
+  if (!startChunk()) {
+    m_file.close();
+    return false;
+  }
+  return true;
+}
+
+void RecordingWriter::close() {
+  if (m_chunk) {
+    m_file.unmap(m_chunk);
+    m_chunk = nullptr;
+  }
+  m_file.close();
+}
+
+bool RecordingWriter::startChunk() {
+  if (!m_file.resize(m_chunkOffset + RECORDING_CHUNK_SIZE)) {
+    return false;
+  }
+  m_chunk = m_file.map(m_chunkOffset, RECORDING_CHUNK_SIZE);
+  if (!m_chunk) {
+    return false;
+  }
+  // The file grew with zeros, so only `used` needs setting.
+  reinterpret_cast<RecordingChunkHeader *>(m_chunk)->used =
+      sizeof(RecordingChunkHeader);
+  return true;
+}
+
+bool RecordingWriter::write(uint32_t time_ms, msgType type, uint8_t id,
+                            const char *data, uint8_t len) {
+  if (!m_chunk) {
+    return false;
+  }
+
+  RecordingChunkHeader *chunk =
+      reinterpret_cast<RecordingChunkHeader *>(m_chunk);
+  uint32_t size = RECORDING_RECORD_HEADER_LEN + len;
+  if (chunk->used + size > RECORDING_CHUNK_SIZE) {
+    m_file.unmap(m_chunk);
+    m_chunk = nullptr;
+    m_chunkOffset += RECORDING_CHUNK_SIZE;
+    if (!startChunk()) {
+      return false;
+    }
+    chunk = reinterpret_cast<RecordingChunkHeader *>(m_chunk);
+  }
+
+  uchar *record = m_chunk + chunk->used;
+  memcpy(record, &time_ms, sizeof(time_ms));
+  record[4] = static_cast<uchar>(type);
+  record[5] = id;
+  record[6] = len;
+  memcpy(record + RECORDING_RECORD_HEADER_LEN, data, len);
+
+  if (chunk->records == 0) {
+    chunk->first_ms = time_ms;
+  }
+  chunk->last_ms = time_ms;
+  chunk->records++;
+  // Last, so that the record is whole before anyone can see it.
+  chunk->used += size;
+  return true;
+}
+
+RecordingReader::RecordingReader() : m_map(nullptr), m_chunks(0) {
+  memset(&m_header, 0, sizeof(m_header));
+}
+
+RecordingReader::~RecordingReader() { close(); }
+
+bool RecordingReader::open(const QString &path) {
+  close();
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadOnly)) {
+    m_error = m_file.errorString();
+    return false;
+  }
+
+  qint64 size = m_file.size();
+  if (size < static_cast<qint64>(sizeof(m_header)) ||
+      m_file.read(reinterpret_cast<char *>(&m_header), sizeof(m_header)) !=
+          sizeof(m_header) ||
+      memcmp(m_header.magic, RECORDING_MAGIC, sizeof(m_header.magic)) != 0) {
+    m_error = path + " is not a recording";
+    close();
+    return false;
+  }
+  if (m_header.version != RECORDING_VERSION ||
+      m_header.chunk_size < sizeof(RecordingChunkHeader) +
+                                RECORDING_RECORD_HEADER_LEN + 255) {
+    m_error = path + " is a recording this version can't read";
+    close();
+    return false;
+  }
+
+  m_map = m_file.map(0, size);
+  if (!m_map) {
+    m_error = m_file.errorString();
+    close();
+    return false;
+  }
+  // Ignores a partial chunk at the end, which a crash while growing the file
+  // could leave.
+  m_chunks = static_cast<uint32_t>((size - sizeof(m_header)) /
+                                   m_header.chunk_size);
+  return true;
+}
+
+void RecordingReader::close() {
+  if (m_map) {
+    m_file.unmap(const_cast<uchar *>(m_map));
+    m_map = nullptr;
+  }
+  m_file.close();
+  m_chunks = 0;
+}
+
+const RecordingChunkHeader *RecordingReader::chunk(uint32_t index) const {
+  return reinterpret_cast<const RecordingChunkHeader *>(
+      m_map + sizeof(m_header) +
+      static_cast<qint64>(index) * m_header.chunk_size);
+}
+
+uint32_t RecordingReader::durationMs() const {
+  for (uint32_t i = m_chunks; i > 0; i--) {
+    if (chunk(i - 1)->records > 0) {
+      return chunk(i - 1)->last_ms;
+    }
+  }
+  return 0;
+}
+
+RecordingReader::Position RecordingReader::begin() const {
+  Position pos = {0, sizeof(RecordingChunkHeader)};
+  return pos;
+}
+
+RecordingReader::Position RecordingReader::seek(uint32_t time_ms) const {
+  // The last chunk that starts at or before time_ms, if any, holds the first
+  // record at or after it unless all its records are earlier, in which case
+  // that is the next chunk's first record.  Chunks are only ever empty at the
+  // end, and count as starting after everything.
+  uint32_t lo = 0;
+  uint32_t hi = m_chunks;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    const RecordingChunkHeader *c = chunk(mid);
+    if (c->records > 0 && c->first_ms <= time_ms) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  Position pos = {lo > 0 ? lo - 1 : 0, sizeof(RecordingChunkHeader)};
+  Position found = pos;
+  RecordingEntry entry;
+  while (next(&pos, &entry)) {
+    if (entry.time_ms >= time_ms) {
+      break;
+    }
+    found = pos;
+  }
+  return found;
+}
+
+bool RecordingReader::next(Position *pos, RecordingEntry *entry) const {
+  while (pos->chunk < m_chunks) {
+    const RecordingChunkHeader *c = chunk(pos->chunk);
+    uint32_t used = c->used;
+    if (used > m_header.chunk_size) {
+      // Corrupt; skip the chunk rather than read past it.
+      used = 0;
+    }
+    if (pos->offset + RECORDING_RECORD_HEADER_LEN <= used) {
+      const uchar *record = reinterpret_cast<const uchar *>(c) + pos->offset;
+      uint8_t len = record[6];
+      if (pos->offset + RECORDING_RECORD_HEADER_LEN + len <= used) {
+        memcpy(&entry->time_ms, record, sizeof(entry->time_ms));
+        entry->type = static_cast<msgType>(record[4]);
+        entry->id = record[5];
+        entry->len = len;
+        entry->data = reinterpret_cast<const char *>(record) +
+                      RECORDING_RECORD_HEADER_LEN;
+        pos->offset += RECORDING_RECORD_HEADER_LEN + len;
+        return true;
+      }
+    }
+    pos->chunk++;
+    pos->offset = sizeof(RecordingChunkHeader);
+  }
+  return false;
+}
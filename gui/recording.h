@@ -0,0 +1,150 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+// Session recordings: every packet from the controller (readings, alarms,
+// breath summaries, command responses) as it arrived, with the time it did.
+//
+// A recording is a file header followed by chunks of chunk_size bytes:
+//
+//   RecordingHeader
+//   chunk 0:  RecordingChunkHeader, records
+//   chunk 1:  RecordingChunkHeader, records
+//   ...
+//
+// and a record is
+//
+//   TIME[4]     ms since the recording started
+//   TYPE[1] ID[1] LEN[1] DATA[LEN]   the packet, as in packet_types.h
+//
+// Records never straddle chunks; a chunk ends where the next record wouldn't
+// fit.  Each chunk header has the time of the chunk's first record, so
+// finding a time is a binary search over the chunks.  All values are in the
+// host's byte order, which is little endian everywhere the GUI runs.
+//
+// Both ends work on the file through memory maps, so writing a record is a
+// memcpy; the file grows, and is mapped, a chunk at a time.  The chunk's
+// `used` is advanced after each record is in place, so a reader, or whoever
+// opens the file after a crash, only ever sees whole records.
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <stdint.h>
+
+#include "packet_types.h"
+
+struct RecordingHeader {
+  char magic[8]; // RECORDING_MAGIC
+  uint32_t version;
+  uint32_t chunk_size;
+  int64_t start_ms; // Wall clock time the recording started, ms since epoch
+  uint8_t reserved[40];
+};
+
+struct RecordingChunkHeader {
+  uint32_t used; // Bytes of the chunk in use, including this header
+  uint32_t records;
+  uint32_t first_ms; // Time of the first record
+  uint32_t last_ms;  // Time of the last record
+};
+
+static const char RECORDING_MAGIC[8] = {'R', 'W', 'V', 'E', 'N', 'T', 'R', 0};
+static const uint32_t RECORDING_VERSION = 1;
+// At the 100 Hz the controller samples at, a chunk holds about 45 s.
+static const uint32_t RECORDING_CHUNK_SIZE = 64 * 1024;
+static const uint32_t RECORDING_RECORD_HEADER_LEN = 7;
+
+// One record of a recording, pointing into the reader's map of the file.
+struct RecordingEntry {
+  uint32_t time_ms;
+  msgType type;
+  uint8_t id;
+  uint8_t len;
+  const char *data;
+};
+
+// Appends to a new recording.  Not thread safe; it belongs to whichever thread
+// receives the packets.
+class RecordingWriter {
+public:
+  RecordingWriter();
+  ~RecordingWriter();
+
+  // Creates `path`, replacing anything already there.  Returns false, with
+  // the reason in errorString(), if that fails.
+  bool open(const QString &path);
+  void close();
+  bool isOpen() const { return m_chunk != nullptr; }
+
+  // Records a packet that arrived `time_ms` after the recording started.
+  // Times must not go backwards.  Returns false if the file couldn't grow.
+  bool write(uint32_t time_ms, msgType type, uint8_t id, const char *data,
+             uint8_t len);
+
+  QString errorString() const { return m_file.errorString(); }
+
+private:
+  bool startChunk();
+
+  QFile m_file;
+  qint64 m_chunkOffset;
+  uchar *m_chunk;
+};
+
+// Reads a recording, from a read-only map of the whole file.
+class RecordingReader {
+public:
+  // Where a record is in the recording.
+  struct Position {
+    uint32_t chunk;
+    uint32_t offset; // From the start of the chunk
+  };
+
+  RecordingReader();
+  ~RecordingReader();
+
+  // Returns false, with the reason in errorString(), if `path` can't be
+  // read or isn't a recording.
+  bool open(const QString &path);
+  void close();
+
+  QString errorString() const { return m_error; }
+
+  int64_t startMs() const { return m_header.start_ms; }
+  uint32_t chunks() const { return m_chunks; }
+  // Time of the last record, 0 for an empty recording.
+  uint32_t durationMs() const;
+
+  // The first record.
+  Position begin() const;
+  // The first record at or after `time_ms`, in O(log chunks).
+  Position seek(uint32_t time_ms) const;
+  // Reads the record at *pos and moves *pos on to the next one.  Returns
+  // false at the end of the recording.
+  bool next(Position *pos, RecordingEntry *entry) const;
+
+private:
+  const RecordingChunkHeader *chunk(uint32_t index) const;
+
+  QFile m_file;
+  const uchar *m_map;
+  RecordingHeader m_header;
+  uint32_t m_chunks;
+  QString m_error;
+};
+
+#endif // RECORDING_H
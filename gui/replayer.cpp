@@ -0,0 +1,82 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "replayer.h"
+#include <QtCore/QTimer>
+
+#include <limits>
+
+// Often enough to hand over each 10 ms reading on time at normal speed.
+static const int PLAY_INTERVAL_MS = 5;
+
+Replayer::Replayer(const QString &path, double speed, uint32_t fromMs,
+                   TelemetryRing *ring, QObject *parent)
+    : QObject(parent), m_path(path), m_speed(speed), m_fromMs(fromMs),
+      m_ring(ring), m_timer(nullptr), m_pos(), m_next(), m_haveNext(false),
+      m_pendingCount(0), m_pendingNext(0), m_records(0), m_samples(0) {}
+
+void Replayer::start() {
+  if (!m_recording.open(m_path)) {
+    emit error(m_recording.errorString());
+    return;
+  }
+  m_pos = m_recording.seek(m_fromMs);
+  m_haveNext = m_recording.next(&m_pos, &m_next);
+
+  m_timer = new QTimer(this);
+  connect(m_timer, &QTimer::timeout, this, &Replayer::play);
+  m_timer->start(m_speed > 0 ? PLAY_INTERVAL_MS : 0);
+  m_clock.start();
+}
+
+bool Replayer::flushPending() {
+  while (m_pendingNext < m_pendingCount) {
+    if (!m_ring->push(m_pending[m_pendingNext])) {
+      return false;
+    }
+    m_pendingNext++;
+    m_samples++;
+  }
+  return true;
+}
+
+void Replayer::play() {
+  uint32_t now = std::numeric_limits<uint32_t>::max();
+  if (m_speed > 0) {
+    double played = m_fromMs + m_clock.elapsed() * m_speed;
+    if (played < now) {
+      now = static_cast<uint32_t>(played);
+    }
+  }
+
+  if (!flushPending()) {
+    return;
+  }
+  while (m_haveNext && m_next.time_ms <= now) {
+    m_records++;
+    m_pendingCount = decodeReadings(m_next.type, m_next.id, m_next.data,
+                                    m_next.len, m_pending);
+    m_pendingNext = 0;
+    m_haveNext = m_recording.next(&m_pos, &m_next);
+    if (!flushPending()) {
+      return;
+    }
+  }
+
+  if (!m_haveNext) {
+    m_timer->stop();
+    emit finished(m_records, m_samples, m_clock.elapsed());
+  }
+}
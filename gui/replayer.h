@@ -0,0 +1,84 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+#include "protocol.h"
+#include "recording.h"
+#include "telemetryfeed.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+// Plays a recording back into a TelemetryRing, standing in for a
+// SerialReader, and like one meant to live on a thread of its own.  Records
+// are decoded straight from the map of the file.
+//
+// Nothing is dropped: when the ring is full, playback waits for the UI to
+// catch up.  So at a speed of 0, which plays the recording as fast as it
+// goes, the time it takes measures how fast the GUI decodes and draws.
+class Replayer : public QObject {
+  Q_OBJECT
+public:
+  // Plays `path` at `speed` times the speed it was recorded at, starting
+  // `fromMs` into it.
+  Replayer(const QString &path, double speed, uint32_t fromMs,
+           TelemetryRing *ring, QObject *parent = 0);
+
+Q_SIGNALS:
+  void error(const QString &message);
+  // At the end of the recording.
+  void finished(quint64 records, quint64 samples, qint64 elapsedMs);
+
+public slots:
+  // Opens the recording and starts playing it.  Call on the replayer's
+  // thread.
+  void start();
+
+private slots:
+  void play();
+
+private:
+  // Hands the readings of the last record to the ring.  Returns false if the
+  // ring filled first.
+  bool flushPending();
+
+  QString m_path;
+  double m_speed;
+  uint32_t m_fromMs;
+  TelemetryRing *m_ring;
+  QTimer *m_timer;
+  QElapsedTimer m_clock;
+
+  RecordingReader m_recording;
+  RecordingReader::Position m_pos;
+  RecordingEntry m_next;
+  bool m_haveNext;
+
+  TelemetrySample m_pending[READINGS_PER_PACKET_MAX];
+  int m_pendingCount;
+  int m_pendingNext;
+
+  quint64 m_records;
+  quint64 m_samples;
+};
+
+#endif // REPLAYER_H
@@ -0,0 +1,101 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "serialreader.h"
+#include <QtCore/QTimer>
+#include <QtSerialPort/QSerialPort>
+
+SerialReader::SerialReader(const QString &portName, qint32 baudRate,
+                           TelemetryRing *ring, QObject *parent)
+    : QObject(parent), m_portName(portName), m_baudRate(baudRate),
+      m_ring(ring), m_port(nullptr), m_droppedSamples(0), m_commands(this) {
+  // Queued over to this thread, wherever the command was sent from.
+  connect(&m_commands, &CommandClient::packetReady, this,
+          &SerialReader::writePacket);
+}
+
+void SerialReader::start() {
+  // Created here rather than in the constructor, so that the port belongs to
+  // this thread.
+  m_port = new QSerialPort(m_portName, this);
+  m_port->setBaudRate(m_baudRate);
+  m_port->setDataBits(QSerialPort::Data8);
+  m_port->setParity(QSerialPort::NoParity);
+  m_port->setStopBits(QSerialPort::OneStop);
+  m_port->setFlowControl(QSerialPort::NoFlowControl);
+  if (!m_port->open(QIODevice::ReadWrite)) {
+    emit error(m_port->errorString());
+    return;
+  }
+  connect(m_port, &QSerialPort::readyRead, this, &SerialReader::readData);
+
+  if (!m_recordPath.isEmpty() && !m_recording.open(m_recordPath)) {
+    emit error(m_recordPath + ": " + m_recording.errorString());
+  }
+  m_clock.start();
+
+  QTimer *expiry = new QTimer(this);
+  connect(expiry, &QTimer::timeout, &m_commands, &CommandClient::expire);
+  expiry->start(CommandClient::TIMEOUT_MS / 5);
+
+  // The scopes show pressure, volume and flow, at the full rate.
+  char dividers[TELEMETRY_CHANNELS] = {};
+  dividers[static_cast<uint8_t>(telemetryChannel::pressure)] = 1;
+  dividers[static_cast<uint8_t>(telemetryChannel::volume)] = 1;
+  dividers[static_cast<uint8_t>(telemetryChannel::flow)] = 1;
+  m_commands.send(command::set_subscription,
+                  std::string(dividers, sizeof(dividers)));
+}
+
+void SerialReader::readData() {
+  char buf[512];
+  qint64 len;
+  while ((len = m_port->read(buf, sizeof(buf))) > 0) {
+    for (qint64 i = 0; i < len; i++) {
+      if (m_decoder.push(buf[i])) {
+        const Packet &packet = m_decoder.packet();
+        if (m_recording.isOpen() &&
+            !m_recording.write(static_cast<uint32_t>(m_clock.elapsed()),
+                               packet.type, packet.id, packet.data,
+                               packet.len)) {
+          emit error(m_recordPath + ": " + m_recording.errorString());
+          m_recording.close();
+        }
+        handlePacket(packet);
+      }
+    }
+  }
+}
+
+void SerialReader::writePacket(const QByteArray &packet) {
+  if (m_port && m_port->isOpen()) {
+    m_port->write(packet);
+  }
+}
+
+void SerialReader::handlePacket(const Packet &packet) {
+  if (m_commands.handleResponse(packet)) {
+    return;
+  }
+
+  TelemetrySample samples[READINGS_PER_PACKET_MAX];
+  int count = decodeReadings(packet.type, packet.id, packet.data, packet.len,
+                             samples);
+  for (int i = 0; i < count; i++) {
+    if (!m_ring->push(samples[i])) {
+      m_droppedSamples++;
+    }
+  }
+}
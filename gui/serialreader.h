@@ -0,0 +1,89 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SERIALREADER_H
+#define SERIALREADER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+#include "commandclient.h"
+#include "protocol.h"
+#include "recording.h"
+#include "telemetryfeed.h"
+
+QT_BEGIN_NAMESPACE
+class QSerialPort;
+QT_END_NAMESPACE
+
+// Reads the controller's serial port and decodes its packets.  Meant to live
+// on a thread of its own, so that serial I/O never holds up rendering:
+//
+//   QThread thread;
+//   reader.moveToThread(&thread);
+//   QObject::connect(&thread, &QThread::started, &reader,
+//                    &SerialReader::start);
+//   thread.start();
+//
+// Readings go into `ring`, for a TelemetryFeed on the UI thread.  Every
+// packet can also go into a recording; see recordTo().  Commands go through
+// commands().
+class SerialReader : public QObject {
+  Q_OBJECT
+public:
+  SerialReader(const QString &portName, qint32 baudRate, TelemetryRing *ring,
+               QObject *parent = 0);
+
+  // Records the session to `path`, from when start() opens the port.  Call
+  // before start().
+  void recordTo(const QString &path) { m_recordPath = path; }
+
+  // For sending commands to the controller, from any thread.
+  CommandClient *commands() { return &m_commands; }
+
+  // Readings that didn't fit in the ring, because the UI fell behind.
+  quint64 droppedSamples() const { return m_droppedSamples; }
+
+Q_SIGNALS:
+  void error(const QString &message);
+
+public slots:
+  // Opens the port and asks the controller for its readings.  Call on the
+  // reader's thread.
+  void start();
+
+private slots:
+  void readData();
+  void writePacket(const QByteArray &packet);
+
+private:
+  void handlePacket(const Packet &packet);
+
+  QString m_portName;
+  qint32 m_baudRate;
+  TelemetryRing *m_ring;
+  QSerialPort *m_port;
+  PacketDecoder m_decoder;
+  quint64 m_droppedSamples;
+
+  CommandClient m_commands;
+
+  QString m_recordPath;
+  RecordingWriter m_recording;
+  QElapsedTimer m_clock;
+};
+
+#endif // SERIALREADER_H
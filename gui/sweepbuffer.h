@@ -0,0 +1,74 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef SWEEPBUFFER_H
+#define SWEEPBUFFER_H
+
+#include <vector>
+
+// The trace of a sweeping scope: a fixed number of slots, which new values
+// overwrite from left to right and then from the left again.  Nothing moves
+// once written, so a chart of it only needs to redraw the slots that
+// changed, which takeChanges() reports.
+class SweepBuffer {
+public:
+  explicit SweepBuffer(int size)
+      : m_values(size, 0), m_cursor(0), m_changed(0) {}
+
+  int size() const { return static_cast<int>(m_values.size()); }
+  double at(int slot) const { return m_values[slot]; }
+  // The slot the next value goes in.
+  int cursor() const { return m_cursor; }
+
+  void append(double value) {
+    m_values[m_cursor] = value;
+    m_cursor = m_cursor + 1 == size() ? 0 : m_cursor + 1;
+    if (m_changed < size()) {
+      m_changed++;
+    }
+  }
+
+  // Overwrites the value `back` slots behind the cursor, which then counts
+  // as changed.  For revising values that are still being worked out.
+  void amend(int back, double value) {
+    int slot = m_cursor - back;
+    if (slot < 0) {
+      slot += size();
+    }
+    m_values[slot] = value;
+    if (m_changed < back) {
+      m_changed = back;
+    }
+  }
+
+  // Returns how many slots changed since the last call, which are that many
+  // slots on from *first, wrapping around at the end.
+  int takeChanges(int *first) {
+    int changed = m_changed;
+    *first = m_cursor - changed;
+    if (*first < 0) {
+      *first += size();
+    }
+    m_changed = 0;
+    return changed;
+  }
+
+private:
+  std::vector<double> m_values;
+  int m_cursor;
+  int m_changed;
+};
+
+#endif // SWEEPBUFFER_H
@@ -1,4 +1,4 @@
-/* Copyright 2020, Edwin Chiu
+/* Copyright 2020, RespiraWorks
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -13,11 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#ifndef SOLENOID_H
-#define SOLENOID_H
+#include "telemetryfeed.h"
+#include "datasource.h"
 
-void solenoid_init();
-void solenoid_open();
-void solenoid_close();
-
-#endif // SOLENOID_H
+void TelemetryFeed::drain() {
+  TelemetrySample sample;
+  while (m_ring->pop(&sample)) {
+    for (DataSource *source : m_sources) {
+      source->addSample(sample);
+    }
+  }
+}
@@ -0,0 +1,47 @@
+/* Copyright 2020, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef TELEMETRYFEED_H
+#define TELEMETRYFEED_H
+
+#include <QtCore/QList>
+
+#include "spsc_ring.h"
+#include "telemetry_codec.h"
+
+class DataSource;
+
+// Readings on their way from the serial thread to the UI thread.  40 s of
+// readings at 100 Hz, far more than can arrive between two frames.
+typedef SpscRing<TelemetrySample, 4096> TelemetryRing;
+
+// The UI thread's end of a TelemetryRing, which hands each reading to every
+// DataSource showing live data.
+class TelemetryFeed {
+public:
+  explicit TelemetryFeed(TelemetryRing *ring) : m_ring(ring) {}
+
+  void addSource(DataSource *source) { m_sources.append(source); }
+
+  // Passes on everything that has arrived.  Cheap when nothing has, so each
+  // DataSource can call it on every update().
+  void drain();
+
+private:
+  TelemetryRing *m_ring;
+  QList<DataSource *> m_sources;
+};
+
+#endif // TELEMETRYFEED_H